@@ -1,10 +1,14 @@
 #pragma once
 
 #include "src/Dataset.h"
+#include "src/Quantization.h"
 #include "src/Datasets/XORDataset.h"
 #include "src/Datasets/MNISTDataset.h"
 #include "src/Datasets/MNISTAutoEncoderDataset.h"
 #include "src/Datasets/ThisPersonDoesNotExistsAutoEncoderDataset.h"
 #include "src/Datasets/GeneralFaces.h"
 #include "src/Datasets/FaceCompare.h"
-#include "src/Datasets/FaceRecognitionDataset.h"
\ No newline at end of file
+#include "src/Datasets/FaceRecognitionDataset.h"
+#include "src/Datasets/FaceTripletDataset.h"
+#include "src/Datasets/ShardedDataset.h"
+#include "src/Datasets/PrefixCacheDataset.h"
\ No newline at end of file
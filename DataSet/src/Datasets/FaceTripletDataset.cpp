@@ -0,0 +1,102 @@
+#include <assert.h>
+#include <random>
+
+#include "FaceTripletDataset.h"
+
+
+namespace_dataset_start
+
+FaceTripletDataset::FaceTripletDataset(
+	const std::string& positiveFolderPath, const std::string& positivePrefix, size_t positiveOffset, size_t positiveNumImages,
+	const std::string& negativeFolderPath, const std::string& negativePrefix, size_t negativeOffset, size_t negativeNumImages
+) : m_Width(0), m_Height(0), m_SampleIndex(0)
+{
+	m_Positives = LoadImages(positiveFolderPath, positivePrefix, positiveOffset, positiveNumImages);
+	m_Negatives = LoadImages(negativeFolderPath, negativePrefix, negativeOffset, negativeNumImages);
+	assert(m_Positives.size() > 1 && m_Negatives.size() > 0 && "Not enough images for triplets!");
+	Shuffle();
+}
+
+std::vector<Tensor2D> FaceTripletDataset::LoadImages(const std::string& folderPath, const std::string& prefix, size_t offset, size_t numImages)
+{
+	std::vector<Tensor2D> res;
+
+	for (size_t i = offset; i < offset + numImages; i++)
+	{
+		std::string filePath = folderPath + "/" + prefix + "_" + std::to_string(i) + ".jpg";
+		cv::Mat image = cv::imread(filePath, cv::IMREAD_COLOR);
+
+		if (image.empty())
+		{
+			throw std::runtime_error("No file at: " + filePath);
+		}
+
+		if ((m_Height > 0 && m_Height != image.rows) || (m_Width > 0 && m_Width != image.cols))
+		{
+			throw std::runtime_error("Image dimensions are different.");
+		}
+
+		m_Height = image.rows;
+		m_Width = image.cols;
+
+		mogi::Tensor2D imageTensor(image.rows, image.cols);
+		for (size_t i = 0; i < image.rows; i++)
+		{
+			for (size_t j = 0; j < image.cols; j++)
+			{
+				cv::Vec3b brgPixel = image.at<cv::Vec3b>(i, j);
+				float average = (float)(brgPixel.val[0] + brgPixel.val[1] + brgPixel.val[2]) / 3.0f;
+				float normalizedAverage = average / 255.0f;
+				imageTensor.SetAt(i, j, normalizedAverage);
+			}
+		}
+		res.push_back(imageTensor);
+	}
+
+	return res;
+}
+
+SampleShape FaceTripletDataset::GetSampleShape() const
+{
+	return
+	{
+		m_Height, m_Width, 3,
+		1, 1, 1
+	};
+}
+
+Sample FaceTripletDataset::GetSample() const
+{
+	std::random_device rd;
+
+	size_t positiveIndex = (m_SampleIndex + 1 + rd() % (m_Positives.size() - 1)) % m_Positives.size();  // Never the anchor.
+	size_t negativeIndex = rd() % m_Negatives.size();
+
+	Tensor3D input(m_Height, m_Width, 3, 0.0f);
+	CreateWatcher(input, 0).Add(m_Positives[m_SampleIndex]);
+	CreateWatcher(input, 1).Add(m_Positives[positiveIndex]);
+	CreateWatcher(input, 2).Add(m_Negatives[negativeIndex]);
+
+	return
+	{
+		input,
+		{ { { 0.0f } } }
+	};
+}
+
+void FaceTripletDataset::Next()
+{
+	m_SampleIndex = (m_SampleIndex + 1) % m_Positives.size();
+}
+
+void FaceTripletDataset::Shuffle()
+{
+	std::random_device rd;
+
+	for (size_t i = 0; i < m_Positives.size(); i++)
+	{
+		std::swap(m_Positives[i], m_Positives[rd() % m_Positives.size()]);
+	}
+}
+
+namespace_dataset_end
@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "../Dataset.h"
+#include <opencv2/opencv.hpp>
+
+
+namespace_dataset_start
+
+/*
+	Triplets for training an embedding model (see EmbeddingTrainer), the input stacks the three faces as channels:
+	0: anchor, 1: positive (the anchor's person), 2: negative (an other person). The label is not used.
+*/
+class DATASET_API FaceTripletDataset : public Dataset
+{
+public:
+	FaceTripletDataset(
+		const std::string& positiveFolderPath, const std::string& positivePrefix, size_t positiveOffset, size_t positiveNumImages,
+		const std::string& negativeFolderPath, const std::string& negativePrefix, size_t negativeOffset, size_t negativeNumImages
+	);
+
+	virtual SampleShape GetSampleShape() const;
+
+	virtual Sample GetSample() const;
+	virtual size_t GetEpochSize() const { return m_Positives.size(); }
+
+	virtual void Next();
+	virtual void Shuffle();
+
+private:
+	std::vector<Tensor2D> LoadImages(const std::string& folderPath, const std::string& prefix, size_t offset, size_t numImages);
+
+private:
+	size_t m_Height, m_Width;
+	std::vector<Tensor2D> m_Positives;
+	std::vector<Tensor2D> m_Negatives;
+	size_t m_SampleIndex;
+};
+
+namespace_dataset_end
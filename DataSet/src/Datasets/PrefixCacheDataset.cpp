@@ -0,0 +1,86 @@
+#include "PrefixCacheDataset.h"
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+#include <numeric>
+#include <stdexcept>
+
+
+namespace_dataset_start
+
+PrefixCacheDataset::PrefixCacheDataset(Dataset& dataset, const Model& model, const std::string& cachePath, unsigned int seed)
+	: m_SampleShape(dataset.GetSampleShape()), m_CachePath(cachePath), m_SampleIndex(0), m_Generator(seed)
+{
+	if (!dataset.IsModelCompatible(model))
+		throw std::runtime_error("The dataset is not compatible with the model!");
+
+	std::ofstream cacheFile;
+	if (!cachePath.empty())
+	{
+		cacheFile.open(cachePath, std::ios::binary);
+		if (!cacheFile.is_open())
+			throw std::runtime_error("Could not open the prefix cache file: " + cachePath);
+	}
+
+	for (size_t i = 0; i < dataset.GetEpochSize(); i++)
+	{
+		Sample sample = dataset.GetSample();
+		dataset.Next();
+
+		Tensor3D output = model.FeedForwardPrefix(sample.Input);
+		m_SampleShape.InputRows = output.GetRows();
+		m_SampleShape.InputCols = output.GetCols();
+		m_SampleShape.InputDepth = output.GetDepth();
+
+		if (cacheFile.is_open())
+			cacheFile.write((const char*)output.GetData(), output.GetSize() * sizeof(float));
+		else
+			m_Inputs.push_back(output);
+		m_Labels.push_back(sample.Label);
+	}
+
+	if (cacheFile.is_open())
+	{
+		cacheFile.close();
+		m_CacheFile = std::make_unique<MappedFile>(cachePath);
+
+		const size_t inputSize = m_SampleShape.InputRows * m_SampleShape.InputCols * m_SampleShape.InputDepth;
+		if (m_CacheFile->GetSize() != m_Labels.size() * inputSize * sizeof(float))
+			throw std::runtime_error("Could not write the prefix cache file: " + cachePath);
+	}
+
+	m_Order.resize(m_Labels.size());
+	std::iota(m_Order.begin(), m_Order.end(), 0);
+}
+
+PrefixCacheDataset::~PrefixCacheDataset()
+{
+	if (m_CacheFile)
+	{
+		m_CacheFile.reset();
+		std::remove(m_CachePath.c_str());
+	}
+}
+
+Sample PrefixCacheDataset::GetSample() const
+{
+	const size_t index = m_Order[m_SampleIndex];
+	if (!m_CacheFile)
+		return { m_Inputs[index], m_Labels[index] };
+
+	const size_t inputSize = m_SampleShape.InputRows * m_SampleShape.InputCols * m_SampleShape.InputDepth;
+	const float* data = (const float*)m_CacheFile->GetData() + index * inputSize;
+	return { Tensor3D(m_SampleShape.InputRows, m_SampleShape.InputCols, m_SampleShape.InputDepth, data, false), m_Labels[index] };
+}
+
+void PrefixCacheDataset::Next()
+{
+	m_SampleIndex = (m_SampleIndex + 1) % m_Order.size();
+}
+
+void PrefixCacheDataset::Shuffle()
+{
+	std::shuffle(m_Order.begin(), m_Order.end(), m_Generator);
+}
+
+namespace_dataset_end
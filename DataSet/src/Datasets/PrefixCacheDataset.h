@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <random>
+#include <string>
+
+#include "../Dataset.h"
+
+
+namespace_dataset_start
+
+/*
+	The samples of a dataset with their inputs replaced by the output of the model's frozen prefix (see Model::FeedForwardPrefix),
+	calculated once at construction, so an epoch only trains the layers after the prefix (see Model::BackPropagationFromPrefix).
+	The outputs are kept in memory, or written to the cache file and memory mapped (the pages are loaded by the OS when they are read),
+	the file is removed with the dataset. The model must be on the host, the dataset must give the same samples in every epoch.
+*/
+class DATASET_API PrefixCacheDataset : public Dataset
+{
+public:
+	PrefixCacheDataset(Dataset& dataset, const Model& model, const std::string& cachePath="", unsigned int seed=0);
+	~PrefixCacheDataset();
+
+	virtual SampleShape GetSampleShape() const { return m_SampleShape; }
+
+	virtual Sample GetSample() const;
+	virtual size_t GetEpochSize() const { return m_Order.size(); }
+
+	virtual void Next();
+	virtual void Shuffle();
+
+	inline bool IsMapped() const { return m_CacheFile != nullptr; }
+
+private:
+	SampleShape m_SampleShape;
+	std::vector<Tensor3D> m_Inputs;  // Empty, when the inputs are mapped.
+	std::vector<Tensor3D> m_Labels;
+	std::string m_CachePath;
+	std::unique_ptr<MappedFile> m_CacheFile;
+	std::vector<size_t> m_Order;
+	size_t m_SampleIndex;
+	std::mt19937 m_Generator;
+};
+
+namespace_dataset_end
@@ -0,0 +1,45 @@
+#include "ShardedDataset.h"
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace_dataset_start
+
+ShardedDataset::ShardedDataset(Dataset& dataset, size_t rank, size_t worldSize, unsigned int seed)
+	: m_SampleShape(dataset.GetSampleShape()), m_Rank(rank), m_WorldSize(worldSize), m_SampleIndex(0)
+{
+	if (worldSize == 0 || rank >= worldSize)
+		throw std::runtime_error("Invalid rank or world size for the sharded dataset!");
+
+	const size_t shardSize = dataset.GetEpochSize() / worldSize;
+	if (shardSize == 0)
+		throw std::runtime_error("The dataset is smaller than the world size!");
+
+	m_Samples.reserve(shardSize);
+	for (size_t i = 0; i < shardSize * worldSize; i++)
+	{
+		if (i % worldSize == rank)
+			m_Samples.push_back(dataset.GetSample());
+		dataset.Next();
+	}
+
+	std::seed_seq seedSequence = { seed, (unsigned int)rank };
+	m_Generator.seed(seedSequence);
+}
+
+Sample ShardedDataset::GetSample() const
+{
+	return m_Samples[m_SampleIndex];
+}
+
+void ShardedDataset::Next()
+{
+	m_SampleIndex = (m_SampleIndex + 1) % m_Samples.size();
+}
+
+void ShardedDataset::Shuffle()
+{
+	std::shuffle(m_Samples.begin(), m_Samples.end(), m_Generator);
+}
+
+namespace_dataset_end
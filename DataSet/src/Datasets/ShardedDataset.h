@@ -0,0 +1,40 @@
+#pragma once
+#include <vector>
+#include <random>
+
+#include "../Dataset.h"
+
+
+namespace_dataset_start
+
+/*
+	The rank-th shard of a dataset for the multi process training: the samples with index % worldSize == rank (in the dataset's current order).
+	Every shard has the same number of samples (the remainder of the dataset is dropped), so every rank runs the same number of steps in an epoch.
+	The dataset's order must be the same in every process (it must not be shuffled before), the shards are copied at construction.
+	Shuffle only reorders the shard, with a generator seeded by the seed and the rank.
+*/
+class DATASET_API ShardedDataset : public Dataset
+{
+public:
+	ShardedDataset(Dataset& dataset, size_t rank, size_t worldSize, unsigned int seed=0);
+
+	virtual SampleShape GetSampleShape() const { return m_SampleShape; }
+
+	virtual Sample GetSample() const;
+	virtual size_t GetEpochSize() const { return m_Samples.size(); }
+
+	virtual void Next();
+	virtual void Shuffle();
+
+	inline size_t GetRank() const { return m_Rank; }
+	inline size_t GetWorldSize() const { return m_WorldSize; }
+
+private:
+	std::vector<Sample> m_Samples;
+	SampleShape m_SampleShape;
+	size_t m_Rank, m_WorldSize;
+	size_t m_SampleIndex;
+	std::mt19937 m_Generator;
+};
+
+namespace_dataset_end
@@ -0,0 +1,108 @@
+#include "Quantization.h"
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+
+
+namespace_dataset_start
+
+static size_t Predict(const Tensor3D& output)
+{
+	if (output.GetSize() == 1)
+		return output.GetData()[0] > 0.5f ? 1 : 0;
+
+	return std::max_element(output.GetData(), output.GetData() + output.GetSize()) - output.GetData();
+}
+
+std::string QuantizationReport::ToString() const
+{
+	std::stringstream ss;
+
+	ss << "Quantization report over " << NumSamples << " # samples:\n" <<
+		"\tAccuracy: float " << Accuracy * 100.0f << "%, int8 " << QuantizedAccuracy * 100.0f << "%, agreement " << Agreement * 100.0f << "%\n" <<
+		"\tOutput error: mean " << MeanAbsoluteError << ", max " << MaxAbsoluteError << "\n" <<
+		"\tInference: float " << Microseconds << " us, int8 " << QuantizedMicroseconds << " us\n" <<
+		"\tParameters: float " << ParamsBytes << " bytes, int8 " << QuantizedParamsBytes << " bytes";
+
+	return ss.str();
+}
+
+QuantizedModel QuantizeModel(const Model& model, Dataset& dataset, size_t numSamples)
+{
+	QuantizationCalibrator calibrator(model);
+
+	for (size_t i = 0; i < numSamples; i++)
+	{
+		Sample sample = dataset.GetSample();
+		dataset.Next();
+
+		sample.Input.ToHost();
+		calibrator.Observe(sample.Input);
+	}
+
+	return calibrator.Quantize();
+}
+
+QuantizationReport EvaluateQuantization(const Model& model, const QuantizedModel& quantized, Dataset& dataset, size_t numSamples)
+{
+	QuantizationReport report;
+	report.NumSamples = numSamples ? numSamples : dataset.GetEpochSize();
+	report.QuantizedParamsBytes = quantized.GetParamsBytes();
+
+	std::shared_ptr<Layer> layer = model.GetRootLayer();
+	while (layer)
+	{
+		report.ParamsBytes += layer->GetLearnableParams() * sizeof(float);
+		layer = layer->NextLayer;
+	}
+
+	size_t numCorrect = 0, numQuantizedCorrect = 0, numAgreeing = 0, numOutputs = 0;
+	double sumError = 0.0, microseconds = 0.0, quantizedMicroseconds = 0.0;
+	for (size_t i = 0; i < report.NumSamples; i++)
+	{
+		Sample sample = dataset.GetSample();
+		dataset.Next();
+		sample.Input.ToHost();
+		sample.Label.ToHost();
+
+		auto start = std::chrono::high_resolution_clock::now();
+		Tensor3D output = model.FeedForward(sample.Input);
+		auto end = std::chrono::high_resolution_clock::now();
+		Tensor3D quantizedOutput = quantized.FeedForward(sample.Input);
+		auto quantizedEnd = std::chrono::high_resolution_clock::now();
+
+		microseconds += std::chrono::duration<double, std::micro>(end - start).count();
+		quantizedMicroseconds += std::chrono::duration<double, std::micro>(quantizedEnd - end).count();
+
+		size_t label = Predict(sample.Label);
+		size_t prediction = Predict(output);
+		size_t quantizedPrediction = Predict(quantizedOutput);
+		numCorrect += prediction == label;
+		numQuantizedCorrect += quantizedPrediction == label;
+		numAgreeing += prediction == quantizedPrediction;
+
+		for (size_t t = 0; t < output.GetSize(); t++)
+		{
+			float error = std::abs(output.GetData()[t] - quantizedOutput.GetData()[t]);
+			sumError += error;
+			report.MaxAbsoluteError = std::max(report.MaxAbsoluteError, error);
+		}
+		numOutputs += output.GetSize();
+	}
+
+	if (report.NumSamples)
+	{
+		report.Accuracy = (float)numCorrect / report.NumSamples;
+		report.QuantizedAccuracy = (float)numQuantizedCorrect / report.NumSamples;
+		report.Agreement = (float)numAgreeing / report.NumSamples;
+		report.Microseconds = microseconds / report.NumSamples;
+		report.QuantizedMicroseconds = quantizedMicroseconds / report.NumSamples;
+	}
+	if (numOutputs)
+		report.MeanAbsoluteError = sumError / numOutputs;
+
+	return report;
+}
+
+namespace_dataset_end
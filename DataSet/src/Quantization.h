@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include "Dataset.h"
+
+
+namespace_dataset_start
+
+// Accuracy of the quantized model against the float model over a dataset.
+struct DATASET_API QuantizationReport
+{
+	size_t NumSamples = 0;
+	// Rate of the samples where the prediction (the max position, or the output > 0.5 with one output) is the label's.
+	float Accuracy = 0.0f, QuantizedAccuracy = 0.0f;
+	// Rate of the samples where the two models predict the same.
+	float Agreement = 0.0f;
+	float MeanAbsoluteError = 0.0f, MaxAbsoluteError = 0.0f;
+	// Average inference time of a sample.
+	float Microseconds = 0.0f, QuantizedMicroseconds = 0.0f;
+	size_t ParamsBytes = 0, QuantizedParamsBytes = 0;
+
+	std::string ToString() const;
+};
+
+// Calibrates the quantization on numSamples samples of the dataset.
+DATASET_API QuantizedModel QuantizeModel(const Model& model, Dataset& dataset, size_t numSamples = 300);
+
+// Evaluates both models on numSamples samples of the dataset, 0 means an epoch.
+DATASET_API QuantizationReport EvaluateQuantization(const Model& model, const QuantizedModel& quantized, Dataset& dataset, size_t numSamples = 0);
+
+namespace_dataset_end
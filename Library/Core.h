@@ -11,3 +11,12 @@
 #else
 #define LIBRARY_API __declspec(dllimport)
 #endif // EXPORT_LIBRARY
+
+// The SIMD paths are compiled for the instruction sets of the build (/arch:AVX2, -mavx2 -mfma -mf16c or -march=native).
+// MSVC defines __AVX2__ with /arch:AVX2, but never __FMA__ or __F16C__, every AVX2 CPU has both.
+#if defined(__FMA__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define SIMD_FMA 1
+#endif
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define SIMD_F16C 1
+#endif
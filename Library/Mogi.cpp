@@ -20,6 +20,98 @@ void TestLibrary()
 	std::cout << "MatrixMultLeftTranspose: ";
 	TestMatrixMultLeftTranspose();
 	std::cout << std::endl;
+
+	std::cout << "ConvolutionBiasActivation: ";
+	TestConvolutionBiasActivation();
+	std::cout << std::endl;
+
+	std::cout << "MatrixMultBiasActivation: ";
+	TestMatrixMultBiasActivation();
+	std::cout << std::endl;
+
+	std::cout << "Softmax: ";
+	TestSoftmax();
+	std::cout << std::endl;
+
+	std::cout << "Loss: ";
+	TestLoss();
+	std::cout << std::endl;
+
+	std::cout << "MaxPool: ";
+	TestMaxPool();
+	std::cout << std::endl;
+
+	std::cout << "InferenceSession: ";
+	TestInferenceSession();
+	std::cout << std::endl;
+
+	std::cout << "Quantization: ";
+	TestQuantization();
+	std::cout << std::endl;
+
+	std::cout << "Embedding: ";
+	TestEmbedding();
+	std::cout << std::endl;
+
+	std::cout << "HNSW: ";
+	TestHNSW();
+	std::cout << std::endl;
+
+	std::cout << "Inference cache: ";
+	TestInferenceCache();
+	std::cout << std::endl;
+
+	std::cout << "Sliding window: ";
+	TestSlidingWindow();
+	std::cout << std::endl;
+
+	std::cout << "Model compiler: ";
+	TestModelCompiler();
+	std::cout << std::endl;
+
+	std::cout << "Static layers: ";
+	TestStaticLayers();
+	std::cout << std::endl;
+
+	std::cout << "Data parallel: ";
+	TestDataParallel();
+	std::cout << std::endl;
+
+	std::cout << "Process group: ";
+	TestProcessGroup();
+	std::cout << std::endl;
+
+	std::cout << "Pipeline model: ";
+	TestPipelineModel();
+	std::cout << std::endl;
+
+	std::cout << "Gradient checkpointing: ";
+	TestGradientCheckpointing();
+	std::cout << std::endl;
+
+	std::cout << "ReLU mask: ";
+	TestReluMask();
+	std::cout << std::endl;
+
+	std::cout << "BFloat16: ";
+	TestBFloat16();
+	std::cout << std::endl;
+
+	std::cout << "Quantized Adam: ";
+	TestQuantizedAdam();
+	std::cout << std::endl;
+
+	std::cout << "Frozen layers: ";
+	TestFrozenLayers();
+	std::cout << std::endl;
+
+	std::cout << "Grouped convolution: ";
+	TestGroupedConvolution();
+	std::cout << std::endl;
+
+	std::cout << "Strided convolution: ";
+	TestStridedConvolution();
+	std::cout << std::endl;
 }
 
 namespace_end
\ No newline at end of file
@@ -3,22 +3,42 @@
 #include "Core.h"
 
 #include "src/ThreadPool.h"
+#include "src/MappedFile.h"
+#include "src/SharedMemory.h"
+#include "src/ProcessGroup.h"
+#include "src/SPSCQueue.h"
+#include "src/LatencyWindow.h"
 
 #include "src/Math/Tensor2D.h"
 #include "src/Math/Tensor3D.h"
 #include "src/Math/Operation.h"
+#include "src/Math/BFloat16.h"
+#include "src/Math/StaticTensor.h"
+
+#include "src/Search/HNSWIndex.h"
 
 #include "src/NeuralNetwork/ActivationF.h"
 #include "src/NeuralNetwork/CostF.h"
 #include "src/NeuralNetwork/Initializer.h"
 #include "src/NeuralNetwork/DenseLayer.h"
 #include "src/NeuralNetwork/ConvolutionalLayer.h"
+#include "src/NeuralNetwork/GroupedConvolutionalLayer.h"
 #include "src/NeuralNetwork/ReshapeLayer.h"
 #include "src/NeuralNetwork/MaxPoolingLayer.h"
 #include "src/NeuralNetwork/NearestUpsamplingLayer.h"
 #include "src/NeuralNetwork/SoftmaxLayer.h"
 #include "src/NeuralNetwork/DropoutLayer.h"
 #include "src/NeuralNetwork/Model.h"
+#include "src/NeuralNetwork/InferenceSession.h"
+#include "src/NeuralNetwork/InferenceServer.h"
+#include "src/NeuralNetwork/InferenceCache.h"
+#include "src/NeuralNetwork/QuantizedModel.h"
+#include "src/NeuralNetwork/Embedding.h"
+#include "src/NeuralNetwork/SlidingWindow.h"
+#include "src/NeuralNetwork/ModelCompiler.h"
+#include "src/NeuralNetwork/StaticLayers.h"
+#include "src/NeuralNetwork/DataParallelModel.h"
+#include "src/NeuralNetwork/PipelineModel.h"
 
 namespace_start
 
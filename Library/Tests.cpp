@@ -1,6 +1,13 @@
 #include "Tests.h"
 #include <assert.h>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <limits>
 
 #include "Mogi.h"
 
@@ -603,4 +610,1638 @@ void TestMatrixMultLeftTranspose()
 	}
 }
 
+void TestConvolutionBiasActivation()
+{
+	Tensor3D input = Random3D(9, 9, 3, -1.0f, 1.0f);
+	Tensor3D kernels = Random3D(3, 3, 3 * 4, -1.0f, 1.0f);
+	Tensor3D bias = Random3D(9, 9, 4, -1.0f, 1.0f);
+	RelU relu(0.1f);
+
+	Tensor3D expected(9, 9, 4);
+	for (size_t d = 0; d < 4; d++)
+	{
+		Tensor3D kernelBlock = CreateWatcher(kernels, d * 3, 3);
+		Tensor2D outputSlice = CreateWatcher(expected, d);
+		Convolution(outputSlice, input, kernelBlock, 1, 1);
+	}
+	expected.Add(bias);
+	Tensor3D expectedPreActivation = expected;
+	relu.MapActivation(&expected);
+
+	{
+		Tensor3D result(9, 9, 4);
+		Tensor3D preActivation(9, 9, 4);
+		ConvolutionBiasActivation(result, input, kernels, &bias, relu.Activation, 1, 1, &preActivation);
+		assert(Compare(&result, &expected, 0.0001f) && Compare(&expected, &result, 0.0001f));
+		assert(Compare(&preActivation, &expectedPreActivation, 0.0001f) && Compare(&expectedPreActivation, &preActivation, 0.0001f));
+	}
+	std::cout << "+";
+
+	{
+		Tensor3D expectedPooled = MaxPool(expected, 2, 2);
+		Tensor3D result(4, 4, 4);
+		ConvolutionBiasActivationMaxPool(result, input, kernels, &bias, relu.Activation, 1, 1, 2, 2);
+		assert(Compare(&result, &expectedPooled, 0.0001f) && Compare(&expectedPooled, &result, 0.0001f));
+	}
+	std::cout << "+";
+
+	{
+		Tensor3D expectedStrided(4, 4, 4);
+		for (size_t d = 0; d < 4; d++)
+		{
+			Tensor3D kernelBlock = CreateWatcher(kernels, d * 3, 3);
+			Tensor2D outputSlice = CreateWatcher(expectedStrided, d);
+			Convolution(outputSlice, input, kernelBlock, 2, 0);
+		}
+		Tensor3D result(4, 4, 4);
+		ConvolutionBiasActivation(result, input, kernels, nullptr, [](float v) -> float { return v; }, 2, 0);
+		assert(Compare(&result, &expectedStrided, 0.0001f) && Compare(&expectedStrided, &result, 0.0001f));
+	}
+	std::cout << "+";
+}
+
+void TestMatrixMultBiasActivation()
+{
+	Tensor2D weights = Random2D(37, 300, -1.0f, 1.0f);
+	Tensor2D bias = Random2D(37, 1, -1.0f, 1.0f);
+	Sigmoid sigmoid;
+
+	{
+		Tensor2D input = Random2D(300, 1, -1.0f, 1.0f);
+		Tensor2D expectedPreActivation = MatrixMult(weights, input);
+		expectedPreActivation.Add(bias);
+		Tensor2D expected = Map(expectedPreActivation, sigmoid.Activation);
+
+		Tensor2D result(37, 1);
+		Tensor2D preActivation(37, 1);
+		MatrixMultBiasActivation(result, weights, input, &bias, sigmoid.Activation, &preActivation);
+		assert(Compare(&result, &expected, 0.0001f) && Compare(&expected, &result, 0.0001f));
+		assert(Compare(&preActivation, &expectedPreActivation, 0.0001f) && Compare(&expectedPreActivation, &preActivation, 0.0001f));
+	}
+	std::cout << "+";
+
+	{
+		Tensor2D input = Random2D(300, 5, -1.0f, 1.0f);
+		Tensor2D expected = MatrixMult(weights, input);
+		Tensor2D result(37, 5);
+		MatrixMultBiasActivation(result, weights, input, nullptr, [](float v) -> float { return v; });
+		assert(Compare(&result, &expected, 0.0001f) && Compare(&expected, &result, 0.0001f));
+	}
+	std::cout << "+";
+
+	{
+		Tensor2D left = Random2D(37, 1, -1.0f, 1.0f);
+		Tensor2D right = Random2D(300, 1, -1.0f, 1.0f);
+		Tensor2D expected = MatrixMultRightTranspose(left, right);
+		Tensor2D result(37, 300);
+		OuterProductTiles(left, right, [&result](size_t index, const float* tile, size_t size) {
+			for (size_t i = 0; i < size; i++)
+				result.GetData()[index + i] = tile[i];
+		});
+		assert(Compare(&result, &expected, 0.0001f) && Compare(&expected, &result, 0.0001f));
+	}
+	std::cout << "+";
+}
+
+void TestSoftmax()
+{
+	Tensor3D input = Random3D(50, 1, 1, -5.0f, 5.0f);
+	Tensor3D costs = Random3D(50, 1, 1, -1.0f, 1.0f);
+	Tensor3D output = Softmax(input);
+
+	{
+		float sum = 0.0f;
+		for (size_t i = 0; i < input.GetSize(); i++)
+			sum += exp(input.GetData()[i]);
+		Tensor3D expected = Map(input, [sum](float v) -> float { return exp(v) / sum; });
+		assert(Compare(&output, &expected, 0.0001f) && Compare(&expected, &output, 0.0001f));
+
+		Tensor3D shifted = Map(input, [](float v) -> float { return v + 1000.0f; });
+		Tensor3D shiftedOutput = Softmax(shifted);
+		assert(Compare(&shiftedOutput, &expected, 0.0001f) && Compare(&expected, &shiftedOutput, 0.0001f));
+	}
+	std::cout << "+";
+
+	{
+		Tensor3D expected(50, 1, 1);
+		for (size_t i = 0; i < output.GetSize(); i++)
+		{
+			float value = 0.0f;
+			for (size_t j = 0; j < output.GetSize(); j++)
+			{
+				float p = output.GetData()[j];
+				value += costs.GetData()[j] * p * ((i == j ? 1.0f : 0.0f) - output.GetData()[i]);
+			}
+			expected.GetData()[i] = value;
+		}
+		Tensor3D result = SoftmaxJacobianProduct(output, costs);
+		assert(Compare(&result, &expected, 0.0001f) && Compare(&expected, &result, 0.0001f));
+	}
+	std::cout << "+";
+
+	{
+		Tensor3D target(50, 1, 1);
+		target.SetAt(7, 0, 0, 1.0f);
+		CrossEntropyLoss loss(target);
+		Tensor3D expected = SoftmaxJacobianProduct(output, loss.DiffCost(output));
+		Tensor3D result = loss.SoftmaxDiffCost(output);
+		assert(Compare(&result, &expected, 0.0001f) && Compare(&expected, &result, 0.0001f));
+	}
+	std::cout << "+";
+}
+
+void TestLoss()
+{
+	Tensor3D output = Random3D(20, 1, 1, 0.05f, 0.95f);
+	Tensor3D target = Random3D(20, 1, 1, 0.0f, 1.0f);
+
+	CostType types[] = { CostType::MeanSquareError, CostType::CrossEntropy, CostType::BinaryCrossEntropy };
+	for (CostType type : types)
+	{
+		CostFunction reference = 
+			type == CostType::MeanSquareError ? (CostFunction)MeanSquareError(target) :
+			type == CostType::CrossEntropy ? (CostFunction)CrossEntropyLoss(target) : 
+			(CostFunction)BinaryCrossEntropyLoss(target);
+
+		Loss loss(type);
+		Tensor3D gradient(20, 1, 1);
+		float cost = loss.Evaluate(output, target, &gradient);
+		Tensor3D expected = reference.DiffCost(output);
+		assert(abs(cost - reference.Cost(output)) < 0.0001f);
+		assert(Compare(&gradient, &expected, 0.0001f) && Compare(&expected, &gradient, 0.0001f));
+
+		Tensor3D boundGradient = loss.Bind(target).DiffCost(output);
+		assert(abs(loss.GetLastCost() - cost) < 0.0001f);
+		assert(Compare(&boundGradient, &expected, 0.0001f) && Compare(&expected, &boundGradient, 0.0001f));
+
+		Tensor2D outputs = Random2D(20, 3, 0.05f, 0.95f);
+		Tensor2D targets = Random2D(20, 3, 0.0f, 1.0f);
+		Tensor2D gradients(20, 3);
+		float batchCost = loss.EvaluateBatch(outputs, targets, &gradients);
+		float expectedBatchCost = 0.0f;
+		for (size_t c = 0; c < 3; c++)
+		{
+			Tensor3D sampleOutput(20, 1, 1);
+			Tensor3D sampleTarget(20, 1, 1);
+			for (size_t r = 0; r < 20; r++)
+			{
+				sampleOutput.SetAt(r, 0, 0, outputs.GetAt(r, c));
+				sampleTarget.SetAt(r, 0, 0, targets.GetAt(r, c));
+			}
+			Tensor3D sampleGradient(20, 1, 1);
+			expectedBatchCost += loss.Evaluate(sampleOutput, sampleTarget, &sampleGradient);
+			for (size_t r = 0; r < 20; r++)
+				assert(abs(gradients.GetAt(r, c) - sampleGradient.GetAt(r, 0, 0)) < 0.0001f);
+		}
+		assert(abs(batchCost - expectedBatchCost) < 0.0001f);
+		std::cout << "+";
+	}
+
+	{
+		Loss loss(CostType::BinaryCrossEntropy);
+		Tensor3D gradient = loss.Bind(target).SigmoidDiffCost(output);
+		Tensor3D expected = loss.Bind(target).DiffCost(output);
+		expected.ElementWise(output, [](float c, float p) -> float { return c * p * (1.0f - p); });
+		assert(Compare(&gradient, &expected, 0.0001f) && Compare(&expected, &gradient, 0.0001f));
+	}
+	std::cout << "+";
+}
+
+void TestMaxPool()
+{
+	size_t shapes[][5] = { { 13, 10, 3, 2, 2 }, { 12, 12, 2, 3, 4 }, { 36, 34, 2, 17, 17 } };
+	for (auto& shape : shapes)
+	{
+		Tensor3D input = Random3D(shape[0], shape[1], shape[2], -1.0f, 1.0f);
+		size_t poolHeight = shape[3], poolWidth = shape[4];
+
+		Tensor3D expected(shape[0] / poolHeight, shape[1] / poolWidth, shape[2]);
+		for (size_t d = 0; d < expected.GetDepth(); d++)
+		{
+			Tensor2D slice = CreateWatcher(input, d);
+			for (size_t r = 0; r < expected.GetRows(); r++)
+				for (size_t c = 0; c < expected.GetCols(); c++)
+				{
+					Tensor2D window = CreateWatcher(slice, r * poolHeight, c * poolWidth, poolHeight, poolWidth, 0, 0);
+					auto pos = MaxPos(window);
+					expected.SetAt(r, c, d, window.GetAt(pos.first, pos.second));
+				}
+		}
+
+		MaxPoolIndices indices;
+		Tensor3D result = MaxPool(input, poolHeight, poolWidth);
+		Tensor3D indexedResult = MaxPool(input, poolHeight, poolWidth, &indices);
+		assert(Compare(&result, &expected, 0.0001f) && Compare(&expected, &result, 0.0001f));
+		assert(Compare(&indexedResult, &expected, 0.0001f) && Compare(&expected, &indexedResult, 0.0001f));
+		assert(indices.IsWide == (poolHeight * poolWidth > 256));
+
+		Tensor3D costs = Random3D(expected.GetRows(), expected.GetCols(), expected.GetDepth(), -1.0f, 1.0f);
+		Tensor3D expectedGradient(shape[0], shape[1], shape[2]);
+		Tensor3D gradient(shape[0], shape[1], shape[2]);
+		DistributeReverseMaxPool(expectedGradient, input, costs, poolHeight, poolWidth);
+		DistributeReverseMaxPool(gradient, indices, costs, poolHeight, poolWidth);
+		assert(Compare(&gradient, &expectedGradient, 0.0001f) && Compare(&expectedGradient, &gradient, 0.0001f));
+		std::cout << "+";
+	}
+}
+
+void TestInferenceSession()
+{
+	Model model;
+	model.AddLayer(std::make_shared<ConvolutionalLayer>(12, 12, 2, 3, 3, 4, 1, RelU(0.01f), Xavier(18, 4)));
+	model.AddLayer(std::make_shared<MaxPoolingLayer>(12, 12, 4, 2, 2));
+	model.AddLayer(std::make_shared<ReshapeLayer>(6, 6, 4, 144, 1, 1));
+	model.AddLayer(std::make_shared<DropoutLayer>(144, 1, 1, 0.5f));
+	model.AddLayer(std::make_shared<DenseLayer>(144, 10, Sigmoid(), Xavier(144, 10)));
+	model.AddLayer(std::make_shared<SoftmaxLayer>(10));
+
+	std::vector<Tensor3D> inputs;
+	std::vector<Tensor3D> expected;
+	for (size_t i = 0; i < 8; i++)
+	{
+		inputs.push_back(Random3D(12, 12, 2, -1.0f, 1.0f));
+		expected.push_back(model.FeedForward(inputs.back()));
+	}
+
+	{
+		InferenceSession session(model);
+		for (size_t i = 0; i < inputs.size(); i++)
+		{
+			const Tensor3D& output = session.Run(inputs[i]);
+			assert(Compare(&output, &expected[i], 0.0001f) && Compare(&expected[i], &output, 0.0001f));
+		}
+	}
+	std::cout << "+";
+
+	{
+		std::vector<std::thread> threads;
+		std::vector<int> isMatching(4, 1);
+		for (size_t t = 0; t < 4; t++)
+		{
+			threads.emplace_back([&, t]() {
+				InferenceSession session(model);
+				for (size_t k = 0; k < 20; k++)
+				{
+					size_t i = (t + k) % inputs.size();
+					const Tensor3D& output = session.Run(inputs[i]);
+					if (!(Compare(&output, &expected[i], 0.0001f) && Compare(&expected[i], &output, 0.0001f)))
+						isMatching[t] = 0;
+				}
+			});
+		}
+		for (auto& thread : threads)
+			thread.join();
+		for (int matching : isMatching)
+			assert(matching);
+	}
+	std::cout << "+";
+
+	{
+		InferenceSession session(model, true, 5);
+		std::vector<const Tensor3D*> batch = { &inputs[0], &inputs[3], &inputs[5] };
+		const std::vector<Tensor3D>& outputs = session.RunBatch(batch);
+		assert(Compare(&outputs[0], &expected[0], 0.0001f) && Compare(&expected[0], &outputs[0], 0.0001f));
+		assert(Compare(&outputs[1], &expected[3], 0.0001f) && Compare(&expected[3], &outputs[1], 0.0001f));
+		assert(Compare(&outputs[2], &expected[5], 0.0001f) && Compare(&expected[5], &outputs[2], 0.0001f));
+	}
+	std::cout << "+";
+
+	{
+		InferenceServer server(model, 4, 1000, 2, 3);
+		std::vector<std::future<Tensor3D>> outputs;
+		for (size_t i = 0; i < inputs.size(); i++)
+			outputs.push_back(server.Submit(inputs[i]));
+		for (size_t i = 0; i < inputs.size(); i++)
+		{
+			Tensor3D output = outputs[i].get();
+			assert(Compare(&output, &expected[i], 0.0001f) && Compare(&expected[i], &output, 0.0001f));
+		}
+		assert(server.GetStats().NumRequests == inputs.size());  // Counted beyond the latency window.
+	}
+
+	// The percentiles are over the last values, the memory is bounded.
+	LatencyWindow window(4);
+	for (size_t i = 0; i < 10; i++)
+		window.Add((float)i);
+	assert(window.GetCount() == 10 && window.Percentile(0.0f) == 6.0f && window.Percentile(1.0f) == 9.0f);
+	std::cout << "+";
+}
+
+void TestQuantization()
+{
+	{
+		std::vector<uint8_t> left(75);
+		std::vector<int8_t> right(75);
+		for (size_t i = 0; i < left.size(); i++)
+		{
+			left[i] = (uint8_t)(i * 37 % 128);
+			right[i] = (int8_t)((int)(i * 53 % 255) - 127);
+		}
+		for (size_t size : { 0, 5, 32, 64, 75 })
+		{
+			int32_t expected = 0;
+			for (size_t i = 0; i < size; i++)
+				expected += (int32_t)left[i] * (int32_t)right[i];
+			assert(DotProductU8S8(left.data(), right.data(), size) == expected);
+		}
+	}
+	std::cout << "+";
+
+	Model model;
+	model.AddLayer(std::make_shared<ConvolutionalLayer>(10, 10, 2, 3, 3, 4, 1, RelU(), Xavier(18, 4)));
+	model.AddLayer(std::make_shared<MaxPoolingLayer>(10, 10, 4, 2, 2));
+	model.AddLayer(std::make_shared<ConvolutionalLayer>(5, 5, 4, 3, 3, 6, 0, RelU(), Xavier(36, 6), false));
+	model.AddLayer(std::make_shared<ReshapeLayer>(3, 3, 6, 54, 1, 1));
+	model.AddLayer(std::make_shared<DenseLayer>(54, 16, RelU(), Xavier(54, 16)));
+	model.AddLayer(std::make_shared<DenseLayer>(16, 4, Sigmoid(), Xavier(16, 4)));
+
+	std::vector<Tensor3D> inputs;
+	QuantizationCalibrator calibrator(model);
+	for (size_t i = 0; i < 32; i++)
+	{
+		inputs.push_back(Random3D(10, 10, 2, -1.0f, 1.0f));
+		calibrator.Observe(inputs.back());
+	}
+	QuantizedModel quantized = calibrator.Quantize();
+
+	assert(quantized.GetLayers()[0]->IsQuantizingOutput() && !quantized.GetLayers()[5]->IsQuantizingOutput());
+	assert(quantized.GetParamsBytes() < (54 * 16 + 16 * 4) * sizeof(float));
+	for (const Tensor3D& input : inputs)
+	{
+		Tensor3D expected = model.FeedForward(input);
+		Tensor3D output = quantized.FeedForward(input);
+		assert(Compare(&output, &expected, 0.05f) && Compare(&expected, &output, 0.05f));
+	}
+	std::cout << "+";
+
+	QuantizedModel loaded;
+	for (const std::shared_ptr<QuantizedLayer>& layer : quantized.GetLayers())
+	{
+		loaded.AddLayer(layer->GetName(), layer->ToString());
+	}
+	for (const Tensor3D& input : inputs)
+	{
+		Tensor3D expected = quantized.FeedForward(input);
+		Tensor3D output = loaded.FeedForward(input);
+		assert(Compare(&output, &expected, 0.0001f) && Compare(&expected, &output, 0.0001f));
+	}
+	std::cout << "+";
+}
+
+void TestEmbedding()
+{
+	{
+		Tensor3D anchor = Random3D(6, 1, 1, 0.0f, 1.0f);
+		Tensor3D positive = Random3D(6, 1, 1, 0.0f, 1.0f);
+		Tensor3D negative = Random3D(6, 1, 1, 0.0f, 1.0f);
+		const float margin = 10.0f;  // The loss is active.
+
+		Tensor3D costs[3];
+		float loss = TripletLoss(anchor, positive, negative, margin, &costs[0], &costs[1], &costs[2]);
+		assert(loss > 0.0f);
+
+		Tensor3D* embeddings[3] = { &anchor, &positive, &negative };
+		for (size_t e = 0; e < 3; e++)
+		{
+			for (size_t t = 0; t < 6; t++)
+			{
+				float value = embeddings[e]->GetData()[t];
+				embeddings[e]->GetData()[t] = value + 0.001f;
+				float plus = TripletLoss(anchor, positive, negative, margin);
+				embeddings[e]->GetData()[t] = value - 0.001f;
+				float minus = TripletLoss(anchor, positive, negative, margin);
+				embeddings[e]->GetData()[t] = value;
+
+				assert(std::abs((plus - minus) / 0.002f - costs[e].GetData()[t]) < 0.01f);
+			}
+		}
+
+		Tensor3D leftCost, rightCost;
+		const float contrastiveMargin = 3.0f;  // Larger than the distance, the loss is active.
+		ContrastiveLoss(anchor, negative, false, contrastiveMargin, &leftCost, &rightCost);
+		for (size_t t = 0; t < 6; t++)
+		{
+			float value = anchor.GetData()[t];
+			anchor.GetData()[t] = value + 0.001f;
+			float plus = ContrastiveLoss(anchor, negative, false, contrastiveMargin);
+			anchor.GetData()[t] = value - 0.001f;
+			float minus = ContrastiveLoss(anchor, negative, false, contrastiveMargin);
+			anchor.GetData()[t] = value;
+
+			assert(std::abs((plus - minus) / 0.002f - leftCost.GetData()[t]) < 0.01f);
+			assert(std::abs(leftCost.GetData()[t] + rightCost.GetData()[t]) < 0.0001f);
+		}
+	}
+	std::cout << "+";
+
+	Model model;
+	model.AddLayer(std::make_shared<ReshapeLayer>(4, 4, 1, 16, 1, 1));
+	model.AddLayer(std::make_shared<DenseLayer>(16, 8, Sigmoid(), Xavier(16, 8)));
+
+	std::vector<Tensor3D> faces;
+	for (size_t i = 0; i < 3; i++)
+		faces.push_back(Random3D(4, 4, 1, 0.0f, 1.0f));
+
+	EmbeddingGallery gallery(model);
+	assert(gallery.GetEmbeddingSize() == 8 && gallery.Identify(faces[0]).Distance < 0.0f);
+	gallery.Enroll("first", faces[0]);
+	gallery.Enroll("second", faces[1]);
+	gallery.Enroll("third", faces[2]);
+	gallery.Enroll("second", faces[0]);
+
+	GalleryMatch match = gallery.Identify(faces[2]);
+	assert(match.Name == "third" && match.Index == 2 && match.Distance < 0.0001f);
+
+	float distance;
+	assert(gallery.Verify("second", faces[0], 0.0001f, &distance) && distance < 0.0001f);
+	assert(!gallery.Verify("third", faces[0], 0.0001f));
+
+	assert(gallery.Remove("second") == 2 && gallery.GetNumEmbeddings() == 2);
+	match = gallery.Identify(faces[2]);
+	assert(match.Name == "third" && match.Index == 2);
+	std::cout << "+";
+
+	gallery.Save("gallery_test.txt");
+	{
+		EmbeddingGallery loaded(model, "gallery_test.txt");
+		match = loaded.Identify(faces[2]);
+		assert(loaded.GetNumEmbeddings() == 2 && match.Name == "third" && match.Index == 1);
+	}
+
+	// The index of the saved order does not belong to the reordered embeddings, it is built again.
+	std::vector<std::string> lines(2);
+	{
+		std::ifstream file("gallery_test.txt");
+		std::getline(file, lines[0]);
+		std::getline(file, lines[1]);
+	}
+	{
+		std::ofstream file("gallery_test.txt");
+		file << lines[1] << std::endl << lines[0] << std::endl;
+	}
+	{
+		EmbeddingGallery loaded(model, "gallery_test.txt");
+		match = loaded.Identify(faces[2]);
+		assert(match.Name == "third" && match.Index == 0);
+	}
+
+	// An invalid index is built again from the text file.
+	std::ofstream("gallery_test.txt.hnsw", std::ios::binary) << "MOGIHNSW";
+	{
+		EmbeddingGallery loaded(model, "gallery_test.txt");
+		match = loaded.Identify(faces[0]);
+		assert(loaded.GetNumEmbeddings() == 2 && match.Name == "first" && match.Index == 1);
+	}
+	std::remove("gallery_test.txt");
+	std::remove("gallery_test.txt.hnsw");
+
+	bool isThrown = false;
+	try
+	{
+		EmbeddingGallery missing(model, "missing_gallery_test.txt");
+	}
+	catch (const std::runtime_error&)
+	{
+		isThrown = true;
+	}
+	assert(isThrown);
+	std::cout << "+";
+}
+
+void TestHNSW()
+{
+	{
+		Tensor2D left = Random2D(1, 37, -1.0f, 1.0f);
+		Tensor2D right = Random2D(1, 37, -1.0f, 1.0f);
+
+		float expected = 0.0f;
+		for (size_t c = 0; c < 37; c++)
+			expected += (left.GetAt(0, c) - right.GetAt(0, c)) * (left.GetAt(0, c) - right.GetAt(0, c));
+
+		assert(std::abs(SquaredDistance(left.GetData(), right.GetData(), 37) - expected) < 0.0001f);
+	}
+	std::cout << "+";
+
+	Tensor2D vectors = Random2D(2000, 16, -1.0f, 1.0f);
+	Tensor2D queries = Random2D(50, 16, -1.0f, 1.0f);
+
+	HNSWIndex index(16, 8, 100);
+	assert(index.Search(queries.GetData(), 5).empty());
+	index.Add(vectors);
+	assert(index.GetCount() == 2000 && index.GetSize() == 2000);
+
+	SearchRecallReport report = index.EvaluateRecall(queries, 10, 64);
+	assert(report.NumQueries == 50 && report.Recall > 0.9f);
+
+	std::vector<SearchResult> results = index.Search(vectors.GetData() + 16 * 7, 3);
+	assert(results.size() == 3 && results[0].Id == 7 && results[0].Distance < 0.0001f);
+	assert(results[0].Distance <= results[1].Distance && results[1].Distance <= results[2].Distance);
+	std::cout << "+";
+
+	assert(index.Remove(7) && !index.Remove(7) && index.GetSize() == 1999);
+	results = index.Search(vectors.GetData() + 16 * 7, 3);
+	assert(results.size() == 3 && results[0].Id != 7 && results[1].Id != 7 && results[2].Id != 7);
+	assert(index.ExactSearch(vectors.GetData() + 16 * 7, 1)[0].Id == results[0].Id);
+	std::cout << "+";
+
+	index.Save("HNSWTest.hnsw");
+	{
+		HNSWIndex loaded("HNSWTest.hnsw");
+		assert(loaded.IsMapped() && loaded.GetCount() == 2000 && loaded.GetSize() == 1999 && loaded.IsRemoved(7));
+
+		for (size_t q = 0; q < 50; q++)
+		{
+			std::vector<SearchResult> expected = index.Search(queries.GetData() + 16 * q, 5);
+			std::vector<SearchResult> loadedResults = loaded.Search(queries.GetData() + 16 * q, 5);
+			for (size_t i = 0; i < expected.size(); i++)
+				assert(expected[i].Id == loadedResults[i].Id);
+		}
+
+		size_t id = loaded.Add(queries.GetData());
+		assert(!loaded.IsMapped() && id == 2000 && loaded.Search(queries.GetData(), 1)[0].Id == id);
+	}
+
+	// A truncated file or an invalid header throws and leaves the index as it was.
+	{
+		std::ifstream file("HNSWTest.hnsw", std::ios::binary);
+		std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		std::ofstream("HNSWTruncated.hnsw", std::ios::binary).write(data.data(), data.size() / 2);
+
+		uint64_t maxConnections = 1;
+		data.replace(24, sizeof(maxConnections), (const char*)&maxConnections, sizeof(maxConnections));  // After the magic, version and dimension.
+		std::ofstream("HNSWInvalid.hnsw", std::ios::binary).write(data.data(), data.size());
+	}
+	{
+		HNSWIndex loaded("HNSWTest.hnsw");
+		for (const char* filePath : { "HNSWTruncated.hnsw", "HNSWInvalid.hnsw" })
+		{
+			bool isThrown = false;
+			try
+			{
+				loaded.Load(filePath);
+			}
+			catch (const std::runtime_error&)
+			{
+				isThrown = true;
+			}
+			assert(isThrown && loaded.GetCount() == 2000 && loaded.GetSize() == 1999);
+			assert(loaded.Search(vectors.GetData() + 16 * 8, 1)[0].Id == 8);
+		}
+	}
+	std::remove("HNSWTest.hnsw");
+	std::remove("HNSWTruncated.hnsw");
+	std::remove("HNSWInvalid.hnsw");
+	std::cout << "+";
+}
+
+void TestInferenceCache()
+{
+	{
+		Tensor3D input = { { { 1.0f, 2.0f, 3.0f }, { 4.0f, 5.0f, 6.0f }, { 7.0f, 8.0f, 9.0f } } };
+		std::vector<float> signature;
+		InferenceCache::ComputeSignature(input, 2, signature);
+		assert(signature.size() == 4);
+		assert(signature[0] == 3.0f && signature[1] == 4.5f && signature[2] == 7.5f && signature[3] == 9.0f);
+	}
+	std::cout << "+";
+
+	Model model;
+	model.AddLayer(std::make_shared<ReshapeLayer>(16, 16, 1, 256, 1, 1));
+	model.AddLayer(std::make_shared<DenseLayer>(256, 4, Sigmoid(), Xavier(256, 4)));
+
+	InferenceCache cache(model, 0.02f, 3, 0, 8);
+	Tensor3D frame = Random3D(16, 16, 1, 0.0f, 1.0f);
+	Tensor3D expected = model.FeedForward(frame);
+
+	auto isEqual = [](const Tensor3D& left, const Tensor3D& right)
+	{
+		for (size_t i = 0; i < left.GetSize(); i++)
+			if (left.GetData()[i] != right.GetData()[i])
+				return false;
+		return left.GetSize() == right.GetSize();
+	};
+
+	assert(isEqual(cache.FeedForward(frame), expected));
+	for (size_t i = 0; i < 3; i++)
+	{
+		Tensor3D similarFrame = frame;
+		similarFrame.SetAt(i, i, 0, similarFrame.GetAt(i, i, 0) + 0.5f);  // Changes a block's mean by 0.5 / 64.
+		assert(isEqual(cache.FeedForward(similarFrame), expected));
+	}
+	assert(cache.GetStats().NumHits == 3);
+
+	// The output is stale after 3 hits.
+	cache.FeedForward(frame);
+	assert(cache.GetStats().NumHits == 3 && cache.GetStats().NumRequests == 5);
+	std::cout << "+";
+
+	Tensor3D otherFrame = Random3D(16, 16, 1, 0.5f, 1.5f);
+	assert(isEqual(cache.FeedForward(otherFrame), model.FeedForward(otherFrame)));
+	assert(isEqual(cache.FeedForward(otherFrame), model.FeedForward(otherFrame)));
+	cache.Invalidate();
+	cache.FeedForward(otherFrame);
+
+	InferenceCacheStats stats = cache.GetStats();
+	assert(stats.NumRequests == 8 && stats.NumHits == 4 && stats.HitRate == 0.5f);
+	assert(stats.SavedMilliseconds == stats.AverageFeedForwardMilliseconds * 4);
+
+	cache.ResetStats();
+	assert(cache.GetStats().NumRequests == 0);
+	std::cout << "+";
+}
+
+void TestSlidingWindow()
+{
+	Model model;
+	model.AddLayer(std::make_shared<ConvolutionalLayer>(16, 16, 1, 3, 3, 4, 0, RelU(), He(3 * 3), false));
+	model.AddLayer(std::make_shared<MaxPoolingLayer>(14, 14, 4, 2, 2));
+	model.AddLayer(std::make_shared<ReshapeLayer>(7, 7, 4, 7 * 7 * 4, 1, 1));
+	model.AddLayer(std::make_shared<DenseLayer>(7 * 7 * 4, 8, RelU(), Xavier(7 * 7 * 4, 8)));
+	model.AddLayer(std::make_shared<DropoutLayer>(8, 1, 1, 0.5f));
+	model.AddLayer(std::make_shared<DenseLayer>(8, 2, Sigmoid(), Xavier(8, 2)));
+
+	size_t stride = 0;
+	Model fullyConvolutional = ConvertToFullyConvolutional(model, 40, 48, &stride);
+	ModelShape shape = fullyConvolutional.GetModelShape();
+	assert(stride == 2 && shape.OutputRows == 13 && shape.OutputCols == 17 && shape.OutputDepth == 2);
+
+	Tensor3D frame = Random3D(40, 48, 1, 0.0f, 1.0f);
+	Tensor3D scoreMap = fullyConvolutional.FeedForward(frame);
+	for (size_t r = 0; r < shape.OutputRows; r++)
+	{
+		for (size_t c = 0; c < shape.OutputCols; c++)
+		{
+			Tensor3D window(16, 16, 1);
+			for (size_t y = 0; y < 16; y++)
+				for (size_t x = 0; x < 16; x++)
+					window.SetAt(y, x, 0, frame.GetAt(r * stride + y, c * stride + x, 0));
+
+			Tensor3D output = model.FeedForward(window);
+			assert(std::abs(output.GetAt(0, 0, 0) - scoreMap.GetAt(r, c, 0)) < 0.0001f);
+			assert(std::abs(output.GetAt(1, 0, 0) - scoreMap.GetAt(r, c, 1)) < 0.0001f);
+		}
+	}
+	std::cout << "+";
+
+	SlidingWindowDetector detector(model, 40, 48, { 1.0f, 0.5f });
+	std::vector<Tensor3D> scoreMaps = detector.Evaluate(frame);
+	assert(scoreMaps.size() == 2 && scoreMaps[1].GetRows() == 3 && scoreMaps[1].GetCols() == 5);
+
+	float maxScore = 0.0f;
+	for (size_t t = 0; t < scoreMap.GetRows() * scoreMap.GetCols(); t++)
+		maxScore = std::max(maxScore, scoreMap.GetData()[t]);
+	for (size_t t = 0; t < scoreMaps[1].GetRows() * scoreMaps[1].GetCols(); t++)
+		maxScore = std::max(maxScore, scoreMaps[1].GetData()[t]);
+
+	WindowDetection best = detector.FindBest(frame);
+	assert(best.Score == maxScore && best.Row + best.Rows <= 40 && best.Col + best.Cols <= 48);
+	assert((best.Scale == 1.0f && best.Rows == 16) || (best.Scale == 0.5f && best.Rows == 32));
+
+	std::vector<WindowDetection> detections = detector.Detect(frame, 0.0f);
+	assert(detections.size() == 13 * 17 + 3 * 5 && detections.front().Score == maxScore);
+	for (size_t i = 1; i < detections.size(); i++)
+		assert(detections[i - 1].Score >= detections[i].Score);
+	std::cout << "+";
+
+	// A bias which depends on the position can't be converted.
+	Model biasedModel;
+	biasedModel.AddLayer(std::make_shared<ConvolutionalLayer>(16, 16, 1, 3, 3, 4, 0, RelU(), Uniform(-1.0f, 1.0f), true));
+	biasedModel.AddLayer(std::make_shared<ReshapeLayer>(14, 14, 4, 14 * 14 * 4, 1, 1));
+	biasedModel.AddLayer(std::make_shared<DenseLayer>(14 * 14 * 4, 1, Sigmoid(), Xavier(14 * 14 * 4, 1)));
+	bool isThrown = false;
+	try
+	{
+		ConvertToFullyConvolutional(biasedModel, 40, 48);
+	}
+	catch (const std::runtime_error&)
+	{
+		isThrown = true;
+	}
+	assert(isThrown);
+	std::cout << "+";
+}
+
+// Reads back an array of the generated source.
+static std::vector<float> ParseGeneratedArray(const std::string& source, const std::string& name)
+{
+	size_t start = source.find(name + "[");
+	assert(start != std::string::npos && "The array is not generated!");
+	start = source.find('{', start) + 1;
+	size_t end = source.find('}', start);
+
+	std::vector<float> values;
+	std::stringstream ss(source.substr(start, end - start));
+	std::string value;
+	while (ss >> value)
+	{
+		values.push_back(std::stof(value));
+	}
+	return values;
+}
+
+static bool IsGeneratedArrayEqual(const std::string& source, const std::string& name, const Tensor& tensor)
+{
+	std::vector<float> values = ParseGeneratedArray(source, name);
+	return values.size() == tensor.GetSize() && std::equal(values.begin(), values.end(), tensor.GetData());
+}
+
+void TestModelCompiler()
+{
+	std::shared_ptr<ConvolutionalLayer> convolutionalLayer = std::make_shared<ConvolutionalLayer>(12, 12, 2, 3, 3, 4, 1, RelU(0.1f), He(3 * 3 * 2), true);
+	std::shared_ptr<DenseLayer> denseLayer = std::make_shared<DenseLayer>(6 * 6 * 4, 5, Sigmoid(), Xavier(6 * 6 * 4, 5));
+
+	Model model;
+	model.AddLayer(convolutionalLayer);
+	model.AddLayer(std::make_shared<MaxPoolingLayer>(12, 12, 4, 2, 2));
+	model.AddLayer(std::make_shared<ReshapeLayer>(6, 6, 4, 6 * 6 * 4, 1, 1));
+	model.AddLayer(denseLayer);
+	model.AddLayer(std::make_shared<SoftmaxLayer>(5));
+
+	ModelCompiler compiler(model, "compiled_model");
+	std::string header = compiler.GenerateHeader();
+	assert(header.find("namespace compiled_model") != std::string::npos);
+	assert(header.find("InputRows = 12, InputCols = 12, InputDepth = 2") != std::string::npos);
+	assert(header.find("OutputSize = 5;") != std::string::npos);
+	assert(header.find("void Run(const float* input, float* output);") != std::string::npos);
+
+	std::string source = compiler.GenerateSource("compiled_model.h");
+	assert(source.find("#include \"compiled_model.h\"") != std::string::npos);
+	assert(source.find("Layer0Kernels[" + std::to_string(3 * 3 * 2 * 4) + "]") != std::string::npos);
+	assert(source.find("Layer3Weights[" + std::to_string(6 * 6 * 4 * 5) + "]") != std::string::npos);
+	assert(source.find("Layer2") == std::string::npos);  // The reshape is left out.
+	assert(source.find("static float Buffer0[" + std::to_string(12 * 12 * 4) + "]") != std::string::npos);
+	assert(source.find("new ") == std::string::npos && source.find("malloc") == std::string::npos);
+	std::cout << "+";
+
+	// The constants are the layers' params (they are written with full precision), in the order the loops index them.
+	assert(IsGeneratedArrayEqual(source, "Layer0Kernels", convolutionalLayer->GetKernels()));
+	assert(IsGeneratedArrayEqual(source, "Layer0Bias", convolutionalLayer->GetBias()));
+	assert(IsGeneratedArrayEqual(source, "Layer3Weights", denseLayer->GetWeights()));
+	assert(IsGeneratedArrayEqual(source, "Layer3Bias", denseLayer->GetBias()));
+
+	assert(source.find("constexpr int KernelRows = 3, KernelCols = 3, Padding = 1, Stride = 1;") != std::string::npos);
+	assert(source.find("Layer0Kernels[((n * InputDepth + d) * KernelRows + ky) * KernelCols + kx]") != std::string::npos);
+	assert(source.find("outputRow[x] += weight * inputRow[x * Stride];") != std::string::npos);
+	assert(source.find("constexpr int Inputs = " + std::to_string(6 * 6 * 4) + ", Outputs = 5;") != std::string::npos);
+	assert(source.find("const float* weights = Layer3Weights + o * Inputs;") != std::string::npos);
+
+	// The layers are chained through the two buffers, the reshape only renames its input.
+	assert(source.find("\tLayer0(input, Buffer0);\n\tLayer1(Buffer0, Buffer1);\n\tLayer3(Buffer1, Buffer0);\n\tLayer4(Buffer0, Buffer1);\n"
+		"\tstd::memcpy(output, Buffer1, OutputSize * sizeof(float));") != std::string::npos);
+	std::cout << "+";
+
+	// An activation function without generated code can't be compiled.
+	ActivationFunciton custom = Sigmoid();
+	custom.Name = "custom";
+	Model customModel;
+	customModel.AddLayer(std::make_shared<DenseLayer>(4, 2, custom, Xavier(4, 2)));
+	bool isThrown = false;
+	try
+	{
+		ModelCompiler(customModel, "custom_model").GenerateSource("custom_model.h");
+	}
+	catch (const std::runtime_error&)
+	{
+		isThrown = true;
+	}
+	assert(isThrown);
+	std::cout << "+";
+}
+
+void TestStaticLayers()
+{
+	Model model;
+	model.AddLayer(std::make_shared<ConvolutionalLayer>(6, 6, 2, 3, 3, 4, 1, RelU(0.1f), He(3 * 3 * 2), true));
+	model.AddLayer(std::make_shared<MaxPoolingLayer>(6, 6, 4, 2, 2));
+	model.AddLayer(std::make_shared<ReshapeLayer>(3, 3, 4, 3 * 3 * 4, 1, 1));
+	model.AddLayer(std::make_shared<DenseLayer>(3 * 3 * 4, 3, Sigmoid(), Xavier(3 * 3 * 4, 3)));
+
+	using StaticConvModel = StaticModel<
+		StaticConv<6, 6, 2, 3, 3, 4, 1, StaticRelU<1, 10>>,
+		StaticMaxPool<6, 6, 4, 2, 2>,
+		StaticDense<3 * 3 * 4, 3, StaticSigmoid>>;
+	StaticConvModel staticModel(model);
+
+	Tensor3D input = Random3D(6, 6, 2, -1.0f, 1.0f);
+	StaticConvModel::Output output = staticModel.FeedForward(StaticConvModel::Input(input));
+	Tensor3D expected = model.FeedForward(input);
+	for (size_t t = 0; t < expected.GetSize(); t++)
+		assert(std::abs(output[t] - expected.GetData()[t]) < 0.0001f);
+	std::cout << "+";
+
+	// The converted model has the reshape back and the same weights.
+	Model convertedModel = staticModel.ToModel();
+	assert(convertedModel.IsModelCorrect() && convertedModel.GetRootLayer()->NextLayer->NextLayer->GetName() == ReshapeLayer::ClassName());
+	Tensor3D convertedOutput = convertedModel.FeedForward(input);
+	for (size_t t = 0; t < expected.GetSize(); t++)
+		assert(std::abs(convertedOutput.GetData()[t] - expected.GetData()[t]) < 0.0001f);
+
+	StaticModel<StaticDense<2, 3, StaticSigmoid>, StaticDense<3, 1, StaticSigmoid>> xorModel;
+	xorModel.GetLayer<0>() = StaticDense<2, 3, StaticSigmoid>(Xavier(2, 3));
+	xorModel.GetLayer<1>() = StaticDense<3, 1, StaticSigmoid>(Xavier(3, 1));
+	xorModel.Save("static_model_test.txt");
+	Model loadedModel("static_model_test.txt");
+	std::remove("static_model_test.txt");
+	StaticTensor<2, 1, 1> xorInput;
+	xorInput[0] = 1.0f;
+	Tensor3D loadedOutput = loadedModel.FeedForward(xorInput.ToTensor3D());
+	assert(std::abs(loadedOutput.GetData()[0] - xorModel.FeedForward(xorInput)[0]) < 0.0001f);
+	std::cout << "+";
+
+	// A layer with another shape or activation can't be loaded.
+	bool isThrown = false;
+	try
+	{
+		StaticModel<StaticDense<2, 3, StaticRelU<>>, StaticDense<3, 1, StaticSigmoid>> reluModel(loadedModel);
+	}
+	catch (const std::runtime_error&)
+	{
+		isThrown = true;
+	}
+	assert(isThrown);
+	std::cout << "+";
+}
+
+static std::vector<float> GetModelParams(const Model& model)
+{
+	std::vector<float> params;
+	for (std::shared_ptr<Layer> layer = model.GetRootLayer(); layer; layer = layer->NextLayer)
+		for (const LearnableTensor& tensor : layer->GetLearnableTensors())
+			params.insert(params.end(), tensor.Params->GetData(), tensor.Params->GetData() + tensor.Params->GetSize());
+	return params;
+}
+
+void TestDataParallel()
+{
+	for (bool isDropout : { false, true })
+	{
+		Model initialModel;
+		initialModel.AddLayer(std::make_shared<ConvolutionalLayer>(6, 6, 1, 3, 3, 2, 0, RelU(0.1f), Uniform(-0.5f, 0.5f), true));
+		initialModel.AddLayer(std::make_shared<ReshapeLayer>(4, 4, 2, 4 * 4 * 2, 1, 1));
+		if (isDropout)
+			initialModel.AddLayer(std::make_shared<DropoutLayer>(4 * 4 * 2, 1, 1, 0.25f));
+		initialModel.AddLayer(std::make_shared<DenseLayer>(4 * 4 * 2, 2, Sigmoid(), Xavier(4 * 4 * 2, 2)));
+		initialModel.InitializeOptimizer(OptimizerFactory(OptimizerType::SGD));
+		initialModel.Save(isDropout ? "data_parallel_dropout_test.txt" : "data_parallel_test.txt");
+	}
+
+	std::vector<Tensor3D> inputs, labels;
+	for (size_t i = 0; i < 6; i++)
+	{
+		inputs.push_back(Random3D(6, 6, 1, -1.0f, 1.0f));
+		labels.push_back(Tensor3D({ { { (float)(i % 2) }, { (float)(1 - i % 2) } } }));
+	}
+
+	// One replica with one sample per batch is the sequential training.
+	Model sequentialModel("data_parallel_test.txt");
+	Model singleModel("data_parallel_test.txt");
+	Loss loss(CostType::MeanSquareError);
+	{
+		DataParallelModel dataParallel(singleModel, 1, loss);
+		for (size_t i = 0; i < inputs.size(); i++)
+		{
+			sequentialModel.BackPropagation(inputs[i], loss.Bind(labels[i]), 0.5f, i);
+			dataParallel.TrainBatch({ inputs[i] }, { labels[i] }, 0.5f, i);
+		}
+	}
+	std::vector<float> sequentialParams = GetModelParams(sequentialModel), singleParams = GetModelParams(singleModel);
+	for (size_t i = 0; i < sequentialParams.size(); i++)
+		assert(std::abs(sequentialParams[i] - singleParams[i]) < 0.00001f);
+	std::cout << "+";
+
+	// The mean gradient of a batch does not depend on the number of replicas (up to the summation order).
+	Model oneReplicaModel("data_parallel_test.txt"), threeReplicasModel("data_parallel_test.txt");
+	float oneReplicaCost = DataParallelModel(oneReplicaModel, 1, loss).TrainBatch(inputs, labels, 0.5f, 0);
+	float threeReplicasCost = DataParallelModel(threeReplicasModel, 3, loss).TrainBatch(inputs, labels, 0.5f, 0);
+	assert(std::abs(oneReplicaCost - threeReplicasCost) < 0.00001f);
+	std::vector<float> oneReplicaParams = GetModelParams(oneReplicaModel), threeReplicasParams = GetModelParams(threeReplicasModel);
+	for (size_t i = 0; i < oneReplicaParams.size(); i++)
+		assert(std::abs(oneReplicaParams[i] - threeReplicasParams[i]) < 0.00001f);
+	std::cout << "+";
+
+	// With dropout the training is reproducible for a seed and a number of replicas.
+	Model firstModel("data_parallel_dropout_test.txt"), secondModel("data_parallel_dropout_test.txt");
+	{
+		DataParallelModel first(firstModel, 3, loss, 42), second(secondModel, 3, loss, 42);
+		for (size_t t = 0; t < 3; t++)
+		{
+			first.TrainBatch(inputs, labels, 0.5f, t);
+			second.TrainBatch(inputs, labels, 0.5f, t);
+		}
+	}
+	assert(GetModelParams(firstModel) == GetModelParams(secondModel));
+	std::remove("data_parallel_test.txt");
+	std::remove("data_parallel_dropout_test.txt");
+	std::cout << "+";
+}
+
+void TestProcessGroup()
+{
+	// The ranks are threads here, the shared memory works the same way between processes.
+	const std::string name = "mogi_test_" + std::to_string(std::random_device()());
+	const size_t worldSize = 3, size = 12;
+	std::vector<std::vector<float>> results(worldSize), broadcasts(worldSize);
+	{
+		std::vector<std::thread> ranks;
+		for (size_t rank = 0; rank < worldSize; rank++)
+		{
+			ranks.emplace_back([&, rank] {
+				ProcessGroup group(name + "_collectives", rank, worldSize, 5);  // The buffers are larger than the capacity.
+				for (size_t i = 0; i < 10; i++)
+					group.Barrier();
+
+				std::vector<float> data(size);
+				for (size_t i = 0; i < size; i++)
+					data[i] = rank * 100.0f + i;
+				group.AllReduce(data.data(), size);
+				results[rank] = data;
+
+				std::vector<float> broadcast(size, (float)rank);
+				group.Broadcast(broadcast.data(), size, 1);
+				broadcasts[rank] = broadcast;
+			});
+		}
+		for (std::thread& rank : ranks)
+			rank.join();
+	}
+	for (size_t rank = 0; rank < worldSize; rank++)
+	{
+		for (size_t i = 0; i < size; i++)
+		{
+			assert(results[rank][i] == 300.0f + 3.0f * i);
+			assert(broadcasts[rank][i] == 1.0f);
+		}
+	}
+	std::cout << "+";
+
+	// Two ranks training on half of the batch each are the single process training on the batch.
+	Model initialModel;
+	initialModel.AddLayer(std::make_shared<DenseLayer>(4, 3, Sigmoid(), Xavier(4, 3)));
+	initialModel.AddLayer(std::make_shared<DenseLayer>(3, 2, Sigmoid(), Xavier(3, 2)));
+	initialModel.InitializeOptimizer(OptimizerFactory(OptimizerType::SGD));
+	initialModel.Save("process_group_test.txt");
+
+	std::vector<Tensor3D> inputs, labels;
+	for (size_t i = 0; i < 4; i++)
+	{
+		inputs.push_back(Random3D(4, 1, 1, -1.0f, 1.0f));
+		labels.push_back(Tensor3D({ { { (float)(i % 2) }, { (float)(1 - i % 2) } } }));
+	}
+
+	Loss loss(CostType::MeanSquareError);
+	Model singleModel("process_group_test.txt");
+	float singleCost = 0.0f;
+	{
+		DataParallelModel dataParallel(singleModel, 1, loss);
+		for (size_t t = 0; t < 3; t++)
+			singleCost = dataParallel.TrainBatch(inputs, labels, 0.5f, t);
+	}
+
+	std::vector<std::vector<float>> rankParams(2);
+	std::vector<float> rankCosts(2);
+	{
+		std::vector<std::thread> ranks;
+		for (size_t rank = 0; rank < 2; rank++)
+		{
+			ranks.emplace_back([&, rank] {
+				ProcessGroup group(name + "_training", rank, 2);
+				Model rankModel;
+				if (rank == 0)
+					rankModel.Load("process_group_test.txt");
+				else
+				{
+					// The other ranks start from rank 0's params.
+					rankModel.AddLayer(std::make_shared<DenseLayer>(4, 3, Sigmoid(), Xavier(4, 3)));
+					rankModel.AddLayer(std::make_shared<DenseLayer>(3, 2, Sigmoid(), Xavier(3, 2)));
+					rankModel.InitializeOptimizer(OptimizerFactory(OptimizerType::SGD));
+				}
+
+				DataParallelModel dataParallel(rankModel, 1, loss, 0, &group);
+				std::vector<Tensor3D> rankInputs(inputs.begin() + rank * 2, inputs.begin() + rank * 2 + 2);
+				std::vector<Tensor3D> rankLabels(labels.begin() + rank * 2, labels.begin() + rank * 2 + 2);
+				for (size_t t = 0; t < 3; t++)
+					rankCosts[rank] = dataParallel.TrainBatch(rankInputs, rankLabels, 0.5f, t);
+				rankParams[rank] = GetModelParams(rankModel);
+			});
+		}
+		for (std::thread& rank : ranks)
+			rank.join();
+	}
+	std::remove("process_group_test.txt");
+
+	assert(rankParams[0] == rankParams[1] && rankCosts[0] == rankCosts[1]);
+	assert(std::abs(singleCost - rankCosts[0]) < 0.00001f);
+	std::vector<float> singleParams = GetModelParams(singleModel);
+	for (size_t i = 0; i < singleParams.size(); i++)
+		assert(std::abs(singleParams[i] - rankParams[0][i]) < 0.00001f);
+	std::cout << "+";
+}
+
+void TestPipelineModel()
+{
+	Model initialModel;
+	initialModel.AddLayer(std::make_shared<ConvolutionalLayer>(8, 8, 1, 3, 3, 2, 1, RelU(0.1f), Uniform(-0.5f, 0.5f), true));
+	initialModel.AddLayer(std::make_shared<MaxPoolingLayer>(8, 8, 2, 2, 2));
+	initialModel.AddLayer(std::make_shared<ConvolutionalLayer>(4, 4, 2, 3, 3, 3, 1, RelU(0.1f), Uniform(-0.5f, 0.5f), true));
+	initialModel.AddLayer(std::make_shared<ReshapeLayer>(4, 4, 3, 4 * 4 * 3, 1, 1));
+	initialModel.AddLayer(std::make_shared<DenseLayer>(4 * 4 * 3, 2, Sigmoid(), Xavier(4 * 4 * 3, 2)));
+	initialModel.InitializeOptimizer(OptimizerFactory(OptimizerType::SGD));
+	initialModel.Save("pipeline_test.txt");
+
+	std::vector<Tensor3D> inputs, labels;
+	for (size_t i = 0; i < 7; i++)
+	{
+		inputs.push_back(Random3D(8, 8, 1, -1.0f, 1.0f));
+		labels.push_back(Tensor3D({ { { (float)(i % 2) }, { (float)(1 - i % 2) } } }));
+	}
+
+	// The stages cover the layers contiguously, the outputs are the model's outputs.
+	Model pipelineModel("pipeline_test.txt");
+	PipelineModel pipeline(pipelineModel, 3);
+	const std::vector<size_t>& boundaries = pipeline.GetStageBoundaries();
+	assert(pipeline.GetNumStages() == 3 && boundaries.size() == 4 && boundaries.front() == 0 && boundaries.back() == 5);
+	for (size_t s = 0; s < 3; s++)
+		assert(boundaries[s] < boundaries[s + 1]);
+
+	std::vector<Tensor3D> outputs = pipeline.FeedForward(inputs);
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		Tensor3D output = pipelineModel.FeedForward(inputs[i]);
+		for (size_t j = 0; j < output.GetSize(); j++)
+			assert(std::abs(output.GetData()[j] - outputs[i].GetData()[j]) < 0.00001f);
+	}
+	std::cout << "+";
+
+	// A training step is the data parallel step on the same batch.
+	Loss loss(CostType::MeanSquareError);
+	Model referenceModel("pipeline_test.txt");
+	DataParallelModel reference(referenceModel, 1, loss);
+	for (size_t t = 0; t < 3; t++)
+	{
+		float pipelineCost = pipeline.TrainBatch(inputs, labels, loss, 0.5f, t);
+		float referenceCost = reference.TrainBatch(inputs, labels, 0.5f, t);
+		assert(std::abs(pipelineCost - referenceCost) < 0.00001f);
+	}
+	std::vector<float> pipelineParams = GetModelParams(pipelineModel), referenceParams = GetModelParams(referenceModel);
+	for (size_t i = 0; i < pipelineParams.size(); i++)
+		assert(std::abs(pipelineParams[i] - referenceParams[i]) < 0.00001f);
+
+	// The feed forward after a training step uses the updated params.
+	outputs = pipeline.FeedForward(inputs);
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		Tensor3D output = pipelineModel.FeedForward(inputs[i]);
+		for (size_t j = 0; j < output.GetSize(); j++)
+			assert(std::abs(output.GetData()[j] - outputs[i].GetData()[j]) < 0.00001f);
+	}
+
+	const PipelineStats& stats = pipeline.GetStats();
+	for (size_t s = 0; s < 3; s++)
+		assert(stats.GetUtilization(s) >= 0.0 && stats.GetUtilization(s) <= 1.0);
+	assert(stats.GetBubbleFraction() >= 0.0 && stats.GetBubbleFraction() <= 1.0);
+	std::remove("pipeline_test.txt");
+	std::cout << "+";
+}
+
+void TestGradientCheckpointing()
+{
+	Model initialModel;
+	initialModel.AddLayer(std::make_shared<ConvolutionalLayer>(8, 8, 1, 3, 3, 2, 1, RelU(0.1f), Uniform(-0.5f, 0.5f), true));
+	initialModel.AddLayer(std::make_shared<ConvolutionalLayer>(8, 8, 2, 3, 3, 2, 1, RelU(0.1f), Uniform(-0.5f, 0.5f), true));
+	initialModel.AddLayer(std::make_shared<MaxPoolingLayer>(8, 8, 2, 2, 2));
+	initialModel.AddLayer(std::make_shared<ConvolutionalLayer>(4, 4, 2, 3, 3, 3, 1, RelU(0.1f), Uniform(-0.5f, 0.5f), true));
+	initialModel.AddLayer(std::make_shared<ReshapeLayer>(4, 4, 3, 4 * 4 * 3, 1, 1));
+	initialModel.AddLayer(std::make_shared<DenseLayer>(4 * 4 * 3, 8, Sigmoid(), Xavier(4 * 4 * 3, 8)));
+	initialModel.AddLayer(std::make_shared<DropoutLayer>(8, 1, 1, 0.0f));
+	initialModel.AddLayer(std::make_shared<DenseLayer>(8, 2, Sigmoid(), Xavier(8, 2)));
+	initialModel.InitializeOptimizer(OptimizerFactory(OptimizerType::Adam));
+	initialModel.Save("checkpointing_test.txt");
+
+	// The checkpointed training is the training without checkpoints.
+	Model model("checkpointing_test.txt"), checkpointedModel("checkpointing_test.txt");
+	checkpointedModel.SetSquareRootCheckpoints();
+	assert((checkpointedModel.GetCheckpoints() == std::vector<size_t>{ 3, 6 }));
+
+	Loss loss(CostType::MeanSquareError);
+	for (size_t t = 0; t < 4; t++)
+	{
+		Tensor3D input = Random3D(8, 8, 1, -1.0f, 1.0f);
+		Tensor3D label({ { { (float)(t % 2) }, { (float)(1 - t % 2) } } });
+		Tensor3D gradient = model.BackPropagation(input, loss.Bind(label), 0.1f, t);
+		Tensor3D checkpointedGradient = checkpointedModel.BackPropagation(input, loss.Bind(label), 0.1f, t);
+		for (size_t i = 0; i < gradient.GetSize(); i++)
+			assert(std::abs(gradient.GetData()[i] - checkpointedGradient.GetData()[i]) < 0.00001f);
+	}
+	std::vector<float> params = GetModelParams(model), checkpointedParams = GetModelParams(checkpointedModel);
+	for (size_t i = 0; i < params.size(); i++)
+		assert(std::abs(params[i] - checkpointedParams[i]) < 0.00001f);
+	std::cout << "+";
+
+	CheckpointReport report = checkpointedModel.GetCheckpointReport();
+	assert(report.NumLayers == 8 && report.NumRecomputedLayers == 6);
+	assert(report.CheckpointedActivationBytes < report.ActivationBytes);
+	assert(model.GetCheckpointReport().CheckpointedActivationBytes == model.GetCheckpointReport().ActivationBytes);
+
+	// A dropout mask can not be recomputed.
+	checkpointedModel.SetCheckpoints({ 7 });
+	bool isThrown = false;
+	try
+	{
+		checkpointedModel.BackPropagation(Random3D(8, 8, 1, -1.0f, 1.0f), loss.Bind(Tensor3D({ { { 1.0f }, { 0.0f } } })), 0.1f, 4);
+	}
+	catch (const std::runtime_error&)
+	{
+		isThrown = true;
+	}
+	assert(isThrown);
+	std::remove("checkpointing_test.txt");
+	std::cout << "+";
+}
+
+void TestReluMask()
+{
+	Tensor3D output = { { { 1.0f, -2.0f, 0.0f }, { 3.0f, -0.0f, 0.5f } } };
+	ReluMask mask;
+	CreateReluMask(mask, output);
+	assert(mask.Size == 6 && mask.Bits.size() == 1 && mask.Bits[0] == 0b101001);
+
+	Tensor3D gradient(2, 3, 1, 2.0f);
+	ApplyReluMask(gradient, mask, 0.25f);
+	for (size_t i = 0; i < gradient.GetSize(); i++)
+		assert(gradient.GetData()[i] == (output.GetData()[i] > 0.0f ? 2.0f : 0.5f));
+	std::cout << "+";
+
+	// The masked back propagation is the back propagation with the sums (an activation, which is not recognized as a ReLU).
+	for (float alpha : { 0.0f, 0.1f })
+	{
+		ActivationFunciton copiedRelU = RelU(alpha);
+		copiedRelU.Name = "CopiedRelU";
+
+		Tensor3D kernels = Random3D(3, 3, 2 * 3, -0.5f, 0.5f);
+		Tensor3D bias = Random3D(10, 10, 3, -0.1f, 0.1f);
+		ConvolutionalLayer masked(10, 10, 2, kernels, 3, 1, RelU(alpha), &bias);
+		ConvolutionalLayer reference(10, 10, 2, kernels, 3, 1, copiedRelU, &bias);
+		masked.InitOptimizer(OptimizerFactory(OptimizerType::SGD));
+		reference.InitOptimizer(OptimizerFactory(OptimizerType::SGD));
+
+		Tensor3D input = Random3D(10, 10, 2, -1.0f, 1.0f);
+		Tensor3D label = Random3D(10, 10, 3, 0.0f, 1.0f);
+		Loss loss(CostType::MeanSquareError);
+		Tensor3D maskedGradient = masked.BackPropagation(input, loss.Bind(label), 0.1f, 0);
+		Tensor3D referenceGradient = reference.BackPropagation(input, loss.Bind(label), 0.1f, 0);
+		for (size_t i = 0; i < maskedGradient.GetSize(); i++)
+			assert(maskedGradient.GetData()[i] == referenceGradient.GetData()[i]);
+		for (size_t i = 0; i < kernels.GetSize(); i++)
+			assert(masked.GetLearnableTensors()[0].Params->GetData()[i] == reference.GetLearnableTensors()[0].Params->GetData()[i]);
+	}
+	std::cout << "+";
+}
+
+void TestBFloat16()
+{
+	assert(FloatToBFloat16(1.0f) == 0x3F80 && BFloat16ToFloat(0x3F80) == 1.0f);
+	assert(FloatToBFloat16(1.0f + 1.0f / 256.0f) == 0x3F80);  // A tie rounds to the even mantissa.
+	assert(FloatToBFloat16(1.0f + 3.0f / 256.0f) == 0x3F82);
+	assert(FloatToBFloat16(-2.0f) == 0xC000);
+	float nan = std::numeric_limits<float>::quiet_NaN();
+	assert(std::isnan(BFloat16ToFloat(FloatToBFloat16(nan))));
+
+	// The vectorized conversions are the scalar ones.
+	Tensor2D values = Random2D(37, 1, -100.0f, 100.0f);
+	values.GetData()[20] = nan;
+	std::vector<uint16_t> converted(values.GetSize());
+	std::vector<float> back(values.GetSize());
+	ToBFloat16(converted.data(), values.GetData(), values.GetSize());
+	FromBFloat16(back.data(), converted.data(), converted.size());
+	for (size_t i = 0; i < values.GetSize(); i++)
+	{
+		if (i == 20)
+			assert(std::isnan(back[i]));
+		else
+			assert(converted[i] == FloatToBFloat16(values.GetData()[i]) && back[i] == BFloat16ToFloat(converted[i]));
+	}
+	std::cout << "+";
+
+	// The kernels accumulate in fp32: the result is the fp32 kernel's on the rounded operands.
+	Tensor2D left = Random2D(5, 70, -1.0f, 1.0f), right = Random2D(70, 3, -1.0f, 1.0f), bias = Random2D(5, 1, -1.0f, 1.0f);
+	BFloat16Tensor leftBF16, rightBF16;
+	ToBFloat16(leftBF16, left);
+	ToBFloat16(rightBF16, right);
+	RoundToBFloat16(left);
+	RoundToBFloat16(right);
+
+	float dot = 0.0f;
+	for (size_t i = 0; i < left.GetCols(); i++)
+		dot += left.GetData()[i] * left.GetData()[i];
+	assert(std::abs(DotProductBF16(leftBF16.Data.data(), leftBF16.Data.data(), left.GetCols()) - dot) < 1e-4f);
+
+	Tensor2D product(5, 3), productBF16(5, 3), sums(5, 3), sumsBF16(5, 3);
+	MatrixMultBiasActivation(product, left, right, &bias, RelU(0.1f).Activation, &sums);
+	MatrixMultBiasActivationBF16(productBF16, leftBF16, rightBF16, &bias, RelU(0.1f).Activation, &sumsBF16);
+	for (size_t i = 0; i < product.GetSize(); i++)
+		assert(std::abs(product.GetData()[i] - productBF16.GetData()[i]) < 1e-4f && std::abs(sums.GetData()[i] - sumsBF16.GetData()[i]) < 1e-4f);
+
+	for (size_t stride : { 1, 2 })
+	{
+		Tensor3D input = Random3D(13, 11, 2, -1.0f, 1.0f), kernels = Random3D(3, 3, 2 * 4, -1.0f, 1.0f);
+		BFloat16Tensor inputBF16, kernelsBF16;
+		ToBFloat16(inputBF16, input);
+		ToBFloat16(kernelsBF16, kernels);
+		RoundToBFloat16(input);
+		RoundToBFloat16(kernels);
+
+		size_t rows = CalcConvSize(13, 3, stride, 1), cols = CalcConvSize(11, 3, stride, 1);
+		Tensor3D convBias = Random3D(rows, cols, 4, -1.0f, 1.0f);
+		Tensor3D conv(rows, cols, 4), convBF16(rows, cols, 4), preActivation(rows, cols, 4);
+		ConvolutionBiasActivation(conv, input, kernels, &convBias, Sigmoid().Activation, stride, 1);
+		ConvolutionBiasActivationBF16(convBF16, inputBF16, kernelsBF16, &convBias, Sigmoid().Activation, stride, 1, &preActivation);
+		for (size_t i = 0; i < conv.GetSize(); i++)
+			assert(std::abs(conv.GetData()[i] - convBF16.GetData()[i]) < 1e-4f && Sigmoid().Activation(preActivation.GetData()[i]) == convBF16.GetData()[i]);
+	}
+	std::cout << "+";
+
+	// The mixed precision training stays close to the fp32 training, the fp32 params are updated.
+	Model model, mixedModel;
+	model.AddLayer(std::make_shared<ConvolutionalLayer>(8, 8, 1, 3, 3, 4, 1, RelU(0.0f), He(3 * 3)));
+	model.AddLayer(std::make_shared<ReshapeLayer>(8, 8, 4, 8 * 8 * 4, 1, 1));
+	model.AddLayer(std::make_shared<DenseLayer>(8 * 8 * 4, 3, Sigmoid(), Xavier(8 * 8 * 4, 3)));
+	model.InitializeOptimizer(OptimizerFactory(OptimizerType::SGD));
+	mixedModel.SetMixedPrecision(true);
+	for (std::shared_ptr<Layer> layer = model.GetRootLayer(); layer; layer = layer->NextLayer)
+		mixedModel.AddLayer(layer->GetName(), layer->ToString());
+	assert(mixedModel.GetRootLayer()->IsMixedPrecision() && mixedModel.GetRootLayer()->NextLayer->NextLayer->IsMixedPrecision());
+
+	Loss loss(CostType::MeanSquareError);
+	float cost = 0.0f, mixedCost = 0.0f;
+	for (size_t t = 0; t < 50; t++)
+	{
+		Tensor3D input = Random3D(8, 8, 1, 0.0f, 1.0f);
+		Tensor3D label(3, 1, 1);
+		label.SetAt(t % 3, 0, 0, 1.0f);
+		model.BackPropagation(input, loss.Bind(label), 0.1f, t);
+		cost += loss.GetLastCost();
+		mixedModel.BackPropagation(input, loss.Bind(label), 0.1f, t);
+		mixedCost += loss.GetLastCost();
+	}
+	assert(std::abs(cost - mixedCost) < 0.01f * cost);
+
+	bool isChanged = false;
+	for (std::shared_ptr<Layer> layer = model.GetRootLayer(), mixedLayer = mixedModel.GetRootLayer(); layer; layer = layer->NextLayer, mixedLayer = mixedLayer->NextLayer)
+	{
+		std::vector<LearnableTensor> tensors = layer->GetLearnableTensors(), mixedTensors = mixedLayer->GetLearnableTensors();
+		for (size_t j = 0; j < tensors.size(); j++)
+			for (size_t i = 0; i < tensors[j].Params->GetSize(); i++)
+			{
+				float param = tensors[j].Params->GetData()[i], mixedParam = mixedTensors[j].Params->GetData()[i];
+				assert(std::abs(param - mixedParam) < 0.01f);
+				isChanged = isChanged || BFloat16ToFloat(FloatToBFloat16(mixedParam)) != mixedParam;
+			}
+	}
+	assert(isChanged && "The params are fp32.");
+
+	// The bfloat16 weights are kept while the params do not change (the accumulator only collects the gradient),
+	// params written directly are converted again after MarkParamsChanged.
+	mixedModel.InitializeOptimizer(OptimizerFactory(OptimizerType::Accumulator));
+	Tensor3D input = Random3D(8, 8, 1, 0.0f, 1.0f), label(3, 1, 1);
+	mixedModel.BackPropagation(input, loss.Bind(label), 0.1f, 50);
+	Tensor* weights = mixedModel.GetRootLayer()->NextLayer->NextLayer->GetLearnableTensors()[0].Params;
+	std::fill(weights->GetData(), weights->GetData() + weights->GetSize(), 0.0f);
+	mixedModel.MarkParamsChanged();
+	float expectedCost = loss.Evaluate(mixedModel.FeedForward(input), label);
+	mixedModel.BackPropagation(input, loss.Bind(label), 0.1f, 51);
+	assert(std::abs(loss.GetLastCost() - expectedCost) < 1e-6f);
+	std::cout << "+";
+}
+
+void TestQuantizedAdam()
+{
+	for (OptimizerType type : { OptimizerType::Adam8Bit, OptimizerType::AdamHalf })
+	{
+		// The quantized moments stay close to the fp32 moments (1000 params: the last block is partial).
+		Tensor2D params = Random2D(1000, 1, -1.0f, 1.0f);
+		Tensor2D referenceParams = params;
+		std::unique_ptr<Optimizer> optimizer = OptimizerFactory(type).Get(params.GetSize());
+		AdamOptimizer reference(params.GetSize());
+		for (size_t t = 0; t < 20; t++)
+		{
+			Tensor2D gradient = Random2D(1000, 1, -1.0f, 1.0f);
+			gradient.GetData()[t] *= 0.001f;
+			optimizer->Update(&params, &gradient, 0.01f);
+			reference.Update(&referenceParams, &gradient, 0.01f);
+		}
+		for (size_t i = 0; i < params.GetSize(); i++)
+			assert(std::abs(params.GetData()[i] - referenceParams.GetData()[i]) < (type == OptimizerType::Adam8Bit ? 0.01f : 0.001f));
+
+		QuantizedAdamOptimizer* quantized = static_cast<QuantizedAdamOptimizer*>(optimizer.get());
+		assert(quantized->GetStateBytes() == (type == OptimizerType::Adam8Bit ? 2000 : 4000) + 4 * 2 * sizeof(float));
+		std::cout << "+";
+
+		// The saved state is loaded back exactly.
+		std::string saved = optimizer->ToString();
+		std::unique_ptr<Optimizer> loaded = OptimizerFactory().Get(optimizer->GetName() + " " + saved);
+		assert(loaded->GetName() == optimizer->GetName() && loaded->ToString() == saved);
+		assert(saved.size() * 3 < reference.ToString().size());
+
+		Tensor2D gradient = Random2D(1000, 1, -1.0f, 1.0f);
+		Tensor2D loadedParams = params;
+		optimizer->Update(&params, &gradient, 0.01f);
+		loaded->Update(&loadedParams, &gradient, 0.01f);
+		for (size_t i = 0; i < params.GetSize(); i++)
+			assert(params.GetData()[i] == loadedParams.GetData()[i]);
+
+		// The outer product update is the update with the materialized gradient.
+		Tensor2D left = Random2D(30, 1, -1.0f, 1.0f), right = Random2D(20, 1, -1.0f, 1.0f);
+		Tensor2D weights = Random2D(30, 20, -1.0f, 1.0f);
+		Tensor2D materializedWeights = weights;
+		std::unique_ptr<Optimizer> fused = OptimizerFactory(type).Get(weights.GetSize());
+		std::unique_ptr<Optimizer> materialized = OptimizerFactory(type).Get(weights.GetSize());
+		for (size_t t = 0; t < 3; t++)
+		{
+			Tensor2D outerProduct = MatrixMultRightTranspose(left, right);
+			fused->UpdateOuterProduct(&weights, left, right, 0.01f);
+			materialized->Update(&materializedWeights, &outerProduct, 0.01f);
+		}
+		for (size_t i = 0; i < weights.GetSize(); i++)
+			assert(weights.GetData()[i] == materializedWeights.GetData()[i]);
+
+		// A layer with a quantized optimizer is saved and loaded.
+		DenseLayer layer(20, 30, Sigmoid(), Xavier(20, 30));
+		layer.InitOptimizer(OptimizerFactory(type));
+		Loss loss(CostType::MeanSquareError);
+		layer.BackPropagation(Random3D(20, 1, 1, -1.0f, 1.0f), loss.Bind(Random3D(30, 1, 1, 0.0f, 1.0f)), 0.01f, 0);
+		DenseLayer loadedLayer(layer.ToString());
+		assert(loadedLayer.ToString() == layer.ToString());
+		std::cout << "+";
+	}
+}
+
+void TestFrozenLayers()
+{
+	auto createModel = []() {
+		Model model;
+		model.AddLayer(std::make_shared<ConvolutionalLayer>(8, 8, 1, 3, 3, 4, 1, RelU(0.0f), He(3 * 3)));
+		model.AddLayer(std::make_shared<MaxPoolingLayer>(8, 8, 4, 2, 2));
+		model.AddLayer(std::make_shared<ReshapeLayer>(4, 4, 4, 4 * 4 * 4, 1, 1));
+		model.AddLayer(std::make_shared<DenseLayer>(4 * 4 * 4, 8, RelU(0.1f), Xavier(4 * 4 * 4, 8)));
+		model.AddLayer(std::make_shared<DenseLayer>(8, 2, Sigmoid(), Xavier(8, 2)));
+		model.InitializeOptimizer(OptimizerFactory(OptimizerType::Adam));
+		return model;
+	};
+	auto copyModel = [](const Model& model, size_t fromLayer) {
+		Model copy;
+		size_t layerIndex = 0;
+		for (std::shared_ptr<Layer> layer = model.GetRootLayer(); layer; layer = layer->NextLayer, layerIndex++)
+		{
+			if (layerIndex >= fromLayer)
+				copy.AddLayer(layer->GetName(), layer->ToString());
+		}
+		return copy;
+	};
+	auto getParams = [](const Model& model) {
+		std::vector<float> params;
+		for (std::shared_ptr<Layer> layer = model.GetRootLayer(); layer; layer = layer->NextLayer)
+			for (const LearnableTensor& tensor : layer->GetLearnableTensors())
+				params.insert(params.end(), tensor.Params->GetData(), tensor.Params->GetData() + tensor.Params->GetSize());
+		return params;
+	};
+
+	// The frozen prefix is only fed forward: the head is trained as a model of its own on the prefix's output.
+	Model original = createModel();
+	original.FreezePrefix(3);
+	assert(original.GetFrozenPrefix() == 3);
+	assert(original.GetRootLayer()->GetLearnableTensors()[0].ParamsOptimizer->GetName() == SGDOptimizer::ClassName());
+	// The copies have the same (printed) params.
+	Model model = copyModel(original, 0);
+	model.FreezePrefix(3);
+	Model cachedModel = copyModel(original, 0);
+	cachedModel.FreezePrefix(3);
+	Model head = copyModel(original, 3);
+	std::vector<float> frozenParams = getParams(model);
+
+	Loss loss(CostType::MeanSquareError);
+	for (size_t t = 0; t < 5; t++)
+	{
+		Tensor3D input = Random3D(8, 8, 1, 0.0f, 1.0f);
+		Tensor3D label(2, 1, 1);
+		label.SetAt(t % 2, 0, 0, 1.0f);
+		Tensor3D prefixOutput = model.FeedForwardPrefix(input);
+		assert(prefixOutput.GetRows() == 4 * 4 * 4 && prefixOutput.GetCols() == 1);
+
+		model.BackPropagation(input, loss.Bind(label), 0.01f, t);
+		cachedModel.BackPropagationFromPrefix(prefixOutput, loss.Bind(label), 0.01f, t);
+		head.BackPropagation(prefixOutput, loss.Bind(label), 0.01f, t);
+	}
+	std::vector<float> params = getParams(model), cachedParams = getParams(cachedModel), headParams = getParams(head);
+	const size_t numPrefixParams = params.size() - headParams.size();
+	for (size_t i = 0; i < params.size(); i++)
+	{
+		assert(params[i] == cachedParams[i]);
+		assert(i < numPrefixParams ? params[i] == frozenParams[i] : params[i] == headParams[i - numPrefixParams]);
+	}
+	assert(params != frozenParams);
+	std::cout << "+";
+
+	// A frozen layer in the middle passes the gradient to the layers before it.
+	Model middleFrozen = createModel();
+	middleFrozen.SetFrozen(3, true);
+	assert(middleFrozen.GetFrozenPrefix() == 0);
+	std::vector<float> initialParams = getParams(middleFrozen);
+	Tensor3D label(2, 1, 1);
+	label.SetAt(0, 0, 0, 1.0f);
+	middleFrozen.BackPropagation(Random3D(8, 8, 1, 0.0f, 1.0f), loss.Bind(label), 0.01f, 0);
+	std::vector<float> trainedParams = getParams(middleFrozen);
+	const size_t numConvParams = 3 * 3 * 4 + 8 * 8 * 4;
+	const size_t numFrozenParams = 4 * 4 * 4 * 8 + 8;
+	for (size_t i = numConvParams; i < numConvParams + numFrozenParams; i++)
+		assert(trainedParams[i] == initialParams[i]);
+	assert(!std::equal(initialParams.begin(), initialParams.begin() + numConvParams, trainedParams.begin()));
+	assert(!std::equal(initialParams.begin() + numConvParams + numFrozenParams, initialParams.end(), trainedParams.begin() + numConvParams + numFrozenParams));
+
+	// The data parallel training keeps the frozen params.
+	Model parallelModel = createModel();
+	parallelModel.FreezePrefix(4);
+	initialParams = getParams(parallelModel);
+	{
+		DataParallelModel dataParallel(parallelModel, 2, loss);
+		std::vector<Tensor3D> inputs = { Random3D(8, 8, 1, 0.0f, 1.0f), Random3D(8, 8, 1, 0.0f, 1.0f) };
+		std::vector<Tensor3D> labels = { label, label };
+		dataParallel.TrainBatch(inputs, labels, 0.01f, 0);
+	}
+	trainedParams = getParams(parallelModel);
+	assert(std::equal(initialParams.begin(), initialParams.begin() + numConvParams + numFrozenParams, trainedParams.begin()));
+	assert(!std::equal(initialParams.begin() + numConvParams + numFrozenParams, initialParams.end(), trainedParams.begin() + numConvParams + numFrozenParams));
+	std::cout << "+";
+}
+
+void TestGroupedConvolution()
+{
+	auto sum = [](const Tensor3D& left, const Tensor3D& right) {
+		double result = 0.0;
+		for (size_t i = 0; i < left.GetSize(); i++)
+			result += (double)left.GetData()[i] * right.GetData()[i];
+		return result;
+	};
+
+	// A grouped convolution is the dense convolution with zero kernels between the groups.
+	const size_t inputDepth = 4, numKernels = 6, groups = 2;
+	const size_t groupDepth = inputDepth / groups, blocksPerGroup = numKernels / groups;
+	Tensor3D input = Random3D(9, 7, inputDepth, -1.0f, 1.0f);
+	Tensor3D kernels = Random3D(3, 3, groupDepth * numKernels, -0.5f, 0.5f);
+	Tensor3D denseKernels(3, 3, inputDepth * numKernels);
+	for (size_t o = 0; o < numKernels; o++)
+		for (size_t d = 0; d < groupDepth; d++)
+			for (size_t i = 0; i < 9; i++)
+				denseKernels.GetData()[(o * inputDepth + o / blocksPerGroup * groupDepth + d) * 9 + i] = kernels.GetData()[(o * groupDepth + d) * 9 + i];
+	Tensor3D bias = Random3D(9, 7, numKernels, -0.1f, 0.1f);
+
+	Tensor3D output(9, 7, numKernels), denseOutput(9, 7, numKernels);
+	GroupedConvolutionBiasActivation(output, input, kernels, groups, &bias, RelU(0.1f).Activation, 1, 1);
+	ConvolutionBiasActivation(denseOutput, input, denseKernels, &bias, RelU(0.1f).Activation, 1, 1);
+	for (size_t i = 0; i < output.GetSize(); i++)
+		assert(std::abs(output.GetData()[i] - denseOutput.GetData()[i]) < 1e-5f);
+	std::cout << "+";
+
+	// The gradients are the adjoints of the convolution: <conv(x, k), g> = <x, dx(g, k)> = <k, dk(x, g)>, also strided.
+	for (size_t stride : { 1, 2 })
+	{
+		for (size_t g : { 1, 2, 4 })
+		{
+			Tensor3D groupKernels = Random3D(3, 2, inputDepth / g * 8, -0.5f, 0.5f);
+			size_t outputRows = CalcConvSize(input.GetRows(), 3, stride, 1), outputCols = CalcConvSize(input.GetCols(), 2, stride, 1);
+			Tensor3D convolution(outputRows, outputCols, 8);
+			GroupedConvolutionBiasActivation(convolution, input, groupKernels, g, nullptr, RelU(1.0f).Activation, stride, 1);  // Identity.
+			Tensor3D gradient = Random3D(outputRows, outputCols, 8, -1.0f, 1.0f);
+
+			Tensor3D inputGradient(input.GetRows(), input.GetCols(), inputDepth);
+			GroupedConvolutionInputGradient(inputGradient, gradient, groupKernels, g, stride, 1);
+			Tensor3D kernelGradient(3, 2, groupKernels.GetDepth());
+			GroupedConvolutionKernelGradient(kernelGradient, input, gradient, g, stride, 1);
+
+			double expected = sum(convolution, gradient);
+			assert(std::abs(sum(input, inputGradient) - expected) < 1e-3 * (1.0 + std::abs(expected)));
+			assert(std::abs(sum(groupKernels, kernelGradient) - expected) < 1e-3 * (1.0 + std::abs(expected)));
+		}
+	}
+	std::cout << "+";
+
+	// A depthwise separable model is trained, serialized and loaded, a frozen depthwise layer keeps its kernels.
+	Model model;
+	model.AddLayer(std::make_shared<GroupedConvolutionalLayer>(8, 8, 3, 3, 3, 6, 3, 1, RelU(0.0f), He(3 * 3)));
+	model.AddLayer(std::make_shared<ConvolutionalLayer>(8, 8, 6, 1, 1, 4, 0, Sigmoid(), He(6)));
+	model.InitializeOptimizer(OptimizerFactory(OptimizerType::Adam));
+	assert(model.GetRootLayer()->GetLearnableParams() == 3 * 3 * 6 + 8 * 8 * 6);
+
+	Loss loss(CostType::MeanSquareError);
+	Tensor3D sample = Random3D(8, 8, 3, 0.0f, 1.0f);
+	Tensor3D label = Random3D(8, 8, 4, 0.0f, 1.0f);
+	float firstCost = 0.0f;
+	for (size_t t = 0; t < 20; t++)
+	{
+		model.BackPropagation(sample, loss.Bind(label), 0.01f, t);
+		if (t == 0)
+			firstCost = loss.GetLastCost();
+	}
+	assert(loss.GetLastCost() < firstCost);
+
+	Model loaded;
+	for (std::shared_ptr<Layer> layer = model.GetRootLayer(); layer; layer = layer->NextLayer)
+		loaded.AddLayer(layer->GetName(), layer->ToString());
+	Tensor3D modelOutput = model.FeedForward(sample), loadedOutput = loaded.FeedForward(sample);
+	for (size_t i = 0; i < modelOutput.GetSize(); i++)
+		assert(std::abs(modelOutput.GetData()[i] - loadedOutput.GetData()[i]) < 1e-4f);
+
+	loaded.SetFrozen(0, true);
+	const Tensor* kernelParams = loaded.GetRootLayer()->GetLearnableTensors()[0].Params;
+	std::vector<float> frozenKernels(kernelParams->GetData(), kernelParams->GetData() + kernelParams->GetSize());
+	loaded.BackPropagation(sample, loss.Bind(label), 0.01f, 0);
+	for (size_t i = 0; i < frozenKernels.size(); i++)
+		assert(kernelParams->GetData()[i] == frozenKernels[i]);
+	std::cout << "+";
+}
+
+void TestStridedConvolution()
+{
+	// A rectangular, strided layer's gradients are the finite differences of its cost.
+	Tensor3D kernels = Random3D(3, 2, 2 * 3, -0.5f, 0.5f);
+	Tensor3D bias = Random3D(5, 6, 3, -0.1f, 0.1f);
+	Tensor3D input = Random3D(9, 11, 2, -1.0f, 1.0f);
+	Tensor3D label = Random3D(5, 6, 3, 0.0f, 1.0f);
+	Loss loss(CostType::MeanSquareError);
+	auto cost = [&](const Tensor3D& layerKernels, const Tensor3D& layerInput) {
+		ConvolutionalLayer layer(9, 11, 2, layerKernels, 3, 1, Sigmoid(), &bias, 2);
+		return loss.Evaluate(layer.FeedForward(layerInput), label);
+	};
+
+	ConvolutionalLayer layer(9, 11, 2, kernels, 3, 1, Sigmoid(), &bias, 2);
+	LayerShape shape = layer.GetLayerShape();
+	assert(shape.OutputRows == 5 && shape.OutputCols == 6 && shape.OutputDepth == 3);
+	layer.InitOptimizer(OptimizerFactory(OptimizerType::SGD));
+	Tensor3D inputGradient = layer.BackPropagation(input, loss.Bind(label), 1.0f, 0);
+
+	const float epsilon = 1e-2f;
+	for (size_t i = 0; i < input.GetSize(); i++)
+	{
+		Tensor3D plus = input, minus = input;
+		plus.GetData()[i] += epsilon;
+		minus.GetData()[i] -= epsilon;
+		float difference = (cost(kernels, plus) - cost(kernels, minus)) / (2.0f * epsilon);
+		assert(std::abs(difference - inputGradient.GetData()[i]) < 1e-3f + 0.02f * std::abs(difference));
+	}
+	const Tensor& trainedKernels = layer.GetKernels();
+	for (size_t i = 0; i < kernels.GetSize(); i++)
+	{
+		Tensor3D plus = kernels, minus = kernels;
+		plus.GetData()[i] += epsilon;
+		minus.GetData()[i] -= epsilon;
+		float difference = (cost(plus, input) - cost(minus, input)) / (2.0f * epsilon);
+		float gradient = kernels.GetData()[i] - trainedKernels.GetData()[i];  // The learning rate is 1.
+		assert(std::abs(difference - gradient) < 1e-3f + 0.02f * std::abs(difference));
+	}
+	std::cout << "+";
+
+	// The stride is saved, a layer saved without a stride is loaded with stride 1.
+	ConvolutionalLayer loaded(layer.ToString());
+	assert(loaded.GetStride() == 2 && loaded.GetLayerShape().OutputRows == 5 && loaded.GetLayerShape().OutputCols == 6);
+	Tensor3D output = layer.FeedForward(input), loadedOutput = loaded.FeedForward(input);
+	for (size_t i = 0; i < output.GetSize(); i++)
+		assert(std::abs(output.GetData()[i] - loadedOutput.GetData()[i]) < 1e-4f);
+
+	ConvolutionalLayer unstrided(9, 11, 2, kernels, 3, 1, Sigmoid());
+	unstrided.InitOptimizer(OptimizerFactory(OptimizerType::SGD));
+	std::string data = unstrided.ToString();
+	size_t strideStart = data.find(") 1 ]");
+	assert(strideStart != std::string::npos);
+	data.replace(strideStart, 5, ") ]");
+	ConvolutionalLayer legacy(data);
+	assert(legacy.GetStride() == 1 && legacy.GetLayerShape().OutputRows == 9 && legacy.GetLayerShape().OutputCols == 12);
+
+	Model model;
+	model.AddLayer(std::make_shared<ConvolutionalLayer>(9, 11, 2, 3, 2, 3, 1, RelU(0.0f), He(3 * 2 * 2), true, 2));
+	model.InitializeOptimizer(OptimizerFactory(OptimizerType::SGD));
+	std::string source = ModelCompiler(model, "strided_model").GenerateSource("strided_model.h");
+	assert(source.find("Padding = 1, Stride = 2;") != std::string::npos);
+
+	// The static and the quantized layers take the stride too.
+	StaticConv<9, 11, 2, 3, 2, 3, 1, StaticRelU<>, true, 2> staticConv(*model.GetRootLayer());
+	assert(staticConv.OutputRows == 5 && staticConv.OutputCols == 6);
+	Tensor3D expected = model.FeedForward(input);
+	StaticTensor<5, 6, 3> staticOutput = staticConv.FeedForward(StaticTensor<9, 11, 2>(input));
+	for (size_t i = 0; i < expected.GetSize(); i++)
+		assert(std::abs(staticOutput[i] - expected.GetData()[i]) < 1e-4f);
+	Tensor3D convertedOutput = staticConv.ToLayer()->FeedForward(input);
+	assert(Compare(&convertedOutput, &expected, 1e-4f) && Compare(&expected, &convertedOutput, 1e-4f));
+
+	QuantizationCalibrator calibrator(model);
+	for (size_t i = 0; i < 8; i++)
+		calibrator.Observe(Random3D(9, 11, 2, -1.0f, 1.0f));
+	calibrator.Observe(input);
+	QuantizedModel quantized = calibrator.Quantize();
+	Tensor3D quantizedOutput = quantized.FeedForward(input);
+	assert(Compare(&quantizedOutput, &expected, 0.05f) && Compare(&expected, &quantizedOutput, 0.05f));
+
+	QuantizedConvolutionalLayer loadedQuantized(quantized.GetLayers()[0]->ToString());
+	assert(loadedQuantized.GetLayerShape().OutputRows == 5 && loadedQuantized.GetLayerShape().OutputCols == 6);
+	std::cout << "+";
+}
+
 namespace_end
\ No newline at end of file
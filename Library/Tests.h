@@ -28,4 +28,28 @@ void TestMatrixMult();
 void TestMatrixMultRightTranspose();
 void TestMatrixMultLeftTranspose();
 
+void TestConvolutionBiasActivation();
+void TestMatrixMultBiasActivation();
+void TestSoftmax();
+void TestLoss();
+void TestMaxPool();
+void TestInferenceSession();
+void TestQuantization();
+void TestEmbedding();
+void TestHNSW();
+void TestInferenceCache();
+void TestSlidingWindow();
+void TestModelCompiler();
+void TestStaticLayers();
+void TestDataParallel();
+void TestProcessGroup();
+void TestPipelineModel();
+void TestGradientCheckpointing();
+void TestReluMask();
+void TestBFloat16();
+void TestQuantizedAdam();
+void TestFrozenLayers();
+void TestGroupedConvolution();
+void TestStridedConvolution();
+
 namespace_end
\ No newline at end of file
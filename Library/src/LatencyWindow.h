@@ -0,0 +1,59 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+
+#include "Core.h"
+
+
+namespace_start
+
+/*
+	The latencies of a long running loop for its percentiles: the last capacity values are kept in a ring buffer, so the memory and the cost
+	of a percentile do not grow with the run. The number of the added values is counted separately. Not thread safe.
+*/
+class LatencyWindow
+{
+public:
+	LatencyWindow(size_t capacity = 4096) : m_Capacity(std::max(capacity, size_t(1))) { }
+
+	void Add(float latency)
+	{
+		if (m_Values.size() < m_Capacity)
+			m_Values.push_back(latency);
+		else
+			m_Values[m_Next] = latency;
+		m_Next = (m_Next + 1) % m_Capacity;
+		m_Count++;
+	}
+
+	// The percentile (0 ... 1) of the values in the window.
+	float Percentile(float percentile) const
+	{
+		if (m_Values.empty())
+			return 0.0f;
+
+		std::vector<float> values = m_Values;
+		size_t index = std::min((size_t)(percentile * values.size()), values.size() - 1);
+		std::nth_element(values.begin(), values.begin() + index, values.end());
+		return values[index];
+	}
+
+	void Clear()
+	{
+		m_Values.clear();
+		m_Next = 0;
+		m_Count = 0;
+	}
+
+	// The number of the added values since the construction or the last clear, not only the ones in the window.
+	inline size_t GetCount() const { return m_Count; }
+	inline size_t GetCapacity() const { return m_Capacity; }
+
+private:
+	size_t m_Capacity;
+	std::vector<float> m_Values;
+	size_t m_Next = 0;
+	size_t m_Count = 0;
+};
+
+namespace_end
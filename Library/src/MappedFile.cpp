@@ -0,0 +1,98 @@
+#include "MappedFile.h"
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+namespace_start
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& filePath)
+{
+	m_File = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_File == INVALID_HANDLE_VALUE)
+	{
+		m_File = nullptr;
+		throw std::runtime_error("Could not open file: " + filePath);
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_File, &size))
+	{
+		CloseHandle(m_File);
+		throw std::runtime_error("Could not get the size of file: " + filePath);
+	}
+	m_Size = (size_t)size.QuadPart;
+	if (m_Size == 0)
+		return;
+
+	m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_Mapping)
+		m_Data = (const uint8_t*)MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0);
+
+	if (!m_Data)
+	{
+		if (m_Mapping)
+			CloseHandle(m_Mapping);
+		CloseHandle(m_File);
+		throw std::runtime_error("Could not map file: " + filePath);
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_Data)
+		UnmapViewOfFile(m_Data);
+	if (m_Mapping)
+		CloseHandle(m_Mapping);
+	if (m_File)
+		CloseHandle(m_File);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& filePath)
+{
+	m_File = open(filePath.c_str(), O_RDONLY);
+	if (m_File < 0)
+		throw std::runtime_error("Could not open file: " + filePath);
+
+	struct stat status;
+	if (fstat(m_File, &status) != 0)
+	{
+		close(m_File);
+		throw std::runtime_error("Could not get the size of file: " + filePath);
+	}
+	m_Size = (size_t)status.st_size;
+	if (m_Size == 0)
+		return;
+
+	void* data = mmap(nullptr, m_Size, PROT_READ, MAP_SHARED, m_File, 0);
+	if (data == MAP_FAILED)
+	{
+		close(m_File);
+		throw std::runtime_error("Could not map file: " + filePath);
+	}
+	m_Data = (const uint8_t*)data;
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_Data)
+		munmap((void*)m_Data, m_Size);
+	if (m_File >= 0)
+		close(m_File);
+}
+
+#endif
+
+namespace_end
@@ -0,0 +1,37 @@
+#pragma once
+#include <string>
+#include <stdint.h>
+
+#include "Core.h"
+
+
+namespace_start
+
+/*
+	Read only memory mapping of a whole file, the pages are loaded by the OS when they are read.
+*/
+class LIBRARY_API MappedFile
+{
+public:
+	MappedFile(const std::string& filePath);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	inline const uint8_t* GetData() const { return m_Data; }
+	inline size_t GetSize() const { return m_Size; }
+
+private:
+	const uint8_t* m_Data = nullptr;
+	size_t m_Size = 0;
+
+#ifdef _WIN32
+	void* m_File = nullptr;
+	void* m_Mapping = nullptr;
+#else
+	int m_File = -1;
+#endif
+};
+
+namespace_end
@@ -0,0 +1,366 @@
+#include "BFloat16.h"
+#include <assert.h>
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include <future>
+#include "Operation.h"
+#include "../ThreadPool.h"
+
+
+namespace_start
+
+void ToBFloat16(uint16_t* destination, const float* source, size_t size)
+{
+	size_t i = 0;
+#if defined(__AVX512BF16__) && defined(__AVX512VL__)
+	for (; i + 16 <= size; i += 16)
+	{
+		__m256bh converted = _mm512_cvtneps_pbh(_mm512_loadu_ps(source + i));
+		_mm256_storeu_si256((__m256i*)(destination + i), (__m256i)converted);
+	}
+#elif defined(__AVX2__)
+	// Round to the nearest even on the integer bits, NaNs are left to the scalar path.
+	const __m256i roundingBias = _mm256_set1_epi32(0x7FFF);
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256i absMask = _mm256_set1_epi32(0x7FFFFFFF);
+	const __m256i infinity = _mm256_set1_epi32(0x7F800000);
+	for (; i + 8 <= size; i += 8)
+	{
+		__m256i bits = _mm256_castps_si256(_mm256_loadu_ps(source + i));
+		if (!_mm256_testz_si256(_mm256_cmpgt_epi32(_mm256_and_si256(bits, absMask), infinity), _mm256_set1_epi32(-1)))
+			break;
+		__m256i lsb = _mm256_and_si256(_mm256_srli_epi32(bits, 16), one);
+		__m256i rounded = _mm256_srli_epi32(_mm256_add_epi32(bits, _mm256_add_epi32(roundingBias, lsb)), 16);
+		__m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(rounded, rounded), _MM_SHUFFLE(3, 1, 2, 0));
+		_mm_storeu_si128((__m128i*)(destination + i), _mm256_castsi256_si128(packed));
+	}
+#endif
+	for (; i < size; i++)
+	{
+		destination[i] = FloatToBFloat16(source[i]);
+	}
+}
+
+void FromBFloat16(float* destination, const uint16_t* source, size_t size)
+{
+	size_t i = 0;
+#if defined(__AVX2__)
+	for (; i + 8 <= size; i += 8)
+	{
+		__m256i widened = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(source + i)));
+		_mm256_storeu_ps(destination + i, _mm256_castsi256_ps(_mm256_slli_epi32(widened, 16)));
+	}
+#endif
+	for (; i < size; i++)
+	{
+		destination[i] = BFloat16ToFloat(source[i]);
+	}
+}
+
+void ToBFloat16(BFloat16Tensor& result, const Tensor2D& tensor)
+{
+	if (tensor.IsOnDevice())
+	{
+		throw std::runtime_error("bfloat16 tensors are only used on the host.");
+	}
+
+	result.Rows = tensor.GetRows();
+	result.Cols = tensor.GetCols();
+	result.Depth = 1;
+	result.Data.resize(tensor.GetSize());
+	ToBFloat16(result.Data.data(), tensor.GetData(), tensor.GetSize());
+}
+
+void ToBFloat16(BFloat16Tensor& result, const Tensor3D& tensor)
+{
+	if (tensor.IsOnDevice())
+	{
+		throw std::runtime_error("bfloat16 tensors are only used on the host.");
+	}
+
+	result.Rows = tensor.GetRows();
+	result.Cols = tensor.GetCols();
+	result.Depth = tensor.GetDepth();
+	result.Data.resize(tensor.GetSize());
+	ToBFloat16(result.Data.data(), tensor.GetData(), tensor.GetSize());
+}
+
+void RoundToBFloat16(Tensor& tensor)
+{
+	if (tensor.IsOnDevice())
+	{
+		throw std::runtime_error("bfloat16 tensors are only used on the host.");
+	}
+
+	for (size_t i = 0; i < tensor.GetSize(); i++)
+	{
+		size_t index = tensor.TraverseTo(i);
+		tensor.GetData()[index] = BFloat16ToFloat(FloatToBFloat16(tensor.GetData()[index]));
+	}
+}
+
+#if defined(__AVX2__)
+static inline __m256 LoadBFloat16(const uint16_t* source)
+{
+	return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)source)), 16));
+}
+
+static inline float HorizontalSum(__m256 sums)
+{
+	__m128 half = _mm_add_ps(_mm256_castps256_ps128(sums), _mm256_extractf128_ps(sums, 1));
+	half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+	half = _mm_add_ss(half, _mm_movehdup_ps(half));
+	return _mm_cvtss_f32(half);
+}
+#endif
+
+float DotProductBF16(const uint16_t* left, const uint16_t* right, size_t size)
+{
+	size_t t = 0;
+	float sum = 0.0f;
+
+#if defined(__AVX512BF16__)
+	__m512 sums = _mm512_setzero_ps();
+	for (; t + 32 <= size; t += 32)
+	{
+		__m512bh l = (__m512bh)_mm512_loadu_si512((const void*)(left + t));
+		__m512bh r = (__m512bh)_mm512_loadu_si512((const void*)(right + t));
+		sums = _mm512_dpbf16_ps(sums, l, r);
+	}
+	sum = _mm512_reduce_add_ps(sums);
+#elif defined(__AVX2__)
+	__m256 sums = _mm256_setzero_ps();
+	for (; t + 8 <= size; t += 8)
+	{
+#if defined(SIMD_FMA)
+		sums = _mm256_fmadd_ps(LoadBFloat16(left + t), LoadBFloat16(right + t), sums);
+#else
+		sums = _mm256_add_ps(sums, _mm256_mul_ps(LoadBFloat16(left + t), LoadBFloat16(right + t)));
+#endif
+	}
+	sum = HorizontalSum(sums);
+#endif
+
+	for (; t < size; t++)
+	{
+		sum += BFloat16ToFloat(left[t]) * BFloat16ToFloat(right[t]);
+	}
+	return sum;
+}
+
+static void AsyncMatrixMultBiasActivationBF16(size_t startRow, size_t endRow, Tensor2D& output, const BFloat16Tensor& left, const uint16_t* columns, size_t numCols, const Tensor2D* bias, const std::function<float(float v)>& activation, Tensor2D* preActivation)
+{
+	for (size_t r = startRow; r < endRow; r++)
+	{
+		for (size_t c = 0; c < numCols; c++)
+		{
+			const size_t index = r * numCols + c;
+			float sum = DotProductBF16(left.Data.data() + r * left.Cols, columns + c * left.Cols, left.Cols);
+			if (bias)
+				sum += bias->GetData()[r];
+			if (preActivation)
+				preActivation->GetData()[index] = sum;
+			output.GetData()[index] = activation(sum);
+		}
+	}
+}
+
+void MatrixMultBiasActivationBF16(Tensor2D& output, const BFloat16Tensor& left, const BFloat16Tensor& right, const Tensor2D* bias, std::function<float(float v)> activation, Tensor2D* preActivation)
+{
+	assert(left.Cols == right.Rows && output.GetRows() == left.Rows && output.GetCols() == right.Cols && "Invalid matrix multiplication shapes!");
+	assert((!bias || (bias->GetRows() == left.Rows && bias->GetCols() == 1)) && "Invalid bias tensor size!");
+	assert((!preActivation || preActivation->GetSize() == output.GetSize()) && "Invalid pre activation tensor size!");
+
+	if (output.IsOnDevice())
+	{
+		throw std::runtime_error("bfloat16 tensors are only used on the host.");
+	}
+
+	// The dot products need the right matrix's columns contiguous.
+	std::vector<uint16_t> transposed;
+	const uint16_t* columns = right.Data.data();
+	if (right.Cols > 1)
+	{
+		transposed.resize(right.Data.size());
+		for (size_t r = 0; r < right.Rows; r++)
+			for (size_t c = 0; c < right.Cols; c++)
+				transposed[c * right.Rows + r] = right.Data[r * right.Cols + c];
+		columns = transposed.data();
+	}
+
+#ifdef ASYNC
+	ThreadPool* pool = ThreadPool::GetInstance();
+	size_t numThreads = std::min(pool->GetNumThreads(), left.Rows);
+	size_t rowsPerThread = numThreads ? left.Rows / numThreads : 0;
+	size_t extraRows = numThreads ? left.Rows % numThreads : 0;
+
+	std::vector<std::future<void>> tasks;
+	size_t startRow = 0;
+	for (size_t i = 0; i < numThreads; i++) {
+		size_t endRow = startRow + rowsPerThread + (i < extraRows ? 1 : 0);
+
+		tasks.emplace_back(
+			pool->enqueue(AsyncMatrixMultBiasActivationBF16, startRow, endRow, std::ref(output), std::cref(left), columns, right.Cols, bias, std::cref(activation), preActivation)
+		);
+
+		startRow = endRow;
+	}
+
+	for (auto& task : tasks) {
+		task.get();
+	}
+#else
+	AsyncMatrixMultBiasActivationBF16(0, left.Rows, output, left, columns, right.Cols, bias, activation, preActivation);
+#endif // ASYNC
+}
+
+// ConvolutionRow with bfloat16 operands: the kernel weight is widened once, the input row is widened 8 values at a time.
+static void ConvolutionRowBF16(float* row, const BFloat16Tensor& input, const BFloat16Tensor& kernels, size_t kernelBlock, size_t y, size_t outputCols, size_t stride, size_t padding)
+{
+	const size_t inputSliceSize = input.Rows * input.Cols;
+	const size_t kernelSliceSize = kernels.Rows * kernels.Cols;
+
+	for (size_t x = 0; x < outputCols; x++)
+	{
+		row[x] = 0.0f;
+	}
+
+	for (size_t d = 0; d < input.Depth; d++)
+	{
+		const uint16_t* inputSlice = input.Data.data() + d * inputSliceSize;
+		const uint16_t* kernelSlice = kernels.Data.data() + (kernelBlock * input.Depth + d) * kernelSliceSize;
+
+		for (size_t ky = 0; ky < kernels.Rows; ky++)
+		{
+			long long posY = (long long)(y * stride + ky) - (long long)padding;
+			if (posY < 0 || posY >= (long long)input.Rows)
+				continue;
+
+			const uint16_t* inputRow = inputSlice + posY * input.Cols;
+			for (size_t kx = 0; kx < kernels.Cols; kx++)
+			{
+				long long lastPosX = (long long)input.Cols - 1 + (long long)padding - (long long)kx;
+				if (lastPosX < 0)
+					continue;
+				size_t startX = kx >= padding ? 0 : (padding - kx + stride - 1) / stride;
+				size_t endX = std::min(outputCols, (size_t)lastPosX / stride + 1);
+
+				const float weight = BFloat16ToFloat(kernelSlice[ky * kernels.Cols + kx]);
+				const uint16_t* source = inputRow + (startX * stride + kx - padding);
+				size_t x = startX;
+				if (stride == 1)
+				{
+#if defined(__AVX2__)
+					const __m256 weights = _mm256_set1_ps(weight);
+					for (; x + 8 <= endX; x += 8)
+					{
+						__m256 values = LoadBFloat16(source + (x - startX));
+#if defined(SIMD_FMA)
+						_mm256_storeu_ps(row + x, _mm256_fmadd_ps(weights, values, _mm256_loadu_ps(row + x)));
+#else
+						_mm256_storeu_ps(row + x, _mm256_add_ps(_mm256_mul_ps(weights, values), _mm256_loadu_ps(row + x)));
+#endif
+					}
+#endif
+					for (; x < endX; x++)
+					{
+						row[x] += weight * BFloat16ToFloat(source[x - startX]);
+					}
+				}
+				else
+				{
+					for (; x < endX; x++)
+					{
+						row[x] += weight * BFloat16ToFloat(source[(x - startX) * stride]);
+					}
+				}
+			}
+		}
+	}
+}
+
+static void AsyncConvolutionBiasActivationBF16(size_t startDepth, size_t endDepth, Tensor3D& output, const BFloat16Tensor& input, const BFloat16Tensor& kernels, const Tensor3D* bias, const std::function<float(float v)>& activation, size_t stride, size_t padding, Tensor3D* preActivation)
+{
+	const size_t outputRows = output.GetRows();
+	const size_t outputCols = output.GetCols();
+	std::vector<float> row(outputCols);
+
+	for (size_t d = startDepth; d < endDepth; d++)
+	{
+		for (size_t y = 0; y < outputRows; y++)
+		{
+			ConvolutionRowBF16(row.data(), input, kernels, d, y, outputCols, stride, padding);
+
+			size_t offset = d * outputRows * outputCols + y * outputCols;
+			if (bias)
+			{
+				const float* biasRow = bias->GetData() + offset;
+				for (size_t x = 0; x < outputCols; x++)
+				{
+					row[x] += biasRow[x];
+				}
+			}
+
+			if (preActivation)
+			{
+				float* preActivationRow = preActivation->GetData() + offset;
+				for (size_t x = 0; x < outputCols; x++)
+				{
+					preActivationRow[x] = row[x];
+				}
+			}
+
+			float* outputRow = output.GetData() + offset;
+			for (size_t x = 0; x < outputCols; x++)
+			{
+				outputRow[x] = activation(row[x]);
+			}
+		}
+	}
+}
+
+void ConvolutionBiasActivationBF16(Tensor3D& output, const BFloat16Tensor& input, const BFloat16Tensor& kernels, const Tensor3D* bias, std::function<float(float v)> activation, size_t stride, size_t padding, Tensor3D* preActivation)
+{
+	assert(output.GetRows() == CalcConvSize(input.Rows, kernels.Rows, stride, padding) &&
+		output.GetCols() == CalcConvSize(input.Cols, kernels.Cols, stride, padding) && "Invalid output tensor size!");
+	assert(output.GetDepth() * input.Depth == kernels.Depth && "Invalid output tensor depth!");
+	assert((!bias || bias->GetSize() == output.GetSize()) && "Invalid bias tensor size!");
+	assert((!preActivation || preActivation->GetSize() == output.GetSize()) && "Invalid pre activation tensor size!");
+
+	if (output.IsOnDevice())
+	{
+		throw std::runtime_error("bfloat16 tensors are only used on the host.");
+	}
+
+#ifdef ASYNC
+	ThreadPool* pool = ThreadPool::GetInstance();
+	size_t numThreads = pool->GetNumThreads();
+	size_t depthPerThread = output.GetDepth() / numThreads;
+	size_t extraDepth = output.GetDepth() % numThreads;
+
+	std::vector<std::future<void>> tasks;
+	size_t startDepth = 0;
+	for (size_t i = 0; i < numThreads; i++) {
+		size_t endDepth = startDepth + depthPerThread + (i < extraDepth ? 1 : 0);
+
+		tasks.emplace_back(
+			pool->enqueue(AsyncConvolutionBiasActivationBF16, startDepth, endDepth, std::ref(output), std::cref(input), std::cref(kernels), bias, std::cref(activation), stride, padding, preActivation)
+		);
+
+		startDepth = endDepth;
+	}
+
+	for (auto& task : tasks) {
+		task.get();
+	}
+#else
+	AsyncConvolutionBiasActivationBF16(0, output.GetDepth(), output, input, kernels, bias, activation, stride, padding, preActivation);
+#endif // ASYNC
+}
+
+namespace_end
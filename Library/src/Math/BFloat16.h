@@ -0,0 +1,60 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include <stdint.h>
+#include <string.h>
+
+#include "Core.h"
+#include "Tensor2D.h"
+#include "Tensor3D.h"
+
+
+namespace_start
+
+/*
+	bfloat16: the upper 16 bits of a float (8 exponent bits, 7 mantissa bits). The conversion rounds to the nearest even,
+	the conversion back is exact. The mixed precision kernels read bfloat16 weights and activations and accumulate in fp32.
+*/
+
+inline uint16_t FloatToBFloat16(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	if ((bits & 0x7FFFFFFF) > 0x7F800000)
+		return (uint16_t)((bits >> 16) | 0x0040);  // A quiet NaN stays a NaN.
+	bits += 0x7FFF + ((bits >> 16) & 1);
+	return (uint16_t)(bits >> 16);
+}
+
+inline float BFloat16ToFloat(uint16_t value)
+{
+	uint32_t bits = (uint32_t)value << 16;
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+// The values of a tensor in bfloat16, in the tensor's order (the tensor must not be a sliced watcher).
+struct LIBRARY_API BFloat16Tensor
+{
+	std::vector<uint16_t> Data;
+	size_t Rows = 0, Cols = 0, Depth = 0;
+};
+
+// Vectorized with AVX512-BF16 or AVX2 when available. Host only.
+LIBRARY_API void ToBFloat16(uint16_t* destination, const float* source, size_t size);
+LIBRARY_API void FromBFloat16(float* destination, const uint16_t* source, size_t size);
+LIBRARY_API void ToBFloat16(BFloat16Tensor& result, const Tensor2D& tensor);
+LIBRARY_API void ToBFloat16(BFloat16Tensor& result, const Tensor3D& tensor);
+// Rounds the values of the tensor to the nearest bfloat16 (the tensor stays fp32).
+LIBRARY_API void RoundToBFloat16(Tensor& tensor);
+
+// fp32 sum of the products, with AVX512-BF16 dot products (or AVX2 FMAs) when available.
+LIBRARY_API float DotProductBF16(const uint16_t* left, const uint16_t* right, size_t size);
+
+// MatrixMultBiasActivation with bfloat16 operands: output = activation(left x right + bias), the bias is a column added to every column, preActivation (optional) = left x right + bias.
+LIBRARY_API void MatrixMultBiasActivationBF16(Tensor2D& output, const BFloat16Tensor& left, const BFloat16Tensor& right, const Tensor2D* bias, std::function<float(float v)> activation, Tensor2D* preActivation=nullptr);
+// ConvolutionBiasActivation with a bfloat16 input and kernels.
+LIBRARY_API void ConvolutionBiasActivationBF16(Tensor3D& output, const BFloat16Tensor& input, const BFloat16Tensor& kernels, const Tensor3D* bias, std::function<float(float v)> activation, size_t stride, size_t padding, Tensor3D* preActivation=nullptr);
+
+namespace_end
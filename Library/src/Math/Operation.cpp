@@ -2,6 +2,11 @@
 #include <assert.h>
 #include <random>
 #include <limits>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 #include <MogiAccelerator.h>
 
@@ -421,6 +426,278 @@ Tensor2D MatrixMultRightTranspose(const Tensor2D& left, const Tensor2D& right)
 	return res;
 }
 
+bool IsContiguous(const Tensor2D& tensor)
+{
+	return tensor.CalculateIndex(0, 1) == 1 && (tensor.GetRows() < 2 || tensor.CalculateIndex(1, 0) == tensor.GetCols());
+}
+
+float DotProduct(const float* left, const float* right, size_t size)
+{
+	// Independent partial sums, so the loop can be vectorized.
+	float sums[8] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+	size_t t = 0;
+	for (; t + 8 <= size; t += 8)
+	{
+		for (size_t k = 0; k < 8; k++)
+		{
+			sums[k] += left[t + k] * right[t + k];
+		}
+	}
+
+	float sum = ((sums[0] + sums[1]) + (sums[2] + sums[3])) + ((sums[4] + sums[5]) + (sums[6] + sums[7]));
+	for (; t < size; t++)
+	{
+		sum += left[t] * right[t];
+	}
+	return sum;
+}
+
+int32_t DotProductU8S8(const uint8_t* left, const int8_t* right, size_t size)
+{
+	size_t t = 0;
+	int32_t sum = 0;
+
+#if defined(__AVX2__)
+	__m256i sums = _mm256_setzero_si256();
+#if defined(__AVX512VNNI__) && defined(__AVX512VL__)
+	for (; t + 32 <= size; t += 32)
+	{
+		__m256i l = _mm256_loadu_si256((const __m256i*)(left + t));
+		__m256i r = _mm256_loadu_si256((const __m256i*)(right + t));
+		sums = _mm256_dpbusd_epi32(sums, l, r);
+	}
+#else
+	const __m256i ones = _mm256_set1_epi16(1);
+	for (; t + 32 <= size; t += 32)
+	{
+		__m256i l = _mm256_loadu_si256((const __m256i*)(left + t));
+		__m256i r = _mm256_loadu_si256((const __m256i*)(right + t));
+		__m256i pairs = _mm256_maddubs_epi16(l, r);
+		sums = _mm256_add_epi32(sums, _mm256_madd_epi16(pairs, ones));
+	}
+#endif
+	__m128i half = _mm_add_epi32(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+	half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+	half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+	sum = _mm_cvtsi128_si32(half);
+#endif
+
+	for (; t < size; t++)
+	{
+		sum += (int32_t)left[t] * (int32_t)right[t];
+	}
+	return sum;
+}
+
+float SquaredDistance(const float* left, const float* right, size_t size)
+{
+	size_t t = 0;
+	float sum = 0.0f;
+
+#if defined(__AVX2__)
+	__m256 sums0 = _mm256_setzero_ps();
+	__m256 sums1 = _mm256_setzero_ps();
+	for (; t + 16 <= size; t += 16)
+	{
+		__m256 difference0 = _mm256_sub_ps(_mm256_loadu_ps(left + t), _mm256_loadu_ps(right + t));
+		__m256 difference1 = _mm256_sub_ps(_mm256_loadu_ps(left + t + 8), _mm256_loadu_ps(right + t + 8));
+#if defined(SIMD_FMA)
+		sums0 = _mm256_fmadd_ps(difference0, difference0, sums0);
+		sums1 = _mm256_fmadd_ps(difference1, difference1, sums1);
+#else
+		sums0 = _mm256_add_ps(sums0, _mm256_mul_ps(difference0, difference0));
+		sums1 = _mm256_add_ps(sums1, _mm256_mul_ps(difference1, difference1));
+#endif
+	}
+	__m256 sums = _mm256_add_ps(sums0, sums1);
+	__m128 half = _mm_add_ps(_mm256_castps256_ps128(sums), _mm256_extractf128_ps(sums, 1));
+	half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+	half = _mm_add_ss(half, _mm_movehdup_ps(half));
+	sum = _mm_cvtss_f32(half);
+#endif
+
+	for (; t < size; t++)
+	{
+		float difference = left[t] - right[t];
+		sum += difference * difference;
+	}
+	return sum;
+}
+
+void AsyncMatrixMultBiasActivation(size_t startRow, size_t endRow, Tensor2D* output, const Tensor2D* left, const Tensor2D* right, const Tensor2D* bias, const std::function<float(float v)>* activation, Tensor2D* preActivation)
+{
+	const size_t inner = left->GetCols();
+	const size_t cols = right->GetCols();
+	const bool isContiguous = IsContiguous(*output) && IsContiguous(*left) && IsContiguous(*right) && (!preActivation || IsContiguous(*preActivation));
+	std::vector<float> row(cols);
+
+	for (size_t r = startRow; r < endRow; r++)
+	{
+		if (isContiguous && cols == 1)
+		{
+			row[0] = DotProduct(left->GetData() + r * inner, right->GetData(), inner);
+		}
+		else if (isContiguous)
+		{
+			for (size_t c = 0; c < cols; c++)
+			{
+				row[c] = 0.0f;
+			}
+			const float* leftRow = left->GetData() + r * inner;
+			for (size_t t = 0; t < inner; t++)
+			{
+				const float value = leftRow[t];
+				const float* rightRow = right->GetData() + t * cols;
+				for (size_t c = 0; c < cols; c++)
+				{
+					row[c] += value * rightRow[c];
+				}
+			}
+		}
+		else
+		{
+			for (size_t c = 0; c < cols; c++)
+			{
+				float product = 0.0f;
+				for (size_t t = 0; t < inner; t++)
+				{
+					product += left->GetAt(r, t) * right->GetAt(t, c);
+				}
+				row[c] = product;
+			}
+		}
+
+		const float biasValue = bias ? bias->GetAt(r, 0) : 0.0f;
+		for (size_t c = 0; c < cols; c++)
+		{
+			float sum = row[c] + biasValue;
+			if (preActivation)
+			{
+				preActivation->GetData()[preActivation->CalculateIndex(r, c)] = sum;
+			}
+			output->GetData()[output->CalculateIndex(r, c)] = (*activation)(sum);
+		}
+	}
+}
+
+void MatrixMultBiasActivation(Tensor2D& output, const Tensor2D& left, const Tensor2D& right, const Tensor2D* bias, std::function<float(float v)> activation, Tensor2D* preActivation)
+{
+	assert(left.GetCols() == right.GetRows() && "Matrix params for matrix multiplication not math! Left.column != Right.rows");
+	assert(output.GetRows() == left.GetRows() && output.GetCols() == right.GetCols() && "Invalid output tensor size!");
+	assert((!bias || (bias->GetRows() == left.GetRows() && bias->GetCols() == 1)) && "Invalid bias tensor size!");
+	assert((!preActivation || (preActivation->GetRows() == output.GetRows() && preActivation->GetCols() == output.GetCols())) && "Invalid pre activation tensor size!");
+
+	if (output.IsOnDevice() || left.IsOnDevice() || right.IsOnDevice())
+	{
+		throw std::runtime_error("Fused matrix multiplication is not supported on device.");
+	}
+
+#ifdef ASYNC
+	ThreadPool* pool = ThreadPool::GetInstance();
+	int numThreads = std::min(pool->GetNumThreads(), output.GetRows());
+	int rowsPerThread = output.GetRows() / numThreads;
+	int extraRows = output.GetRows() % numThreads;
+
+	std::vector<std::future<void>> threads;
+	size_t startRow = 0;
+	for (size_t i = 0; i < numThreads; i++)
+	{
+		size_t endRow = startRow + rowsPerThread + (i < extraRows ? 1 : 0);
+
+		threads.emplace_back(
+			pool->enqueue(AsyncMatrixMultBiasActivation, startRow, endRow, &output, &left, &right, bias, &activation, preActivation)
+		);
+
+		startRow = endRow;
+	}
+
+	for (auto& thread : threads) {
+		thread.get();
+	}
+#else
+	AsyncMatrixMultBiasActivation(0, output.GetRows(), &output, &left, &right, bias, &activation, preActivation);
+#endif // ASYNC
+}
+
+void AsyncOuterProductTiles(size_t startRow, size_t endRow, const Tensor2D* left, const Tensor2D* right, const std::function<void(size_t index, const float* tile, size_t size)>* consumer)
+{
+	const size_t tileSize = 256;  // 1KB, stays in the L1 cache while consumed.
+	const size_t cols = right->GetRows();
+	const size_t batch = left->GetCols();
+	const bool isContiguous = batch == 1 && IsContiguous(*right);
+	float tile[tileSize];
+
+	for (size_t r = startRow; r < endRow; r++)
+	{
+		for (size_t tileStart = 0; tileStart < cols; tileStart += tileSize)
+		{
+			size_t size = std::min(tileSize, cols - tileStart);
+			for (size_t j = 0; j < size; j++)
+			{
+				tile[j] = 0.0f;
+			}
+
+			for (size_t b = 0; b < batch; b++)
+			{
+				const float value = left->GetAt(r, b);
+				if (isContiguous)
+				{
+					const float* rightData = right->GetData() + tileStart;
+					for (size_t j = 0; j < size; j++)
+					{
+						tile[j] += value * rightData[j];
+					}
+				}
+				else
+				{
+					for (size_t j = 0; j < size; j++)
+					{
+						tile[j] += value * right->GetAt(tileStart + j, b);
+					}
+				}
+			}
+
+			(*consumer)(r * cols + tileStart, tile, size);
+		}
+	}
+}
+
+void OuterProductTiles(const Tensor2D& left, const Tensor2D& right, std::function<void(size_t index, const float* tile, size_t size)> consumer)
+{
+	assert(left.GetCols() == right.GetCols() && "Matrix params for the outer product not match! Left.cols != Right.cols");
+
+	if (left.IsOnDevice() || right.IsOnDevice())
+	{
+		throw std::runtime_error("Tiled outer product is not supported on device.");
+	}
+
+#ifdef ASYNC
+	ThreadPool* pool = ThreadPool::GetInstance();
+	int numThreads = std::min(pool->GetNumThreads(), left.GetRows());
+	int rowsPerThread = left.GetRows() / numThreads;
+	int extraRows = left.GetRows() % numThreads;
+
+	std::vector<std::future<void>> threads;
+	size_t startRow = 0;
+	for (size_t i = 0; i < numThreads; i++)
+	{
+		size_t endRow = startRow + rowsPerThread + (i < extraRows ? 1 : 0);
+
+		threads.emplace_back(
+			pool->enqueue(AsyncOuterProductTiles, startRow, endRow, &left, &right, &consumer)
+		);
+
+		startRow = endRow;
+	}
+
+	for (auto& thread : threads) {
+		thread.get();
+	}
+#else
+	AsyncOuterProductTiles(0, left.GetRows(), &left, &right, &consumer);
+#endif // ASYNC
+}
+
 size_t CalcConvSize(size_t inputSize, size_t kernelSize, size_t stride, size_t padding)
 {
 	return (inputSize - kernelSize + 2 * padding) / stride + 1;
@@ -862,55 +1139,141 @@ Tensor2D ConvolutionKernelFlip(const Tensor3D& input, const Tensor3D& kernel, si
 	return output;
 }
 
-void AsyncMaxPool(size_t startDepth, size_t endDepth, Tensor3D& output, const Tensor3D& input, size_t poolHeight, size_t poolWidth) 
+// Accumulates one output row of a kernel block's convolution into row. The inner loop runs along the contiguous input row.
+// With groups, the kernel block only sees the input slices of its group.
+void ConvolutionRow(float* row, const Tensor3D& input, const Tensor3D& kernels, size_t kernelBlock, size_t y, size_t outputCols, size_t stride, size_t padding, size_t groups)
 {
-	for (size_t d = startDepth; d < endDepth; d++) 
+	const size_t inputRows = input.GetRows();
+	const size_t inputCols = input.GetCols();
+	const size_t kernelRows = kernels.GetRows();
+	const size_t kernelCols = kernels.GetCols();
+	const size_t inputSliceSize = inputRows * inputCols;
+	const size_t kernelSliceSize = kernelRows * kernelCols;
+	const size_t groupDepth = input.GetDepth() / groups;
+	const size_t blocksPerGroup = kernels.GetDepth() / groupDepth / groups;
+	const size_t inputStartDepth = kernelBlock / blocksPerGroup * groupDepth;
+
+	for (size_t x = 0; x < outputCols; x++)
 	{
-		Tensor2D slice = CreateWatcher((Tensor3D&)input, d);  // !
-		for (size_t r = 0; r < output.GetRows(); r++)
+		row[x] = 0.0f;
+	}
+
+	for (size_t d = 0; d < groupDepth; d++)
+	{
+		const float* inputSlice = input.GetData() + (inputStartDepth + d) * inputSliceSize;
+		const float* kernelSlice = kernels.GetData() + (kernelBlock * groupDepth + d) * kernelSliceSize;
+
+		for (size_t ky = 0; ky < kernelRows; ky++)
 		{
-			for (size_t c = 0; c < output.GetCols(); c++)
-			{
-				Tensor2D window = CreateWatcher(slice, r * poolHeight, c * poolWidth, poolHeight, poolWidth, 0, 0);
-				auto pos = MaxPos(window);
+			long long posY = (long long)(y * stride + ky) - (long long)padding;
+			if (posY < 0 || posY >= (long long)inputRows)
+				continue;
 
-				output.SetAt(r, c, d, window.GetAt(pos.first, pos.second));
+			const float* inputRow = inputSlice + posY * inputCols;
+			for (size_t kx = 0; kx < kernelCols; kx++)
+			{
+				// The range of x where posX = x * stride + kx - padding is inside of the input row.
+				long long lastPosX = (long long)inputCols - 1 + (long long)padding - (long long)kx;
+				if (lastPosX < 0)
+					continue;
+				size_t startX = kx >= padding ? 0 : (padding - kx + stride - 1) / stride;
+				size_t endX = std::min(outputCols, (size_t)lastPosX / stride + 1);
+
+				const float weight = kernelSlice[ky * kernelCols + kx];
+				const float* source = inputRow + (startX * stride + kx - padding);
+				if (stride == 1)
+				{
+					for (size_t x = startX; x < endX; x++)
+					{
+						row[x] += weight * source[x - startX];
+					}
+				}
+				else
+				{
+					for (size_t x = startX; x < endX; x++)
+					{
+						row[x] += weight * source[(x - startX) * stride];
+					}
+				}
 			}
 		}
 	}
 }
 
-Tensor3D MaxPool(const Tensor3D& input, size_t poolHeight, size_t poolWidth)
+void AsyncConvolutionBiasActivation(size_t startDepth, size_t endDepth, Tensor3D& output, const Tensor3D& input, const Tensor3D& kernels, size_t groups, const Tensor3D* bias, const std::function<float(float v)>& activation, size_t stride, size_t padding, Tensor3D* preActivation)
 {
-	Tensor3D output(input.GetRows() / poolHeight, input.GetCols() / poolWidth, input.GetDepth(), 0.0f, input.IsOnDevice());
+	const size_t outputRows = output.GetRows();
+	const size_t outputCols = output.GetCols();
+	std::vector<float> row(outputCols);
 
-	if (output.IsOnDevice() != input.IsOnDevice())
+	for (size_t d = startDepth; d < endDepth; d++)
 	{
-		throw std::runtime_error("Tensors are not on the same device.");
+		for (size_t y = 0; y < outputRows; y++)
+		{
+			ConvolutionRow(row.data(), input, kernels, d, y, outputCols, stride, padding, groups);
+
+			size_t offset = d * outputRows * outputCols + y * outputCols;
+			if (bias)
+			{
+				const float* biasRow = bias->GetData() + offset;
+				for (size_t x = 0; x < outputCols; x++)
+				{
+					row[x] += biasRow[x];
+				}
+			}
+
+			if (preActivation)
+			{
+				float* preActivationRow = preActivation->GetData() + offset;
+				for (size_t x = 0; x < outputCols; x++)
+				{
+					preActivationRow[x] = row[x];
+				}
+			}
+
+			float* outputRow = output.GetData() + offset;
+			for (size_t x = 0; x < outputCols; x++)
+			{
+				outputRow[x] = activation(row[x]);
+			}
+		}
 	}
+}
 
-	if (input.IsOnDevice())
+void ConvolutionBiasActivation(Tensor3D& output, const Tensor3D& input, const Tensor3D& kernels, const Tensor3D* bias, std::function<float(float v)> activation, size_t stride, size_t padding, Tensor3D* preActivation)
+{
+	GroupedConvolutionBiasActivation(output, input, kernels, 1, bias, activation, stride, padding, preActivation);
+}
+
+void GroupedConvolutionBiasActivation(Tensor3D& output, const Tensor3D& input, const Tensor3D& kernels, size_t groups, const Tensor3D* bias, std::function<float(float v)> activation, size_t stride, size_t padding, Tensor3D* preActivation)
+{
+	size_t outputRows = CalcConvSize(input.GetRows(), kernels.GetRows(), stride, padding);
+	size_t outputCols = CalcConvSize(input.GetCols(), kernels.GetCols(), stride, padding);
+
+	assert(output.GetRows() == outputRows && output.GetCols() == outputCols && "Invalid output tensor size!");
+	assert(input.GetDepth() % groups == 0 && output.GetDepth() % groups == 0 && "The depths must be divisible by the groups!");
+	assert(output.GetDepth() * (input.GetDepth() / groups) == kernels.GetDepth() && "Invalid output tensor depth!");
+	assert((!bias || bias->GetSize() == output.GetSize()) && "Invalid bias tensor size!");
+	assert((!preActivation || preActivation->GetSize() == output.GetSize()) && "Invalid pre activation tensor size!");
+
+	if (output.IsOnDevice() || input.IsOnDevice() || kernels.IsOnDevice())
 	{
-		accelerator::CudaMaxPool(&output, &input, poolHeight, poolWidth);
-		return output;
+		throw std::runtime_error("Fused convolution is not supported on device.");
 	}
 
 #ifdef ASYNC
 	ThreadPool* pool = ThreadPool::GetInstance();
 	int numThreads = pool->GetNumThreads();
-
-	// Calculate depth per thread more accurately
 	int depthPerThread = output.GetDepth() / numThreads;
-	int extraDepth = output.GetDepth() % numThreads; // Remaining depths that need to be distributed
+	int extraDepth = output.GetDepth() % numThreads;
 
 	std::vector<std::future<void>> tasks;
 	size_t startDepth = 0;
 	for (size_t i = 0; i < numThreads; i++) {
-		// Assign extra depth to the first 'extraDepth' threads
 		size_t endDepth = startDepth + depthPerThread + (i < extraDepth ? 1 : 0);
 
 		tasks.emplace_back(
-			pool->enqueue(AsyncMaxPool, startDepth, endDepth, std::ref(output), std::cref(input), poolHeight, poolWidth)
+			pool->enqueue(AsyncConvolutionBiasActivation, startDepth, endDepth, std::ref(output), std::cref(input), std::cref(kernels), groups, bias, std::cref(activation), stride, padding, preActivation)
 		);
 
 		startDepth = endDepth;
@@ -919,70 +1282,485 @@ Tensor3D MaxPool(const Tensor3D& input, size_t poolHeight, size_t poolWidth)
 	for (auto& task : tasks) {
 		task.get();
 	}
-
 #else
-	for (size_t d = 0; d < output.GetDepth(); d++)
-	{
-		Tensor2D slice = CreateWatcher((Tensor3D&)input, d);  // !
-
-		for (size_t r = 0; r < output.GetRows(); r++)
-		{
-			for (size_t c = 0; c < output.GetCols(); c++)
-			{
-				Tensor2D window = CreateWatcher(slice, r * poolHeight, c * poolWidth, poolHeight, poolWidth, 0, 0);
-				auto pos = MaxPos(window);
-
-				output.SetAt(r, c, d, window.GetAt(pos.first, pos.second));
-			}
-		}
-	}
+	AsyncConvolutionBiasActivation(0, output.GetDepth(), output, input, kernels, groups, bias, activation, stride, padding, preActivation);
 #endif // ASYNC
-
-	return output;
 }
 
-void AsyncDistributeReverseMaxPool(size_t startDepth, size_t endDepth, Tensor3D& distributed, const Tensor3D& input, const Tensor3D& output, size_t poolHeight, size_t poolWidth)
+void AsyncConvolutionBiasActivationMaxPool(size_t startDepth, size_t endDepth, Tensor3D& output, const Tensor3D& input, const Tensor3D& kernels, const Tensor3D* bias, const std::function<float(float v)>& activation, size_t stride, size_t padding, size_t poolHeight, size_t poolWidth)
 {
+	const size_t convRows = CalcConvSize(input.GetRows(), kernels.GetRows(), stride, padding);
+	const size_t convCols = CalcConvSize(input.GetCols(), kernels.GetCols(), stride, padding);
+	const size_t outputRows = output.GetRows();
+	const size_t outputCols = output.GetCols();
+	std::vector<float> row(convCols);
+	std::vector<float> pooledRow(outputCols);
+
 	for (size_t d = startDepth; d < endDepth; d++)
 	{
-		Tensor2D inputSlice = CreateWatcher((Tensor3D&)input, d);  // !
-		Tensor2D distributedSlice = CreateWatcher(distributed, d);
-
-		for (size_t r = 0; r < output.GetRows(); r++)
+		for (size_t r = 0; r < outputRows; r++)
 		{
-			for (size_t c = 0; c < output.GetCols(); c++)
+			for (size_t c = 0; c < outputCols; c++)
 			{
-				Tensor2D inputWindow = CreateWatcher(inputSlice, r * poolHeight, c * poolWidth, poolHeight, poolWidth, 0, 0);
-				Tensor2D distributedWindow = CreateWatcher(distributedSlice, r * poolHeight, c * poolWidth, poolHeight, poolWidth, 0, 0);
-				auto pos = MaxPos(inputWindow);
+				pooledRow[c] = -std::numeric_limits<float>::infinity();
+			}
 
-				distributedWindow.SetAt(pos.first, pos.second, output.GetAt(r, c, d));
+			for (size_t py = 0; py < poolHeight; py++)
+			{
+				size_t y = r * poolHeight + py;
+				ConvolutionRow(row.data(), input, kernels, d, y, convCols, stride, padding, 1);
+
+				if (bias)
+				{
+					const float* biasRow = bias->GetData() + d * convRows * convCols + y * convCols;
+					for (size_t x = 0; x < convCols; x++)
+					{
+						row[x] += biasRow[x];
+					}
+				}
+
+				for (size_t c = 0; c < outputCols; c++)
+				{
+					for (size_t px = 0; px < poolWidth; px++)
+					{
+						float value = activation(row[c * poolWidth + px]);
+						if (value > pooledRow[c])
+							pooledRow[c] = value;
+					}
+				}
+			}
+
+			float* outputRow = output.GetData() + d * outputRows * outputCols + r * outputCols;
+			for (size_t c = 0; c < outputCols; c++)
+			{
+				outputRow[c] = pooledRow[c];
 			}
 		}
 	}
 }
 
-
-void DistributeReverseMaxPool(Tensor3D& distributed, const Tensor3D& input, const Tensor3D& output, size_t poolHeight, size_t poolWidth)
+void ConvolutionBiasActivationMaxPool(Tensor3D& output, const Tensor3D& input, const Tensor3D& kernels, const Tensor3D* bias, std::function<float(float v)> activation, size_t stride, size_t padding, size_t poolHeight, size_t poolWidth)
 {
-	if (output.IsOnDevice() != input.IsOnDevice() || output.IsOnDevice() != distributed.IsOnDevice())
-	{
-		throw std::runtime_error("Tensors are not on the same device.");
-	}
+	size_t convRows = CalcConvSize(input.GetRows(), kernels.GetRows(), stride, padding);
+	size_t convCols = CalcConvSize(input.GetCols(), kernels.GetCols(), stride, padding);
 
-	if (input.IsOnDevice())
+	assert(output.GetRows() == convRows / poolHeight && output.GetCols() == convCols / poolWidth && "Invalid output tensor size!");
+	assert(output.GetDepth() * input.GetDepth() == kernels.GetDepth() && "Invalid output tensor depth!");
+	assert((!bias || bias->GetSize() == convRows * convCols * output.GetDepth()) && "Invalid bias tensor size!");
+
+	if (output.IsOnDevice() || input.IsOnDevice() || kernels.IsOnDevice())
 	{
-		accelerator::CudaDistributeReverseMaxPool(&distributed, &input, &output, poolHeight, poolWidth);
-		return;
+		throw std::runtime_error("Fused convolution is not supported on device.");
 	}
 
 #ifdef ASYNC
 	ThreadPool* pool = ThreadPool::GetInstance();
 	int numThreads = pool->GetNumThreads();
-
-	// Calculate depth per thread more accurately
 	int depthPerThread = output.GetDepth() / numThreads;
-	int extraDepth = output.GetDepth() % numThreads; // Remaining depths that need to be distributed
+	int extraDepth = output.GetDepth() % numThreads;
+
+	std::vector<std::future<void>> tasks;
+	size_t startDepth = 0;
+	for (size_t i = 0; i < numThreads; i++) {
+		size_t endDepth = startDepth + depthPerThread + (i < extraDepth ? 1 : 0);
+
+		tasks.emplace_back(
+			pool->enqueue(AsyncConvolutionBiasActivationMaxPool, startDepth, endDepth, std::ref(output), std::cref(input), std::cref(kernels), bias, std::cref(activation), stride, padding, poolHeight, poolWidth)
+		);
+
+		startDepth = endDepth;
+	}
+
+	for (auto& task : tasks) {
+		task.get();
+	}
+#else
+	AsyncConvolutionBiasActivationMaxPool(0, output.GetDepth(), output, input, kernels, bias, activation, stride, padding, poolHeight, poolWidth);
+#endif // ASYNC
+}
+
+void AsyncGroupedConvolutionInputGradient(size_t startDepth, size_t endDepth, Tensor3D& inputGradient, const Tensor3D& outputGradient, const Tensor3D& kernels, size_t groups, size_t stride, size_t padding)
+{
+	const size_t inputRows = inputGradient.GetRows();
+	const size_t inputCols = inputGradient.GetCols();
+	const size_t outputRows = outputGradient.GetRows();
+	const size_t outputCols = outputGradient.GetCols();
+	const size_t kernelRows = kernels.GetRows();
+	const size_t kernelCols = kernels.GetCols();
+	const size_t groupDepth = inputGradient.GetDepth() / groups;
+	const size_t blocksPerGroup = outputGradient.GetDepth() / groups;
+
+	for (size_t d = startDepth; d < endDepth; d++)
+	{
+		const size_t group = d / groupDepth;
+		float* inputSlice = inputGradient.GetData() + d * inputRows * inputCols;
+
+		for (size_t o = group * blocksPerGroup; o < (group + 1) * blocksPerGroup; o++)
+		{
+			const float* gradientSlice = outputGradient.GetData() + o * outputRows * outputCols;
+			const float* kernelSlice = kernels.GetData() + (o * groupDepth + d % groupDepth) * kernelRows * kernelCols;
+
+			for (size_t y = 0; y < outputRows; y++)
+			{
+				const float* gradientRow = gradientSlice + y * outputCols;
+				for (size_t ky = 0; ky < kernelRows; ky++)
+				{
+					long long posY = (long long)(y * stride + ky) - (long long)padding;
+					if (posY < 0 || posY >= (long long)inputRows)
+						continue;
+
+					float* inputRow = inputSlice + posY * inputCols;
+					for (size_t kx = 0; kx < kernelCols; kx++)
+					{
+						// The range of x where posX = x * stride + kx - padding is inside of the input row.
+						long long lastPosX = (long long)inputCols - 1 + (long long)padding - (long long)kx;
+						if (lastPosX < 0)
+							continue;
+						size_t startX = kx >= padding ? 0 : (padding - kx + stride - 1) / stride;
+						size_t endX = std::min(outputCols, (size_t)lastPosX / stride + 1);
+
+						const float weight = kernelSlice[ky * kernelCols + kx];
+						float* target = inputRow + (startX * stride + kx - padding);
+						if (stride == 1)
+						{
+							for (size_t x = startX; x < endX; x++)
+							{
+								target[x - startX] += weight * gradientRow[x];
+							}
+						}
+						else
+						{
+							for (size_t x = startX; x < endX; x++)
+							{
+								target[(x - startX) * stride] += weight * gradientRow[x];
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+void GroupedConvolutionInputGradient(Tensor3D& inputGradient, const Tensor3D& outputGradient, const Tensor3D& kernels, size_t groups, size_t stride, size_t padding)
+{
+	assert(outputGradient.GetRows() == CalcConvSize(inputGradient.GetRows(), kernels.GetRows(), stride, padding) &&
+		outputGradient.GetCols() == CalcConvSize(inputGradient.GetCols(), kernels.GetCols(), stride, padding) && "Invalid output gradient size!");
+	assert(inputGradient.GetDepth() % groups == 0 && outputGradient.GetDepth() % groups == 0 && "The depths must be divisible by the groups!");
+	assert(outputGradient.GetDepth() * (inputGradient.GetDepth() / groups) == kernels.GetDepth() && "Invalid kernel depth!");
+
+	if (inputGradient.IsOnDevice() || outputGradient.IsOnDevice() || kernels.IsOnDevice())
+	{
+		throw std::runtime_error("Grouped convolution is not supported on device.");
+	}
+
+#ifdef ASYNC
+	ThreadPool* pool = ThreadPool::GetInstance();
+	int numThreads = pool->GetNumThreads();
+	int depthPerThread = inputGradient.GetDepth() / numThreads;
+	int extraDepth = inputGradient.GetDepth() % numThreads;
+
+	std::vector<std::future<void>> tasks;
+	size_t startDepth = 0;
+	for (size_t i = 0; i < numThreads; i++) {
+		size_t endDepth = startDepth + depthPerThread + (i < extraDepth ? 1 : 0);
+
+		tasks.emplace_back(
+			pool->enqueue(AsyncGroupedConvolutionInputGradient, startDepth, endDepth, std::ref(inputGradient), std::cref(outputGradient), std::cref(kernels), groups, stride, padding)
+		);
+
+		startDepth = endDepth;
+	}
+
+	for (auto& task : tasks) {
+		task.get();
+	}
+#else
+	AsyncGroupedConvolutionInputGradient(0, inputGradient.GetDepth(), inputGradient, outputGradient, kernels, groups, stride, padding);
+#endif // ASYNC
+}
+
+void AsyncGroupedConvolutionKernelGradient(size_t startDepth, size_t endDepth, Tensor3D& kernelGradient, const Tensor3D& input, const Tensor3D& outputGradient, size_t groups, size_t stride, size_t padding)
+{
+	const size_t inputRows = input.GetRows();
+	const size_t inputCols = input.GetCols();
+	const size_t outputRows = outputGradient.GetRows();
+	const size_t outputCols = outputGradient.GetCols();
+	const size_t kernelRows = kernelGradient.GetRows();
+	const size_t kernelCols = kernelGradient.GetCols();
+	const size_t groupDepth = input.GetDepth() / groups;
+	const size_t blocksPerGroup = outputGradient.GetDepth() / groups;
+
+	for (size_t o = startDepth; o < endDepth; o++)
+	{
+		const float* gradientSlice = outputGradient.GetData() + o * outputRows * outputCols;
+		const size_t inputStartDepth = o / blocksPerGroup * groupDepth;
+
+		for (size_t d = 0; d < groupDepth; d++)
+		{
+			const float* inputSlice = input.GetData() + (inputStartDepth + d) * inputRows * inputCols;
+			float* kernelSlice = kernelGradient.GetData() + (o * groupDepth + d) * kernelRows * kernelCols;
+
+			for (size_t ky = 0; ky < kernelRows; ky++)
+			{
+				for (size_t kx = 0; kx < kernelCols; kx++)
+				{
+					long long lastPosX = (long long)inputCols - 1 + (long long)padding - (long long)kx;
+					if (lastPosX < 0)
+						continue;
+					size_t startX = kx >= padding ? 0 : (padding - kx + stride - 1) / stride;
+					size_t endX = std::min(outputCols, (size_t)lastPosX / stride + 1);
+					if (startX >= endX)
+						continue;
+
+					float sum = 0.0f;
+					for (size_t y = 0; y < outputRows; y++)
+					{
+						long long posY = (long long)(y * stride + ky) - (long long)padding;
+						if (posY < 0 || posY >= (long long)inputRows)
+							continue;
+
+						const float* gradientRow = gradientSlice + y * outputCols + startX;
+						const float* source = inputSlice + posY * inputCols + (startX * stride + kx - padding);
+						if (stride == 1)
+						{
+							sum += DotProduct(gradientRow, source, endX - startX);
+						}
+						else
+						{
+							for (size_t x = 0; x < endX - startX; x++)
+							{
+								sum += gradientRow[x] * source[x * stride];
+							}
+						}
+					}
+					kernelSlice[ky * kernelCols + kx] += sum;
+				}
+			}
+		}
+	}
+}
+
+void GroupedConvolutionKernelGradient(Tensor3D& kernelGradient, const Tensor3D& input, const Tensor3D& outputGradient, size_t groups, size_t stride, size_t padding)
+{
+	assert(outputGradient.GetRows() == CalcConvSize(input.GetRows(), kernelGradient.GetRows(), stride, padding) &&
+		outputGradient.GetCols() == CalcConvSize(input.GetCols(), kernelGradient.GetCols(), stride, padding) && "Invalid output gradient size!");
+	assert(input.GetDepth() % groups == 0 && outputGradient.GetDepth() % groups == 0 && "The depths must be divisible by the groups!");
+	assert(outputGradient.GetDepth() * (input.GetDepth() / groups) == kernelGradient.GetDepth() && "Invalid kernel gradient depth!");
+
+	if (kernelGradient.IsOnDevice() || input.IsOnDevice() || outputGradient.IsOnDevice())
+	{
+		throw std::runtime_error("Grouped convolution is not supported on device.");
+	}
+
+#ifdef ASYNC
+	ThreadPool* pool = ThreadPool::GetInstance();
+	int numThreads = pool->GetNumThreads();
+	int depthPerThread = outputGradient.GetDepth() / numThreads;
+	int extraDepth = outputGradient.GetDepth() % numThreads;
+
+	std::vector<std::future<void>> tasks;
+	size_t startDepth = 0;
+	for (size_t i = 0; i < numThreads; i++) {
+		size_t endDepth = startDepth + depthPerThread + (i < extraDepth ? 1 : 0);
+
+		tasks.emplace_back(
+			pool->enqueue(AsyncGroupedConvolutionKernelGradient, startDepth, endDepth, std::ref(kernelGradient), std::cref(input), std::cref(outputGradient), groups, stride, padding)
+		);
+
+		startDepth = endDepth;
+	}
+
+	for (auto& task : tasks) {
+		task.get();
+	}
+#else
+	AsyncGroupedConvolutionKernelGradient(0, outputGradient.GetDepth(), kernelGradient, input, outputGradient, groups, stride, padding);
+#endif // ASYNC
+}
+
+template<typename Offset>
+void AsyncMaxPool(size_t startDepth, size_t endDepth, Tensor3D& output, const Tensor3D& input, size_t poolHeight, size_t poolWidth, Offset* offsets)
+{
+	const size_t inputCols = input.GetCols();
+	const size_t outputRows = output.GetRows();
+	const size_t outputCols = output.GetCols();
+
+	for (size_t d = startDepth; d < endDepth; d++)
+	{
+		const float* slice = input.GetData() + d * input.GetRows() * inputCols;
+		for (size_t r = 0; r < outputRows; r++)
+		{
+			const size_t outputIndex = (d * outputRows + r) * outputCols;
+			const float* windows = slice + r * poolHeight * inputCols;
+			float* out = output.GetData() + outputIndex;
+			Offset* offset = offsets ? offsets + outputIndex : nullptr;
+
+			// The windows of an output row are processed together, the inner loops run across the width.
+			for (size_t c = 0; c < outputCols; c++)
+			{
+				out[c] = windows[c * poolWidth];
+			}
+			if (offset)
+			{
+				std::fill(offset, offset + outputCols, (Offset)0);
+			}
+
+			for (size_t i = 0; i < poolHeight; i++)
+			{
+				const float* row = windows + i * inputCols;
+				for (size_t j = (i == 0 ? 1 : 0); j < poolWidth; j++)
+				{
+					if (offset)
+					{
+						const Offset position = (Offset)(i * poolWidth + j);
+						for (size_t c = 0; c < outputCols; c++)
+						{
+							const float v = row[c * poolWidth + j];
+							const bool isGreater = v > out[c];
+							out[c] = isGreater ? v : out[c];
+							offset[c] = isGreater ? position : offset[c];
+						}
+					}
+					else
+					{
+						for (size_t c = 0; c < outputCols; c++)
+						{
+							out[c] = std::max(out[c], row[c * poolWidth + j]);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+template<typename Offset>
+void MaxPoolOffsets(Tensor3D& output, const Tensor3D& input, size_t poolHeight, size_t poolWidth, Offset* offsets)
+{
+#ifdef ASYNC
+	ThreadPool* pool = ThreadPool::GetInstance();
+	int numThreads = pool->GetNumThreads();
+
+	// Calculate depth per thread more accurately
+	int depthPerThread = output.GetDepth() / numThreads;
+	int extraDepth = output.GetDepth() % numThreads; // Remaining depths that need to be distributed
+
+	std::vector<std::future<void>> tasks;
+	size_t startDepth = 0;
+	for (size_t i = 0; i < numThreads; i++) {
+		// Assign extra depth to the first 'extraDepth' threads
+		size_t endDepth = startDepth + depthPerThread + (i < extraDepth ? 1 : 0);
+
+		tasks.emplace_back(
+			pool->enqueue(AsyncMaxPool<Offset>, startDepth, endDepth, std::ref(output), std::cref(input), poolHeight, poolWidth, offsets)
+		);
+
+		startDepth = endDepth;
+	}
+
+	for (auto& task : tasks) {
+		task.get();
+	}
+#else
+	AsyncMaxPool<Offset>(0, output.GetDepth(), output, input, poolHeight, poolWidth, offsets);
+#endif // ASYNC
+}
+
+void MaxPool(Tensor3D& output, const Tensor3D& input, size_t poolHeight, size_t poolWidth)
+{
+	assert(output.GetRows() == input.GetRows() / poolHeight &&
+		output.GetCols() == input.GetCols() / poolWidth &&
+		output.GetDepth() == input.GetDepth()
+		&& "Output shape not match!");
+
+	if (output.IsOnDevice() || input.IsOnDevice())
+	{
+		throw std::runtime_error("Max pooling into an output is only implemented on the host.");
+	}
+
+	MaxPoolOffsets<uint8_t>(output, input, poolHeight, poolWidth, nullptr);
+}
+
+Tensor3D MaxPool(const Tensor3D& input, size_t poolHeight, size_t poolWidth, MaxPoolIndices* indices)
+{
+	Tensor3D output(input.GetRows() / poolHeight, input.GetCols() / poolWidth, input.GetDepth(), 0.0f, input.IsOnDevice());
+
+	if (output.IsOnDevice() != input.IsOnDevice())
+	{
+		throw std::runtime_error("Tensors are not on the same device.");
+	}
+
+	if (input.IsOnDevice())
+	{
+		if (indices)
+		{
+			throw std::runtime_error("Max pooling indices are only recorded on the host.");
+		}
+
+		accelerator::CudaMaxPool(&output, &input, poolHeight, poolWidth);
+		return output;
+	}
+
+	if (!indices)
+	{
+		MaxPoolOffsets<uint8_t>(output, input, poolHeight, poolWidth, nullptr);
+		return output;
+	}
+
+	indices->IsWide = poolHeight * poolWidth > 256;
+	indices->Offsets.resize(output.GetSize() * (indices->IsWide ? sizeof(uint16_t) : sizeof(uint8_t)));
+
+	if (indices->IsWide)
+		MaxPoolOffsets<uint16_t>(output, input, poolHeight, poolWidth, (uint16_t*)indices->Offsets.data());
+	else
+		MaxPoolOffsets<uint8_t>(output, input, poolHeight, poolWidth, indices->Offsets.data());
+
+	return output;
+}
+
+void AsyncDistributeReverseMaxPool(size_t startDepth, size_t endDepth, Tensor3D& distributed, const Tensor3D& input, const Tensor3D& output, size_t poolHeight, size_t poolWidth)
+{
+	for (size_t d = startDepth; d < endDepth; d++)
+	{
+		Tensor2D inputSlice = CreateWatcher((Tensor3D&)input, d);  // !
+		Tensor2D distributedSlice = CreateWatcher(distributed, d);
+
+		for (size_t r = 0; r < output.GetRows(); r++)
+		{
+			for (size_t c = 0; c < output.GetCols(); c++)
+			{
+				Tensor2D inputWindow = CreateWatcher(inputSlice, r * poolHeight, c * poolWidth, poolHeight, poolWidth, 0, 0);
+				Tensor2D distributedWindow = CreateWatcher(distributedSlice, r * poolHeight, c * poolWidth, poolHeight, poolWidth, 0, 0);
+				auto pos = MaxPos(inputWindow);
+
+				distributedWindow.SetAt(pos.first, pos.second, output.GetAt(r, c, d));
+			}
+		}
+	}
+}
+
+
+void DistributeReverseMaxPool(Tensor3D& distributed, const Tensor3D& input, const Tensor3D& output, size_t poolHeight, size_t poolWidth)
+{
+	if (output.IsOnDevice() != input.IsOnDevice() || output.IsOnDevice() != distributed.IsOnDevice())
+	{
+		throw std::runtime_error("Tensors are not on the same device.");
+	}
+
+	if (input.IsOnDevice())
+	{
+		accelerator::CudaDistributeReverseMaxPool(&distributed, &input, &output, poolHeight, poolWidth);
+		return;
+	}
+
+#ifdef ASYNC
+	ThreadPool* pool = ThreadPool::GetInstance();
+	int numThreads = pool->GetNumThreads();
+
+	// Calculate depth per thread more accurately
+	int depthPerThread = output.GetDepth() / numThreads;
+	int extraDepth = output.GetDepth() % numThreads; // Remaining depths that need to be distributed
 
 	std::vector<std::future<void>> tasks;
 	size_t startDepth = 0;
@@ -1021,6 +1799,125 @@ void DistributeReverseMaxPool(Tensor3D& distributed, const Tensor3D& input, cons
 #endif // ASYNC
 }
 
+template<typename Offset>
+void AsyncDistributeReverseMaxPool(size_t startDepth, size_t endDepth, Tensor3D& distributed, const Offset* offsets, const Tensor3D& output, size_t poolHeight, size_t poolWidth)
+{
+	const size_t distributedCols = distributed.GetCols();
+	const size_t outputRows = output.GetRows();
+	const size_t outputCols = output.GetCols();
+
+	for (size_t d = startDepth; d < endDepth; d++)
+	{
+		float* slice = distributed.GetData() + d * distributed.GetRows() * distributedCols;
+		for (size_t r = 0; r < outputRows; r++)
+		{
+			const size_t outputIndex = (d * outputRows + r) * outputCols;
+			const float* out = output.GetData() + outputIndex;
+			const Offset* offset = offsets + outputIndex;
+			float* windows = slice + r * poolHeight * distributedCols;
+
+			for (size_t c = 0; c < outputCols; c++)
+			{
+				const size_t i = offset[c] / poolWidth;
+				const size_t j = offset[c] - i * poolWidth;
+				windows[i * distributedCols + c * poolWidth + j] = out[c];
+			}
+		}
+	}
+}
+
+template<typename Offset>
+void DistributeReverseMaxPoolOffsets(Tensor3D& distributed, const Offset* offsets, const Tensor3D& output, size_t poolHeight, size_t poolWidth)
+{
+#ifdef ASYNC
+	ThreadPool* pool = ThreadPool::GetInstance();
+	int numThreads = pool->GetNumThreads();
+
+	// Calculate depth per thread more accurately
+	int depthPerThread = output.GetDepth() / numThreads;
+	int extraDepth = output.GetDepth() % numThreads; // Remaining depths that need to be distributed
+
+	std::vector<std::future<void>> tasks;
+	size_t startDepth = 0;
+	for (size_t i = 0; i < numThreads; i++) {
+		// Assign extra depth to the first 'extraDepth' threads
+		size_t endDepth = startDepth + depthPerThread + (i < extraDepth ? 1 : 0);
+
+		tasks.emplace_back(
+			pool->enqueue(AsyncDistributeReverseMaxPool<Offset>, startDepth, endDepth, std::ref(distributed), offsets, std::cref(output), poolHeight, poolWidth)
+		);
+
+		startDepth = endDepth;
+	}
+
+	for (auto& task : tasks) {
+		task.get();
+	}
+#else
+	AsyncDistributeReverseMaxPool<Offset>(0, output.GetDepth(), distributed, offsets, output, poolHeight, poolWidth);
+#endif // ASYNC
+}
+
+void DistributeReverseMaxPool(Tensor3D& distributed, const MaxPoolIndices& indices, const Tensor3D& output, size_t poolHeight, size_t poolWidth)
+{
+	if (output.IsOnDevice() || distributed.IsOnDevice())
+	{
+		throw std::runtime_error("Max pooling indices are only used on the host.");
+	}
+
+	assert(indices.Offsets.size() == output.GetSize() * (indices.IsWide ? sizeof(uint16_t) : sizeof(uint8_t)) && "Max pooling indices not match the output!");
+
+	if (indices.IsWide)
+		DistributeReverseMaxPoolOffsets<uint16_t>(distributed, (const uint16_t*)indices.Offsets.data(), output, poolHeight, poolWidth);
+	else
+		DistributeReverseMaxPoolOffsets<uint8_t>(distributed, indices.Offsets.data(), output, poolHeight, poolWidth);
+}
+
+void CreateReluMask(ReluMask& mask, const Tensor& output)
+{
+	if (output.IsOnDevice())
+	{
+		throw std::runtime_error("ReLU masks are only used on the host.");
+	}
+
+	const size_t size = output.GetSize();
+	const float* data = output.GetData();
+	mask.Size = size;
+	mask.Bits.assign((size + 63) / 64, 0);
+	for (size_t word = 0; word < mask.Bits.size(); word++)
+	{
+		const size_t start = word * 64, end = std::min(start + 64, size);
+		uint64_t bits = 0;
+		for (size_t i = start; i < end; i++)
+			bits |= (uint64_t)(data[i] > 0.0f) << (i - start);
+		mask.Bits[word] = bits;
+	}
+}
+
+void ApplyReluMask(Tensor& gradient, const ReluMask& mask, float alpha)
+{
+	if (gradient.IsOnDevice())
+	{
+		throw std::runtime_error("ReLU masks are only used on the host.");
+	}
+
+	assert(gradient.GetSize() == mask.Size && "ReLU mask not match the gradient!");
+
+	float* data = gradient.GetData();
+	for (size_t word = 0; word < mask.Bits.size(); word++)
+	{
+		const size_t start = word * 64, end = std::min(start + 64, mask.Size);
+		const uint64_t bits = mask.Bits[word];
+		if (bits == ~uint64_t(0))
+			continue;
+		for (size_t i = start; i < end; i++)
+		{
+			if (!((bits >> (i - start)) & 1))
+				data[i] *= alpha;
+		}
+	}
+}
+
 void AsyncNearestUpsample(size_t startDepth, size_t endDepth, Tensor3D& output, const Tensor3D& input, size_t upsampleHeight, size_t upsampleWidth)
 {
 	for (size_t d = startDepth; d < endDepth; d++)
@@ -1054,6 +1951,23 @@ Tensor3D NearestUpsample(const Tensor3D& input, size_t upsampleHeight, size_t up
 		return output;
 	}
 
+	NearestUpsample(output, input, upsampleHeight, upsampleWidth);
+
+	return output;
+}
+
+void NearestUpsample(Tensor3D& output, const Tensor3D& input, size_t upsampleHeight, size_t upsampleWidth)
+{
+	assert(output.GetRows() == input.GetRows() * upsampleHeight &&
+		output.GetCols() == input.GetCols() * upsampleWidth &&
+		output.GetDepth() == input.GetDepth()
+		&& "Output shape not match!");
+
+	if (output.IsOnDevice() || input.IsOnDevice())
+	{
+		throw std::runtime_error("Upsampling into an output is only implemented on the host.");
+	}
+
 #ifdef ASYNC
 	ThreadPool* pool = ThreadPool::GetInstance();
 	int numThreads = pool->GetNumThreads();
@@ -1076,28 +1990,8 @@ Tensor3D NearestUpsample(const Tensor3D& input, size_t upsampleHeight, size_t up
 		task.get();
 	}
 #else
-	for (size_t d = 0; d < input.GetDepth(); d++)
-	{
-		Tensor2D inputSlice = CreateWatcher((Tensor3D&)input, d);  // !
-		Tensor2D outputSlice = CreateWatcher(output, d);
-
-		for (size_t r = 0; r < input.GetRows(); r++)
-		{
-			for (size_t c = 0; c < input.GetCols(); c++)
-			{
-				float value = inputSlice.GetAt(r, c);
-				Tensor2D outputWindow = CreateWatcher(outputSlice, r * upsampleHeight, c * upsampleWidth, upsampleHeight, upsampleWidth, 0, 0);
-				for (size_t i = 0; i < outputWindow.GetSize(); i++)
-				{
-					size_t index = outputWindow.TraverseTo(i);
-					outputWindow.GetData()[index] = value;
-				}
-			}
-		}
-	}
+	AsyncNearestUpsample(0, input.GetDepth(), output, input, upsampleHeight, upsampleWidth);
 #endif // ASYNC
-
-	return output;
 }
 
 void AsyncDistributeReverseNearestUpsample(size_t startDepth, size_t endDepth, Tensor3D& distributed, const Tensor3D& output, size_t upsampleHeight, size_t upsampleWidth)
@@ -1182,6 +2076,90 @@ void DistributeReverseNearestUpsample(Tensor3D& distributed, const Tensor3D& out
 #endif // ASYNC
 }
 
+Tensor3D Softmax(const Tensor3D& input)
+{
+	if (input.IsOnDevice())
+	{
+		Tensor3D hostInput = input;
+		hostInput.ToHost();
+		Tensor3D output = Softmax(hostInput);
+		output.ToDevice();
+		return output;
+	}
+
+	Tensor3D output(input.GetRows(), input.GetCols(), input.GetDepth());
+	Softmax(output, input);
+	return output;
+}
+
+void Softmax(Tensor3D& output, const Tensor3D& input)
+{
+	assert(output.GetSize() == input.GetSize() && "Output shape not match!");
+
+	if (output.IsOnDevice() || input.IsOnDevice())
+	{
+		throw std::runtime_error("Softmax into an output is only implemented on the host.");
+	}
+
+	const size_t size = input.GetSize();
+	const float* in = input.GetData();
+	float* out = output.GetData();
+
+	float max = -std::numeric_limits<float>::infinity();
+	for (size_t i = 0; i < size; i++)
+	{
+		max = std::max(max, in[i]);
+	}
+
+	float sum = 0.0f;
+	for (size_t i = 0; i < size; i++)
+	{
+		out[i] = exp(in[i] - max);
+		sum += out[i];
+	}
+
+	const float scale = 1.0f / sum;
+	for (size_t i = 0; i < size; i++)
+	{
+		out[i] *= scale;
+	}
+}
+
+Tensor3D SoftmaxJacobianProduct(const Tensor3D& output, const Tensor3D& costs)
+{
+	assert(output.GetSize() == costs.GetSize() && "Output and costs sizes not match!");
+
+	if (output.IsOnDevice() || costs.IsOnDevice())
+	{
+		Tensor3D hostOutput = output;
+		Tensor3D hostCosts = costs;
+		hostOutput.ToHost();
+		hostCosts.ToHost();
+		Tensor3D gradient = SoftmaxJacobianProduct(hostOutput, hostCosts);
+		gradient.ToDevice();
+		return gradient;
+	}
+
+	const size_t size = output.GetSize();
+	const float* p = output.GetData();
+	const float* c = costs.GetData();
+	Tensor3D gradient(output.GetRows(), output.GetCols(), output.GetDepth());
+	float* g = gradient.GetData();
+
+	float dot = 0.0f;
+	for (size_t i = 0; i < size; i++)
+	{
+		dot += c[i] * p[i];
+	}
+
+	for (size_t i = 0; i < size; i++)
+	{
+		g[i] = p[i] * (c[i] - dot);
+	}
+
+	return gradient;
+}
+
 void AsyncDropOut(size_t start, size_t end, Tensor* output, const Tensor* input, float dropoutRate, float retentionProb, Tensor* dropOutMask)
 {
 	std::random_device rd;
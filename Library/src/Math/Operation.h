@@ -1,5 +1,7 @@
 #pragma once
 #include <functional>
+#include <vector>
+#include <stdint.h>
 #include "Core.h"
 #include "Tensor2D.h"
 #include "Tensor3D.h"
@@ -39,6 +41,12 @@ LIBRARY_API Tensor2D MatrixMult(const Tensor2D& left, const Tensor2D& right);
 LIBRARY_API Tensor2D MatrixMultLeftTranspose(const Tensor2D& left, const Tensor2D& right);
 // Calculates the matrix multiplication, but take the right matrix as a transpose matrix without extra calculation.
 LIBRARY_API Tensor2D MatrixMultRightTranspose(const Tensor2D& left, const Tensor2D& right);
+// Calculates the matrix multiplication, adds the bias column (if not null) to every column of the result and applies the activation before writing the output.
+// If preActivation is not null, the biased sums are also written into it (needed for the backpropagation).
+LIBRARY_API void MatrixMultBiasActivation(Tensor2D& output, const Tensor2D& left, const Tensor2D& right, const Tensor2D* bias, std::function<float(float v)> activation, Tensor2D* preActivation=nullptr);
+// Calculates the outer product gradient (left x right^T) in small tiles and hands every tile to the consumer, the whole gradient is never allocated.
+// The consumer gets the flat index of the tile's first element, the tile and its size. Tiles are disjoint and consumed in parallel.
+LIBRARY_API void OuterProductTiles(const Tensor2D& left, const Tensor2D& right, std::function<void(size_t index, const float* tile, size_t size)> consumer);
 
 LIBRARY_API size_t CalcConvSize(size_t inputSize, size_t kernelSize, size_t stride, size_t padding);
 LIBRARY_API float KernelOperation(const Tensor2D& window, const Tensor2D& kernel);
@@ -65,12 +73,68 @@ LIBRARY_API Tensor2D ConvolutionKernelFlip(const Tensor2D& input, const Tensor2D
 LIBRARY_API Tensor2D Convolution(const Tensor3D& input, const Tensor3D& kernel, size_t stride, size_t padding);
 LIBRARY_API Tensor2D ConvolutionKernelFlip(const Tensor3D& input, const Tensor3D& kernel, size_t stride, size_t padding);
 
-LIBRARY_API Tensor3D MaxPool(const Tensor3D& input, size_t poolHeight, size_t poolWidth);
+// Preform a convolutional operation with every kernel block (input depth sized slices of the kernels) on the input, with zero padding.
+// The bias (if not null) and the activation are applied to the sums before they are written to the output.
+// If preActivation is not null, the biased sums are also written into it (needed for the backpropagation).
+LIBRARY_API void ConvolutionBiasActivation(Tensor3D& output, const Tensor3D& input, const Tensor3D& kernels, const Tensor3D* bias, std::function<float(float v)> activation, size_t stride, size_t padding, Tensor3D* preActivation=nullptr);
+// Same as ConvolutionBiasActivation, but max pools the activated sums, only the pooled output is written.
+LIBRARY_API void ConvolutionBiasActivationMaxPool(Tensor3D& output, const Tensor3D& input, const Tensor3D& kernels, const Tensor3D* bias, std::function<float(float v)> activation, size_t stride, size_t padding, size_t poolHeight, size_t poolWidth);
+
+// Grouped convolution: the input depth and the kernel blocks are split into groups, a kernel block only sees the (input depth / groups) slices of its group.
+// The kernels are (kh, kw, input depth / groups * output depth). With groups = 1 it is ConvolutionBiasActivation, with groups = input depth a depthwise convolution.
+LIBRARY_API void GroupedConvolutionBiasActivation(Tensor3D& output, const Tensor3D& input, const Tensor3D& kernels, size_t groups, const Tensor3D* bias, std::function<float(float v)> activation, size_t stride, size_t padding, Tensor3D* preActivation=nullptr);
+// The gradient of a (grouped) convolution's input: every output gradient is scattered back through the kernels to its strided input positions. Adds to the input gradient.
+LIBRARY_API void GroupedConvolutionInputGradient(Tensor3D& inputGradient, const Tensor3D& outputGradient, const Tensor3D& kernels, size_t groups, size_t stride, size_t padding);
+// The gradient of a (grouped) convolution's kernels from its input and output gradient. Adds to the kernel gradient.
+LIBRARY_API void GroupedConvolutionKernelGradient(Tensor3D& kernelGradient, const Tensor3D& input, const Tensor3D& outputGradient, size_t groups, size_t stride, size_t padding);
+
+// Positions of the maximums inside their pooling windows (row * poolWidth + col), in the order of the pooled output.
+// A byte per window, two bytes if the window has more than 256 elements (IsWide).
+struct LIBRARY_API MaxPoolIndices
+{
+	std::vector<uint8_t> Offsets;
+	bool IsWide = false;
+};
+
+// If indices is not null, the positions of the maximums are recorded for the backward pass (host only).
+LIBRARY_API Tensor3D MaxPool(const Tensor3D& input, size_t poolHeight, size_t poolWidth, MaxPoolIndices* indices=nullptr);
 LIBRARY_API void DistributeReverseMaxPool(Tensor3D& distributed, const Tensor3D& input, const Tensor3D& output, size_t poolHeight, size_t poolWidth);
+// Host only, the output must have the pooled shape.
+LIBRARY_API void MaxPool(Tensor3D& output, const Tensor3D& input, size_t poolHeight, size_t poolWidth);
+// Scatters the output into the recorded positions of the maximums, the input is not read again.
+LIBRARY_API void DistributeReverseMaxPool(Tensor3D& distributed, const MaxPoolIndices& indices, const Tensor3D& output, size_t poolHeight, size_t poolWidth);
+
+// A bit per element, set where a (leaky) ReLU's output is positive. With a non negative alpha it is the ReLU's derivative (1 or alpha),
+// so it is kept for the backward pass instead of the sums.
+struct LIBRARY_API ReluMask
+{
+	std::vector<uint64_t> Bits;
+	size_t Size = 0;
+};
+
+// Host only.
+LIBRARY_API void CreateReluMask(ReluMask& mask, const Tensor& output);
+// gradient *= (mask ? 1 : alpha), host only.
+LIBRARY_API void ApplyReluMask(Tensor& gradient, const ReluMask& mask, float alpha);
 
 LIBRARY_API Tensor3D NearestUpsample(const Tensor3D& input, size_t upsampleHeight, size_t upsampleWidth);
+// Host only, the output must have the upsampled shape.
+LIBRARY_API void NearestUpsample(Tensor3D& output, const Tensor3D& input, size_t upsampleHeight, size_t upsampleWidth);
 LIBRARY_API void DistributeReverseNearestUpsample(Tensor3D& distributed, const Tensor3D& output, size_t upsampleHeight, size_t upsampleWidht);
 
+// Dot product of unsigned 7 bit (0..127) and signed 8 bit values, exact in 32 bits.
+// With AVX2 it uses maddubs (the 7 bit left operand can't saturate the 16 bit pair sums), with AVX512-VNNI dpbusd.
+LIBRARY_API int32_t DotProductU8S8(const uint8_t* left, const int8_t* right, size_t size);
+// Squared euclidean distance of two vectors, vectorized with AVX2 (and FMA).
+LIBRARY_API float SquaredDistance(const float* left, const float* right, size_t size);
+
+// Numerically stable softmax over all the elements of the input (the maximum is subtracted before the exponentiation).
+LIBRARY_API Tensor3D Softmax(const Tensor3D& input);
+// Host only, the output must have the input's shape.
+LIBRARY_API void Softmax(Tensor3D& output, const Tensor3D& input);
+// Multiplies the costs with the softmax's Jacobian in O(n): grad_i = p_i * (c_i - sum_j(c_j * p_j)).
+LIBRARY_API Tensor3D SoftmaxJacobianProduct(const Tensor3D& output, const Tensor3D& costs);
+
 LIBRARY_API Tensor3D DropOut(const Tensor3D& input, float dropoutRate, Tensor3D* dropOutMask=nullptr);
 
 namespace_end
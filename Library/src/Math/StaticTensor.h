@@ -0,0 +1,45 @@
+#pragma once
+#include <assert.h>
+#include <algorithm>
+#include <stdexcept>
+
+#include "Core.h"
+#include "Tensor3D.h"
+
+
+namespace_start
+
+/*
+	A tensor with its shape as template parameters and its data in place (on the stack when it is a local), for tiny models.
+	The memory order is the Tensor3D's: (depth, row, col). Always on the host, it never allocates.
+*/
+template<size_t R, size_t C, size_t D=1>
+struct StaticTensor
+{
+	static constexpr size_t Rows = R, Cols = C, Depth = D;
+	static constexpr size_t Size = R * C * D;
+
+	alignas(32) float Data[Size] = { };
+
+	StaticTensor() = default;
+	explicit StaticTensor(float value) { std::fill(Data, Data + Size, value); }
+	explicit StaticTensor(const Tensor3D& tensor) { FromTensor3D(tensor); }
+
+	inline float GetAt(size_t row, size_t col, size_t depth) const { return Data[(depth * R + row) * C + col]; }
+	inline void SetAt(size_t row, size_t col, size_t depth, float value) { Data[(depth * R + row) * C + col] = value; }
+
+	inline float& operator[](size_t i) { return Data[i]; }
+	inline float operator[](size_t i) const { return Data[i]; }
+
+	void FromTensor3D(const Tensor3D& tensor)
+	{
+		assert(tensor.GetRows() == R && tensor.GetCols() == C && tensor.GetDepth() == D && "Invalid tensor shape!");
+		if (tensor.IsOnDevice())
+			throw std::runtime_error("The tensor must be on the host.");
+		std::copy(tensor.GetData(), tensor.GetData() + Size, Data);
+	}
+
+	Tensor3D ToTensor3D() const { return Tensor3D(R, C, D, (const float*)Data, false); }
+};
+
+namespace_end
@@ -10,15 +10,15 @@ ConvolutionalLayer::ConvolutionalLayer(
 	size_t inputHeight, size_t inputWidth, size_t inputDepth,
 	size_t kernelHeight, size_t kernelWidth, size_t numKernels,
 	size_t padding, ActivationFunciton activationFunction, Initializer initializer,
-	bool isUseBias
-) : m_ActivationFunction(activationFunction), m_Padding(padding), m_InputWidth(inputWidth), m_InputHeight(inputHeight), m_InputDepth(inputDepth), m_NumKernels(numKernels), m_IsUseBias(isUseBias)
+	bool isUseBias, size_t stride
+) : m_ActivationFunction(activationFunction), m_InputWidth(inputWidth), m_InputHeight(inputHeight), m_InputDepth(inputDepth), m_NumKernels(numKernels), m_Padding(padding), m_Stride(stride), m_IsUseBias(isUseBias)
 {
-	assert(inputHeight == inputWidth && "Different input size ratio not supported!");
-	assert(kernelHeight == kernelWidth && "Different kernel size ratio not supported!");
+	assert(stride > 0 && "Invalid stride!");
+	assert(inputHeight + 2 * padding >= kernelHeight && inputWidth + 2 * padding >= kernelWidth && "The kernel is larger than the padded input!");
 
 	size_t kernelDepth = numKernels * inputDepth;
-	size_t outputHeight = CalcConvSize(inputHeight, kernelHeight, 1, padding);
-	size_t outputWidth = CalcConvSize(inputWidth, kernelWidth, 1, padding);
+	size_t outputHeight = CalcConvSize(inputHeight, kernelHeight, stride, padding);
+	size_t outputWidth = CalcConvSize(inputWidth, kernelWidth, stride, padding);
 
 	if (m_IsUseBias)
 	{
@@ -27,6 +27,24 @@ ConvolutionalLayer::ConvolutionalLayer(
 	m_Kernels = Tensor3D(kernelHeight, kernelWidth, kernelDepth, initializer.Init);
 }
 
+ConvolutionalLayer::ConvolutionalLayer(
+	size_t inputHeight, size_t inputWidth, size_t inputDepth,
+	const Tensor3D& kernels, size_t numKernels,
+	size_t padding, ActivationFunciton activationFunction, const Tensor3D* bias, size_t stride
+) : m_ActivationFunction(activationFunction), m_InputWidth(inputWidth), m_InputHeight(inputHeight), m_InputDepth(inputDepth), m_NumKernels(numKernels), m_Padding(padding), m_Stride(stride), m_IsUseBias(bias != nullptr)
+{
+	assert(kernels.GetDepth() == numKernels * inputDepth && "Invalid kernel depth!");
+	assert(stride > 0 && "Invalid stride!");
+
+	m_Kernels = kernels;
+	if (m_IsUseBias)
+	{
+		LayerShape layerShape = GetLayerShape();
+		assert(bias->GetRows() == layerShape.OutputRows && bias->GetCols() == layerShape.OutputCols && bias->GetDepth() == numKernels && "Invalid bias shape!");
+		m_Bias = *bias;
+	}
+}
+
 ConvolutionalLayer::ConvolutionalLayer(const std::string& fromString)
 {
 	FromString(fromString);
@@ -72,11 +90,18 @@ Tensor3D ConvolutionalLayer::FeedForward(const Tensor3D& inputs)
 
 	Tensor3D output = Tensor3D(layerShape.OutputRows, layerShape.OutputCols, layerShape.OutputDepth, 0.0f, inputs.IsOnDevice());
 
+	if (!inputs.IsOnDevice())
+	{
+		// Bias and activation are applied in the convolution's epilogue, the output is written once.
+		ConvolutionBiasActivation(output, inputs, m_Kernels, m_IsUseBias ? &m_Bias : nullptr, m_ActivationFunction.Activation, m_Stride, m_Padding);
+		return output;
+	}
+
 	for (int d = 0; d < layerShape.OutputDepth; d++)
 	{
 		Tensor3D kernelBlock = CreateWatcher(m_Kernels, d * layerShape.InputDepth, layerShape.InputDepth);
 		Tensor2D outputSlice = CreateWatcher(output, d);
-		Convolution(outputSlice, inputs, kernelBlock, 1, m_Padding);
+		Convolution(outputSlice, inputs, kernelBlock, m_Stride, m_Padding);
 	}
 
 	if (m_IsUseBias)
@@ -87,28 +112,99 @@ Tensor3D ConvolutionalLayer::FeedForward(const Tensor3D& inputs)
 	return output;
 }
 
+void ConvolutionalLayer::Infer(const Tensor3D& inputs, Tensor3D& output) const
+{
+	assert(inputs.GetRows() == m_InputHeight && inputs.GetCols() == m_InputWidth && inputs.GetDepth() == m_InputDepth 
+		&& "Invalid input shape!");
+
+	if (inputs.IsOnDevice() || output.IsOnDevice() || m_Kernels.IsOnDevice())
+		throw std::runtime_error("Inference is only implemented on the host.");
+
+	ConvolutionBiasActivation(output, inputs, m_Kernels, m_IsUseBias ? &m_Bias : nullptr, m_ActivationFunction.Activation, m_Stride, m_Padding);
+}
+
+Tensor3D ConvolutionalLayer::FeedForwardMaxPool(const Tensor3D& inputs, size_t poolingHeight, size_t poolingWidth)
+{
+	assert(inputs.GetRows() == m_InputHeight && inputs.GetCols() == m_InputWidth && inputs.GetDepth() == m_InputDepth
+		&& "Invalid input shape!");
+
+	if (inputs.IsOnDevice())
+	{
+		return MaxPool(FeedForward(inputs), poolingHeight, poolingWidth);
+	}
+
+	LayerShape layerShape = GetLayerShape();
+
+	Tensor3D output = Tensor3D(layerShape.OutputRows / poolingHeight, layerShape.OutputCols / poolingWidth, layerShape.OutputDepth);
+	ConvolutionBiasActivationMaxPool(output, inputs, m_Kernels, m_IsUseBias ? &m_Bias : nullptr, m_ActivationFunction.Activation, m_Stride, m_Padding, poolingHeight, poolingWidth);
+	return output;
+}
+
+void ConvolutionalLayer::InferMaxPool(const Tensor3D& inputs, Tensor3D& output, size_t poolingHeight, size_t poolingWidth) const
+{
+	assert(inputs.GetRows() == m_InputHeight && inputs.GetCols() == m_InputWidth && inputs.GetDepth() == m_InputDepth
+		&& "Invalid input shape!");
+
+	if (inputs.IsOnDevice() || output.IsOnDevice() || m_Kernels.IsOnDevice())
+		throw std::runtime_error("Inference is only implemented on the host.");
+
+	ConvolutionBiasActivationMaxPool(output, inputs, m_Kernels, m_IsUseBias ? &m_Bias : nullptr, m_ActivationFunction.Activation, m_Stride, m_Padding, poolingHeight, poolingWidth);
+}
+
 Tensor3D ConvolutionalLayer::BackPropagation(const Tensor3D& inputs, const CostFunction& costFunction, float learningRate, size_t t)
 {
 	assert(inputs.GetRows() == m_InputHeight && inputs.GetCols() == m_InputWidth && inputs.GetDepth() == m_InputDepth
 		&& "Invalid input shape!");
 
+	if (inputs.IsOnDevice() && (m_Stride != 1 || m_Kernels.GetRows() != m_Kernels.GetCols()))
+		throw std::runtime_error("The back propagation of a strided or rectangular convolution is only implemented on the host.");
+
 	LayerShape layerShape = GetLayerShape();
-	
-	Tensor3D filterMap = Tensor3D(layerShape.OutputRows, layerShape.OutputCols, layerShape.OutputDepth, 0.0f, inputs.IsOnDevice());
 
-	for (int d = 0; d < layerShape.OutputDepth; d++)
+	// A (leaky) ReLU's derivative only needs the sign of the output: a bit per element is kept through the back propagation, not the sums.
+	const float reluAlpha = m_ActivationFunction.Name == "RelU" ? std::stof(m_ActivationFunction.Params) : -1.0f;
+	const bool isReluMask = !inputs.IsOnDevice() && reluAlpha >= 0.0f;
+	ReluMask reluMask;
+
+	Tensor3D filterMap = isReluMask ? Tensor3D() : Tensor3D(layerShape.OutputRows, layerShape.OutputCols, layerShape.OutputDepth, 0.0f, inputs.IsOnDevice());
+	Tensor3D output = Tensor3D(layerShape.OutputRows, layerShape.OutputCols, layerShape.OutputDepth, 0.0f, inputs.IsOnDevice());
+
+	if (!inputs.IsOnDevice())
 	{
-		Tensor3D kernelBlock = CreateWatcher(m_Kernels, d * layerShape.InputDepth, layerShape.InputDepth);
-		Tensor2D outputSlice = CreateWatcher(filterMap, d);
-		Convolution(outputSlice, inputs, kernelBlock, 1, m_Padding);
+		// The epilogue writes both the biased sums (for the activation's derivative) and the activated output.
+		if (m_IsMixedPrecision)
+		{
+			if (m_IsKernelsBF16Stale)
+			{
+				ToBFloat16(m_KernelsBF16, m_Kernels);
+				m_IsKernelsBF16Stale = false;
+			}
+			ToBFloat16(m_InputBF16, inputs);
+			ConvolutionBiasActivationBF16(output, m_InputBF16, m_KernelsBF16, m_IsUseBias ? &m_Bias : nullptr, m_ActivationFunction.Activation, m_Stride, m_Padding, isReluMask ? nullptr : &filterMap);
+		}
+		else
+		{
+			ConvolutionBiasActivation(output, inputs, m_Kernels, m_IsUseBias ? &m_Bias : nullptr, m_ActivationFunction.Activation, m_Stride, m_Padding, isReluMask ? nullptr : &filterMap);
+		}
+		if (isReluMask)
+			CreateReluMask(reluMask, output);
 	}
-	if (m_IsUseBias)
+	else
 	{
-		filterMap.Add(m_Bias);
-	}
+		for (int d = 0; d < layerShape.OutputDepth; d++)
+		{
+			Tensor3D kernelBlock = CreateWatcher(m_Kernels, d * layerShape.InputDepth, layerShape.InputDepth);
+			Tensor2D outputSlice = CreateWatcher(filterMap, d);
+			Convolution(outputSlice, inputs, kernelBlock, 1, m_Padding);
+		}
+		if (m_IsUseBias)
+		{
+			filterMap.Add(m_Bias);
+		}
 
-	Tensor3D output = filterMap;
-	m_ActivationFunction.MapActivation(&output);
+		output.Add(filterMap);
+		m_ActivationFunction.MapActivation(&output);
+	}
 
 
 	Tensor3D costs = NextLayer ?
@@ -119,40 +215,71 @@ Tensor3D ConvolutionalLayer::BackPropagation(const Tensor3D& inputs, const CostF
 		&& "Invalid cost shape!");
 
 
-	m_ActivationFunction.MapDiffActivation(&filterMap);
-	costs.Mult(filterMap);  // costs -> Gradient.
+	if (isReluMask)
+	{
+		ApplyReluMask(costs, reluMask, reluAlpha);  // costs -> Gradient.
+	}
+	else
+	{
+		m_ActivationFunction.MapDiffActivation(&filterMap);
+		costs.Mult(filterMap);  // costs -> Gradient.
+	}
 
 	Tensor3D& gradBias = costs;
 
-	Tensor3D gradKernel = Tensor3D(m_Kernels.GetRows(), m_Kernels.GetCols(), m_Kernels.GetDepth(), 0.0f, m_Kernels.IsOnDevice());
+	Tensor3D gradKernel = m_IsFrozen ? Tensor3D() : Tensor3D(m_Kernels.GetRows(), m_Kernels.GetCols(), m_Kernels.GetDepth(), 0.0f, m_Kernels.IsOnDevice());
 
-	size_t gradInputPadding = m_Kernels.GetRows() - 1 - m_Padding;
 	Tensor3D gradInput = Tensor3D(layerShape.InputRows, layerShape.InputCols, layerShape.InputDepth, 0.0f, inputs.IsOnDevice());
 
-	for (size_t d = 0; d < layerShape.OutputDepth; d++)
+	if (!inputs.IsOnDevice())
+	{
+		// The output gradients are scattered back to the strided input positions (the dilated gradient), any stride and kernel shape.
+		GroupedConvolutionInputGradient(gradInput, costs, m_Kernels, 1, m_Stride, m_Padding);
+		if (!m_IsFrozen)
+			GroupedConvolutionKernelGradient(gradKernel, inputs, costs, 1, m_Stride, m_Padding);
+	}
+	else
 	{
-		Tensor2D grad = CreateWatcher(costs, d);
+		size_t gradInputPadding = m_Kernels.GetRows() - 1 - m_Padding;
+		for (size_t d = 0; d < layerShape.OutputDepth; d++)
+		{
+			Tensor2D grad = CreateWatcher(costs, d);
 
-		Tensor3D gradKernelBlock = CreateWatcher(gradKernel, d * layerShape.InputDepth, layerShape.InputDepth);
-		Convolution(gradKernelBlock, inputs, grad, 1, m_Padding);
+			if (!m_IsFrozen)
+			{
+				Tensor3D gradKernelBlock = CreateWatcher(gradKernel, d * layerShape.InputDepth, layerShape.InputDepth);
+				Convolution(gradKernelBlock, inputs, grad, 1, m_Padding);
+			}
 
-		Tensor3D kernelBlock = CreateWatcher(m_Kernels, d * layerShape.InputDepth, layerShape.InputDepth);
-		ConvolutionKernelFlip(gradInput, grad, kernelBlock, 1, gradInputPadding);
+			Tensor3D kernelBlock = CreateWatcher(m_Kernels, d * layerShape.InputDepth, layerShape.InputDepth);
+			ConvolutionKernelFlip(gradInput, grad, kernelBlock, 1, gradInputPadding);
+		}
 	}
 
-	m_KernelOptimizer->Update(&m_Kernels, &gradKernel, learningRate);
-	if (m_IsUseBias)
+	if (!m_IsFrozen)
 	{
-		m_BiasOptimizer->Update(&m_Bias, &gradBias, learningRate);
+		m_KernelOptimizer->Update(&m_Kernels, &gradKernel, learningRate);
+		if (m_IsUseBias)
+		{
+			m_BiasOptimizer->Update(&m_Bias, &gradBias, learningRate);
+		}
+		m_IsKernelsBF16Stale = m_IsKernelsBF16Stale || m_KernelOptimizer->IsChangingParams();
 	}
 
 	return gradInput;
 }
 
+std::vector<LearnableTensor> ConvolutionalLayer::GetLearnableTensors()
+{
+	if (!m_IsUseBias)
+		return { { &m_Kernels, m_KernelOptimizer.get() } };
+	return { { &m_Kernels, m_KernelOptimizer.get() }, { &m_Bias, m_BiasOptimizer.get() } };
+}
+
 LayerShape ConvolutionalLayer::GetLayerShape() const
 {
-	size_t outputHeight = CalcConvSize(m_InputHeight, m_Kernels.GetRows(), 1, m_Padding);
-	size_t outputWidth = CalcConvSize(m_InputWidth, m_Kernels.GetCols(), 1, m_Padding);
+	size_t outputHeight = CalcConvSize(m_InputHeight, m_Kernels.GetRows(), m_Stride, m_Padding);
+	size_t outputWidth = CalcConvSize(m_InputWidth, m_Kernels.GetCols(), m_Stride, m_Padding);
 
 	return
 	{
@@ -168,7 +295,7 @@ std::string ConvolutionalLayer::ToString() const
 	ss << "[ " <<
 		m_InputWidth << " " << m_InputHeight << " " << m_InputDepth << " " << 
 		m_Kernels.GetRows() << " " << m_Kernels.GetCols() << " " << m_NumKernels << " " << m_Padding << " " << m_IsUseBias << " " <<
-		m_ActivationFunction.Name << " ( " << m_ActivationFunction.Params << " )" <<
+		m_ActivationFunction.Name << " ( " << m_ActivationFunction.Params << " ) " << m_Stride <<
 	" ]";
 
 	for (size_t t = 0; t < m_Kernels.GetSize(); t++)
@@ -210,9 +337,14 @@ void ConvolutionalLayer::FromString(const std::string& data)
 	ss >> m_InputWidth >> m_InputHeight >> m_InputDepth >> kernelHeight >> kernelWidth >> m_NumKernels >> m_Padding >> m_IsUseBias;
 	ss >> activationName;
 
+	// The stride follows the activation, the files saved before the strided convolution have none.
+	std::stringstream strideSS(hyperparams.substr(acivationParamsEnd + 1));
+	if (!(strideSS >> m_Stride))
+		m_Stride = 1;
+
 	size_t kernelDepth = m_NumKernels * m_InputDepth;
-	size_t outputHeight = CalcConvSize(m_InputHeight, kernelHeight, 1, m_Padding);
-	size_t outputWidth = CalcConvSize(m_InputWidth, kernelWidth, 1, m_Padding);
+	size_t outputHeight = CalcConvSize(m_InputHeight, kernelHeight, m_Stride, m_Padding);
+	size_t outputWidth = CalcConvSize(m_InputWidth, kernelWidth, m_Stride, m_Padding);
 
 	m_Bias = Tensor3D(outputHeight, outputWidth, m_NumKernels);
 	m_Kernels = Tensor3D(kernelHeight, kernelWidth, kernelDepth);
@@ -248,6 +380,7 @@ void ConvolutionalLayer::FromString(const std::string& data)
 		std::string biasOptimizerStr = remaining.substr(biasOptimizerStart + 1, biasOptimizerEnd - biasOptimizerStart - 2);
 		m_BiasOptimizer = optimizerFactory.Get(biasOptimizerStr);
 	}
+	m_IsKernelsBF16Stale = true;
 }
 
 std::string ConvolutionalLayer::ToDebugString() const
@@ -269,7 +402,7 @@ std::string ConvolutionalLayer::Summarize() const
 	ss << ClassName() << ":\t Input: (" <<
 		shape.InputRows << ", " << shape.InputCols << ", " << shape.InputDepth << "), Output: (" <<
 		shape.OutputRows << ", " << shape.OutputCols << ", " << shape.OutputDepth << "), " <<
-		"# kernels: " << m_NumKernels << ", Padding: " << m_Padding <<
+		"# kernels: " << m_NumKernels << ", Padding: " << m_Padding << ", Stride: " << m_Stride <<
 		", Activation: " << m_ActivationFunction.Name << "(" << m_ActivationFunction.Params << "), " <<
 		"# learnable parameters: " << m_Kernels.GetSize() + m_Bias.GetSize();
 
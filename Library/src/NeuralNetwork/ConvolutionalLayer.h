@@ -2,6 +2,7 @@
 #include "Layer.h"
 #include "ActivationF.h"
 #include "Initializer.h"
+#include "../Math/BFloat16.h"
 
 
 namespace_start
@@ -13,7 +14,13 @@ public:
 		size_t inputHeight, size_t inputWidth, size_t inputDepth,
 		size_t kernelHeight, size_t kernelWidth, size_t numKernels,
 		size_t padding, ActivationFunciton activationFunction, Initializer initializer,
-		bool isUseBias = true
+		bool isUseBias = true, size_t stride = 1
+	);
+	// A layer with the given kernels (kh, kw, inputDepth * numKernels) and bias (output rows, output cols, numKernels), or without bias.
+	ConvolutionalLayer(
+		size_t inputHeight, size_t inputWidth, size_t inputDepth,
+		const Tensor3D& kernels, size_t numKernels,
+		size_t padding, ActivationFunciton activationFunction, const Tensor3D* bias = nullptr, size_t stride = 1
 	);
 	ConvolutionalLayer(const std::string& fromString);
 
@@ -22,8 +29,16 @@ public:
 
 	virtual void InitOptimizer(OptimizerFactory optimizerFactory) override;
 	virtual Tensor3D FeedForward(const Tensor3D& inputs) override;
+	virtual void Infer(const Tensor3D& inputs, Tensor3D& output) const override;
+	// Inference of this layer followed by a max pooling, only the pooled output is written.
+	Tensor3D FeedForwardMaxPool(const Tensor3D& inputs, size_t poolingHeight, size_t poolingWidth);
+	void InferMaxPool(const Tensor3D& inputs, Tensor3D& output, size_t poolingHeight, size_t poolingWidth) const;
 	virtual Tensor3D BackPropagation(const Tensor3D& inputs, const CostFunction& costFunction, float learningRate, size_t t) override;
 
+	virtual void SetMixedPrecision(bool isMixedPrecision) override { m_IsMixedPrecision = isMixedPrecision; m_IsKernelsBF16Stale = true; }
+	virtual bool IsMixedPrecision() const override { return m_IsMixedPrecision; }
+	virtual void MarkParamsChanged() override { m_IsKernelsBF16Stale = true; }
+
 	virtual LayerShape GetLayerShape() const override;
 
 	virtual std::string GetName() const override { return ClassName(); }
@@ -33,11 +48,19 @@ public:
 
 	virtual ActivationFunciton GetActivationFunction() const override { return m_ActivationFunction; }
 	virtual size_t GetLearnableParams() const override { return m_Kernels.GetSize() + (m_IsUseBias ? m_Bias.GetSize() : 0); };
-	virtual std::string GetSepcialParams() const override { return "Kernel: (" + std::to_string(m_Kernels.GetRows()) + ", " + std::to_string(m_Kernels.GetCols()) + ", " + std::to_string(m_InputDepth) + " * " + std::to_string(m_NumKernels) + "), Padding: " + std::to_string(m_Padding) + ", Stride: 1, Optimizer: " + m_KernelOptimizer->GetName(); };
+	virtual std::vector<LearnableTensor> GetLearnableTensors() override;
+	virtual std::string GetSepcialParams() const override { return "Kernel: (" + std::to_string(m_Kernels.GetRows()) + ", " + std::to_string(m_Kernels.GetCols()) + ", " + std::to_string(m_InputDepth) + " * " + std::to_string(m_NumKernels) + "), Padding: " + std::to_string(m_Padding) + ", Stride: " + std::to_string(m_Stride) + ", Optimizer: " + m_KernelOptimizer->GetName(); };
 
 	virtual void FromString(const std::string& data) override;
 
 	static std::string ClassName() { return "ConvolutionalLayer"; }
+
+	inline const Tensor3D& GetKernels() const { return m_Kernels; }
+	inline const Tensor3D& GetBias() const { return m_Bias; }
+	inline size_t GetNumKernels() const { return m_NumKernels; }
+	inline size_t GetPadding() const { return m_Padding; }
+	inline size_t GetStride() const { return m_Stride; }
+	inline bool IsUseBias() const { return m_IsUseBias; }
 private:
 	Tensor3D m_Kernels;  // k x k x (#2Dinputs * n)
 	Tensor3D m_Bias;  // Wo x Ho x n
@@ -46,11 +69,16 @@ private:
 	size_t m_InputWidth, m_InputHeight, m_InputDepth;
 	size_t m_NumKernels;
 	size_t m_Padding;
+	size_t m_Stride = 1;
 
 	bool m_IsUseBias;
 
 	std::unique_ptr<Optimizer> m_KernelOptimizer;
 	std::unique_ptr<Optimizer> m_BiasOptimizer;
+
+	bool m_IsMixedPrecision = false;
+	BFloat16Tensor m_KernelsBF16, m_InputBF16;  // The copies of the mixed precision forward pass, the kernels' is kept until they change.
+	bool m_IsKernelsBF16Stale = true;
 };
 
 namespace_end
@@ -1,10 +1,127 @@
 #include "CostF.h"
 
+#include <algorithm>
 #include <MogiAccelerator.h>
 
 
 namespace_start
 
+// Returns the sum of the elements' costs (the caller scales it), writes the derivatives into the gradient if it is set.
+// The derivatives are scaled the same way as the CostFunctions' DiffCost.
+static float EvaluateCost(CostType type, const float* output, const float* target, float* gradient, size_t size, float scale)
+{
+	const float ep = 1e-7f;
+	float cost = 0.0f;
+
+	switch (type)
+	{
+	case CostType::MeanSquareError:
+		for (size_t i = 0; i < size; i++)
+		{
+			float diff = output[i] - target[i];
+			cost += diff * diff;
+			if (gradient)
+				gradient[i] = 2.0f * scale * diff;
+		}
+		break;
+	case CostType::CrossEntropy:
+		for (size_t i = 0; i < size; i++)
+		{
+			float p = output[i];
+			float t = target[i];
+			cost -= t * log(p + ep);
+			if (gradient)
+				gradient[i] = p > 0.00000001f ? -1.0f * t / p * scale : 0.0f;
+		}
+		break;
+	case CostType::BinaryCrossEntropy:
+		for (size_t i = 0; i < size; i++)
+		{
+			float p = output[i];
+			float t = target[i];
+			cost -= t * log(p + ep) + (1.0f - t) * log(1.0f - p + ep);
+			if (gradient)
+			{
+				float c = std::min(std::max(p, ep), 1.0f - ep);
+				gradient[i] = -((t / c) - (1.0f - t) / (1.0f - c));
+			}
+		}
+		break;
+	default:
+		assert(false && "Unknown cost type!");
+		break;
+	}
+
+	return cost;
+}
+
+// Cross entropy of a softmax's output, the derivative is respect to the softmax's inputs: (p * sum(t) - t) / n.
+static float SoftmaxCrossEntropy(const float* output, const float* target, float* gradient, size_t size)
+{
+	const float ep = 1e-7f;
+	float cost = 0.0f;
+	float targetSum = 0.0f;
+	for (size_t i = 0; i < size; i++)
+	{
+		targetSum += target[i];
+		cost -= target[i] * log(output[i] + ep);
+	}
+
+	const float scale = 1.0f / (float)size;
+	for (size_t i = 0; i < size; i++)
+	{
+		gradient[i] = (output[i] * targetSum - target[i]) * scale;
+	}
+
+	return cost * scale;
+}
+
+// Binary cross entropy of a sigmoid's output, the derivative is respect to the sigmoid's inputs: p - t.
+static float SigmoidBinaryCrossEntropy(const float* output, const float* target, float* gradient, size_t size)
+{
+	const float ep = 1e-7f;
+	float cost = 0.0f;
+	for (size_t i = 0; i < size; i++)
+	{
+		float p = output[i];
+		float t = target[i];
+		cost -= t * log(p + ep) + (1.0f - t) * log(1.0f - p + ep);
+		gradient[i] = p - t;
+	}
+
+	return cost / (float)size;
+}
+
+// Runs the kernel on the host and returns the gradient on the output's device. The cost is written into cost if it is set.
+static Tensor3D EvaluateGradient(
+	const std::function<float(const float* output, const float* target, float* gradient, size_t size)>& kernel,
+	const Tensor3D& output, const Tensor3D& target, float* cost)
+{
+	assert((output.GetDepth() == target.GetDepth() &&
+		output.GetRows() == target.GetRows() &&
+		output.GetCols() == target.GetCols()
+		) && "Number of parameters in the output and target must be the same!");
+
+	if (output.IsOnDevice() || target.IsOnDevice())
+	{
+		Tensor3D out = output;
+		Tensor3D tar = target;
+		out.ToHost();
+		tar.ToHost();
+		Tensor3D gradient = EvaluateGradient(kernel, out, tar, cost);
+		if (output.IsOnDevice())
+			gradient.ToDevice();
+		return gradient;
+	}
+
+	Tensor3D gradient(output.GetRows(), output.GetCols(), output.GetDepth());
+	float value = kernel(output.GetData(), target.GetData(), gradient.GetData(), output.GetSize());
+	if (cost)
+		*cost = value;
+
+	return gradient;
+}
+
 MeanSquareError::MeanSquareError(const Tensor3D& target)
 {
 	Cost = [target](const Tensor3D& output) -> float
@@ -99,6 +216,11 @@ CrossEntropyLoss::CrossEntropyLoss(const Tensor3D& target)
 		res.Div(target.GetSize());
 		return res;
 	};
+
+	SoftmaxDiffCost = [target](const Tensor3D& output) -> Tensor3D
+	{
+		return EvaluateGradient(SoftmaxCrossEntropy, output, target, nullptr);
+	};
 }
 
 
@@ -166,6 +288,129 @@ BinaryCrossEntropyLoss::BinaryCrossEntropyLoss(const Tensor3D& target)
 		});
 		return res;
 	};
+
+	SigmoidDiffCost = [target](const Tensor3D& output) -> Tensor3D
+	{
+		return EvaluateGradient(SigmoidBinaryCrossEntropy, output, target, nullptr);
+	};
+}
+
+
+Loss::Loss(CostType type) : m_Type(type)
+{
+	BuildCostFunction();
+}
+
+Loss::Loss(const Loss& other) : m_Type(other.m_Type), m_Target(other.m_Target), m_LastCost(other.m_LastCost)
+{
+	BuildCostFunction();
+}
+
+Loss& Loss::operator=(const Loss& other)
+{
+	m_Type = other.m_Type;
+	m_Target = other.m_Target;
+	m_LastCost = other.m_LastCost;
+	BuildCostFunction();
+	return *this;
+}
+
+float Loss::Evaluate(const Tensor3D& output, const Tensor3D& target, Tensor3D* gradient) const
+{
+	assert((output.GetDepth() == target.GetDepth() &&
+		output.GetRows() == target.GetRows() &&
+		output.GetCols() == target.GetCols()
+		) && "Number of parameters in the output and target must be the same!");
+	assert((!gradient || (gradient->GetSize() == output.GetSize() && !gradient->IsOnDevice())) && "Gradient must be on the host with the output's shape!");
+
+	if (output.IsOnDevice() || target.IsOnDevice())
+	{
+		Tensor3D out = output;
+		Tensor3D tar = target;
+		out.ToHost();
+		tar.ToHost();
+		return Evaluate(out, tar, gradient);
+	}
+
+	const float scale = 1.0f / (float)output.GetSize();
+	return EvaluateCost(m_Type, output.GetData(), target.GetData(), gradient ? gradient->GetData() : nullptr, output.GetSize(), scale) * scale;
+}
+
+float Loss::EvaluateBatch(const Tensor2D& outputs, const Tensor2D& targets, Tensor2D* gradients) const
+{
+	assert(outputs.GetRows() == targets.GetRows() && outputs.GetCols() == targets.GetCols() && "Number of parameters in the outputs and targets must be the same!");
+	assert((!gradients || (gradients->GetRows() == outputs.GetRows() && gradients->GetCols() == outputs.GetCols() && !gradients->IsOnDevice())) && "Gradients must be on the host with the outputs' shape!");
+
+	if (outputs.IsOnDevice() || targets.IsOnDevice())
+	{
+		Tensor2D out = outputs;
+		Tensor2D tar = targets;
+		out.ToHost();
+		tar.ToHost();
+		return EvaluateBatch(out, tar, gradients);
+	}
+
+	// The samples are the columns, so every row is a contiguous run over the batch. The sum of the samples' mean costs is the total / rows.
+	const float scale = 1.0f / (float)outputs.GetRows();
+	float cost = 0.0f;
+	for (size_t r = 0; r < outputs.GetRows(); r++)
+	{
+		cost += EvaluateCost(
+			m_Type,
+			outputs.GetData() + outputs.CalculateIndex(r, 0),
+			targets.GetData() + targets.CalculateIndex(r, 0),
+			gradients ? gradients->GetData() + gradients->CalculateIndex(r, 0) : nullptr,
+			outputs.GetCols(),
+			scale
+		);
+	}
+
+	return cost * scale;
+}
+
+const CostFunction& Loss::Bind(const Tensor3D& target)
+{
+	m_Target = &target;
+	return m_CostFunction;
+}
+
+void Loss::BuildCostFunction()
+{
+	m_CostFunction = CostFunction();
+
+	m_CostFunction.Cost = [this](const Tensor3D& output) -> float
+	{
+		assert(m_Target && "The loss is not bound to a target!");
+		return Evaluate(output, *m_Target);
+	};
+
+	m_CostFunction.DiffCost = [this](const Tensor3D& output) -> Tensor3D
+	{
+		assert(m_Target && "The loss is not bound to a target!");
+		CostType type = m_Type;
+		return EvaluateGradient([type](const float* out, const float* tar, float* gradient, size_t size) -> float {
+			const float scale = 1.0f / (float)size;
+			return EvaluateCost(type, out, tar, gradient, size, scale) * scale;
+		}, output, *m_Target, &m_LastCost);
+	};
+
+	if (m_Type == CostType::CrossEntropy)
+	{
+		m_CostFunction.SoftmaxDiffCost = [this](const Tensor3D& output) -> Tensor3D
+		{
+			assert(m_Target && "The loss is not bound to a target!");
+			return EvaluateGradient(SoftmaxCrossEntropy, output, *m_Target, &m_LastCost);
+		};
+	}
+
+	if (m_Type == CostType::BinaryCrossEntropy)
+	{
+		m_CostFunction.SigmoidDiffCost = [this](const Tensor3D& output) -> Tensor3D
+		{
+			assert(m_Target && "The loss is not bound to a target!");
+			return EvaluateGradient(SigmoidBinaryCrossEntropy, output, *m_Target, &m_LastCost);
+		};
+	}
 }
 
 
@@ -15,6 +15,10 @@ struct LIBRARY_API CostFunction
 {
 	std::function<float(const Tensor3D& output)> Cost;
 	std::function<Tensor3D(const Tensor3D& output)> DiffCost;
+	// Optional, derivative respect to the inputs of a softmax, which produced the output. Skips the softmax's Jacobian.
+	std::function<Tensor3D(const Tensor3D& output)> SoftmaxDiffCost;
+	// Optional, derivative respect to the inputs of a sigmoid, which produced the output. Skips the sigmoid's derivative.
+	std::function<Tensor3D(const Tensor3D& output)> SigmoidDiffCost;
 };
 
 struct LIBRARY_API MeanSquareError : public CostFunction
@@ -32,4 +36,43 @@ struct LIBRARY_API BinaryCrossEntropyLoss : public CostFunction
 	BinaryCrossEntropyLoss(const Tensor3D& target);
 };
 
+enum class CostType
+{
+	MeanSquareError = 0,
+	CrossEntropy,
+	BinaryCrossEntropy
+};
+
+// Reusable loss, build it once and evaluate it for every sample. The target is referenced, never copied.
+// The cost and its derivative are computed in the same pass.
+class LIBRARY_API Loss
+{
+public:
+	Loss(CostType type);
+	Loss(const Loss& other);
+	Loss& operator=(const Loss& other);
+
+	// Returns the cost of the output. If gradient is set, the derivative respect to the output is written into it (same shape as the output).
+	float Evaluate(const Tensor3D& output, const Tensor3D& target, Tensor3D* gradient=nullptr) const;
+	// Every column is a sample. Returns the sum of the samples' costs, gradients (optional) must have the outputs' shape.
+	float EvaluateBatch(const Tensor2D& outputs, const Tensor2D& targets, Tensor2D* gradients=nullptr) const;
+
+	// Points the loss to the target and returns the cost function for the back propagation.
+	// The target must outlive the returned cost function's usage.
+	const CostFunction& Bind(const Tensor3D& target);
+	// The cost computed while the bound cost function's derivative was evaluated (during the last back propagation).
+	inline float GetLastCost() const { return m_LastCost; }
+
+	inline CostType GetType() const { return m_Type; }
+
+private:
+	void BuildCostFunction();
+
+private:
+	CostType m_Type;
+	const Tensor3D* m_Target = nullptr;
+	float m_LastCost = 0.0f;
+	CostFunction m_CostFunction;
+};
+
 namespace_end
\ No newline at end of file
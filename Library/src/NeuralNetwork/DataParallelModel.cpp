@@ -0,0 +1,264 @@
+#include "DataParallelModel.h"
+#include <assert.h>
+#include <algorithm>
+#include <random>
+
+#include "DropoutLayer.h"
+
+
+namespace_start
+
+DataParallelModel::DataParallelModel(Model& model, size_t numReplicas, const Loss& loss, unsigned int seed, ProcessGroup* processGroup)
+	: m_Model(model), m_ProcessGroup(processGroup)
+{
+	assert(numReplicas > 0 && "At least one replica is needed!");
+	assert(m_Model.IsModelCorrect() && "Model is not defined correctly!");
+
+	for (std::shared_ptr<Layer> layer = m_Model.GetRootLayer(); layer; layer = layer->NextLayer)
+	{
+		for (const LearnableTensor& tensor : layer->GetLearnableTensors())
+		{
+			if (!tensor.ParamsOptimizer)
+				throw std::runtime_error("No optimizer for training!");
+			if (tensor.Params->IsOnDevice())
+				throw std::runtime_error("The model must be on the host.");
+
+			m_Tensors.push_back(tensor);
+			m_TensorOffsets.push_back(m_NumParams);
+			m_NumParams += tensor.Params->GetSize();
+		}
+	}
+
+	if (m_ProcessGroup)
+	{
+		FlattenParams();
+		m_ProcessGroup->Broadcast(m_FlatBuffer.data(), m_NumParams);
+		UnflattenParams();
+	}
+
+	const unsigned int rank = m_ProcessGroup ? (unsigned int)m_ProcessGroup->GetRank() : 0;
+	for (size_t k = 0; k < numReplicas; k++)
+	{
+		std::unique_ptr<Replica> replica = std::make_unique<Replica>(loss);
+
+		// The layers are copied through their string format, the params are synchronized before every step anyway.
+		for (std::shared_ptr<Layer> layer = m_Model.GetRootLayer(); layer; layer = layer->NextLayer)
+		{
+			replica->ReplicaModel.AddLayer(layer->GetName(), layer->ToString());
+		}
+		replica->ReplicaModel.SetMixedPrecision(m_Model.IsMixedPrecision());
+		replica->ReplicaModel.InitializeOptimizer(OptimizerFactory(OptimizerType::Accumulator));
+		// A frozen replica layer does not accumulate, the model's frozen params are updated with a zero gradient by their stateless optimizer.
+		for (std::shared_ptr<Layer> layer = m_Model.GetRootLayer(), replicaLayer = replica->ReplicaModel.GetRootLayer(); layer; layer = layer->NextLayer, replicaLayer = replicaLayer->NextLayer)
+		{
+			replicaLayer->SetFrozen(layer->IsFrozen());
+		}
+
+		size_t layerIndex = 0;
+		for (std::shared_ptr<Layer> layer = replica->ReplicaModel.GetRootLayer(); layer; layer = layer->NextLayer, layerIndex++)
+		{
+			if (layer->GetName() == DropoutLayer::ClassName())
+			{
+				std::seed_seq seedSequence = { seed, rank, (unsigned int)k, (unsigned int)layerIndex };
+				unsigned int layerSeed;
+				seedSequence.generate(&layerSeed, &layerSeed + 1);
+				static_cast<DropoutLayer*>(layer.get())->SetSeed(layerSeed);
+			}
+
+			for (const LearnableTensor& tensor : layer->GetLearnableTensors())
+			{
+				replica->Tensors.push_back(tensor);
+				replica->Accumulators.push_back(static_cast<AccumulatorOptimizer*>(tensor.ParamsOptimizer));
+			}
+		}
+		assert(replica->Tensors.size() == m_Tensors.size() && "The replica does not match the model!");
+
+		m_Replicas.push_back(std::move(replica));
+	}
+
+	for (size_t k = 0; k < numReplicas; k++)
+	{
+		m_Workers.emplace_back(&DataParallelModel::Work, this, k);
+	}
+}
+
+DataParallelModel::~DataParallelModel()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_TaskMutex);
+		m_IsStopping = true;
+	}
+	m_TaskCondition.notify_all();
+
+	for (std::thread& worker : m_Workers)
+	{
+		worker.join();
+	}
+}
+
+void DataParallelModel::Work(size_t worker)
+{
+	size_t taskId = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_TaskMutex);
+			m_TaskCondition.wait(lock, [this, taskId] { return m_IsStopping || m_TaskId != taskId; });
+			if (m_IsStopping)
+				return;
+			taskId = m_TaskId;
+		}
+
+		std::exception_ptr exception;
+		try
+		{
+			m_Task(worker);
+		}
+		catch (...)
+		{
+			exception = std::current_exception();
+		}
+
+		std::unique_lock<std::mutex> lock(m_TaskMutex);
+		if (exception && !m_TaskException)
+			m_TaskException = exception;
+		if (--m_NumPending == 0)
+			m_DoneCondition.notify_one();
+	}
+}
+
+void DataParallelModel::RunOnWorkers(const std::function<void(size_t worker)>& task)
+{
+	std::unique_lock<std::mutex> lock(m_TaskMutex);
+	m_Task = task;
+	m_NumPending = m_Workers.size();
+	m_TaskException = nullptr;
+	m_TaskId++;
+	m_TaskCondition.notify_all();
+
+	m_DoneCondition.wait(lock, [this] { return m_NumPending == 0; });
+	if (m_TaskException)
+		std::rethrow_exception(m_TaskException);
+}
+
+void DataParallelModel::ReduceChunk(size_t worker, float scale)
+{
+	const size_t numReplicas = m_Replicas.size();
+	const size_t chunkStart = worker * m_NumParams / numReplicas;
+	const size_t chunkEnd = (worker + 1) * m_NumParams / numReplicas;
+
+	// The sum is written to the first replica's gradient, every element is summed in replica order.
+	for (size_t j = 0; j < m_Tensors.size(); j++)
+	{
+		const size_t tensorSize = m_Tensors[j].Params->GetSize();
+		const size_t start = std::max(chunkStart, m_TensorOffsets[j]);
+		const size_t end = std::min(chunkEnd, m_TensorOffsets[j] + tensorSize);
+		if (start >= end)
+			continue;
+
+		float* sum = m_Replicas[0]->Accumulators[j]->GetGradient().GetData() + start - m_TensorOffsets[j];
+		const size_t size = end - start;
+		for (size_t k = 1; k < numReplicas; k++)
+		{
+			const float* gradient = m_Replicas[k]->Accumulators[j]->GetGradient().GetData() + start - m_TensorOffsets[j];
+			for (size_t i = 0; i < size; i++)
+				sum[i] += gradient[i];
+		}
+		for (size_t i = 0; i < size; i++)
+			sum[i] *= scale;
+	}
+}
+
+void DataParallelModel::FlattenParams()
+{
+	m_FlatBuffer.resize(m_NumParams + 1);
+	for (size_t j = 0; j < m_Tensors.size(); j++)
+	{
+		const Tensor* params = m_Tensors[j].Params;
+		std::copy(params->GetData(), params->GetData() + params->GetSize(), m_FlatBuffer.data() + m_TensorOffsets[j]);
+	}
+}
+
+void DataParallelModel::UnflattenParams()
+{
+	for (size_t j = 0; j < m_Tensors.size(); j++)
+	{
+		const float* params = m_FlatBuffer.data() + m_TensorOffsets[j];
+		std::copy(params, params + m_Tensors[j].Params->GetSize(), m_Tensors[j].Params->GetData());
+	}
+	m_Model.MarkParamsChanged();
+}
+
+void DataParallelModel::AllReduceGradient(float& cost)
+{
+	// The cost is reduced with the gradient, one collective operation per step.
+	m_FlatBuffer.resize(m_NumParams + 1);
+	for (size_t j = 0; j < m_Tensors.size(); j++)
+	{
+		const Tensor& gradient = m_Replicas[0]->Accumulators[j]->GetGradient();
+		std::copy(gradient.GetData(), gradient.GetData() + gradient.GetSize(), m_FlatBuffer.data() + m_TensorOffsets[j]);
+	}
+	m_FlatBuffer[m_NumParams] = cost;
+
+	m_ProcessGroup->AllReduce(m_FlatBuffer.data(), m_NumParams + 1);
+
+	const float scale = 1.0f / m_ProcessGroup->GetWorldSize();
+	for (size_t j = 0; j < m_Tensors.size(); j++)
+	{
+		Tensor& gradient = m_Replicas[0]->Accumulators[j]->GetGradient();
+		const float* sum = m_FlatBuffer.data() + m_TensorOffsets[j];
+		for (size_t i = 0; i < gradient.GetSize(); i++)
+			gradient.GetData()[i] = sum[i] * scale;
+	}
+	cost = m_FlatBuffer[m_NumParams] * scale;
+}
+
+float DataParallelModel::TrainBatch(const std::vector<Tensor3D>& inputs, const std::vector<Tensor3D>& labels, float learningRate, size_t t)
+{
+	assert(inputs.size() && inputs.size() == labels.size() && "Invalid batch!");
+
+	const size_t batchSize = inputs.size();
+	const size_t numReplicas = m_Replicas.size();
+
+	RunOnWorkers([this, &inputs, &labels, batchSize, numReplicas, learningRate, t](size_t worker) {
+		Replica& replica = *m_Replicas[worker];
+
+		for (size_t j = 0; j < m_Tensors.size(); j++)
+		{
+			const Tensor* params = m_Tensors[j].Params;
+			std::copy(params->GetData(), params->GetData() + params->GetSize(), replica.Tensors[j].Params->GetData());
+			replica.Accumulators[j]->Reset();
+		}
+		replica.ReplicaModel.MarkParamsChanged();
+
+		replica.Cost = 0.0f;
+		for (size_t i = worker * batchSize / numReplicas; i < (worker + 1) * batchSize / numReplicas; i++)
+		{
+			replica.ReplicaModel.BackPropagation(inputs[i], replica.ReplicaLoss.Bind(labels[i]), learningRate, t);
+			replica.Cost += replica.ReplicaLoss.GetLastCost();
+		}
+	});
+
+	const float scale = 1.0f / batchSize;
+	RunOnWorkers([this, scale](size_t worker) { ReduceChunk(worker, scale); });
+
+	float cost = 0.0f;
+	for (const std::unique_ptr<Replica>& replica : m_Replicas)
+	{
+		cost += replica->Cost;
+	}
+	cost *= scale;
+
+	if (m_ProcessGroup)
+		AllReduceGradient(cost);
+
+	for (size_t j = 0; j < m_Tensors.size(); j++)
+	{
+		m_Tensors[j].ParamsOptimizer->Update(m_Tensors[j].Params, &m_Replicas[0]->Accumulators[j]->GetGradient(), learningRate);
+	}
+	m_Model.MarkParamsChanged();
+
+	return cost;
+}
+
+namespace_end
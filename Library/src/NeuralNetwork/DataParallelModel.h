@@ -0,0 +1,85 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+#include "Core.h"
+#include "Model.h"
+#include "CostF.h"
+#include "../ProcessGroup.h"
+
+
+namespace_start
+
+/*
+	Synchronous data parallel training of a model with numReplicas copies of it, every replica on its own thread.
+	A batch is split into contiguous shards, replica k back propagates the k-th shard with accumulator optimizers (the gradient is summed, the replica's params are not changed).
+	The gradients are reduced in shared memory: worker k sums the k-th contiguous chunk of every replica's gradient in replica order (a reduce scatter),
+	than one optimizer step is applied to the model's params with the mean gradient. The replicas copy the updated params at the start of the next step.
+
+	The result only depends on the batches, the number of replicas and the seed (of the replicas' dropout masks), not on the thread scheduling.
+
+	With a process group every rank trains its own batch of the same size: the reduced gradients (and costs) are all reduced across the ranks,
+	so every rank applies the same mean gradient of the ranks' batches. The ranks start from rank 0's params.
+	The model must have its optimizers initialized, must be on the host and must outlive the trainer.
+*/
+class LIBRARY_API DataParallelModel
+{
+public:
+	DataParallelModel(Model& model, size_t numReplicas, const Loss& loss, unsigned int seed=0, ProcessGroup* processGroup=nullptr);
+	~DataParallelModel();
+
+	DataParallelModel(const DataParallelModel&) = delete;
+	DataParallelModel& operator=(const DataParallelModel&) = delete;
+
+	// One optimizer step with the mean gradient of the batch (of every rank's batch). Returns the mean cost of the samples.
+	float TrainBatch(const std::vector<Tensor3D>& inputs, const std::vector<Tensor3D>& labels, float learningRate, size_t t);
+
+	inline size_t GetNumReplicas() const { return m_Replicas.size(); }
+
+private:
+	void Work(size_t worker);
+	// Runs the task on every worker (with the worker's index) and waits for them.
+	void RunOnWorkers(const std::function<void(size_t worker)>& task);
+	void ReduceChunk(size_t worker, float scale);
+	// Copies the params (or the first replica's reduced gradient) to or from the flat buffer.
+	void FlattenParams();
+	void UnflattenParams();
+	void AllReduceGradient(float& cost);
+
+private:
+	struct Replica
+	{
+		Replica(const Loss& loss) : ReplicaLoss(loss) { }
+
+		Model ReplicaModel;
+		std::vector<LearnableTensor> Tensors;
+		std::vector<AccumulatorOptimizer*> Accumulators;
+		Loss ReplicaLoss;
+		float Cost = 0.0f;
+	};
+
+	Model& m_Model;
+	std::vector<LearnableTensor> m_Tensors;
+	std::vector<size_t> m_TensorOffsets;  // The offset of every tensor in the concatenation of the gradients.
+	size_t m_NumParams = 0;
+	std::vector<std::unique_ptr<Replica>> m_Replicas;
+	ProcessGroup* m_ProcessGroup;
+	std::vector<float> m_FlatBuffer;
+
+	std::vector<std::thread> m_Workers;
+	std::mutex m_TaskMutex;
+	std::condition_variable m_TaskCondition;
+	std::condition_variable m_DoneCondition;
+	std::function<void(size_t worker)> m_Task;
+	size_t m_TaskId = 0;
+	size_t m_NumPending = 0;
+	std::exception_ptr m_TaskException;
+	bool m_IsStopping = false;
+};
+
+namespace_end
@@ -61,6 +61,17 @@ Tensor3D DenseLayer::FeedForward(const Tensor3D& inputs)
 {
 	assert(inputs.GetDepth() == 1 && "Dense layer's input is 1 Tensor2D!");
 
+	if (!inputs.IsOnDevice())
+	{
+		Tensor2D input = CreateWatcher((Tensor3D&)inputs, 0);  // !
+
+		// Bias and activation are applied in the matrix multiplication's epilogue.
+		Tensor3D output(m_Weights.GetRows(), input.GetCols(), 1);
+		Tensor2D outputWatcher = CreateWatcher(output, 0);
+		MatrixMultBiasActivation(outputWatcher, m_Weights, input, &m_Bias, m_ActivationFunction.Activation);
+		return output;
+	}
+
 	Tensor2D input = SliceTensor(inputs, 0);
 
 	Tensor2D sum = MatrixMult(m_Weights, input);
@@ -70,6 +81,19 @@ Tensor3D DenseLayer::FeedForward(const Tensor3D& inputs)
 	return Tensor3D(sum.GetRows(), sum.GetCols(), 1, std::move(sum));
 }
 
+void DenseLayer::Infer(const Tensor3D& inputs, Tensor3D& output) const
+{
+	assert(inputs.GetDepth() == 1 && "Dense layer's input is 1 Tensor2D!");
+	assert(output.GetRows() == m_Weights.GetRows() && output.GetCols() == inputs.GetCols() && output.GetDepth() == 1 && "Output shape not match!");
+
+	if (inputs.IsOnDevice() || output.IsOnDevice() || m_Weights.IsOnDevice())
+		throw std::runtime_error("Inference is only implemented on the host.");
+
+	Tensor2D input = CreateWatcher((Tensor3D&)inputs, 0);  // !
+	Tensor2D outputWatcher = CreateWatcher(output, 0);
+	MatrixMultBiasActivation(outputWatcher, m_Weights, input, &m_Bias, m_ActivationFunction.Activation);
+}
+
 Tensor3D DenseLayer::BackPropagation(const Tensor3D& inputs, const CostFunction& costFunction, float learningRate, size_t t)
 {
 	if (!m_WeightsOptimizer || !m_BiasOptimizer)
@@ -81,36 +105,72 @@ Tensor3D DenseLayer::BackPropagation(const Tensor3D& inputs, const CostFunction&
 
 	LayerShape layerShape = GetLayerShape();
 
-	Tensor2D input = SliceTensor(inputs, 0);
+	Tensor2D input = inputs.IsOnDevice() ? SliceTensor(inputs, 0) : CreateWatcher((Tensor3D&)inputs, 0);  // !
 
-	Tensor2D sum = MatrixMult(m_Weights, input);
-	sum.Add(m_Bias);
+	Tensor2D sum = inputs.IsOnDevice() ? MatrixMult(m_Weights, input) : Tensor2D(layerShape.OutputRows, layerShape.OutputCols);
+	Tensor3D output = Tensor3D(layerShape.OutputRows, layerShape.OutputCols, layerShape.OutputDepth, 0.0f, inputs.IsOnDevice());
+
+	if (!inputs.IsOnDevice())
+	{
+		// The epilogue writes both the biased sums (for the activation's derivative) and the activated output.
+		Tensor2D outputWatcher = CreateWatcher(output, 0);
+		if (m_IsMixedPrecision)
+		{
+			if (m_IsWeightsBF16Stale)
+			{
+				ToBFloat16(m_WeightsBF16, m_Weights);
+				m_IsWeightsBF16Stale = false;
+			}
+			ToBFloat16(m_InputBF16, input);
+			MatrixMultBiasActivationBF16(outputWatcher, m_WeightsBF16, m_InputBF16, &m_Bias, m_ActivationFunction.Activation, &sum);
+		}
+		else
+		{
+			MatrixMultBiasActivation(outputWatcher, m_Weights, input, &m_Bias, m_ActivationFunction.Activation, &sum);
+		}
+	}
+	else
+	{
+		sum.Add(m_Bias);
+		output.Add(sum);
+		m_ActivationFunction.MapActivation(&output);
+	}
 
-	Tensor3D output = Tensor3D(layerShape.OutputRows, layerShape.OutputCols, layerShape.OutputDepth, (const float*)sum.GetData(), sum.IsOnDevice());
-	m_ActivationFunction.MapActivation(&output);
+	// Sigmoid head with a binary cross entropy loss, the cost function gives the derivative respect to the sums (p - y).
+	const bool isSigmoidHead = !NextLayer && costFunction.SigmoidDiffCost && m_ActivationFunction.Name == "sigmoid";
 
 	Tensor3D costs = NextLayer ? 
 								NextLayer->BackPropagation(output, costFunction, learningRate, t) : 
-								costFunction.DiffCost(output);
+								(isSigmoidHead ? costFunction.SigmoidDiffCost(output) : costFunction.DiffCost(output));
 
 	assert(inputs.GetDepth() == 1 && "Dense layer's cost should contain a tensor with a depth of 1!");
 	assert(costs.GetCols() == 1 && "Dense layer's cost should contain 1 column!");
 	assert(costs.GetRows() == m_Weights.GetRows() && "Dense layer's cost should contain as many rows as the weight's rows!");
 
 	Tensor2D cost = CreateWatcher(costs, 0);
-	m_ActivationFunction.MapDiffActivation(&sum);
-	Tensor2D diffSum = Mult(cost, sum);
+	if (!isSigmoidHead)
+		m_ActivationFunction.MapDiffActivation(&sum);
+	Tensor2D diffSum = isSigmoidHead ? cost : Mult(cost, sum);
 
-	Tensor2D gradWeights = MatrixMultRightTranspose(diffSum, input);
 	Tensor2D& gradBiases = diffSum;
 	Tensor2D gradCosts = MatrixMultLeftTranspose(m_Weights, diffSum);
 
-	m_WeightsOptimizer->Update(&m_Weights, &gradWeights, learningRate);
-	m_BiasOptimizer->Update(&m_Bias, &gradBiases, learningRate);
+	if (!m_IsFrozen)
+	{
+		// The weight gradient (diffSum x input^T) is consumed in tiles by the optimizer, it is never allocated.
+		m_WeightsOptimizer->UpdateOuterProduct(&m_Weights, diffSum, input, learningRate);
+		m_BiasOptimizer->Update(&m_Bias, &gradBiases, learningRate);
+		m_IsWeightsBF16Stale = m_IsWeightsBF16Stale || m_WeightsOptimizer->IsChangingParams();
+	}
 
 	return Tensor3D(layerShape.InputRows, layerShape.InputCols, 1, std::move(gradCosts));
 }
 
+std::vector<LearnableTensor> DenseLayer::GetLearnableTensors()
+{
+	return { { &m_Weights, m_WeightsOptimizer.get() }, { &m_Bias, m_BiasOptimizer.get() } };
+}
+
 LayerShape DenseLayer::GetLayerShape() const
 {
 	return 
@@ -192,6 +252,7 @@ void DenseLayer::FromString(const std::string& data)
 	OptimizerFactory optimizerFactory;
 	m_WeightsOptimizer = optimizerFactory.Get(weightOptimizerStr);
 	m_BiasOptimizer = optimizerFactory.Get(biasOptimizerStr);
+	m_IsWeightsBF16Stale = true;
 }
 
 std::string DenseLayer::ToDebugString() const
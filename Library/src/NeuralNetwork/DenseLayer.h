@@ -2,6 +2,7 @@
 #include "Layer.h"
 #include "ActivationF.h"
 #include "Initializer.h"
+#include "../Math/BFloat16.h"
 
 
 namespace_start
@@ -18,8 +19,13 @@ public:
 
 	virtual void InitOptimizer(OptimizerFactory optimizerFactory) override;
 	virtual Tensor3D FeedForward(const Tensor3D& inputs) override;
+	virtual void Infer(const Tensor3D& inputs, Tensor3D& output) const override;
 	virtual Tensor3D BackPropagation(const Tensor3D& inputs, const CostFunction& costFunction, float learningRate, size_t t) override;
 
+	virtual void SetMixedPrecision(bool isMixedPrecision) override { m_IsMixedPrecision = isMixedPrecision; m_IsWeightsBF16Stale = true; }
+	virtual bool IsMixedPrecision() const override { return m_IsMixedPrecision; }
+	virtual void MarkParamsChanged() override { m_IsWeightsBF16Stale = true; }
+
 	virtual LayerShape GetLayerShape() const override;
 
 	virtual std::string GetName() const override { return ClassName(); }
@@ -29,11 +35,15 @@ public:
 
 	virtual ActivationFunciton GetActivationFunction() const override { return m_ActivationFunction; }
 	virtual size_t GetLearnableParams() const override { return m_Weights.GetSize() + m_Bias.GetSize(); };
+	virtual std::vector<LearnableTensor> GetLearnableTensors() override;
 	virtual std::string GetSepcialParams() const override { return ("Optimizer: " + m_WeightsOptimizer->GetName()); };
 
 	virtual void FromString(const std::string& data) override;
 
 	static std::string ClassName() { return "DenseLayer"; }
+
+	inline const Tensor2D& GetWeights() const { return m_Weights; }
+	inline const Tensor2D& GetBias() const { return m_Bias; }
 private:
 	Tensor2D m_Weights;
 	Tensor2D m_Bias;
@@ -41,6 +51,10 @@ private:
 
 	std::unique_ptr<Optimizer> m_WeightsOptimizer;
 	std::unique_ptr<Optimizer> m_BiasOptimizer;
+
+	bool m_IsMixedPrecision = false;
+	BFloat16Tensor m_WeightsBF16, m_InputBF16;  // The copies of the mixed precision forward pass, the weights' is kept until they change.
+	bool m_IsWeightsBF16Stale = true;
 };
 
 namespace_end
@@ -1,6 +1,7 @@
 #include "DropoutLayer.h"
 #include <assert.h>
 #include <sstream>
+#include <algorithm>
 
 
 namespace_start
@@ -26,6 +27,37 @@ Tensor3D DropoutLayer::FeedForward(const Tensor3D& inputs)
 	return inputs;
 }
 
+void DropoutLayer::Infer(const Tensor3D& inputs, Tensor3D& output) const
+{
+	assert(m_InputHeight == inputs.GetRows() &&
+		m_InputWidth == inputs.GetCols() &&
+		m_InputDepth == inputs.GetDepth()
+		&& "Input shape not match!");
+	assert(output.GetSize() == inputs.GetSize() && "Output shape not match!");
+
+	if (inputs.IsOnDevice() || output.IsOnDevice())
+		throw std::runtime_error("Inference is only implemented on the host.");
+
+	std::copy(inputs.GetData(), inputs.GetData() + inputs.GetSize(), output.GetData());
+}
+
+static Tensor3D SeededDropOut(const Tensor3D& input, float dropoutRate, Tensor3D& dropOutMask, std::mt19937& generator)
+{
+	Tensor3D output(input.GetRows(), input.GetCols(), input.GetDepth());
+	std::uniform_real_distribution<float> distr(0.0f, 1.0f);
+	const float retentionProb = 1.0f - dropoutRate;
+
+	for (size_t i = 0; i < input.GetSize(); i++)
+	{
+		if (distr(generator) > dropoutRate)
+		{
+			output.GetData()[i] = input.GetData()[i] / retentionProb;
+			dropOutMask.GetData()[i] = 1.0f;
+		}
+	}
+	return output;
+}
+
 Tensor3D DropoutLayer::BackPropagation(const Tensor3D& inputs, const CostFunction& costFucntion, float learningRate, size_t t)
 {
 	assert(m_InputHeight == inputs.GetRows() &&
@@ -36,11 +68,13 @@ Tensor3D DropoutLayer::BackPropagation(const Tensor3D& inputs, const CostFunctio
 	LayerShape layerShape = GetLayerShape();
 
 	Tensor3D dropOutTensor(layerShape.OutputRows, layerShape.OutputCols, layerShape.OutputDepth, 0.0f, inputs.IsOnDevice());
-	Tensor3D output = DropOut(inputs, m_DropoutRate, &dropOutTensor);
+	Tensor3D output = m_Generator && !inputs.IsOnDevice() ?
+		SeededDropOut(inputs, m_DropoutRate, dropOutTensor, *m_Generator) :
+		DropOut(inputs, m_DropoutRate, &dropOutTensor);
 
 	Tensor3D costs = NextLayer ?
 		NextLayer->BackPropagation(output, costFucntion, learningRate, t) :
-		output;
+		costFucntion.DiffCost(output);
 
 	assert(layerShape.OutputRows == costs.GetRows() &&
 		layerShape.OutputCols == costs.GetCols() &&
@@ -52,6 +86,11 @@ Tensor3D DropoutLayer::BackPropagation(const Tensor3D& inputs, const CostFunctio
 	return costs;
 }
 
+void DropoutLayer::SetSeed(unsigned int seed)
+{
+	m_Generator = std::make_unique<std::mt19937>(seed);
+}
+
 LayerShape DropoutLayer::GetLayerShape() const
 {
 	return
@@ -1,4 +1,6 @@
 #pragma once
+#include <random>
+#include <memory>
 #include "Layer.h"
 
 
@@ -15,6 +17,7 @@ public:
 	virtual void ToDevice() override { }
 
 	virtual Tensor3D FeedForward(const Tensor3D& inputs);
+	virtual void Infer(const Tensor3D& inputs, Tensor3D& output) const;
 	virtual Tensor3D BackPropagation(const Tensor3D& inputs, const CostFunction& costFunction, float learningRate, size_t t);
 
 	virtual LayerShape GetLayerShape() const;
@@ -31,9 +34,13 @@ public:
 	virtual void FromString(const std::string& data);
 
 	static std::string ClassName() { return "DropoutLayer"; }
+
+	// The masks of the back propagation on the host come from a generator with the seed (reproducible training), by default they are random.
+	void SetSeed(unsigned int seed);
 private:
 	size_t m_InputHeight, m_InputWidth, m_InputDepth;
 	float m_DropoutRate;
+	std::unique_ptr<std::mt19937> m_Generator;
 };
 
 namespace_end
@@ -0,0 +1,287 @@
+#include "Embedding.h"
+#include <assert.h>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <limits>
+#include <cmath>
+#include <memory>
+
+#include "../Math/Operation.h"
+
+
+namespace_start
+
+float TripletLoss(
+	const Tensor3D& anchor, const Tensor3D& positive, const Tensor3D& negative, float margin,
+	Tensor3D* anchorCost, Tensor3D* positiveCost, Tensor3D* negativeCost
+)
+{
+	assert(anchor.GetSize() == positive.GetSize() && anchor.GetSize() == negative.GetSize() && "Embedding sizes not match!");
+
+	if (anchor.IsOnDevice() || positive.IsOnDevice() || negative.IsOnDevice())
+		throw std::runtime_error("Triplet loss is only implemented on the host.");
+
+	const size_t size = anchor.GetSize();
+	const float* a = anchor.GetData();
+	const float* p = positive.GetData();
+	const float* n = negative.GetData();
+
+	float loss = std::max(SquaredDistance(a, p, size) - SquaredDistance(a, n, size) + margin, 0.0f);
+
+	Tensor3D* costs[3] = { anchorCost, positiveCost, negativeCost };
+	for (Tensor3D* cost : costs)
+	{
+		if (cost && cost->GetSize() != size)
+			*cost = Tensor3D(anchor.GetRows(), anchor.GetCols(), anchor.GetDepth());
+	}
+
+	for (size_t t = 0; t < size; t++)
+	{
+		bool isActive = loss > 0.0f;
+		if (anchorCost) anchorCost->GetData()[t] = isActive ? 2.0f * (n[t] - p[t]) : 0.0f;
+		if (positiveCost) positiveCost->GetData()[t] = isActive ? 2.0f * (p[t] - a[t]) : 0.0f;
+		if (negativeCost) negativeCost->GetData()[t] = isActive ? 2.0f * (a[t] - n[t]) : 0.0f;
+	}
+
+	return loss;
+}
+
+float ContrastiveLoss(
+	const Tensor3D& left, const Tensor3D& right, bool isSame, float margin,
+	Tensor3D* leftCost, Tensor3D* rightCost
+)
+{
+	assert(left.GetSize() == right.GetSize() && "Embedding sizes not match!");
+
+	if (left.IsOnDevice() || right.IsOnDevice())
+		throw std::runtime_error("Contrastive loss is only implemented on the host.");
+
+	const size_t size = left.GetSize();
+	const float* l = left.GetData();
+	const float* r = right.GetData();
+
+	float squaredDistance = SquaredDistance(l, r, size);
+	float distance = std::sqrt(squaredDistance);
+
+	float loss, factor;  // The cost of the left embedding is factor * (l - r).
+	if (isSame)
+	{
+		loss = squaredDistance;
+		factor = 2.0f;
+	}
+	else
+	{
+		float gap = std::max(margin - distance, 0.0f);
+		loss = gap * gap;
+		factor = distance > 0.0f ? -2.0f * gap / distance : 0.0f;
+	}
+
+	Tensor3D* costs[2] = { leftCost, rightCost };
+	for (Tensor3D* cost : costs)
+	{
+		if (cost && cost->GetSize() != size)
+			*cost = Tensor3D(left.GetRows(), left.GetCols(), left.GetDepth());
+	}
+
+	for (size_t t = 0; t < size; t++)
+	{
+		if (leftCost) leftCost->GetData()[t] = factor * (l[t] - r[t]);
+		if (rightCost) rightCost->GetData()[t] = -factor * (l[t] - r[t]);
+	}
+
+	return loss;
+}
+
+
+static size_t CalculateEmbeddingSize(const Model& embeddingModel)
+{
+	ModelShape shape = embeddingModel.GetModelShape();
+	return shape.OutputRows * shape.OutputCols * shape.OutputDepth;
+}
+
+EmbeddingGallery::EmbeddingGallery(const Model& embeddingModel)
+	: m_Model(embeddingModel), m_EmbeddingSize(CalculateEmbeddingSize(embeddingModel)), m_Index(m_EmbeddingSize)
+{
+}
+
+EmbeddingGallery::EmbeddingGallery(const Model& embeddingModel, const std::string& filePath)
+	: EmbeddingGallery(embeddingModel)
+{
+	Load(filePath);
+}
+
+Tensor3D EmbeddingGallery::Embed(const Tensor3D& input) const
+{
+	Tensor3D embedding = m_Model.FeedForward(input);
+	embedding.ToHost();
+	return embedding;
+}
+
+void EmbeddingGallery::Enroll(const std::string& name, const Tensor3D& input)
+{
+	EnrollEmbedding(name, Embed(input));
+}
+
+void EmbeddingGallery::EnrollEmbedding(const std::string& name, const Tensor3D& embedding)
+{
+	assert(embedding.GetSize() == m_EmbeddingSize && "Invalid embedding size!");
+	assert(!name.empty() && name.find_first_of(" \t\n") == std::string::npos && "The name can't contain whitespaces!");
+
+	if (embedding.IsOnDevice())
+		throw std::runtime_error("The embedding must be on the host.");
+
+	m_Index.Add(embedding.GetData());
+	m_Names.push_back(name);
+}
+
+size_t EmbeddingGallery::Remove(const std::string& name)
+{
+	size_t removed = 0;
+	for (size_t id = 0; id < m_Names.size(); id++)
+	{
+		if (m_Names[id] == name && m_Index.Remove(id))
+		{
+			m_Names[id].clear();
+			removed++;
+		}
+	}
+	return removed;
+}
+
+GalleryMatch EmbeddingGallery::Identify(const Tensor3D& input, size_t ef) const
+{
+	return IdentifyEmbedding(Embed(input), ef);
+}
+
+GalleryMatch EmbeddingGallery::IdentifyEmbedding(const Tensor3D& embedding, size_t ef) const
+{
+	assert(embedding.GetSize() == m_EmbeddingSize && "Invalid embedding size!");
+
+	GalleryMatch match;
+	std::vector<SearchResult> results = m_Index.Search(embedding.GetData(), 1, ef);
+	if (results.size())
+	{
+		match.Name = m_Names[results[0].Id];
+		match.Index = results[0].Id;
+		match.Distance = results[0].Distance;
+	}
+	return match;
+}
+
+bool EmbeddingGallery::Verify(const std::string& name, const Tensor3D& input, float threshold, float* distance) const
+{
+	return VerifyEmbedding(name, Embed(input), threshold, distance);
+}
+
+bool EmbeddingGallery::VerifyEmbedding(const std::string& name, const Tensor3D& embedding, float threshold, float* distance) const
+{
+	assert(embedding.GetSize() == m_EmbeddingSize && "Invalid embedding size!");
+
+	float minDistance = std::numeric_limits<float>::infinity();
+	for (size_t id = 0; id < m_Names.size(); id++)
+	{
+		if (m_Names[id] == name)
+			minDistance = std::min(minDistance, SquaredDistance(embedding.GetData(), GetEmbedding(id), m_EmbeddingSize));
+	}
+
+	if (distance)
+		*distance = minDistance;
+	return minDistance < threshold;
+}
+
+void EmbeddingGallery::Save(const std::string& filePath) const
+{
+	std::stringstream ss;
+	ss << std::setprecision(std::numeric_limits<float>::max_digits10);
+
+	// The removed ids are left out, so the saved index is rebuilt without them.
+	std::unique_ptr<HNSWIndex> compactIndex;
+	if (m_Index.GetSize() != m_Index.GetCount())
+		compactIndex = std::make_unique<HNSWIndex>(m_EmbeddingSize);
+
+	for (size_t id = 0; id < m_Names.size(); id++)
+	{
+		if (m_Index.IsRemoved(id))
+			continue;
+
+		if (compactIndex)
+			compactIndex->Add(GetEmbedding(id));
+
+		ss << m_Names[id] << " " << m_EmbeddingSize;
+		for (size_t t = 0; t < m_EmbeddingSize; t++)
+		{
+			ss << " " << GetEmbedding(id)[t];
+		}
+		ss << std::endl;
+	}
+
+	std::ofstream file(filePath);
+	assert(file.is_open() && "Could not open file!");
+	file << ss.str();
+	file.close();
+
+	(compactIndex ? *compactIndex : m_Index).Save(filePath + ".hnsw");
+}
+
+void EmbeddingGallery::Load(const std::string& filePath)
+{
+	std::ifstream file(filePath);
+	if (!file.is_open())
+		throw std::runtime_error("Could not open file: " + filePath);
+
+	std::vector<std::string> names;
+	std::vector<float> embeddings;
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream iss(line);
+		std::string name;
+		size_t embeddingSize;
+		if (!(iss >> name >> embeddingSize))
+			continue;
+
+		if (embeddingSize != m_EmbeddingSize)
+			throw std::runtime_error("The gallery's embedding size does not match the model's output.");
+
+		names.push_back(name);
+		for (size_t t = 0; t < m_EmbeddingSize; t++)
+		{
+			float value;
+			iss >> value;
+			embeddings.push_back(value);
+		}
+	}
+
+	// An empty gallery maps the saved index when it belongs to the loaded embeddings (the checksum of the saved vectors matches),
+	// otherwise (or when the index file is invalid) the index is built.
+	if (m_Names.empty() && std::ifstream(filePath + ".hnsw").good())
+	{
+		std::unique_ptr<HNSWIndex> index;
+		try
+		{
+			index = std::make_unique<HNSWIndex>(filePath + ".hnsw");
+		}
+		catch (const std::runtime_error&)
+		{
+		}
+
+		if (index && index->GetDimension() == m_EmbeddingSize && index->GetCount() == names.size() && index->GetSize() == names.size() &&
+			index->GetFileChecksum() == HNSWIndex::Checksum(embeddings.data(), names.size(), m_EmbeddingSize))
+		{
+			m_Index = std::move(*index);
+			m_Names = names;
+			return;
+		}
+	}
+
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		m_Index.Add(embeddings.data() + i * m_EmbeddingSize);
+		m_Names.push_back(names[i]);
+	}
+}
+
+namespace_end
@@ -0,0 +1,84 @@
+#pragma once
+#include <vector>
+#include <string>
+
+#include "Core.h"
+#include "Model.h"
+#include "../Search/HNSWIndex.h"
+
+
+namespace_start
+
+/*
+	Triplet loss of the embeddings: max(0, |a - p|^2 - |a - n|^2 + margin).
+	The costs (derivatives respect to the embeddings) are set when they are given, they are zero when the loss is zero.
+*/
+LIBRARY_API float TripletLoss(
+	const Tensor3D& anchor, const Tensor3D& positive, const Tensor3D& negative, float margin,
+	Tensor3D* anchorCost=nullptr, Tensor3D* positiveCost=nullptr, Tensor3D* negativeCost=nullptr
+);
+
+/*
+	Contrastive loss of a pair of embeddings: |a - b|^2 for the same person, max(0, margin - |a - b|)^2 otherwise.
+*/
+LIBRARY_API float ContrastiveLoss(
+	const Tensor3D& left, const Tensor3D& right, bool isSame, float margin,
+	Tensor3D* leftCost=nullptr, Tensor3D* rightCost=nullptr
+);
+
+struct LIBRARY_API GalleryMatch
+{
+	std::string Name;
+	size_t Index = 0;  // Id of the matching embedding.
+	float Distance = -1.0f;  // Squared distance, negative when the gallery is empty.
+};
+
+/*
+	Enrolled people with their cached embeddings, computed by an embedding model (a shared tower of a siamese network).
+	Identification and verification is one feed forward of the model and the distances to the cached embeddings,
+	the nearest embedding is looked up in an approximate nearest neighbor index.
+	Embeddings have stable ids, a removed embedding's id is not reused.
+
+	The gallery is saved as a text file and the index next to it (file path + ".hnsw"), which is mapped by Load if it belongs to the text file.
+	The model must outlive the gallery.
+*/
+class LIBRARY_API EmbeddingGallery
+{
+public:
+	EmbeddingGallery(const Model& embeddingModel);
+	EmbeddingGallery(const Model& embeddingModel, const std::string& filePath);
+
+	Tensor3D Embed(const Tensor3D& input) const;
+
+	// Adds an embedding of the person, a person can have several.
+	void Enroll(const std::string& name, const Tensor3D& input);
+	void EnrollEmbedding(const std::string& name, const Tensor3D& embedding);
+	// Removes all of the person's embeddings, returns the number of removed ones.
+	size_t Remove(const std::string& name);
+
+	// Nearest enrolled embedding (approximate, ef is the number of candidates of the index search).
+	GalleryMatch Identify(const Tensor3D& input, size_t ef=64) const;
+	GalleryMatch IdentifyEmbedding(const Tensor3D& embedding, size_t ef=64) const;
+	// True when the nearest embedding of the person is closer than the threshold (squared distance).
+	bool Verify(const std::string& name, const Tensor3D& input, float threshold, float* distance=nullptr) const;
+	bool VerifyEmbedding(const std::string& name, const Tensor3D& embedding, float threshold, float* distance=nullptr) const;
+
+	void Save(const std::string& filePath) const;
+	void Load(const std::string& filePath);
+
+	inline size_t GetNumEmbeddings() const { return m_Index.GetSize(); }
+	inline size_t GetEmbeddingSize() const { return m_EmbeddingSize; }
+	// The name is empty for a removed id.
+	inline const std::string& GetName(size_t id) const { return m_Names[id]; }
+	inline const float* GetEmbedding(size_t id) const { return m_Index.GetVector(id); }
+	inline const HNSWIndex& GetIndex() const { return m_Index; }
+
+private:
+	const Model& m_Model;
+	size_t m_EmbeddingSize;
+
+	std::vector<std::string> m_Names;  // Name of every embedding id.
+	HNSWIndex m_Index;  // The embeddings.
+};
+
+namespace_end
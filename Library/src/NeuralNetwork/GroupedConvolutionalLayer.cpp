@@ -0,0 +1,274 @@
+#include "GroupedConvolutionalLayer.h"
+#include <assert.h>
+#include <sstream>
+#include <stdexcept>
+
+
+namespace_start
+
+GroupedConvolutionalLayer::GroupedConvolutionalLayer(
+	size_t inputHeight, size_t inputWidth, size_t inputDepth,
+	size_t kernelHeight, size_t kernelWidth, size_t numKernels, size_t groups,
+	size_t padding, ActivationFunciton activationFunction, Initializer initializer,
+	bool isUseBias, size_t stride
+) : m_ActivationFunction(activationFunction), m_InputWidth(inputWidth), m_InputHeight(inputHeight), m_InputDepth(inputDepth), m_NumKernels(numKernels), m_Groups(groups), m_Padding(padding), m_Stride(stride), m_IsUseBias(isUseBias)
+{
+	assert(stride > 0 && "Invalid stride!");
+	assert(groups > 0 && inputDepth % groups == 0 && numKernels % groups == 0 && "The input depth and the number of kernels must be divisible by the groups!");
+
+	size_t kernelDepth = numKernels * (inputDepth / groups);
+	size_t outputHeight = CalcConvSize(inputHeight, kernelHeight, stride, padding);
+	size_t outputWidth = CalcConvSize(inputWidth, kernelWidth, stride, padding);
+
+	if (m_IsUseBias)
+	{
+		m_Bias = Tensor3D(outputHeight, outputWidth, numKernels, initializer.Init);
+	}
+	m_Kernels = Tensor3D(kernelHeight, kernelWidth, kernelDepth, initializer.Init);
+}
+
+GroupedConvolutionalLayer::GroupedConvolutionalLayer(const std::string& fromString)
+{
+	FromString(fromString);
+}
+
+void GroupedConvolutionalLayer::ToHost()
+{
+	m_Kernels.ToHost();
+	if (m_IsUseBias)
+		m_Bias.ToHost();
+
+	if (m_KernelOptimizer)
+		m_KernelOptimizer->ToHost();
+	if (m_BiasOptimizer)
+		m_BiasOptimizer->ToHost();
+}
+
+void GroupedConvolutionalLayer::ToDevice()
+{
+	throw std::runtime_error("GroupedConvolutionalLayer is only implemented on the host.");
+}
+
+void GroupedConvolutionalLayer::InitOptimizer(OptimizerFactory optimizerFactory)
+{
+	m_KernelOptimizer = optimizerFactory.Get(m_Kernels.GetSize());
+	if (m_IsUseBias)
+		m_BiasOptimizer = optimizerFactory.Get(m_Bias.GetSize());
+}
+
+Tensor3D GroupedConvolutionalLayer::FeedForward(const Tensor3D& inputs)
+{
+	LayerShape layerShape = GetLayerShape();
+	Tensor3D output = Tensor3D(layerShape.OutputRows, layerShape.OutputCols, layerShape.OutputDepth);
+	Infer(inputs, output);
+	return output;
+}
+
+void GroupedConvolutionalLayer::Infer(const Tensor3D& inputs, Tensor3D& output) const
+{
+	assert(inputs.GetRows() == m_InputHeight && inputs.GetCols() == m_InputWidth && inputs.GetDepth() == m_InputDepth
+		&& "Invalid input shape!");
+
+	if (inputs.IsOnDevice() || output.IsOnDevice())
+		throw std::runtime_error("GroupedConvolutionalLayer is only implemented on the host.");
+
+	GroupedConvolutionBiasActivation(output, inputs, m_Kernels, m_Groups, m_IsUseBias ? &m_Bias : nullptr, m_ActivationFunction.Activation, m_Stride, m_Padding);
+}
+
+Tensor3D GroupedConvolutionalLayer::BackPropagation(const Tensor3D& inputs, const CostFunction& costFunction, float learningRate, size_t t)
+{
+	assert(inputs.GetRows() == m_InputHeight && inputs.GetCols() == m_InputWidth && inputs.GetDepth() == m_InputDepth
+		&& "Invalid input shape!");
+
+	if (inputs.IsOnDevice())
+		throw std::runtime_error("GroupedConvolutionalLayer is only implemented on the host.");
+
+	LayerShape layerShape = GetLayerShape();
+
+	// A (leaky) ReLU's derivative only needs the sign of the output, like in the ConvolutionalLayer.
+	const float reluAlpha = m_ActivationFunction.Name == "RelU" ? std::stof(m_ActivationFunction.Params) : -1.0f;
+	const bool isReluMask = reluAlpha >= 0.0f;
+	ReluMask reluMask;
+
+	Tensor3D filterMap = isReluMask ? Tensor3D() : Tensor3D(layerShape.OutputRows, layerShape.OutputCols, layerShape.OutputDepth);
+	Tensor3D output = Tensor3D(layerShape.OutputRows, layerShape.OutputCols, layerShape.OutputDepth);
+
+	GroupedConvolutionBiasActivation(output, inputs, m_Kernels, m_Groups, m_IsUseBias ? &m_Bias : nullptr, m_ActivationFunction.Activation, m_Stride, m_Padding, isReluMask ? nullptr : &filterMap);
+	if (isReluMask)
+		CreateReluMask(reluMask, output);
+
+	Tensor3D costs = NextLayer ?
+								NextLayer->BackPropagation(output, costFunction, learningRate, t) :
+								costFunction.DiffCost(output);
+
+	assert(costs.GetRows() == layerShape.OutputRows && costs.GetCols() == layerShape.OutputCols && costs.GetDepth() == layerShape.OutputDepth
+		&& "Invalid cost shape!");
+
+	if (isReluMask)
+	{
+		ApplyReluMask(costs, reluMask, reluAlpha);  // costs -> Gradient.
+	}
+	else
+	{
+		m_ActivationFunction.MapDiffActivation(&filterMap);
+		costs.Mult(filterMap);  // costs -> Gradient.
+	}
+
+	Tensor3D gradInput = Tensor3D(layerShape.InputRows, layerShape.InputCols, layerShape.InputDepth);
+	GroupedConvolutionInputGradient(gradInput, costs, m_Kernels, m_Groups, m_Stride, m_Padding);
+
+	if (!m_IsFrozen)
+	{
+		Tensor3D gradKernel = Tensor3D(m_Kernels.GetRows(), m_Kernels.GetCols(), m_Kernels.GetDepth());
+		GroupedConvolutionKernelGradient(gradKernel, inputs, costs, m_Groups, m_Stride, m_Padding);
+
+		m_KernelOptimizer->Update(&m_Kernels, &gradKernel, learningRate);
+		if (m_IsUseBias)
+		{
+			m_BiasOptimizer->Update(&m_Bias, &costs, learningRate);
+		}
+	}
+
+	return gradInput;
+}
+
+std::vector<LearnableTensor> GroupedConvolutionalLayer::GetLearnableTensors()
+{
+	if (!m_IsUseBias)
+		return { { &m_Kernels, m_KernelOptimizer.get() } };
+	return { { &m_Kernels, m_KernelOptimizer.get() }, { &m_Bias, m_BiasOptimizer.get() } };
+}
+
+LayerShape GroupedConvolutionalLayer::GetLayerShape() const
+{
+	size_t outputHeight = CalcConvSize(m_InputHeight, m_Kernels.GetRows(), m_Stride, m_Padding);
+	size_t outputWidth = CalcConvSize(m_InputWidth, m_Kernels.GetCols(), m_Stride, m_Padding);
+
+	return
+	{
+		m_InputHeight, m_InputWidth, m_InputDepth,
+		outputHeight, outputWidth, m_NumKernels
+	};
+}
+
+std::string GroupedConvolutionalLayer::ToString() const
+{
+	std::stringstream ss;
+
+	ss << "[ " <<
+		m_InputWidth << " " << m_InputHeight << " " << m_InputDepth << " " <<
+		m_Kernels.GetRows() << " " << m_Kernels.GetCols() << " " << m_NumKernels << " " << m_Groups << " " << m_Padding << " " << m_IsUseBias << " " <<
+		m_ActivationFunction.Name << " ( " << m_ActivationFunction.Params << " ) " << m_Stride <<
+	" ]";
+
+	for (size_t t = 0; t < m_Kernels.GetSize(); t++)
+	{
+		ss << " " << m_Kernels.GetData()[t];
+	}
+	if (m_IsUseBias)
+	{
+		for (size_t t = 0; t < m_Bias.GetSize(); t++)
+		{
+			ss << " " << m_Bias.GetData()[t];
+		}
+	}
+
+	ss << " { " << m_KernelOptimizer->GetName() << " " << m_KernelOptimizer->ToString() << "}";
+	if (m_IsUseBias)
+		ss << " { " << m_BiasOptimizer->GetName() << " " << m_BiasOptimizer->ToString() << "}";
+
+	return ss.str();
+}
+
+void GroupedConvolutionalLayer::FromString(const std::string& data)
+{
+	std::size_t numsStartPos = data.find(']');
+	assert(data[0] == '[' && numsStartPos != std::string::npos && "Invalid hyperparameter format.");
+	numsStartPos += 1;
+
+	std::string hyperparams = data.substr(1, numsStartPos - 2);
+	std::size_t acivationParamsStart = hyperparams.find('(');
+	std::size_t acivationParamsEnd = hyperparams.find(')');
+	assert(acivationParamsStart != std::string::npos && acivationParamsEnd != std::string::npos && "Invalid activation function params format.");
+
+	std::stringstream ss(hyperparams);
+	std::string activationFParamsStr = hyperparams.substr(acivationParamsStart + 2, acivationParamsEnd - acivationParamsStart - 3);
+
+	size_t kernelHeight, kernelWidth;
+	std::string activationName;
+
+	ss >> m_InputWidth >> m_InputHeight >> m_InputDepth >> kernelHeight >> kernelWidth >> m_NumKernels >> m_Groups >> m_Padding >> m_IsUseBias;
+	ss >> activationName;
+
+	// The stride follows the activation, like in the ConvolutionalLayer's format.
+	std::stringstream strideSS(hyperparams.substr(acivationParamsEnd + 1));
+	if (!(strideSS >> m_Stride))
+		m_Stride = 1;
+
+	size_t kernelDepth = m_NumKernels * (m_InputDepth / m_Groups);
+	size_t outputHeight = CalcConvSize(m_InputHeight, kernelHeight, m_Stride, m_Padding);
+	size_t outputWidth = CalcConvSize(m_InputWidth, kernelWidth, m_Stride, m_Padding);
+
+	m_Bias = m_IsUseBias ? Tensor3D(outputHeight, outputWidth, m_NumKernels) : Tensor3D();
+	m_Kernels = Tensor3D(kernelHeight, kernelWidth, kernelDepth);
+	m_ActivationFunction = GetActivationFunctionByName(activationName, activationFParamsStr);
+
+	std::istringstream iss(data.substr(numsStartPos));
+
+	for (size_t t = 0; t < m_Kernels.GetSize(); t++)
+	{
+		iss >> m_Kernels.GetData()[t];
+	}
+	if (m_IsUseBias)
+	{
+		for (size_t t = 0; t < m_Bias.GetSize(); t++)
+		{
+			iss >> m_Bias.GetData()[t];
+		}
+	}
+
+	std::string remaining;
+	std::getline(iss, remaining);
+
+	size_t kernelOptimizerStart = remaining.find('{');
+	size_t kernelOptimizerEnd = remaining.find('}');
+	size_t biasOptimizerStart = remaining.find('{', kernelOptimizerEnd);
+	size_t biasOptimizerEnd = remaining.find('}', biasOptimizerStart);
+
+	OptimizerFactory optimizerFactory;
+	std::string kernelOptimizerStr = remaining.substr(kernelOptimizerStart + 1, kernelOptimizerEnd - kernelOptimizerStart - 2);
+	m_KernelOptimizer = optimizerFactory.Get(kernelOptimizerStr);
+	if (m_IsUseBias)
+	{
+		std::string biasOptimizerStr = remaining.substr(biasOptimizerStart + 1, biasOptimizerEnd - biasOptimizerStart - 2);
+		m_BiasOptimizer = optimizerFactory.Get(biasOptimizerStr);
+	}
+}
+
+std::string GroupedConvolutionalLayer::ToDebugString() const
+{
+	std::stringstream ss;
+	ss << "Weights (" << m_Kernels.GetRows() << ", " << m_Kernels.GetCols() << ", " << m_Kernels.GetDepth() << ")\n";
+	ss << m_Kernels.ToString() << "\n";
+	ss << "Bias (" << m_Bias.GetRows() << ", " << m_Bias.GetCols() << ", " << m_Bias.GetDepth() << ")\n";
+	ss << m_Bias.ToString() << "\n";
+	return ss.str();
+}
+
+std::string GroupedConvolutionalLayer::Summarize() const
+{
+	std::stringstream ss;
+
+	LayerShape shape = GetLayerShape();
+
+	ss << ClassName() << ":\t Input: (" <<
+		shape.InputRows << ", " << shape.InputCols << ", " << shape.InputDepth << "), Output: (" <<
+		shape.OutputRows << ", " << shape.OutputCols << ", " << shape.OutputDepth << "), " <<
+		"# kernels: " << m_NumKernels << ", Groups: " << m_Groups << ", Padding: " << m_Padding << ", Stride: " << m_Stride <<
+		", Activation: " << m_ActivationFunction.Name << "(" << m_ActivationFunction.Params << "), " <<
+		"# learnable parameters: " << GetLearnableParams();
+
+	return ss.str();
+}
+
+namespace_end
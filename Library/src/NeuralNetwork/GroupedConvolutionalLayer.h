@@ -0,0 +1,74 @@
+#pragma once
+#include "Layer.h"
+#include "ActivationF.h"
+#include "Initializer.h"
+
+
+namespace_start
+
+/*
+	A convolutional layer with the input depth and the kernels split into groups, every kernel only sees the (inputDepth / groups) input slices
+	of its group, the params and the work are 1 / groups of a ConvolutionalLayer's. With groups = inputDepth it is a depthwise convolution
+	(numKernels / inputDepth kernels per input slice), followed by a ConvolutionalLayer with 1x1 kernels (pointwise) it is a depthwise separable convolution.
+	Host only.
+*/
+class LIBRARY_API GroupedConvolutionalLayer : public Layer
+{
+public:
+	GroupedConvolutionalLayer(
+		size_t inputHeight, size_t inputWidth, size_t inputDepth,
+		size_t kernelHeight, size_t kernelWidth, size_t numKernels, size_t groups,
+		size_t padding, ActivationFunciton activationFunction, Initializer initializer,
+		bool isUseBias = true, size_t stride = 1
+	);
+	GroupedConvolutionalLayer(const std::string& fromString);
+
+	virtual void ToHost() override;
+	virtual void ToDevice() override;
+
+	virtual void InitOptimizer(OptimizerFactory optimizerFactory) override;
+	virtual Tensor3D FeedForward(const Tensor3D& inputs) override;
+	virtual void Infer(const Tensor3D& inputs, Tensor3D& output) const override;
+	virtual Tensor3D BackPropagation(const Tensor3D& inputs, const CostFunction& costFunction, float learningRate, size_t t) override;
+
+	virtual LayerShape GetLayerShape() const override;
+
+	virtual std::string GetName() const override { return ClassName(); }
+	virtual std::string ToString() const override;
+	virtual std::string ToDebugString() const override;
+	virtual std::string Summarize() const override;
+
+	virtual ActivationFunciton GetActivationFunction() const override { return m_ActivationFunction; }
+	virtual size_t GetLearnableParams() const override { return m_Kernels.GetSize() + (m_IsUseBias ? m_Bias.GetSize() : 0); };
+	virtual std::vector<LearnableTensor> GetLearnableTensors() override;
+	virtual std::string GetSepcialParams() const override { return "Kernel: (" + std::to_string(m_Kernels.GetRows()) + ", " + std::to_string(m_Kernels.GetCols()) + ", " + std::to_string(m_InputDepth / m_Groups) + " * " + std::to_string(m_NumKernels) + "), Groups: " + std::to_string(m_Groups) + ", Padding: " + std::to_string(m_Padding) + ", Stride: " + std::to_string(m_Stride) + ", Optimizer: " + m_KernelOptimizer->GetName(); };
+
+	virtual void FromString(const std::string& data) override;
+
+	static std::string ClassName() { return "GroupedConvolutionalLayer"; }
+
+	inline const Tensor3D& GetKernels() const { return m_Kernels; }
+	inline const Tensor3D& GetBias() const { return m_Bias; }
+	inline size_t GetNumKernels() const { return m_NumKernels; }
+	inline size_t GetGroups() const { return m_Groups; }
+	inline size_t GetPadding() const { return m_Padding; }
+	inline size_t GetStride() const { return m_Stride; }
+	inline bool IsUseBias() const { return m_IsUseBias; }
+private:
+	Tensor3D m_Kernels;  // k x k x (#2Dinputs / groups * n)
+	Tensor3D m_Bias;  // Wo x Ho x n
+	ActivationFunciton m_ActivationFunction;
+
+	size_t m_InputWidth, m_InputHeight, m_InputDepth;
+	size_t m_NumKernels;
+	size_t m_Groups;
+	size_t m_Padding;
+	size_t m_Stride = 1;
+
+	bool m_IsUseBias;
+
+	std::unique_ptr<Optimizer> m_KernelOptimizer;
+	std::unique_ptr<Optimizer> m_BiasOptimizer;
+};
+
+namespace_end
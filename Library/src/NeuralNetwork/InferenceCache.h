@@ -0,0 +1,69 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <mutex>
+#include <chrono>
+
+#include "Core.h"
+#include "Model.h"
+
+
+namespace_start
+
+struct LIBRARY_API InferenceCacheStats
+{
+	size_t NumRequests = 0, NumHits = 0;
+	float HitRate = 0.0f;
+	// The estimated compute time the hits saved: the number of hits times the average feed forward.
+	float SavedMilliseconds = 0.0f;
+	float AverageFeedForwardMilliseconds = 0.0f;
+
+	std::string ToString() const;
+};
+
+/*
+	Caches the model's last output in front of Model::FeedForward for inputs that barely change, like the frames of a static video.
+	The signature of an input is the mean of every blockSize x blockSize block of every channel. When the mean absolute difference
+	of the signature and the cached output's input signature is below the threshold, the cached output is returned.
+
+	A cached output is reused for at most maxStaleFrames requests and maxStaleMilliseconds (0: no limit) after it was computed.
+	Thread safe, the feed forward of a miss runs without holding the cache's lock. The model must outlive the cache.
+*/
+class LIBRARY_API InferenceCache
+{
+public:
+	InferenceCache(const Model& model, float threshold=0.02f, size_t maxStaleFrames=30, size_t maxStaleMilliseconds=1000, size_t blockSize=8);
+
+	Tensor3D FeedForward(const Tensor3D& input);
+	// The next request runs the model.
+	void Invalidate();
+
+	InferenceCacheStats GetStats() const;
+	void ResetStats();
+
+	// Block means of the input in (depth, block row, block col) order, the input must be on the host.
+	static void ComputeSignature(const Tensor3D& input, size_t blockSize, std::vector<float>& signature);
+
+	inline float GetThreshold() const { return m_Threshold; }
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	const Model& m_Model;
+	float m_Threshold;
+	size_t m_MaxStaleFrames;
+	std::chrono::milliseconds m_MaxStaleTime;
+	size_t m_BlockSize;
+
+	mutable std::mutex m_Mutex;
+	bool m_IsValid = false;
+	std::vector<float> m_Signature;  // Signature of the cached output's input.
+	Tensor3D m_Output;
+	size_t m_NumStaleFrames = 0;
+	Clock::time_point m_OutputTime;
+
+	size_t m_NumRequests = 0, m_NumHits = 0, m_NumMisses = 0;
+	double m_FeedForwardMilliseconds = 0.0;  // Sum of the misses' feed forwards.
+};
+
+namespace_end
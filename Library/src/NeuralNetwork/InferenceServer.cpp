@@ -0,0 +1,159 @@
+#include "InferenceServer.h"
+#include <assert.h>
+#include <algorithm>
+#include <sstream>
+
+#include "InferenceSession.h"
+
+
+namespace_start
+
+std::string InferenceServerStats::ToString() const
+{
+	std::stringstream ss;
+
+	ss << "requests: " << NumRequests << ", batches: " << NumBatches << ", average batch size: " << AverageBatchSize << "\n";
+	ss << "queueing [us] p50: " << QueueP50 << " p90: " << QueueP90 << " p99: " << QueueP99 << "\n";
+	ss << "compute [us] p50: " << ComputeP50 << " p90: " << ComputeP90 << " p99: " << ComputeP99;
+
+	return ss.str();
+}
+
+InferenceServer::InferenceServer(const Model& model, size_t maxBatchSize, size_t maxWaitMicroseconds, size_t numWorkers, size_t latencyWindow)
+	: m_Model(model), m_MaxBatchSize(std::max(maxBatchSize, size_t(1))), m_MaxWait(maxWaitMicroseconds), m_QueueLatencies(latencyWindow), m_ComputeLatencies(latencyWindow)
+{
+	for (size_t i = 0; i < std::max(numWorkers, size_t(1)); i++)
+	{
+		m_Workers.emplace_back(&InferenceServer::Work, this);
+	}
+}
+
+InferenceServer::~InferenceServer()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_RequestsMutex);
+		m_IsStopping = true;
+	}
+	m_RequestsCondition.notify_all();
+
+	for (std::thread& worker : m_Workers)
+	{
+		worker.join();
+	}
+}
+
+std::future<Tensor3D> InferenceServer::Submit(const Tensor3D& input)
+{
+	std::future<Tensor3D> output;
+	{
+		std::unique_lock<std::mutex> lock(m_RequestsMutex);
+		if (m_IsStopping)
+			throw std::runtime_error("Submit on a stopped inference server.");
+
+		m_Requests.push_back({ input, std::promise<Tensor3D>(), Clock::now() });
+		output = m_Requests.back().Output.get_future();
+	}
+	m_RequestsCondition.notify_one();
+
+	return output;
+}
+
+void InferenceServer::Work()
+{
+	InferenceSession session(m_Model, true, m_MaxBatchSize);
+	std::vector<Request> batch;
+	std::vector<const Tensor3D*> inputs;
+
+	while (true)
+	{
+		batch.clear();
+		{
+			std::unique_lock<std::mutex> lock(m_RequestsMutex);
+			m_RequestsCondition.wait(lock, [this] { return m_IsStopping || !m_Requests.empty(); });
+
+			// Wait for a full batch, but not longer than the oldest request's deadline.
+			Clock::time_point deadline = m_Requests.empty() ? Clock::now() : m_Requests.front().SubmitTime + m_MaxWait;
+			m_RequestsCondition.wait_until(lock, deadline, [this] { return m_IsStopping || m_Requests.size() >= m_MaxBatchSize; });
+
+			if (m_Requests.empty())
+			{
+				if (m_IsStopping)
+					return;
+				continue;  // An other worker took the requests.
+			}
+
+			size_t batchSize = std::min(m_Requests.size(), m_MaxBatchSize);
+			for (size_t i = 0; i < batchSize; i++)
+			{
+				batch.push_back(std::move(m_Requests.front()));
+				m_Requests.pop_front();
+			}
+		}
+
+		Clock::time_point startTime = Clock::now();
+
+		inputs.clear();
+		for (const Request& request : batch)
+			inputs.push_back(&request.Input);
+
+		std::exception_ptr error;
+		const std::vector<Tensor3D>* outputs = nullptr;
+		try
+		{
+			outputs = &session.RunBatch(inputs);
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+
+		float computeTime = std::chrono::duration<float, std::micro>(Clock::now() - startTime).count();
+
+		// The statistics are recorded before the responses, so a client sees its own request in them.
+		{
+			std::unique_lock<std::mutex> lock(m_StatsMutex);
+			m_NumBatches++;
+			for (const Request& request : batch)
+			{
+				m_QueueLatencies.Add(std::chrono::duration<float, std::micro>(startTime - request.SubmitTime).count());
+				m_ComputeLatencies.Add(computeTime);
+			}
+		}
+
+		for (size_t i = 0; i < batch.size(); i++)
+		{
+			if (error)
+				batch[i].Output.set_exception(error);
+			else
+				batch[i].Output.set_value((*outputs)[i]);
+		}
+	}
+}
+
+InferenceServerStats InferenceServer::GetStats() const
+{
+	std::unique_lock<std::mutex> lock(m_StatsMutex);
+
+	InferenceServerStats stats;
+	stats.NumRequests = m_QueueLatencies.GetCount();
+	stats.NumBatches = m_NumBatches;
+	stats.AverageBatchSize = m_NumBatches ? (float)stats.NumRequests / (float)m_NumBatches : 0.0f;
+	stats.QueueP50 = m_QueueLatencies.Percentile(0.5f);
+	stats.QueueP90 = m_QueueLatencies.Percentile(0.9f);
+	stats.QueueP99 = m_QueueLatencies.Percentile(0.99f);
+	stats.ComputeP50 = m_ComputeLatencies.Percentile(0.5f);
+	stats.ComputeP90 = m_ComputeLatencies.Percentile(0.9f);
+	stats.ComputeP99 = m_ComputeLatencies.Percentile(0.99f);
+
+	return stats;
+}
+
+void InferenceServer::ResetStats()
+{
+	std::unique_lock<std::mutex> lock(m_StatsMutex);
+	m_QueueLatencies.Clear();
+	m_ComputeLatencies.Clear();
+	m_NumBatches = 0;
+}
+
+namespace_end
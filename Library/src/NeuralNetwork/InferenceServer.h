@@ -0,0 +1,78 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <chrono>
+
+#include "Core.h"
+#include "Model.h"
+#include "../LatencyWindow.h"
+
+
+namespace_start
+
+struct LIBRARY_API InferenceServerStats
+{
+	size_t NumRequests = 0;
+	size_t NumBatches = 0;
+	float AverageBatchSize = 0.0f;
+
+	// Latency percentiles in microseconds of the last requests (see InferenceServer). Queueing: from the submission until the batch starts, compute: the batch's run.
+	float QueueP50 = 0.0f, QueueP90 = 0.0f, QueueP99 = 0.0f;
+	float ComputeP50 = 0.0f, ComputeP90 = 0.0f, ComputeP99 = 0.0f;
+
+	std::string ToString() const;
+};
+
+/*
+	Serves a model to concurrent requests. The requests are coalesced into batches: a worker takes a batch,
+	when maxBatchSize requests are waiting, or the oldest request has waited maxWaitMicroseconds.
+	Every worker runs its batches with its own InferenceSession, so the model must outlive the server and must not be modified.
+	The latency percentiles of the stats are over the last latencyWindow requests, the counts are over all of them.
+*/
+class LIBRARY_API InferenceServer
+{
+public:
+	InferenceServer(const Model& model, size_t maxBatchSize, size_t maxWaitMicroseconds, size_t numWorkers=1, size_t latencyWindow=4096);
+	~InferenceServer();
+
+	// Thread safe. Queues the input, the future is ready when the input's batch was evaluated.
+	std::future<Tensor3D> Submit(const Tensor3D& input);
+
+	InferenceServerStats GetStats() const;
+	void ResetStats();
+
+private:
+	void Work();
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct Request
+	{
+		Tensor3D Input;
+		std::promise<Tensor3D> Output;
+		Clock::time_point SubmitTime;
+	};
+
+	const Model& m_Model;
+	size_t m_MaxBatchSize;
+	std::chrono::microseconds m_MaxWait;
+
+	std::deque<Request> m_Requests;
+	std::mutex m_RequestsMutex;
+	std::condition_variable m_RequestsCondition;
+	bool m_IsStopping = false;
+	std::vector<std::thread> m_Workers;
+
+	mutable std::mutex m_StatsMutex;
+	LatencyWindow m_QueueLatencies;
+	LatencyWindow m_ComputeLatencies;
+	size_t m_NumBatches = 0;
+};
+
+namespace_end
@@ -0,0 +1,197 @@
+#include "InferenceSession.h"
+#include <assert.h>
+#include <algorithm>
+
+#include "ConvolutionalLayer.h"
+#include "MaxPoolingLayer.h"
+#include "DenseLayer.h"
+#include "DropoutLayer.h"
+#include "../ThreadPool.h"
+
+
+namespace_start
+
+InferenceSession::InferenceSession(const Model& model, bool isRunningInline, size_t maxBatchSize) 
+	: m_IsRunningInline(isRunningInline), m_MaxBatchSize(std::max(maxBatchSize, size_t(1)))
+{
+	assert(model.IsModelCorrect() && "Model is not defined correctly!");
+
+	std::shared_ptr<Layer> layer = model.GetRootLayer();
+	while (layer)
+	{
+		Step step;
+		step.Node = layer;
+		LayerShape shape = layer->GetLayerShape();
+
+		if (layer->GetName() == ConvolutionalLayer::ClassName() && layer->NextLayer && layer->NextLayer->GetName() == MaxPoolingLayer::ClassName())
+		{
+			const MaxPoolingLayer* pooling = static_cast<const MaxPoolingLayer*>(layer->NextLayer.get());
+			step.PoolingHeight = pooling->GetPoolingHeight();
+			step.PoolingWidth = pooling->GetPoolingWidth();
+			shape = pooling->GetLayerShape();
+			layer = layer->NextLayer;
+		}
+
+		m_Steps.push_back(step);
+		m_Activations.emplace_back(shape.OutputRows, shape.OutputCols, shape.OutputDepth);
+		m_ActivationSize += m_Activations.back().GetSize();
+
+		layer = layer->NextLayer;
+	}
+
+	if (m_MaxBatchSize == 1)
+		return;
+
+	// The longest run of dense (and dropout) layers is evaluated for the whole batch.
+	for (size_t i = 0; i < m_Steps.size();)
+	{
+		size_t end = i;
+		bool hasDense = false;
+		while (end < m_Steps.size() && 
+			(m_Steps[end].Node->GetName() == DenseLayer::ClassName() || m_Steps[end].Node->GetName() == DropoutLayer::ClassName()))
+		{
+			hasDense = hasDense || m_Steps[end].Node->GetName() == DenseLayer::ClassName();
+			end++;
+		}
+
+		if (hasDense && end - i > m_BatchEnd - m_BatchStart)
+		{
+			m_BatchStart = i;
+			m_BatchEnd = end;
+		}
+		i = std::max(end, i + 1);
+	}
+
+	if (m_BatchEnd > m_BatchStart)
+	{
+		LayerShape shape = m_Steps[m_BatchStart].Node->GetLayerShape();
+		assert(shape.InputCols == 1 && shape.InputDepth == 1 && "Dense layer's input should be a column!");
+		m_BatchActivations.emplace_back(shape.InputRows * m_MaxBatchSize, 1, 1);
+
+		for (size_t i = m_BatchStart; i < m_BatchEnd; i++)
+		{
+			shape = m_Steps[i].Node->GetLayerShape();
+			m_BatchActivations.emplace_back(shape.OutputRows * m_MaxBatchSize, 1, 1);
+		}
+		m_BatchColumn = Tensor3D(shape.OutputRows, 1, 1);
+
+		for (const Tensor3D& activation : m_BatchActivations)
+			m_ActivationSize += activation.GetSize();
+	}
+
+	for (size_t i = 0; i < m_MaxBatchSize; i++)
+	{
+		const Tensor3D& output = m_Activations.back();
+		m_BatchOutputs.emplace_back(output.GetRows(), output.GetCols(), output.GetDepth());
+		m_ActivationSize += output.GetSize();
+	}
+}
+
+const Tensor3D* InferenceSession::RunSteps(size_t fromStep, size_t toStep, const Tensor3D* input)
+{
+	for (size_t i = fromStep; i < toStep; i++)
+	{
+		const Step& step = m_Steps[i];
+		if (step.PoolingHeight)
+			static_cast<const ConvolutionalLayer*>(step.Node.get())->InferMaxPool(*input, m_Activations[i], step.PoolingHeight, step.PoolingWidth);
+		else
+			step.Node->Infer(*input, m_Activations[i]);
+
+		input = &m_Activations[i];
+	}
+
+	return input;
+}
+
+const Tensor3D& InferenceSession::Run(const Tensor3D& inputs)
+{
+	assert(!m_Steps.empty() && "No layers in the session!");
+
+	const bool wasRunningInline = ThreadPool::IsRunningInline();
+	ThreadPool::SetRunningInline(m_IsRunningInline);
+
+	try
+	{
+		RunSteps(0, m_Steps.size(), &inputs);
+	}
+	catch (...)
+	{
+		ThreadPool::SetRunningInline(wasRunningInline);
+		throw;
+	}
+
+	ThreadPool::SetRunningInline(wasRunningInline);
+
+	return m_Activations.back();
+}
+
+const std::vector<Tensor3D>& InferenceSession::RunBatch(const std::vector<const Tensor3D*>& inputs)
+{
+	assert(!m_Steps.empty() && "No layers in the session!");
+	assert(inputs.size() <= m_MaxBatchSize && "Batch is larger than the session's maximum batch size!");
+
+	const bool wasRunningInline = ThreadPool::IsRunningInline();
+	ThreadPool::SetRunningInline(m_IsRunningInline);
+
+	const size_t batchSize = inputs.size();
+	auto copyTo = [](Tensor3D& destination, const Tensor3D& source) {
+		std::copy(source.GetData(), source.GetData() + source.GetSize(), destination.GetData());
+	};
+
+	try
+	{
+		if (m_BatchEnd == m_BatchStart)
+		{
+			for (size_t i = 0; i < batchSize; i++)
+				copyTo(m_BatchOutputs[i], *RunSteps(0, m_Steps.size(), inputs[i]));
+		}
+		else
+		{
+			// Gather the inputs of the dense block into the columns of a rows x batchSize matrix.
+			float* gathered = m_BatchActivations[0].GetData();
+			for (size_t i = 0; i < batchSize; i++)
+			{
+				const Tensor3D* output = RunSteps(0, m_BatchStart, inputs[i]);
+				const size_t rows = output->GetSize();
+				for (size_t r = 0; r < rows; r++)
+					gathered[r * batchSize + i] = output->GetData()[r];
+			}
+
+			size_t current = 0;
+			for (size_t s = m_BatchStart; s < m_BatchEnd; s++)
+			{
+				const Step& step = m_Steps[s];
+				if (step.Node->GetName() == DropoutLayer::ClassName())
+					continue;
+
+				LayerShape shape = step.Node->GetLayerShape();
+				size_t next = s - m_BatchStart + 1;
+				Tensor3D input(shape.InputRows, batchSize, 1, m_BatchActivations[current].GetData(), false);
+				Tensor3D output(shape.OutputRows, batchSize, 1, m_BatchActivations[next].GetData(), false);
+				step.Node->Infer(input, output);
+				current = next;
+			}
+
+			// Scatter the columns and finish the samples after the dense block.
+			const float* results = m_BatchActivations[current].GetData();
+			for (size_t i = 0; i < batchSize; i++)
+			{
+				for (size_t r = 0; r < m_BatchColumn.GetRows(); r++)
+					m_BatchColumn.GetData()[r] = results[r * batchSize + i];
+
+				copyTo(m_BatchOutputs[i], *RunSteps(m_BatchEnd, m_Steps.size(), &m_BatchColumn));
+			}
+		}
+	}
+	catch (...)
+	{
+		ThreadPool::SetRunningInline(wasRunningInline);
+		throw;
+	}
+
+	ThreadPool::SetRunningInline(wasRunningInline);
+
+	return m_BatchOutputs;
+}
+
+namespace_end
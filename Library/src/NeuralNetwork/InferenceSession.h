@@ -0,0 +1,62 @@
+#pragma once
+#include <memory>
+#include <vector>
+
+#include "Core.h"
+#include "Layer.h"
+#include "Model.h"
+
+
+namespace_start
+
+/*
+	Inference of a model on the host with the session's own preallocated activations.
+	The model's layers are only read, so several sessions over the same model can run at once (one session per thread),
+	the weights are shared and every session only adds its activations to the memory.
+
+	The model must outlive its sessions and must not be trained, modified or moved to the device while a session runs.
+*/
+class LIBRARY_API InferenceSession
+{
+public:
+	// isRunningInline: the session's kernels run on the calling thread instead of the thread pool.
+	// maxBatchSize: the maximum number of inputs of RunBatch.
+	InferenceSession(const Model& model, bool isRunningInline=true, size_t maxBatchSize=1);
+
+	// Returns the output of the model, it is valid until the next run of this session.
+	const Tensor3D& Run(const Tensor3D& inputs);
+	/*
+		Evaluates the inputs as one batch. The layers before and after the model's dense block run per sample,
+		the dense block runs one matrix multiplication per layer for the whole batch (the samples are the columns).
+		The first inputs.size() outputs are valid until the next run of this session.
+	*/
+	const std::vector<Tensor3D>& RunBatch(const std::vector<const Tensor3D*>& inputs);
+
+	inline size_t GetMaxBatchSize() const { return m_MaxBatchSize; }
+	inline size_t GetActivationSize() const { return m_ActivationSize; }
+
+private:
+	const Tensor3D* RunSteps(size_t fromStep, size_t toStep, const Tensor3D* input);
+
+private:
+	struct Step
+	{
+		std::shared_ptr<const Layer> Node;
+		// A ConvolutionalLayer followed by a MaxPoolingLayer is evaluated with one fused kernel.
+		size_t PoolingHeight = 0, PoolingWidth = 0;
+	};
+
+	std::vector<Step> m_Steps;
+	std::vector<Tensor3D> m_Activations;
+	size_t m_ActivationSize = 0;
+	bool m_IsRunningInline;
+
+	// The dense block [m_BatchStart, m_BatchEnd) of the steps, which is evaluated for the whole batch at once.
+	size_t m_MaxBatchSize;
+	size_t m_BatchStart = 0, m_BatchEnd = 0;
+	std::vector<Tensor3D> m_BatchActivations;  // Input of the block, than the output of every step, rows x m_MaxBatchSize.
+	Tensor3D m_BatchColumn;
+	std::vector<Tensor3D> m_BatchOutputs;
+};
+
+namespace_end
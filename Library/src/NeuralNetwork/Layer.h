@@ -19,6 +19,13 @@ struct LayerShape
 	size_t OutputRows, OutputCols, OutputDepth;
 };
 
+// A learnable tensor of a layer and its optimizer (null before InitOptimizer).
+struct LearnableTensor
+{
+	Tensor* Params;
+	Optimizer* ParamsOptimizer;
+};
+
 class LIBRARY_API Layer
 {
 public:
@@ -36,6 +43,12 @@ public:
 
 	virtual Tensor3D FeedForward(const Tensor3D& inputs) = 0;
 
+	/*
+		Inference on the host into a preallocated output, which has the layer's output shape.
+		The layer is only read, so the same layer can be evaluated from several threads at once (see InferenceSession).
+	*/
+	virtual void Infer(const Tensor3D& inputs, Tensor3D& output) const = 0;
+
 	/*
 		Recursive backpropagation learning algorithm.
 		First calculates the feedforward of the current layer.
@@ -48,6 +61,19 @@ public:
 	*/
 	virtual Tensor3D BackPropagation(const Tensor3D& inputs, const CostFunction& costFunction, float learningRate, size_t t) = 0;
 
+	/*
+		Mixed precision training: the forward pass of the back propagation reads bfloat16 copies of the params and the inputs and accumulates
+		in fp32. The params stay fp32, they are the master copy updated by the optimizer. Layers without a bfloat16 kernel ignore it.
+	*/
+	virtual void SetMixedPrecision(bool isMixedPrecision) { }
+	virtual bool IsMixedPrecision() const { return false; }
+	// The params were written outside of the layer's optimizer step, their bfloat16 copy (converted once per step, not per sample) is stale.
+	virtual void MarkParamsChanged() { }
+
+	// A frozen layer's params are not updated and their gradient is not calculated, the gradient of its input is (see Model::SetFrozen).
+	inline void SetFrozen(bool isFrozen) { m_IsFrozen = isFrozen; }
+	inline bool IsFrozen() const { return m_IsFrozen; }
+
 	virtual LayerShape GetLayerShape() const = 0;
 
 	virtual std::string GetName() const = 0;
@@ -57,11 +83,16 @@ public:
 
 	virtual ActivationFunciton GetActivationFunction() const = 0;
 	virtual size_t GetLearnableParams() const = 0;
+	// The learnable tensors in a fixed order, empty for a layer without learnable params.
+	virtual std::vector<LearnableTensor> GetLearnableTensors() { return { }; }
 	virtual std::string GetSepcialParams() const = 0;
 
 	virtual void FromString(const std::string& data) = 0;
 
 	std::shared_ptr<Layer> NextLayer;
+
+protected:
+	bool m_IsFrozen = false;
 };
 
 namespace_end
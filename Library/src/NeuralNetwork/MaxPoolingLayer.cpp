@@ -32,6 +32,16 @@ Tensor3D MaxPoolingLayer::FeedForward(const Tensor3D& inputs)
 	return output;
 }
 
+void MaxPoolingLayer::Infer(const Tensor3D& inputs, Tensor3D& output) const
+{
+	assert(m_InputHeight == inputs.GetRows() &&
+		m_InputWidth == inputs.GetCols() &&
+		m_InputDepth == inputs.GetDepth()
+		&& "Input shape not match!");
+
+	MaxPool(output, inputs, m_PoolingHeight, m_PoolingWidth);
+}
+
 Tensor3D MaxPoolingLayer::BackPropagation(const Tensor3D& inputs, const CostFunction& costFucntion, float learningRate, size_t t)
 {
 	assert(m_InputHeight == inputs.GetRows() &&
@@ -41,11 +51,13 @@ Tensor3D MaxPoolingLayer::BackPropagation(const Tensor3D& inputs, const CostFunc
 
 	LayerShape layerShape = GetLayerShape();
 
-	Tensor3D output = MaxPool(inputs, m_PoolingHeight, m_PoolingWidth);
+	// On the host the positions of the maximums are recorded, so the gradient is scattered without reading the input again.
+	MaxPoolIndices indices;
+	Tensor3D output = MaxPool(inputs, m_PoolingHeight, m_PoolingWidth, inputs.IsOnDevice() ? nullptr : &indices);
 
 	Tensor3D costs = NextLayer ?
 								NextLayer->BackPropagation(output, costFucntion, learningRate, t) :
-								output;
+								costFucntion.DiffCost(output);
 
 	assert(layerShape.OutputRows == costs.GetRows() &&
 		layerShape.OutputCols == costs.GetCols() &&
@@ -54,7 +66,10 @@ Tensor3D MaxPoolingLayer::BackPropagation(const Tensor3D& inputs, const CostFunc
 
 	Tensor3D gradient = Tensor3D(layerShape.InputRows, layerShape.InputCols, layerShape.InputDepth, 0.0f, inputs.IsOnDevice());
 
-	DistributeReverseMaxPool(gradient, inputs, costs, m_PoolingHeight, m_PoolingWidth);
+	if (inputs.IsOnDevice())
+		DistributeReverseMaxPool(gradient, inputs, costs, m_PoolingHeight, m_PoolingWidth);
+	else
+		DistributeReverseMaxPool(gradient, indices, costs, m_PoolingHeight, m_PoolingWidth);
 
 	return gradient;
 }
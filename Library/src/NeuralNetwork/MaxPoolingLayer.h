@@ -16,6 +16,7 @@ public:
 	virtual void ToDevice() override { }
 
 	virtual Tensor3D FeedForward(const Tensor3D& inputs);
+	virtual void Infer(const Tensor3D& inputs, Tensor3D& output) const;
 	virtual Tensor3D BackPropagation(const Tensor3D& inputs, const CostFunction& costFunction, float learningRate, size_t t);
 
 	virtual LayerShape GetLayerShape() const;
@@ -31,6 +32,9 @@ public:
 
 	virtual void FromString(const std::string& data);
 
+	inline size_t GetPoolingHeight() const { return m_PoolingHeight; }
+	inline size_t GetPoolingWidth() const { return m_PoolingWidth; }
+
 	static std::string ClassName() { return "MaxPoolingLayer"; }
 private:
 	size_t m_InputHeight, m_InputWidth, m_InputDepth;
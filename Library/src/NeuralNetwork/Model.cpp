@@ -3,10 +3,15 @@
 #include <fstream>
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
 
 #include "Model.h"
 #include "DenseLayer.h"
 #include "ConvolutionalLayer.h"
+#include "GroupedConvolutionalLayer.h"
 #include "SoftmaxLayer.h"
 #include "ReshapeLayer.h"
 #include "MaxPoolingLayer.h"
@@ -23,6 +28,11 @@ Model::Model(const std::string& filePath)
 
 void Model::AddLayer(const std::shared_ptr<Layer>& headLayer)
 {
+	for (std::shared_ptr<Layer> layer = headLayer; layer; layer = layer->NextLayer)
+	{
+		layer->SetMixedPrecision(m_IsMixedPrecision);
+	}
+
 	if (!m_RootLayer)
 	{
 		m_RootLayer = headLayer;
@@ -39,6 +49,7 @@ void Model::AddLayer(const std::string& layerName, const std::string& layerFromD
 {
 	if (layerName == DenseLayer::ClassName()) { AddLayer(std::make_shared<DenseLayer>(layerFromData)); return; }
 	if (layerName == ConvolutionalLayer::ClassName()) { AddLayer(std::make_shared<ConvolutionalLayer>(layerFromData)); return; }
+	if (layerName == GroupedConvolutionalLayer::ClassName()) { AddLayer(std::make_shared<GroupedConvolutionalLayer>(layerFromData)); return; }
 	if (layerName == SoftmaxLayer::ClassName()) { AddLayer(std::make_shared<SoftmaxLayer>(layerFromData)); return; }
 	if (layerName == ReshapeLayer::ClassName()) { AddLayer(std::make_shared<ReshapeLayer>(layerFromData)); return; }
 	if (layerName == MaxPoolingLayer::ClassName()) { AddLayer(std::make_shared<MaxPoolingLayer>(layerFromData)); return; }
@@ -48,6 +59,28 @@ void Model::AddLayer(const std::string& layerName, const std::string& layerFromD
 	assert(false && "Unknown layer name!");
 }
 
+void Model::SetMixedPrecision(bool isMixedPrecision)
+{
+	m_IsMixedPrecision = isMixedPrecision;
+
+	std::shared_ptr<Layer> layer = m_RootLayer;
+	while (layer)
+	{
+		layer->SetMixedPrecision(isMixedPrecision);
+		layer = layer->NextLayer;
+	}
+}
+
+void Model::MarkParamsChanged()
+{
+	std::shared_ptr<Layer> layer = m_RootLayer;
+	while (layer)
+	{
+		layer->MarkParamsChanged();
+		layer = layer->NextLayer;
+	}
+}
+
 void Model::ToHost()
 {
 	std::shared_ptr<Layer> layer = m_RootLayer;
@@ -73,7 +106,7 @@ void Model::InitializeOptimizer(OptimizerFactory optimizerFactory)
 	std::shared_ptr<Layer> layer = m_RootLayer;
 	while (layer)
 	{
-		layer->InitOptimizer(optimizerFactory);
+		layer->InitOptimizer(layer->IsFrozen() ? OptimizerFactory(OptimizerType::SGD) : optimizerFactory);
 		layer = layer->NextLayer;
 	}
 }
@@ -82,13 +115,32 @@ Tensor3D Model::FeedForward(const Tensor3D& inputs) const
 {
 	assert(m_RootLayer != nullptr && "No layer available!");
 
+	return FeedForwardLayers(inputs, std::numeric_limits<size_t>::max());
+}
+
+Tensor3D Model::FeedForwardLayers(const Tensor3D& inputs, size_t numLayers) const
+{
 	std::shared_ptr<Layer> layer = m_RootLayer;
 	Tensor3D output = inputs;
 
-	while (layer)
+	size_t layerIndex = 0;
+	while (layer && layerIndex < numLayers)
 	{
+		if (m_IsFusingLayers && layer->GetName() == ConvolutionalLayer::ClassName() && layerIndex + 1 < numLayers &&
+			layer->NextLayer && layer->NextLayer->GetName() == MaxPoolingLayer::ClassName())
+		{
+			ConvolutionalLayer* convolutionalLayer = static_cast<ConvolutionalLayer*>(layer.get());
+			MaxPoolingLayer* maxPoolingLayer = static_cast<MaxPoolingLayer*>(layer->NextLayer.get());
+
+			output = convolutionalLayer->FeedForwardMaxPool(output, maxPoolingLayer->GetPoolingHeight(), maxPoolingLayer->GetPoolingWidth());
+			layer = maxPoolingLayer->NextLayer;
+			layerIndex += 2;
+			continue;
+		}
+
 		output = layer->FeedForward(output);
 		layer = layer->NextLayer;
+		layerIndex++;
 	}
 
 	return output;
@@ -98,9 +150,203 @@ Tensor3D Model::BackPropagation(const Tensor3D& inputs, const CostFunction& cost
 {
 	assert(m_RootLayer != nullptr && "No layer available!");
 
+	if (!m_Checkpoints.empty())
+		return CheckpointedBackPropagation(inputs, costFunction, learningRate, t);
+
+	if (m_RootLayer->IsFrozen())
+		return BackPropagationFromPrefix(FeedForwardPrefix(inputs), costFunction, learningRate, t);
+
 	return m_RootLayer->BackPropagation(inputs, costFunction, learningRate, t);
 }
 
+void Model::SetFrozen(size_t layerIndex, bool isFrozen)
+{
+	std::vector<std::shared_ptr<Layer>> layers = GetLayers();
+	assert(layerIndex < layers.size() && "Invalid layer index!");
+
+	layers[layerIndex]->SetFrozen(isFrozen);
+	// The optimizer state of the frozen layer is released.
+	if (isFrozen && layers[layerIndex]->GetLearnableParams() > 0)
+		layers[layerIndex]->InitOptimizer(OptimizerFactory(OptimizerType::SGD));
+}
+
+void Model::FreezePrefix(size_t numLayers)
+{
+	std::vector<std::shared_ptr<Layer>> layers = GetLayers();
+	for (size_t i = 0; i < layers.size(); i++)
+	{
+		if (layers[i]->IsFrozen() != (i < numLayers))
+			SetFrozen(i, i < numLayers);
+	}
+}
+
+size_t Model::GetFrozenPrefix() const
+{
+	size_t numFrozen = 0;
+	for (std::shared_ptr<Layer> layer = m_RootLayer; layer && layer->IsFrozen(); layer = layer->NextLayer)
+		numFrozen++;
+	return numFrozen;
+}
+
+Tensor3D Model::FeedForwardPrefix(const Tensor3D& inputs) const
+{
+	return FeedForwardLayers(inputs, GetFrozenPrefix());
+}
+
+Tensor3D Model::BackPropagationFromPrefix(const Tensor3D& prefixOutput, const CostFunction& costFunction, float learningRate, size_t t)
+{
+	std::shared_ptr<Layer> layer = m_RootLayer;
+	while (layer && layer->IsFrozen())
+		layer = layer->NextLayer;
+
+	if (!layer)
+		throw std::runtime_error("Every layer of the model is frozen!");
+
+	return layer->BackPropagation(prefixOutput, costFunction, learningRate, t);
+}
+
+std::vector<std::shared_ptr<Layer>> Model::GetLayers() const
+{
+	std::vector<std::shared_ptr<Layer>> layers;
+	for (std::shared_ptr<Layer> layer = m_RootLayer; layer; layer = layer->NextLayer)
+		layers.push_back(layer);
+	return layers;
+}
+
+void Model::SetCheckpoints(const std::vector<size_t>& checkpoints)
+{
+	m_Checkpoints = checkpoints;
+	std::sort(m_Checkpoints.begin(), m_Checkpoints.end());
+	m_Checkpoints.erase(std::unique(m_Checkpoints.begin(), m_Checkpoints.end()), m_Checkpoints.end());
+	// The first segment always starts at the root.
+	if (!m_Checkpoints.empty() && m_Checkpoints.front() == 0)
+		m_Checkpoints.erase(m_Checkpoints.begin());
+}
+
+void Model::SetSquareRootCheckpoints()
+{
+	const size_t numLayers = GetLayers().size();
+	const size_t segmentSize = std::max(size_t(1), (size_t)std::ceil(std::sqrt((double)numLayers)));
+
+	std::vector<size_t> checkpoints;
+	for (size_t i = segmentSize; i < numLayers; i += segmentSize)
+		checkpoints.push_back(i);
+	SetCheckpoints(checkpoints);
+}
+
+// Restores a layer's next layer, when the segment's back propagation returns (or throws).
+struct SegmentCut
+{
+	SegmentCut(Layer* layer) : CutLayer(layer), Next(layer->NextLayer) { CutLayer->NextLayer = nullptr; }
+	~SegmentCut() { CutLayer->NextLayer = Next; }
+
+	Layer* CutLayer;
+	std::shared_ptr<Layer> Next;
+};
+
+Tensor3D Model::CheckpointedBackPropagation(const Tensor3D& inputs, const CostFunction& costFunction, float learningRate, size_t t)
+{
+	std::vector<std::shared_ptr<Layer>> layers = GetLayers();
+
+	std::vector<size_t> starts = { 0 };
+	for (size_t checkpoint : m_Checkpoints)
+	{
+		if (checkpoint < layers.size())
+			starts.push_back(checkpoint);
+	}
+	for (size_t i = 0; i < starts.back(); i++)
+	{
+		if (layers[i]->GetName() == DropoutLayer::ClassName())
+			throw std::runtime_error("Dropout layers are only supported in the last checkpointed segment!");
+	}
+
+	// The forward pass keeps only the inputs of the segments.
+	std::vector<Tensor3D> segmentInputs(starts.size());
+	for (size_t k = 0; k + 1 < starts.size(); k++)
+	{
+		Tensor3D output = layers[starts[k]]->FeedForward(k ? segmentInputs[k] : inputs);
+		for (size_t i = starts[k] + 1; i < starts[k + 1]; i++)
+			output = layers[i]->FeedForward(output);
+		segmentInputs[k + 1] = output;
+	}
+
+	// The last segment back propagates the cost, every other segment the gradient of the next segment's input.
+	Tensor3D outputGradient;
+	CostFunction boundary;
+	boundary.DiffCost = [&outputGradient](const Tensor3D&) { return outputGradient; };
+	for (size_t k = starts.size(); k-- > 0;)
+	{
+		const Tensor3D& segmentInput = k ? segmentInputs[k] : inputs;
+		if (k + 1 == starts.size())
+		{
+			outputGradient = layers[starts[k]]->BackPropagation(segmentInput, costFunction, learningRate, t);
+		}
+		else
+		{
+			SegmentCut cut(layers[starts[k + 1] - 1].get());
+			outputGradient = layers[starts[k]]->BackPropagation(segmentInput, boundary, learningRate, t);
+		}
+		// The next segment's input is not needed any more.
+		if (k)
+			segmentInputs[k] = Tensor3D();
+	}
+
+	return outputGradient;
+}
+
+static size_t GetActivationBytes(const Layer& layer)
+{
+	// A layer keeps its output alive, the activated layers also keep their sums for the activation's derivative
+	// (a convolutional layer with a ReLU keeps a bit per element).
+	LayerShape shape = layer.GetLayerShape();
+	const size_t size = shape.OutputRows * shape.OutputCols * shape.OutputDepth;
+	ActivationFunciton activation = layer.GetActivationFunction();
+	const bool isConvolution = layer.GetName() == ConvolutionalLayer::ClassName() || layer.GetName() == GroupedConvolutionalLayer::ClassName();
+	if (isConvolution && activation.Name == "RelU" && std::stof(activation.Params) >= 0.0f)
+		return size * sizeof(float) + (size + 63) / 64 * sizeof(uint64_t);
+	return activation.Name.empty() ? size * sizeof(float) : 2 * size * sizeof(float);
+}
+
+CheckpointReport Model::GetCheckpointReport() const
+{
+	std::vector<std::shared_ptr<Layer>> layers = GetLayers();
+	ModelShape shape = GetModelShape();
+	const size_t inputBytes = shape.InputRows * shape.InputCols * shape.InputDepth * sizeof(float);
+
+	CheckpointReport report = { inputBytes, inputBytes, layers.size(), 0 };
+	for (const std::shared_ptr<Layer>& layer : layers)
+		report.ActivationBytes += GetActivationBytes(*layer);
+
+	std::vector<size_t> starts = { 0 };
+	for (size_t checkpoint : m_Checkpoints)
+	{
+		if (checkpoint < layers.size())
+			starts.push_back(checkpoint);
+	}
+	starts.push_back(layers.size());
+
+	// Every segment's input is kept, the activations of one segment are alive at once.
+	size_t maxSegmentBytes = 0;
+	for (size_t k = 0; k + 1 < starts.size(); k++)
+	{
+		if (k)
+		{
+			LayerShape inputShape = layers[starts[k]]->GetLayerShape();
+			report.CheckpointedActivationBytes += inputShape.InputRows * inputShape.InputCols * inputShape.InputDepth * sizeof(float);
+		}
+		size_t segmentBytes = 0;
+		for (size_t i = starts[k]; i < starts[k + 1]; i++)
+			segmentBytes += GetActivationBytes(*layers[i]);
+		maxSegmentBytes = std::max(maxSegmentBytes, segmentBytes);
+
+		if (k + 2 < starts.size())
+			report.NumRecomputedLayers += starts[k + 1] - starts[k];
+	}
+	report.CheckpointedActivationBytes += maxSegmentBytes;
+
+	return report;
+}
+
 void Model::Save(const std::string& filePath) const
 {
 	assert(m_RootLayer != nullptr && "No layer available!");
@@ -192,6 +438,7 @@ void Model::Summarize() const
 	std::shared_ptr<Layer> layer = m_RootLayer;
 
 	size_t numLearnables = 0;
+	size_t numFrozenLearnables = 0;
 
 	while (layer)
 	{
@@ -200,6 +447,7 @@ void Model::Summarize() const
 		std::string special = layer->GetSepcialParams();
 		size_t learnables = layer->GetLearnableParams();
 		numLearnables += learnables;
+		numFrozenLearnables += layer->IsFrozen() ? learnables : 0;
 
 		std::cout << std::left;
 		std::cout << std::setw(28) << (layer->GetName() + ": ");
@@ -213,6 +461,21 @@ void Model::Summarize() const
 		layer = layer->NextLayer;
 	}
 	std::cout << "# Learnable parameters: " << numLearnables << std::endl;
+	if (numFrozenLearnables > 0)
+	{
+		std::cout << "# Frozen parameters: " << numFrozenLearnables << ", frozen prefix: " << GetFrozenPrefix() << " layers" << std::endl;
+	}
+	if (m_IsMixedPrecision)
+	{
+		std::cout << "Mixed precision training: bfloat16 forward pass, fp32 params" << std::endl;
+	}
+
+	if (!m_Checkpoints.empty())
+	{
+		CheckpointReport report = GetCheckpointReport();
+		std::cout << "Checkpointed activations: " << report.CheckpointedActivationBytes << " bytes (" << report.ActivationBytes << " bytes without checkpoints), " <<
+			"recomputed layers: " << report.NumRecomputedLayers << "/" << report.NumLayers << std::endl;
+	}
 
 }
 
@@ -15,6 +15,15 @@ struct ModelShape
 	size_t OutputRows, OutputCols, OutputDepth;
 };
 
+// The activations kept alive by a back propagation (estimated from the layers' shapes) and the cost of the recomputation.
+struct CheckpointReport
+{
+	size_t ActivationBytes;  // The peak without checkpoints.
+	size_t CheckpointedActivationBytes;  // The peak with the model's checkpoints.
+	size_t NumLayers;
+	size_t NumRecomputedLayers;  // The extra feed forwards of a step.
+};
+
 class LIBRARY_API Model
 {
 public:
@@ -29,7 +38,43 @@ public:
 
 	void InitializeOptimizer(OptimizerFactory optimizerFactory);
 	Tensor3D FeedForward(const Tensor3D& inputs) const;
+	// In FeedForward a ConvolutionalLayer followed by a MaxPoolingLayer is evaluated with one fused kernel (on by default).
+	inline void SetLayerFusion(bool isFusingLayers) { m_IsFusingLayers = isFusingLayers; }
 	Tensor3D BackPropagation(const Tensor3D& inputs, const CostFunction& costFunction, float learningRate, size_t t);
+	// bfloat16 mixed precision training of the model's layers (see Layer::SetMixedPrecision), applies to the layers added later too.
+	// Only BackPropagation is affected, FeedForward and the saved model stay fp32.
+	void SetMixedPrecision(bool isMixedPrecision);
+	inline bool IsMixedPrecision() const { return m_IsMixedPrecision; }
+	// Must be called after the params are written directly (not by the layers' optimizers), see Layer::MarkParamsChanged.
+	void MarkParamsChanged();
+
+	/*
+		Frozen layers are not trained: their params are not updated, their gradient is not calculated and they have no optimizer state
+		(they get the stateless SGD optimizer, also in InitializeOptimizer, call it after a layer is unfrozen). The frozen layers at the root
+		(the frozen prefix) are only fed forward in BackPropagation (it returns the gradient respect to the prefix's output), the prefix's output
+		can be cached and trained from with BackPropagationFromPrefix.
+	*/
+	void SetFrozen(size_t layerIndex, bool isFrozen);
+	// Freezes the first numLayers layers and unfreezes the others.
+	void FreezePrefix(size_t numLayers);
+	// The number of the frozen layers at the root.
+	size_t GetFrozenPrefix() const;
+	// The output of the frozen prefix (the input, if there is no frozen prefix).
+	Tensor3D FeedForwardPrefix(const Tensor3D& inputs) const;
+	// The back propagation of the layers after the frozen prefix, from the prefix's output. Returns the derivated cost respect to the prefix's output.
+	Tensor3D BackPropagationFromPrefix(const Tensor3D& prefixOutput, const CostFunction& costFunction, float learningRate, size_t t);
+
+	/*
+		Gradient checkpointing in BackPropagation. The layer chain is split into segments at the checkpoints (the indices of the segments' first layers),
+		the forward pass keeps only the segments' inputs, every segment's activations are recomputed in its own back propagation.
+		The result is the same as without checkpoints, the peak memory is about one segment's activations (see GetCheckpointReport).
+		Dropout layers are only supported in the last segment (their masks can not be recomputed). An empty list turns it off.
+	*/
+	void SetCheckpoints(const std::vector<size_t>& checkpoints);
+	// About sqrt(n) segments of sqrt(n) layers, call it after the layers are added.
+	void SetSquareRootCheckpoints();
+	inline const std::vector<size_t>& GetCheckpoints() const { return m_Checkpoints; }
+	CheckpointReport GetCheckpointReport() const;
 
 	void Save(const std::string& filePath) const;
 	void Load(const std::string& filePath);
@@ -41,8 +86,17 @@ public:
 	const std::shared_ptr<Layer>& GetLayer(size_t i);
 
 	inline const std::shared_ptr<Layer>& GetRootLayer() const { return m_RootLayer; }
+private:
+	// The feed forward of the first numLayers layers.
+	Tensor3D FeedForwardLayers(const Tensor3D& inputs, size_t numLayers) const;
+	Tensor3D CheckpointedBackPropagation(const Tensor3D& inputs, const CostFunction& costFunction, float learningRate, size_t t);
+	std::vector<std::shared_ptr<Layer>> GetLayers() const;
+
 private:
 	std::shared_ptr<Layer> m_RootLayer = nullptr;
+	bool m_IsFusingLayers = true;
+	bool m_IsMixedPrecision = false;
+	std::vector<size_t> m_Checkpoints;
 };
 
 namespace_end
\ No newline at end of file
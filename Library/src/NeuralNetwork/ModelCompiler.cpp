@@ -0,0 +1,270 @@
+#include "ModelCompiler.h"
+#include <assert.h>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <algorithm>
+#include <cctype>
+
+#include "DenseLayer.h"
+#include "ConvolutionalLayer.h"
+#include "MaxPoolingLayer.h"
+#include "NearestUpsamplingLayer.h"
+#include "SoftmaxLayer.h"
+#include "ReshapeLayer.h"
+#include "DropoutLayer.h"
+
+
+namespace_start
+
+static void WriteArray(std::stringstream& ss, const std::string& name, const float* data, size_t size)
+{
+	ss << "alignas(32) static const float " << name << "[" << size << "] =\n{";
+	for (size_t t = 0; t < size; t++)
+	{
+		ss << (t % 8 == 0 ? "\n\t" : " ") << data[t] << "f" << (t + 1 < size ? "," : "");
+	}
+	ss << "\n};\n\n";
+}
+
+static void WriteActivation(std::stringstream& ss, const std::string& name, const ActivationFunciton& activationFunction)
+{
+	ss << "static inline float " << name << "(float v) { return ";
+	if (activationFunction.Name == "sigmoid")
+	{
+		ss << "1.0f / (1.0f + std::exp(-v));";
+	}
+	else if (activationFunction.Name == "RelU")
+	{
+		float alpha = std::stof(activationFunction.Params);
+		if (alpha == 0.0f)
+			ss << "v > 0.0f ? v : 0.0f;";
+		else
+			ss << "v > 0.0f ? v : " << alpha << "f * v;";
+	}
+	else
+	{
+		throw std::runtime_error("The activation function can't be compiled: " + activationFunction.Name);
+	}
+	ss << " }\n\n";
+}
+
+static void WriteDense(std::stringstream& ss, const std::string& name, const DenseLayer& layer)
+{
+	const Tensor2D& weights = layer.GetWeights();
+	if (weights.IsOnDevice())
+		throw std::runtime_error("The model must be on the host.");
+
+	WriteArray(ss, name + "Weights", weights.GetData(), weights.GetSize());
+	WriteArray(ss, name + "Bias", layer.GetBias().GetData(), layer.GetBias().GetSize());
+	WriteActivation(ss, name + "Activation", layer.GetActivationFunction());
+
+	ss << "// DenseLayer: " << weights.GetCols() << " -> " << weights.GetRows() << "\n";
+	ss << "static void " << name << "(const float* input, float* output)\n{\n";
+	ss << "\tconstexpr int Inputs = " << weights.GetCols() << ", Outputs = " << weights.GetRows() << ";\n\n";
+	ss << "\tfor (int o = 0; o < Outputs; o++)\n\t{\n";
+	ss << "\t\tconst float* weights = " << name << "Weights + o * Inputs;\n";
+	ss << "\t\tfloat sum = 0.0f;\n";
+	ss << "\t\tfor (int i = 0; i < Inputs; i++)\n\t\t\tsum += weights[i] * input[i];\n";
+	ss << "\t\toutput[o] = " << name << "Activation(sum + " << name << "Bias[o]);\n";
+	ss << "\t}\n}\n\n";
+}
+
+static void WriteConvolutional(std::stringstream& ss, const std::string& name, const ConvolutionalLayer& layer)
+{
+	const Tensor3D& kernels = layer.GetKernels();
+	if (kernels.IsOnDevice())
+		throw std::runtime_error("The model must be on the host.");
+
+	LayerShape shape = layer.GetLayerShape();
+	WriteArray(ss, name + "Kernels", kernels.GetData(), kernels.GetSize());
+	if (layer.IsUseBias())
+		WriteArray(ss, name + "Bias", layer.GetBias().GetData(), layer.GetBias().GetSize());
+	WriteActivation(ss, name + "Activation", layer.GetActivationFunction());
+
+	ss << "// ConvolutionalLayer: (" << shape.InputRows << ", " << shape.InputCols << ", " << shape.InputDepth << ") -> (" <<
+		shape.OutputRows << ", " << shape.OutputCols << ", " << shape.OutputDepth << ")\n";
+	ss << "static void " << name << "(const float* input, float* output)\n{\n";
+	ss << "\tconstexpr int InputRows = " << shape.InputRows << ", InputCols = " << shape.InputCols << ", InputDepth = " << shape.InputDepth << ";\n";
+	ss << "\tconstexpr int OutputRows = " << shape.OutputRows << ", OutputCols = " << shape.OutputCols << ", OutputDepth = " << shape.OutputDepth << ";\n";
+	ss << "\tconstexpr int KernelRows = " << kernels.GetRows() << ", KernelCols = " << kernels.GetCols() << ", Padding = " << layer.GetPadding() << ", Stride = " << layer.GetStride() << ";\n\n";
+
+	ss << "\tfor (int t = 0; t < OutputRows * OutputCols * OutputDepth; t++)\n";
+	ss << "\t\toutput[t] = " << (layer.IsUseBias() ? name + "Bias[t]" : "0.0f") << ";\n\n";
+
+	// Every kernel weight is added to a rectangle of the output, the innermost loop runs over the (strided) input rows.
+	ss << "\tfor (int n = 0; n < OutputDepth; n++)\n";
+	ss << "\tfor (int d = 0; d < InputDepth; d++)\n";
+	ss << "\tfor (int ky = 0; ky < KernelRows; ky++)\n";
+	ss << "\tfor (int kx = 0; kx < KernelCols; kx++)\n\t{\n";
+	ss << "\t\tconst float weight = " << name << "Kernels[((n * InputDepth + d) * KernelRows + ky) * KernelCols + kx];\n";
+	ss << "\t\tconst int yStart = Padding - ky > 0 ? (Padding - ky + Stride - 1) / Stride : 0, yLast = (InputRows - 1 + Padding - ky) / Stride + 1, yEnd = yLast < OutputRows ? yLast : OutputRows;\n";
+	ss << "\t\tconst int xStart = Padding - kx > 0 ? (Padding - kx + Stride - 1) / Stride : 0, xLast = (InputCols - 1 + Padding - kx) / Stride + 1, xEnd = xLast < OutputCols ? xLast : OutputCols;\n";
+	ss << "\t\tfor (int y = yStart; y < yEnd; y++)\n\t\t{\n";
+	ss << "\t\t\tconst float* inputRow = input + (d * InputRows + y * Stride + ky - Padding) * InputCols + kx - Padding;\n";
+	ss << "\t\t\tfloat* outputRow = output + (n * OutputRows + y) * OutputCols;\n";
+	ss << "\t\t\tfor (int x = xStart; x < xEnd; x++)\n\t\t\t\toutputRow[x] += weight * inputRow[x * Stride];\n";
+	ss << "\t\t}\n\t}\n\n";
+
+	ss << "\tfor (int t = 0; t < OutputRows * OutputCols * OutputDepth; t++)\n";
+	ss << "\t\toutput[t] = " << name << "Activation(output[t]);\n";
+	ss << "}\n\n";
+}
+
+static void WriteMaxPooling(std::stringstream& ss, const std::string& name, const MaxPoolingLayer& layer)
+{
+	LayerShape shape = layer.GetLayerShape();
+
+	ss << "// MaxPoolingLayer: (" << shape.InputRows << ", " << shape.InputCols << ", " << shape.InputDepth << ") -> (" <<
+		shape.OutputRows << ", " << shape.OutputCols << ", " << shape.OutputDepth << ")\n";
+	ss << "static void " << name << "(const float* input, float* output)\n{\n";
+	ss << "\tconstexpr int InputRows = " << shape.InputRows << ", InputCols = " << shape.InputCols << ";\n";
+	ss << "\tconstexpr int OutputRows = " << shape.OutputRows << ", OutputCols = " << shape.OutputCols << ", Depth = " << shape.OutputDepth << ";\n";
+	ss << "\tconstexpr int PoolingRows = " << layer.GetPoolingHeight() << ", PoolingCols = " << layer.GetPoolingWidth() << ";\n\n";
+	ss << "\tfor (int d = 0; d < Depth; d++)\n";
+	ss << "\tfor (int r = 0; r < OutputRows; r++)\n";
+	ss << "\tfor (int c = 0; c < OutputCols; c++)\n\t{\n";
+	ss << "\t\tconst float* window = input + (d * InputRows + r * PoolingRows) * InputCols + c * PoolingCols;\n";
+	ss << "\t\tfloat maxValue = window[0];\n";
+	ss << "\t\tfor (int i = 0; i < PoolingRows; i++)\n";
+	ss << "\t\tfor (int j = 0; j < PoolingCols; j++)\n";
+	ss << "\t\t\tmaxValue = window[i * InputCols + j] > maxValue ? window[i * InputCols + j] : maxValue;\n";
+	ss << "\t\toutput[(d * OutputRows + r) * OutputCols + c] = maxValue;\n";
+	ss << "\t}\n}\n\n";
+}
+
+static void WriteNearestUpsampling(std::stringstream& ss, const std::string& name, const NearestUpsamplingLayer& layer)
+{
+	LayerShape shape = layer.GetLayerShape();
+
+	ss << "// NearestUpsamplingLayer: (" << shape.InputRows << ", " << shape.InputCols << ", " << shape.InputDepth << ") -> (" <<
+		shape.OutputRows << ", " << shape.OutputCols << ", " << shape.OutputDepth << ")\n";
+	ss << "static void " << name << "(const float* input, float* output)\n{\n";
+	ss << "\tconstexpr int InputRows = " << shape.InputRows << ", InputCols = " << shape.InputCols << ";\n";
+	ss << "\tconstexpr int OutputRows = " << shape.OutputRows << ", OutputCols = " << shape.OutputCols << ", Depth = " << shape.OutputDepth << ";\n";
+	ss << "\tconstexpr int ScaleRows = " << shape.OutputRows / shape.InputRows << ", ScaleCols = " << shape.OutputCols / shape.InputCols << ";\n\n";
+	ss << "\tfor (int d = 0; d < Depth; d++)\n";
+	ss << "\tfor (int r = 0; r < OutputRows; r++)\n";
+	ss << "\tfor (int c = 0; c < OutputCols; c++)\n";
+	ss << "\t\toutput[(d * OutputRows + r) * OutputCols + c] = input[(d * InputRows + r / ScaleRows) * InputCols + c / ScaleCols];\n";
+	ss << "}\n\n";
+}
+
+static void WriteSoftmax(std::stringstream& ss, const std::string& name, const SoftmaxLayer& layer)
+{
+	LayerShape shape = layer.GetLayerShape();
+
+	ss << "// SoftmaxLayer: " << shape.InputRows << "\n";
+	ss << "static void " << name << "(const float* input, float* output)\n{\n";
+	ss << "\tconstexpr int Size = " << shape.InputRows * shape.InputCols * shape.InputDepth << ";\n\n";
+	ss << "\tfloat maxValue = input[0];\n";
+	ss << "\tfor (int t = 1; t < Size; t++)\n\t\tmaxValue = input[t] > maxValue ? input[t] : maxValue;\n";
+	ss << "\tfloat sum = 0.0f;\n";
+	ss << "\tfor (int t = 0; t < Size; t++)\n\t{\n\t\toutput[t] = std::exp(input[t] - maxValue);\n\t\tsum += output[t];\n\t}\n";
+	ss << "\tfor (int t = 0; t < Size; t++)\n\t\toutput[t] /= sum;\n";
+	ss << "}\n\n";
+}
+
+
+ModelCompiler::ModelCompiler(const Model& model, const std::string& name)
+	: m_Model(model), m_Name(name)
+{
+	assert(m_Model.IsModelCorrect() && "Model is not defined correctly!");
+	assert(!m_Name.empty() && m_Name.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_") == std::string::npos &&
+		!std::isdigit((unsigned char)m_Name[0]) && "The name must be a C++ identifier!");
+}
+
+std::string ModelCompiler::GenerateHeader() const
+{
+	ModelShape shape = m_Model.GetModelShape();
+	std::stringstream ss;
+
+	ss << "#pragma once\n#include <cstddef>\n\n\n";
+	ss << "// Generated by mogi::ModelCompiler, the model's weights are compiled in.\n";
+	ss << "namespace " << m_Name << "\n{\n\n";
+	ss << "constexpr size_t InputRows = " << shape.InputRows << ", InputCols = " << shape.InputCols << ", InputDepth = " << shape.InputDepth << ";\n";
+	ss << "constexpr size_t OutputRows = " << shape.OutputRows << ", OutputCols = " << shape.OutputCols << ", OutputDepth = " << shape.OutputDepth << ";\n";
+	ss << "constexpr size_t InputSize = " << shape.InputRows * shape.InputCols * shape.InputDepth << ";\n";
+	ss << "constexpr size_t OutputSize = " << shape.OutputRows * shape.OutputCols * shape.OutputDepth << ";\n\n";
+	ss << "// Evaluates the model, the input and the output are in (depth, row, col) order.\n";
+	ss << "// The intermediates are static buffers: it does not allocate, but it is not thread safe.\n";
+	ss << "void Run(const float* input, float* output);\n\n";
+	ss << "}\n";
+
+	return ss.str();
+}
+
+std::string ModelCompiler::GenerateSource(const std::string& headerFileName) const
+{
+	std::stringstream ss;
+	ss << std::setprecision(std::numeric_limits<float>::max_digits10);
+
+	ss << "#include \"" << headerFileName << "\"\n#include <cmath>\n#include <cstring>\n\n\n";
+	ss << "namespace " << m_Name << "\n{\n\n";
+
+	// The layers write the two buffers in turn, the reshape and dropout layers are left out.
+	std::stringstream run;
+	std::string current = "input";
+	size_t maxSize = 0, numBuffersUsed = 0;
+
+	size_t index = 0;
+	for (std::shared_ptr<Layer> layer = m_Model.GetRootLayer(); layer; layer = layer->NextLayer, index++)
+	{
+		std::string name = layer->GetName();
+		std::string functionName = "Layer" + std::to_string(index);
+
+		if (name == ReshapeLayer::ClassName() || name == DropoutLayer::ClassName())
+			continue;
+		else if (name == DenseLayer::ClassName())
+			WriteDense(ss, functionName, *static_cast<const DenseLayer*>(layer.get()));
+		else if (name == ConvolutionalLayer::ClassName())
+			WriteConvolutional(ss, functionName, *static_cast<const ConvolutionalLayer*>(layer.get()));
+		else if (name == MaxPoolingLayer::ClassName())
+			WriteMaxPooling(ss, functionName, *static_cast<const MaxPoolingLayer*>(layer.get()));
+		else if (name == NearestUpsamplingLayer::ClassName())
+			WriteNearestUpsampling(ss, functionName, *static_cast<const NearestUpsamplingLayer*>(layer.get()));
+		else if (name == SoftmaxLayer::ClassName())
+			WriteSoftmax(ss, functionName, *static_cast<const SoftmaxLayer*>(layer.get()));
+		else
+			throw std::runtime_error("The layer can't be compiled: " + name);
+
+		LayerShape shape = layer->GetLayerShape();
+		maxSize = std::max(maxSize, shape.OutputRows * shape.OutputCols * shape.OutputDepth);
+
+		std::string next = (numBuffersUsed++ % 2 == 0) ? "Buffer0" : "Buffer1";
+		run << "\t" << functionName << "(" << current << ", " << next << ");\n";
+		current = next;
+	}
+
+	if (numBuffersUsed)
+	{
+		ss << "alignas(32) static float Buffer0[" << maxSize << "];\n";
+		if (numBuffersUsed > 1)
+			ss << "alignas(32) static float Buffer1[" << maxSize << "];\n";
+		ss << "\n";
+	}
+
+	ss << "void Run(const float* input, float* output)\n{\n";
+	ss << run.str();
+	ss << "\tstd::memcpy(output, " << current << ", OutputSize * sizeof(float));\n";
+	ss << "}\n\n";
+	ss << "}\n";
+
+	return ss.str();
+}
+
+void ModelCompiler::Compile(const std::string& basePath) const
+{
+	std::string headerFileName = basePath.substr(basePath.find_last_of("/\\") + 1) + ".h";
+
+	std::ofstream header(basePath + ".h");
+	std::ofstream source(basePath + ".cpp");
+	if (!header.is_open() || !source.is_open())
+		throw std::runtime_error("Could not open file: " + basePath);
+
+	header << GenerateHeader();
+	source << GenerateSource(headerFileName);
+}
+
+namespace_end
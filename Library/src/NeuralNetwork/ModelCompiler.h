@@ -0,0 +1,37 @@
+#pragma once
+#include <string>
+
+#include "Core.h"
+#include "Model.h"
+
+
+namespace_start
+
+/*
+	Ahead of time compilation of a model to C++ source, which does not depend on the library.
+	Every shape, padding and activation of the generated code is a compile time constant, the weights are aligned static arrays,
+	the intermediates are two static buffers, so an inference has no allocation (and is not thread safe).
+
+	The generated header declares the model's namespace with the shapes and Run(input, output),
+	the input and the output are in the tensors' memory order (depth, row, col).
+	Supported layers: DenseLayer, ConvolutionalLayer, MaxPoolingLayer, NearestUpsamplingLayer, SoftmaxLayer, ReshapeLayer and DropoutLayer.
+
+	The model must outlive the compiler.
+*/
+class LIBRARY_API ModelCompiler
+{
+public:
+	// name: the namespace of the generated code, a C++ identifier.
+	ModelCompiler(const Model& model, const std::string& name);
+
+	std::string GenerateHeader() const;
+	std::string GenerateSource(const std::string& headerFileName) const;
+	// Writes basePath.h and basePath.cpp.
+	void Compile(const std::string& basePath) const;
+
+private:
+	const Model& m_Model;
+	std::string m_Name;
+};
+
+namespace_end
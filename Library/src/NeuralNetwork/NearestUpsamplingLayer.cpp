@@ -31,6 +31,16 @@ Tensor3D NearestUpsamplingLayer::FeedForward(const Tensor3D& inputs)
 	return output;
 }
 
+void NearestUpsamplingLayer::Infer(const Tensor3D& inputs, Tensor3D& output) const
+{
+	assert(m_InputHeight == inputs.GetRows() &&
+		m_InputWidth == inputs.GetCols() &&
+		m_InputDepth == inputs.GetDepth()
+		&& "Input shape not match!");
+
+	NearestUpsample(output, inputs, m_UpsamplingHeight, m_UpsamplingWidth);
+}
+
 Tensor3D NearestUpsamplingLayer::BackPropagation(const Tensor3D& inputs, const CostFunction& costFucntion, float learningRate, size_t t)
 {
 	assert(m_InputHeight == inputs.GetRows() &&
@@ -44,7 +54,7 @@ Tensor3D NearestUpsamplingLayer::BackPropagation(const Tensor3D& inputs, const C
 
 	Tensor3D costs = NextLayer ?
 								NextLayer->BackPropagation(output, costFucntion, learningRate, t) :
-								output;
+								costFucntion.DiffCost(output);
 
 	assert(layerShape.OutputRows == costs.GetRows() &&
 		layerShape.OutputCols == costs.GetCols() &&
@@ -1,10 +1,27 @@
 #include "Optimizer.h"
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+
+#if defined(SIMD_F16C)
+#include <immintrin.h>
+#endif
 
 #include <MogiAccelerator.h>
 
+#include <future>
+#include "../ThreadPool.h"
+
 
 namespace_start
 
+void Optimizer::UpdateOuterProduct(Tensor* params, const Tensor2D& left, const Tensor2D& right, float learningRate)
+{
+	Tensor2D gradient = MatrixMultRightTranspose(left, right);
+	Update(params, &gradient, learningRate);
+}
+
 void SGDOptimizer::Update(Tensor* params, Tensor* gradient, float learningRate)
 {
 	if (params->IsOnDevice() && gradient->IsOnDevice())
@@ -22,6 +39,26 @@ void SGDOptimizer::Update(Tensor* params, Tensor* gradient, float learningRate)
 	}
 }
 
+void SGDOptimizer::UpdateOuterProduct(Tensor* params, const Tensor2D& left, const Tensor2D& right, float learningRate)
+{
+	if (params->IsOnDevice() || left.IsOnDevice() || right.IsOnDevice())
+	{
+		Optimizer::UpdateOuterProduct(params, left, right, learningRate);
+		return;
+	}
+
+	assert(params->GetSize() == left.GetRows() * right.GetRows() && "Params and gradient sizes not match!");
+
+	float* paramsData = params->GetData();
+	OuterProductTiles(left, right, [paramsData, learningRate](size_t index, const float* tile, size_t size) {
+		float* p = paramsData + index;
+		for (size_t i = 0; i < size; i++)
+		{
+			p[i] -= learningRate * tile[i];
+		}
+	});
+}
+
 std::string SGDOptimizer::ToString() const
 {
 	std::stringstream ss;
@@ -74,6 +111,42 @@ void AdamOptimizer::Update(Tensor* params, Tensor* gradient, float learningRate)
 	m_TrainingTimeStep++;
 }
 
+void AdamOptimizer::UpdateOuterProduct(Tensor* params, const Tensor2D& left, const Tensor2D& right, float learningRate)
+{
+	if (params->IsOnDevice() || left.IsOnDevice() || right.IsOnDevice())
+	{
+		Optimizer::UpdateOuterProduct(params, left, right, learningRate);
+		return;
+	}
+
+	assert(params->GetSize() == left.GetRows() * right.GetRows() && "Params and gradient sizes not match!");
+	assert(params->GetSize() == m_FirstMoments.GetSize() && "Params and moments sizes not match!");
+
+	const float b1 = 0.9f;
+	const float b2 = 0.999f;
+	const float ep = 0.0000001f;
+	const float firstCorrection = 1.0f / (1.0f - pow(b1, m_TrainingTimeStep));
+	const float secondCorrection = 1.0f / (1.0f - pow(b2, m_TrainingTimeStep));
+
+	float* paramsData = params->GetData();
+	float* firstMoments = m_FirstMoments.GetData();
+	float* secondMoments = m_SecondMoments.GetData();
+	OuterProductTiles(left, right, [=](size_t index, const float* tile, size_t size) {
+		float* p = paramsData + index;
+		float* m = firstMoments + index;
+		float* v = secondMoments + index;
+		for (size_t i = 0; i < size; i++)
+		{
+			float g = tile[i];
+			m[i] = b1 * m[i] + (1.0f - b1) * g;
+			v[i] = b2 * v[i] + (1.0f - b2) * g * g;
+			p[i] -= learningRate * (m[i] * firstCorrection) / (sqrt(v[i] * secondCorrection) + ep);
+		}
+	});
+
+	m_TrainingTimeStep++;
+}
+
 std::string AdamOptimizer::ToString() const
 {
 	std::stringstream ss;
@@ -98,4 +171,384 @@ void AdamOptimizer::FromString(const std::string& fromString)
 		ss >> m_SecondMoments.GetData()[t];
 };
 
+
+// The 256 sorted values of the dynamic map: 7 decades (10^-6 .. 1), the i-th decade has 2^i (signed) or 2^(i + 1) (unsigned) linear
+// fractions between 0.1 and 1 (the midpoints of the fraction's intervals), plus 0 and 1.
+static std::vector<float> CreateDynamicMap(bool isSigned)
+{
+	const int numDecades = 7;
+	std::vector<float> map;
+	for (int i = 0; i < numDecades; i++)
+	{
+		const size_t numFractions = (size_t)1 << (isSigned ? i : i + 1);
+		const float decade = (float)pow(10.0, i - (numDecades - 1));
+		for (size_t f = 0; f < numFractions; f++)
+		{
+			float fraction = 0.1f + 0.9f * ((float)f + 0.5f) / (float)numFractions;
+			map.push_back(decade * fraction);
+			if (isSigned)
+				map.push_back(-decade * fraction);
+		}
+	}
+	map.push_back(0.0f);
+	map.push_back(1.0f);
+	assert(map.size() == 256 && "Invalid dynamic map size!");
+
+	std::sort(map.begin(), map.end());
+	return map;
+}
+
+static const std::vector<float>& GetDynamicMap(bool isSigned)
+{
+	static const std::vector<float> signedMap = CreateDynamicMap(true);
+	static const std::vector<float> unsignedMap = CreateDynamicMap(false);
+	return isSigned ? signedMap : unsignedMap;
+}
+
+// The code of the nearest value of the map.
+static uint8_t QuantizeDynamic(const std::vector<float>& map, float value)
+{
+	size_t upper = std::lower_bound(map.begin(), map.end(), value) - map.begin();
+	if (upper == 0)
+		return 0;
+	if (upper == map.size())
+		return (uint8_t)(map.size() - 1);
+	return (uint8_t)(value - map[upper - 1] <= map[upper] - value ? upper - 1 : upper);
+}
+
+static uint16_t FloatToHalf(float value)
+{
+#if defined(SIMD_F16C)
+	return _cvtss_sh(value, 0);
+#else
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	const uint32_t sign = (bits >> 16) & 0x8000;
+	const uint32_t magnitude = bits & 0x7FFFFFFF;
+	if (magnitude >= 0x47800000)  // Overflow, infinity or NaN.
+		return (uint16_t)(sign | (magnitude > 0x7F800000 ? 0x7E00 : 0x7C00));
+	if (magnitude < 0x38800000)  // A subnormal half: the multiple of 2^-24, rounded to the nearest even.
+	{
+		float absolute;
+		memcpy(&absolute, &magnitude, sizeof(absolute));
+		return (uint16_t)(sign | (uint32_t)std::nearbyint(absolute * 16777216.0f));
+	}
+	const uint32_t rounded = magnitude + 0xFFF + ((magnitude >> 13) & 1);
+	return (uint16_t)(sign | ((rounded - 0x38000000) >> 13));
+#endif
+}
+
+static float HalfToFloat(uint16_t value)
+{
+#if defined(SIMD_F16C)
+	return _cvtsh_ss(value);
+#else
+	const uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+	const uint32_t exponent = (value >> 10) & 0x1F;
+	const uint32_t mantissa = value & 0x3FF;
+	if (exponent == 0)
+	{
+		float result = (float)mantissa / 16777216.0f;
+		return sign ? -result : result;
+	}
+	uint32_t bits = sign | (exponent == 31 ? 0x7F800000 | (mantissa << 13) : ((exponent + 112) << 23) | (mantissa << 13));
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+#endif
+}
+
+static const char* Base64Alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static std::string EncodeBase64(const uint8_t* data, size_t size)
+{
+	std::string result;
+	result.reserve((size + 2) / 3 * 4);
+	for (size_t i = 0; i < size; i += 3)
+	{
+		uint32_t group = (uint32_t)data[i] << 16;
+		if (i + 1 < size) group |= (uint32_t)data[i + 1] << 8;
+		if (i + 2 < size) group |= data[i + 2];
+
+		result += Base64Alphabet[(group >> 18) & 63];
+		result += Base64Alphabet[(group >> 12) & 63];
+		result += i + 1 < size ? Base64Alphabet[(group >> 6) & 63] : '=';
+		result += i + 2 < size ? Base64Alphabet[group & 63] : '=';
+	}
+	return result;
+}
+
+static void DecodeBase64(const std::string& text, uint8_t* data, size_t size)
+{
+	if (text.size() != (size + 2) / 3 * 4)
+		throw std::runtime_error("Invalid base64 data size!");
+
+	auto decode = [](char c) -> uint32_t {
+		const char* position = strchr(Base64Alphabet, c);
+		if (c == '=' || c == '\0' || !position)
+			return 0;
+		return (uint32_t)(position - Base64Alphabet);
+	};
+
+	for (size_t i = 0, j = 0; i < size; i += 3, j += 4)
+	{
+		uint32_t group = (decode(text[j]) << 18) | (decode(text[j + 1]) << 12) | (decode(text[j + 2]) << 6) | decode(text[j + 3]);
+		data[i] = (uint8_t)(group >> 16);
+		if (i + 1 < size) data[i + 1] = (uint8_t)(group >> 8);
+		if (i + 2 < size) data[i + 2] = (uint8_t)group;
+	}
+}
+
+QuantizedAdamOptimizer::QuantizedAdamOptimizer(size_t numParams, bool isHalf) : m_IsHalf(isHalf), m_TrainingTimeStep(1), m_NumParams(numParams)
+{
+	const size_t numBlocks = (numParams + BlockSize - 1) / BlockSize;
+	const size_t bytesPerValue = isHalf ? 2 : 1;
+	const uint8_t zeroCode = QuantizeDynamic(GetDynamicMap(true), 0.0f);
+
+	// A zero moment is zero in both formats (with a zero scale), the codes are set for clarity.
+	m_FirstMoments.assign(numParams * bytesPerValue, isHalf ? 0 : zeroCode);
+	m_SecondMoments.assign(numParams * bytesPerValue, 0);
+	m_FirstScales.assign(numBlocks, 0.0f);
+	m_SecondScales.assign(numBlocks, 0.0f);
+}
+
+void QuantizedAdamOptimizer::UpdateBlock(float* params, const float* gradient, size_t block, size_t size, float learningRate, float firstCorrection, float secondCorrection)
+{
+	const float b1 = 0.9f;
+	const float b2 = 0.999f;
+	const float ep = 0.0000001f;
+	const size_t start = block * BlockSize;
+	const std::vector<float>& signedMap = GetDynamicMap(true);
+	const std::vector<float>& unsignedMap = GetDynamicMap(false);
+
+	float m[BlockSize], v[BlockSize];
+	const float firstScale = m_FirstScales[block];
+	const float secondScale = m_SecondScales[block];
+	if (m_IsHalf)
+	{
+		const uint16_t* firstMoments = (const uint16_t*)m_FirstMoments.data() + start;
+		const uint16_t* secondMoments = (const uint16_t*)m_SecondMoments.data() + start;
+		for (size_t i = 0; i < size; i++)
+		{
+			m[i] = HalfToFloat(firstMoments[i]) * firstScale;
+			v[i] = HalfToFloat(secondMoments[i]) * secondScale;
+		}
+	}
+	else
+	{
+		const uint8_t* firstMoments = m_FirstMoments.data() + start;
+		const uint8_t* secondMoments = m_SecondMoments.data() + start;
+		for (size_t i = 0; i < size; i++)
+		{
+			m[i] = signedMap[firstMoments[i]] * firstScale;
+			v[i] = unsignedMap[secondMoments[i]] * secondScale;
+		}
+	}
+
+	float firstMax = 0.0f, secondMax = 0.0f;
+	for (size_t i = 0; i < size; i++)
+	{
+		float g = gradient[i];
+		m[i] = b1 * m[i] + (1.0f - b1) * g;
+		v[i] = b2 * v[i] + (1.0f - b2) * g * g;
+		params[i] -= learningRate * (m[i] * firstCorrection) / (sqrt(v[i] * secondCorrection) + ep);
+
+		firstMax = std::max(firstMax, std::abs(m[i]));
+		secondMax = std::max(secondMax, v[i]);
+	}
+
+	m_FirstScales[block] = firstMax;
+	m_SecondScales[block] = secondMax;
+	const float firstInverse = firstMax > 0.0f ? 1.0f / firstMax : 0.0f;
+	const float secondInverse = secondMax > 0.0f ? 1.0f / secondMax : 0.0f;
+	if (m_IsHalf)
+	{
+		uint16_t* firstMoments = (uint16_t*)m_FirstMoments.data() + start;
+		uint16_t* secondMoments = (uint16_t*)m_SecondMoments.data() + start;
+		for (size_t i = 0; i < size; i++)
+		{
+			firstMoments[i] = FloatToHalf(m[i] * firstInverse);
+			secondMoments[i] = FloatToHalf(v[i] * secondInverse);
+		}
+	}
+	else
+	{
+		uint8_t* firstMoments = m_FirstMoments.data() + start;
+		uint8_t* secondMoments = m_SecondMoments.data() + start;
+		for (size_t i = 0; i < size; i++)
+		{
+			firstMoments[i] = QuantizeDynamic(signedMap, m[i] * firstInverse);
+			secondMoments[i] = QuantizeDynamic(unsignedMap, v[i] * secondInverse);
+		}
+	}
+}
+
+void QuantizedAdamOptimizer::UpdateBlocks(Tensor* params, const std::function<void(size_t start, size_t size, float* gradient)>& blockGradient, float learningRate)
+{
+	if (params->IsOnDevice())
+		throw std::runtime_error("The quantized adam optimizer is host only.");
+	assert(params->GetSize() == m_NumParams && "Params and moments sizes not match!");
+
+	const float firstCorrection = 1.0f / (1.0f - pow(0.9f, m_TrainingTimeStep));
+	const float secondCorrection = 1.0f / (1.0f - pow(0.999f, m_TrainingTimeStep));
+	const size_t numBlocks = m_FirstScales.size();
+
+	// The blocks are independent, a thread updates a range of them.
+	auto updateRange = [&](size_t startBlock, size_t endBlock) {
+		float blockParams[BlockSize], gradient[BlockSize];
+		for (size_t block = startBlock; block < endBlock; block++)
+		{
+			const size_t start = block * BlockSize;
+			const size_t size = std::min(BlockSize, m_NumParams - start);
+			for (size_t i = 0; i < size; i++)
+				blockParams[i] = params->GetData()[params->TraverseTo(start + i)];
+			blockGradient(start, size, gradient);
+
+			UpdateBlock(blockParams, gradient, block, size, learningRate, firstCorrection, secondCorrection);
+
+			for (size_t i = 0; i < size; i++)
+				params->GetData()[params->TraverseTo(start + i)] = blockParams[i];
+		}
+	};
+
+#ifdef ASYNC
+	ThreadPool* pool = ThreadPool::GetInstance();
+	size_t numThreads = std::max(size_t(1), std::min((size_t)pool->GetNumThreads(), numBlocks));
+	size_t blocksPerThread = numBlocks / numThreads;
+	size_t extraBlocks = numBlocks % numThreads;
+
+	std::vector<std::future<void>> tasks;
+	size_t startBlock = 0;
+	for (size_t i = 0; i < numThreads; i++)
+	{
+		size_t endBlock = startBlock + blocksPerThread + (i < extraBlocks ? 1 : 0);
+		tasks.emplace_back(pool->enqueue(updateRange, startBlock, endBlock));
+		startBlock = endBlock;
+	}
+
+	for (auto& task : tasks) {
+		task.get();
+	}
+#else
+	updateRange(0, numBlocks);
+#endif // ASYNC
+
+	m_TrainingTimeStep++;
+}
+
+void QuantizedAdamOptimizer::Update(Tensor* params, Tensor* gradient, float learningRate)
+{
+	if (gradient->IsOnDevice())
+		throw std::runtime_error("The quantized adam optimizer is host only.");
+	assert(params->GetSize() == gradient->GetSize() && "Params and gradient sizes not match!");
+
+	UpdateBlocks(params, [gradient](size_t start, size_t size, float* blockGradient) {
+		for (size_t i = 0; i < size; i++)
+			blockGradient[i] = gradient->GetData()[gradient->TraverseTo(start + i)];
+	}, learningRate);
+}
+
+void QuantizedAdamOptimizer::UpdateOuterProduct(Tensor* params, const Tensor2D& left, const Tensor2D& right, float learningRate)
+{
+	if (left.IsOnDevice() || right.IsOnDevice())
+		throw std::runtime_error("The quantized adam optimizer is host only.");
+	assert(params->GetSize() == left.GetRows() * right.GetRows() && "Params and gradient sizes not match!");
+
+	const size_t cols = right.GetRows();
+	const size_t batch = left.GetCols();
+	UpdateBlocks(params, [&left, &right, cols, batch](size_t start, size_t size, float* blockGradient) {
+		for (size_t i = 0; i < size; i++)
+		{
+			const size_t r = (start + i) / cols;
+			const size_t c = (start + i) % cols;
+			float sum = 0.0f;
+			for (size_t b = 0; b < batch; b++)
+				sum += left.GetData()[left.CalculateIndex(r, b)] * right.GetData()[right.CalculateIndex(c, b)];
+			blockGradient[i] = sum;
+		}
+	}, learningRate);
+}
+
+size_t QuantizedAdamOptimizer::GetStateBytes() const
+{
+	return m_FirstMoments.size() + m_SecondMoments.size() + (m_FirstScales.size() + m_SecondScales.size()) * sizeof(float);
+}
+
+std::string QuantizedAdamOptimizer::ToString() const
+{
+	std::stringstream ss;
+	ss << m_TrainingTimeStep << " " << m_NumParams << " ";
+	ss << EncodeBase64(m_FirstMoments.data(), m_FirstMoments.size()) << " ";
+	ss << EncodeBase64((const uint8_t*)m_FirstScales.data(), m_FirstScales.size() * sizeof(float)) << " ";
+	ss << EncodeBase64(m_SecondMoments.data(), m_SecondMoments.size()) << " ";
+	ss << EncodeBase64((const uint8_t*)m_SecondScales.data(), m_SecondScales.size() * sizeof(float)) << " ";
+	return ss.str();
+}
+
+void QuantizedAdamOptimizer::FromString(const std::string& fromString)
+{
+	std::stringstream ss(fromString);
+	ss >> m_TrainingTimeStep >> m_NumParams;
+	const size_t numBlocks = (m_NumParams + BlockSize - 1) / BlockSize;
+	const size_t bytesPerValue = m_IsHalf ? 2 : 1;
+	m_FirstMoments.resize(m_NumParams * bytesPerValue);
+	m_SecondMoments.resize(m_NumParams * bytesPerValue);
+	m_FirstScales.resize(numBlocks);
+	m_SecondScales.resize(numBlocks);
+
+	std::string firstMoments, firstScales, secondMoments, secondScales;
+	ss >> firstMoments >> firstScales >> secondMoments >> secondScales;
+	DecodeBase64(firstMoments, m_FirstMoments.data(), m_FirstMoments.size());
+	DecodeBase64(firstScales, (uint8_t*)m_FirstScales.data(), m_FirstScales.size() * sizeof(float));
+	DecodeBase64(secondMoments, m_SecondMoments.data(), m_SecondMoments.size());
+	DecodeBase64(secondScales, (uint8_t*)m_SecondScales.data(), m_SecondScales.size() * sizeof(float));
+}
+
+
+void AccumulatorOptimizer::Update(Tensor* /*params*/, Tensor* gradient, float /*learningRate*/)
+{
+	assert(gradient->GetSize() == m_Gradient.GetSize() && "Params and gradient sizes not match!");
+	if (gradient->IsOnDevice() != m_Gradient.IsOnDevice())
+		throw std::runtime_error("The gradient and the accumulator are not on the same device.");
+
+	if (m_Gradient.IsOnDevice())
+		m_Gradient.Add(*gradient);
+	else
+		m_Gradient.ElementWise(*gradient, [](float sum, float g) -> float { return sum + g; });
+}
+
+void AccumulatorOptimizer::UpdateOuterProduct(Tensor* params, const Tensor2D& left, const Tensor2D& right, float learningRate)
+{
+	if (left.IsOnDevice() || right.IsOnDevice())
+	{
+		Optimizer::UpdateOuterProduct(params, left, right, learningRate);
+		return;
+	}
+	assert(m_Gradient.GetSize() == left.GetRows() * right.GetRows() && "Params and gradient sizes not match!");
+
+	float* gradientData = m_Gradient.GetData();
+	OuterProductTiles(left, right, [gradientData](size_t index, const float* tile, size_t size) {
+		float* g = gradientData + index;
+		for (size_t i = 0; i < size; i++)
+		{
+			g[i] += tile[i];
+		}
+	});
+}
+
+std::string AccumulatorOptimizer::ToString() const
+{
+	std::stringstream ss;
+	ss << GetName() << " ";
+	return ss.str();
+}
+
+void AccumulatorOptimizer::Reset()
+{
+	if (m_Gradient.IsOnDevice())
+		m_Gradient.Mult(0.0f);
+	else
+		std::fill(m_Gradient.GetData(), m_Gradient.GetData() + m_Gradient.GetSize(), 0.0f);
+}
+
 namespace_end
\ No newline at end of file
@@ -2,7 +2,11 @@
 #include <sstream>
 #include <math.h>
 #include <memory>
+#include <functional>
 #include <string>
+#include <vector>
+#include <stdint.h>
+#include <stdexcept>
 
 #include "Core.h"
 #include "../Math/Tensor2D.h"
@@ -14,7 +18,7 @@ namespace_start
 enum OptimizerType
 {
 	None=-1,
-	SGD, Adam,
+	SGD, Adam, Accumulator, Adam8Bit, AdamHalf,
 };
 
 
@@ -24,6 +28,10 @@ public:
 	virtual ~Optimizer() { }
 
 	virtual void Update(Tensor* params, Tensor* gradient, float learningRate) = 0;
+	// Updates the params with the outer product gradient (left x right^T). By default the gradient is materialized and passed to Update.
+	virtual void UpdateOuterProduct(Tensor* params, const Tensor2D& left, const Tensor2D& right, float learningRate);
+	// False when the updates only collect the gradient, the params are not changed.
+	virtual bool IsChangingParams() const { return true; }
 
 	virtual std::string GetName() const = 0;
 	virtual std::string ToString() const = 0;
@@ -43,6 +51,8 @@ public:
 	static std::string ClassName() { return "SGDOptimizer"; }
 
 	virtual void Update(Tensor* params, Tensor* gradient, float learningRate) override;
+	// Applies the gradient tiles straight to the params.
+	virtual void UpdateOuterProduct(Tensor* params, const Tensor2D& left, const Tensor2D& right, float learningRate) override;
 	virtual std::string ToString() const override;
 	virtual void FromString(const std::string& fromString) override { }
 
@@ -60,6 +70,8 @@ public:
 	static std::string ClassName() { return "AdamOptimizer"; }
 
 	virtual void Update(Tensor* params, Tensor* gradient, float learningRate) override;
+	// Updates the moments and the params from the gradient tiles as they are calculated.
+	virtual void UpdateOuterProduct(Tensor* params, const Tensor2D& left, const Tensor2D& right, float learningRate) override;
 	virtual std::string ToString() const override;
 	virtual void FromString(const std::string& fromString) override;
 
@@ -72,6 +84,95 @@ private:
 };
 
 
+/*
+	Adam with quantized moments. The moments are stored in blocks of BlockSize values, every block is scaled by its largest magnitude
+	and its values are stored as 8 bit codes of a dynamic map (Adam8BitOptimizer) or as fp16 values (AdamHalfOptimizer).
+	The dynamic map has a decimal exponent and a linear fraction, so both the small and the large values of a block keep about
+	the same relative precision. An update dequantizes, updates and quantizes a block of the moments in one pass, along with the params.
+	The moments are saved in base64. Host only.
+*/
+class QuantizedAdamOptimizer : public Optimizer
+{
+public:
+	static const size_t BlockSize = 256;
+
+	virtual void Update(Tensor* params, Tensor* gradient, float learningRate) override;
+	// The gradient of a block is calculated from the outer product, when the block is updated.
+	virtual void UpdateOuterProduct(Tensor* params, const Tensor2D& left, const Tensor2D& right, float learningRate) override;
+	virtual std::string ToString() const override;
+	virtual void FromString(const std::string& fromString) override;
+
+	virtual void ToHost() override { }
+	virtual void ToDevice() override { throw std::runtime_error("The quantized adam optimizer is host only."); }
+
+	// The bytes of the moments and their scales.
+	size_t GetStateBytes() const;
+protected:
+	QuantizedAdamOptimizer(size_t numParams, bool isHalf);
+	QuantizedAdamOptimizer(bool isHalf) : m_IsHalf(isHalf), m_TrainingTimeStep(1), m_NumParams(0) { }
+
+private:
+	// Updates a block of the params (size values from the block's start) from its gradient.
+	void UpdateBlock(float* params, const float* gradient, size_t block, size_t size, float learningRate, float firstCorrection, float secondCorrection);
+	// One step on every block, blockGradient writes the gradient of the values from start.
+	void UpdateBlocks(Tensor* params, const std::function<void(size_t start, size_t size, float* gradient)>& blockGradient, float learningRate);
+
+private:
+	bool m_IsHalf;
+	size_t m_TrainingTimeStep;
+	size_t m_NumParams;
+	std::vector<uint8_t> m_FirstMoments, m_SecondMoments;  // 1 (8 bit codes) or 2 (fp16) bytes per value.
+	std::vector<float> m_FirstScales, m_SecondScales;
+};
+
+class Adam8BitOptimizer : public QuantizedAdamOptimizer
+{
+public:
+	Adam8BitOptimizer(size_t numParams) : QuantizedAdamOptimizer(numParams, false) { }
+	Adam8BitOptimizer(const std::string& fromString) : QuantizedAdamOptimizer(false) { FromString(fromString); }
+	virtual std::string GetName() const override { return "Adam8BitOptimizer"; }
+	static std::string ClassName() { return "Adam8BitOptimizer"; }
+};
+
+class AdamHalfOptimizer : public QuantizedAdamOptimizer
+{
+public:
+	AdamHalfOptimizer(size_t numParams) : QuantizedAdamOptimizer(numParams, true) { }
+	AdamHalfOptimizer(const std::string& fromString) : QuantizedAdamOptimizer(true) { FromString(fromString); }
+	virtual std::string GetName() const override { return "AdamHalfOptimizer"; }
+	static std::string ClassName() { return "AdamHalfOptimizer"; }
+};
+
+
+/*
+	Sums the gradients instead of updating the params (the learning rate is ignored), so a layer's back propagation
+	only computes its gradient. Used by the replicas of the data parallel training (see DataParallelModel).
+	On the device the outer product gradients are materialized before they are summed.
+*/
+class AccumulatorOptimizer : public Optimizer
+{
+public:
+	AccumulatorOptimizer(size_t numParams) : m_Gradient(numParams, 1) { }
+	virtual std::string GetName() const override { return "AccumulatorOptimizer"; }
+	static std::string ClassName() { return "AccumulatorOptimizer"; }
+
+	virtual void Update(Tensor* params, Tensor* gradient, float learningRate) override;
+	virtual void UpdateOuterProduct(Tensor* params, const Tensor2D& left, const Tensor2D& right, float learningRate) override;
+	virtual bool IsChangingParams() const override { return false; }
+	virtual std::string ToString() const override;
+	virtual void FromString(const std::string& fromString) override { }
+
+	virtual void ToHost() override { m_Gradient.ToHost(); }
+	virtual void ToDevice() override { m_Gradient.ToDevice(); }
+
+	// The sum of the gradients since the last reset.
+	inline Tensor2D& GetGradient() { return m_Gradient; }
+	LIBRARY_API void Reset();
+private:
+	Tensor2D m_Gradient;
+};
+
+
 class OptimizerFactory
 {
 public:
@@ -88,6 +189,8 @@ public:
 
 		if (name == SGDOptimizer::ClassName())		return std::make_unique<SGDOptimizer>(remaining);
 		if (name == AdamOptimizer::ClassName())		return std::make_unique<AdamOptimizer>(remaining);
+		if (name == Adam8BitOptimizer::ClassName())	return std::make_unique<Adam8BitOptimizer>(remaining);
+		if (name == AdamHalfOptimizer::ClassName())	return std::make_unique<AdamHalfOptimizer>(remaining);
 
 		throw std::exception("Unknown optimizer type!");
 	}
@@ -98,6 +201,9 @@ public:
 		{
 		case OptimizerType::SGD:			return std::make_unique<SGDOptimizer>(numParams);
 		case OptimizerType::Adam:			return std::make_unique<AdamOptimizer>(numParams);
+		case OptimizerType::Accumulator:	return std::make_unique<AccumulatorOptimizer>(numParams);
+		case OptimizerType::Adam8Bit:		return std::make_unique<Adam8BitOptimizer>(numParams);
+		case OptimizerType::AdamHalf:		return std::make_unique<AdamHalfOptimizer>(numParams);
 		default:
 			break;
 		}
@@ -0,0 +1,387 @@
+#include "PipelineModel.h"
+#include <assert.h>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+#include "DropoutLayer.h"
+#include "../Math/Operation.h"
+
+
+namespace_start
+
+static double GetSeconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+double PipelineStats::GetBubbleFraction() const
+{
+	if (Time <= 0.0 || StageTimes.empty())
+		return 0.0;
+
+	double busyTime = 0.0;
+	for (double stageTime : StageTimes)
+		busyTime += stageTime;
+	return std::max(0.0, 1.0 - busyTime / (Time * StageTimes.size()));
+}
+
+PipelineModel::PipelineModel(Model& model, size_t numStages, size_t numMeasurements)
+	: m_Model(model)
+{
+	assert(numStages > 0 && "At least one stage is needed!");
+	assert(m_Model.IsModelCorrect() && "Model is not defined correctly!");
+
+	std::vector<std::shared_ptr<Layer>> layers;
+	for (std::shared_ptr<Layer> layer = m_Model.GetRootLayer(); layer; layer = layer->NextLayer)
+	{
+		for (const LearnableTensor& tensor : layer->GetLearnableTensors())
+		{
+			if (!tensor.ParamsOptimizer)
+				throw std::runtime_error("No optimizer for the pipeline!");
+			if (tensor.Params->IsOnDevice())
+				throw std::runtime_error("The model must be on the host.");
+			m_Tensors.push_back(tensor);
+		}
+		m_HasDropout = m_HasDropout || layer->GetName() == DropoutLayer::ClassName();
+		layers.push_back(layer);
+	}
+
+	// The cost of a layer is its fastest feed forward on a random sample.
+	ModelShape shape = m_Model.GetModelShape();
+	Tensor3D input = Random3D(shape.InputRows, shape.InputCols, shape.InputDepth, 0.0f, 1.0f);
+	for (const std::shared_ptr<Layer>& layer : layers)
+	{
+		double cost = std::numeric_limits<double>::max();
+		Tensor3D output;
+		for (size_t i = 0; i < std::max(numMeasurements, size_t(1)); i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			output = layer->FeedForward(input);
+			cost = std::min(cost, GetSeconds(start));
+		}
+		m_LayerCosts.push_back(cost);
+		input = output;
+	}
+
+	Partition(std::min(numStages, layers.size()));
+
+	for (size_t s = 0; s + 1 < m_StageBoundaries.size(); s++)
+	{
+		std::unique_ptr<Stage> stage = std::make_unique<Stage>();
+		for (size_t l = m_StageBoundaries[s]; l < m_StageBoundaries[s + 1]; l++)
+		{
+			stage->StageModel.AddLayer(layers[l]->GetName(), layers[l]->ToString());
+		}
+		stage->StageModel.SetMixedPrecision(m_Model.IsMixedPrecision());
+		stage->StageModel.InitializeOptimizer(OptimizerFactory(OptimizerType::Accumulator));
+		size_t layerIndex = m_StageBoundaries[s];
+		for (std::shared_ptr<Layer> layer = stage->StageModel.GetRootLayer(); layer; layer = layer->NextLayer, layerIndex++)
+		{
+			layer->SetFrozen(layers[layerIndex]->IsFrozen());
+		}
+
+		for (std::shared_ptr<Layer> layer = stage->StageModel.GetRootLayer(); layer; layer = layer->NextLayer)
+		{
+			for (const LearnableTensor& tensor : layer->GetLearnableTensors())
+			{
+				stage->Tensors.push_back(tensor);
+				stage->Accumulators.push_back(static_cast<AccumulatorOptimizer*>(tensor.ParamsOptimizer));
+			}
+		}
+		m_Stages.push_back(std::move(stage));
+	}
+	m_Stats.StageTimes.resize(m_Stages.size(), 0.0);
+
+	for (size_t s = 0; s < m_Stages.size(); s++)
+	{
+		m_Workers.emplace_back(&PipelineModel::Work, this, s);
+	}
+}
+
+PipelineModel::~PipelineModel()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_TaskMutex);
+		m_IsStopping = true;
+	}
+	m_TaskCondition.notify_all();
+
+	for (std::thread& worker : m_Workers)
+	{
+		worker.join();
+	}
+}
+
+void PipelineModel::Partition(size_t numStages)
+{
+	// Contiguous stages minimizing the cost of the slowest stage: minCost[k][i] is the best for the first i layers in k stages.
+	const size_t numLayers = m_LayerCosts.size();
+	std::vector<double> prefix(numLayers + 1, 0.0);
+	for (size_t i = 0; i < numLayers; i++)
+		prefix[i + 1] = prefix[i] + m_LayerCosts[i];
+
+	const double infinity = std::numeric_limits<double>::max();
+	std::vector<std::vector<double>> minCost(numStages + 1, std::vector<double>(numLayers + 1, infinity));
+	std::vector<std::vector<size_t>> split(numStages + 1, std::vector<size_t>(numLayers + 1, 0));
+	minCost[0][0] = 0.0;
+	for (size_t k = 1; k <= numStages; k++)
+	{
+		for (size_t i = k; i <= numLayers; i++)
+		{
+			for (size_t j = k - 1; j < i; j++)
+			{
+				if (minCost[k - 1][j] == infinity)
+					continue;
+				const double cost = std::max(minCost[k - 1][j], prefix[i] - prefix[j]);
+				if (cost < minCost[k][i])
+				{
+					minCost[k][i] = cost;
+					split[k][i] = j;
+				}
+			}
+		}
+	}
+
+	m_StageBoundaries.assign(numStages + 1, numLayers);
+	for (size_t k = numStages, i = numLayers; k > 0; k--)
+	{
+		i = split[k][i];
+		m_StageBoundaries[k - 1] = i;
+	}
+}
+
+void PipelineModel::Synchronize()
+{
+	size_t j = 0;
+	for (const std::unique_ptr<Stage>& stage : m_Stages)
+	{
+		for (const LearnableTensor& tensor : stage->Tensors)
+		{
+			const Tensor* params = m_Tensors[j++].Params;
+			std::copy(params->GetData(), params->GetData() + params->GetSize(), tensor.Params->GetData());
+		}
+		stage->StageModel.MarkParamsChanged();
+	}
+	assert(j == m_Tensors.size() && "The stages do not match the model!");
+}
+
+void PipelineModel::Work(size_t worker)
+{
+	size_t taskId = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_TaskMutex);
+			m_TaskCondition.wait(lock, [this, taskId] { return m_IsStopping || m_TaskId != taskId; });
+			if (m_IsStopping)
+				return;
+			taskId = m_TaskId;
+		}
+
+		std::exception_ptr exception;
+		try
+		{
+			m_Task(worker);
+		}
+		catch (...)
+		{
+			exception = std::current_exception();
+		}
+
+		std::unique_lock<std::mutex> lock(m_TaskMutex);
+		if (exception && !m_TaskException)
+			m_TaskException = exception;
+		if (--m_NumPending == 0)
+			m_DoneCondition.notify_one();
+	}
+}
+
+void PipelineModel::RunOnWorkers(const std::function<void(size_t stage)>& task)
+{
+	auto start = std::chrono::steady_clock::now();
+	{
+		std::unique_lock<std::mutex> lock(m_TaskMutex);
+		m_Task = task;
+		m_NumPending = m_Workers.size();
+		m_TaskException = nullptr;
+		m_TaskId++;
+		m_TaskCondition.notify_all();
+
+		m_DoneCondition.wait(lock, [this] { return m_NumPending == 0; });
+		if (m_TaskException)
+			std::rethrow_exception(m_TaskException);
+	}
+	m_Stats.Time += GetSeconds(start);
+	for (size_t s = 0; s < m_Stages.size(); s++)
+	{
+		m_Stats.StageTimes[s] += m_Stages[s]->Time;
+	}
+}
+
+void PipelineModel::PrepareQueues(size_t numSamples)
+{
+	// A queue holds every sample of a call, a stage never waits for a full queue (the backward pass starts before the forward pass ends).
+	for (size_t s = 0; s < m_Stages.size(); s++)
+	{
+		Stage& stage = *m_Stages[s];
+		if (s > 0 && (!stage.ForwardQueue || stage.ForwardQueue->GetCapacity() < numSamples))
+			stage.ForwardQueue = std::make_unique<SPSCQueue<size_t>>(numSamples);
+		if (s + 1 < m_Stages.size() && (!stage.BackwardQueue || stage.BackwardQueue->GetCapacity() < numSamples))
+			stage.BackwardQueue = std::make_unique<SPSCQueue<size_t>>(numSamples);
+		stage.Inputs.resize(s > 0 ? numSamples : 0);
+		stage.Gradients.resize(s + 1 < m_Stages.size() ? numSamples : 0);
+		stage.Time = 0.0;
+		stage.Cost = 0.0f;
+	}
+}
+
+std::vector<Tensor3D> PipelineModel::FeedForward(const std::vector<Tensor3D>& inputs)
+{
+	const size_t numSamples = inputs.size();
+	const size_t numStages = m_Stages.size();
+	std::vector<Tensor3D> outputs(numSamples);
+	Synchronize();  // The last training step updated the model's params, not the stages'.
+	PrepareQueues(numSamples);
+
+	RunOnWorkers([this, &inputs, &outputs, numSamples, numStages](size_t s) {
+		Stage& stage = *m_Stages[s];
+		for (size_t m = 0; m < numSamples; m++)
+		{
+			const size_t i = s > 0 ? stage.ForwardQueue->Pop() : m;
+			auto start = std::chrono::steady_clock::now();
+
+			Tensor3D output = stage.StageModel.FeedForward(s > 0 ? stage.Inputs[i] : inputs[i]);
+			if (s + 1 < numStages)
+				m_Stages[s + 1]->Inputs[i] = output;
+			else
+				outputs[i] = output;
+
+			stage.Time += GetSeconds(start);
+			if (s + 1 < numStages)
+				m_Stages[s + 1]->ForwardQueue->Push(i);
+		}
+	});
+
+	return outputs;
+}
+
+float PipelineModel::TrainBatch(const std::vector<Tensor3D>& inputs, const std::vector<Tensor3D>& labels, const Loss& loss, float learningRate, size_t t)
+{
+	assert(inputs.size() && inputs.size() == labels.size() && "Invalid batch!");
+	if (m_HasDropout)
+		throw std::runtime_error("The pipeline can not train dropout layers.");
+
+	const size_t numSamples = inputs.size();
+	const size_t numStages = m_Stages.size();
+	Synchronize();
+	PrepareQueues(numSamples);
+	Loss stageLoss(loss);
+
+	RunOnWorkers([this, &inputs, &labels, &stageLoss, numSamples, numStages, learningRate, t](size_t s) {
+		Stage& stage = *m_Stages[s];
+		for (AccumulatorOptimizer* accumulator : stage.Accumulators)
+			accumulator->Reset();
+
+		auto getInput = [&stage, &inputs, s](size_t i) -> const Tensor3D& { return s > 0 ? stage.Inputs[i] : inputs[i]; };
+		auto sendGradient = [this, s](size_t i, const Tensor3D& gradient) {
+			if (s == 0)
+				return;
+			m_Stages[s - 1]->Gradients[i] = gradient;
+			m_Stages[s - 1]->BackwardQueue->Push(i);
+		};
+
+		// The model skips the back propagation of a frozen prefix, only the first stage's input gradient is not needed.
+		auto backPropagate = [&stage, s, learningRate, t](const Tensor3D& input, const CostFunction& costFunction) {
+			return s > 0 ? stage.StageModel.GetRootLayer()->BackPropagation(input, costFunction, learningRate, t) :
+				stage.StageModel.BackPropagation(input, costFunction, learningRate, t);
+		};
+
+		if (s + 1 == numStages)
+		{
+			// The last stage back propagates a sample as soon as it arrives.
+			for (size_t m = 0; m < numSamples; m++)
+			{
+				const size_t i = s > 0 ? stage.ForwardQueue->Pop() : m;
+				auto start = std::chrono::steady_clock::now();
+				Tensor3D gradient = backPropagate(getInput(i), stageLoss.Bind(labels[i]));
+				stage.Cost += stageLoss.GetLastCost();
+				stage.Time += GetSeconds(start);
+				sendGradient(i, gradient);
+			}
+			return;
+		}
+
+		for (size_t m = 0; m < numSamples; m++)
+		{
+			const size_t i = s > 0 ? stage.ForwardQueue->Pop() : m;
+			auto start = std::chrono::steady_clock::now();
+			m_Stages[s + 1]->Inputs[i] = stage.StageModel.FeedForward(getInput(i));
+			stage.Time += GetSeconds(start);
+			m_Stages[s + 1]->ForwardQueue->Push(i);
+		}
+
+		// The derivative of the stage's output is the gradient from the next stage.
+		const Tensor3D* outputGradient = nullptr;
+		CostFunction boundary;
+		boundary.DiffCost = [&outputGradient](const Tensor3D&) { return *outputGradient; };
+		for (size_t m = 0; m < numSamples; m++)
+		{
+			const size_t i = stage.BackwardQueue->Pop();
+			auto start = std::chrono::steady_clock::now();
+			outputGradient = &stage.Gradients[i];
+			Tensor3D gradient = backPropagate(getInput(i), boundary);
+			stage.Time += GetSeconds(start);
+			sendGradient(i, gradient);
+		}
+	});
+
+	const float scale = 1.0f / numSamples;
+	size_t j = 0;
+	for (const std::unique_ptr<Stage>& stage : m_Stages)
+	{
+		for (AccumulatorOptimizer* accumulator : stage->Accumulators)
+		{
+			Tensor2D& gradient = accumulator->GetGradient();
+			for (size_t i = 0; i < gradient.GetSize(); i++)
+				gradient.GetData()[i] *= scale;
+			m_Tensors[j].ParamsOptimizer->Update(m_Tensors[j].Params, &gradient, learningRate);
+			j++;
+		}
+	}
+	m_Model.MarkParamsChanged();
+
+	return m_Stages.back()->Cost * scale;
+}
+
+void PipelineModel::ResetStats()
+{
+	m_Stats.Time = 0.0;
+	std::fill(m_Stats.StageTimes.begin(), m_Stats.StageTimes.end(), 0.0);
+}
+
+void PipelineModel::Summarize() const
+{
+	for (size_t s = 0; s < m_Stages.size(); s++)
+	{
+		double cost = 0.0;
+		std::string layers;
+		for (std::shared_ptr<Layer> layer = m_Stages[s]->StageModel.GetRootLayer(); layer; layer = layer->NextLayer)
+			layers += (layers.size() ? ", " : "") + layer->GetName();
+		for (size_t l = m_StageBoundaries[s]; l < m_StageBoundaries[s + 1]; l++)
+			cost += m_LayerCosts[l];
+
+		std::cout << std::left;
+		std::cout << std::setw(12) << ("Stage " + std::to_string(s) + ": ");
+		std::cout << std::setw(28) << ("Measured cost: " + std::to_string(cost * 1e3) + " [ms], ");
+		std::cout << std::setw(24) << ("Utilization: " + std::to_string(m_Stats.GetUtilization(s)) + ", ");
+		std::cout << "Layers: " << layers;
+		std::cout << std::endl << std::right;
+	}
+	std::cout << "Bubble fraction: " << m_Stats.GetBubbleFraction() << std::endl;
+}
+
+namespace_end
@@ -0,0 +1,114 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+#include "Core.h"
+#include "Model.h"
+#include "CostF.h"
+#include "../SPSCQueue.h"
+
+
+namespace_start
+
+// The busy time of every stage and the wall time of the pipeline's calls, in seconds.
+struct LIBRARY_API PipelineStats
+{
+	std::vector<double> StageTimes;
+	double Time = 0.0;
+
+	inline double GetUtilization(size_t stage) const { return Time > 0.0 ? StageTimes[stage] / Time : 0.0; }
+	// The idle part of the stages' time (the pipeline's fill and drain, and the imbalance of the stages).
+	double GetBubbleFraction() const;
+};
+
+/*
+	Pipeline parallel execution of a model: the layer chain is partitioned into numStages contiguous stages, balanced by the measured
+	feed forward time of the layers, and every stage runs on its own thread. The samples (the microbatches) stream through the stages
+	in single producer single consumer queues, so the stages work on different samples at the same time.
+
+	Training is GPipe like: every stage feeds forward every sample of the batch, keeping only its inputs, than the gradients flow back
+	through the stages in the same order. A stage recomputes its activations in the backward pass (its layers' back propagation), the
+	gradient of the next stage is passed to it as the cost function's derivative. The stages accumulate the gradient, one optimizer
+	step is applied to the model's params with the mean gradient of the batch.
+
+	The stages are copies of the model's layers: the params are copied at construction and before every feed forward and training step.
+	The model must have its optimizers initialized, must be on the host and must outlive the pipeline.
+	Dropout layers are not supported in training (the forward pass of the stages is the inference).
+*/
+class LIBRARY_API PipelineModel
+{
+public:
+	// numMeasurements: the number of timed feed forwards of every layer, the fastest is the layer's cost.
+	PipelineModel(Model& model, size_t numStages, size_t numMeasurements=3);
+	~PipelineModel();
+
+	PipelineModel(const PipelineModel&) = delete;
+	PipelineModel& operator=(const PipelineModel&) = delete;
+
+	std::vector<Tensor3D> FeedForward(const std::vector<Tensor3D>& inputs);
+	// One optimizer step with the mean gradient of the batch. Returns the mean cost of the samples.
+	float TrainBatch(const std::vector<Tensor3D>& inputs, const std::vector<Tensor3D>& labels, const Loss& loss, float learningRate, size_t t);
+
+	// Copies the model's params to the stages.
+	void Synchronize();
+
+	inline size_t GetNumStages() const { return m_Stages.size(); }
+	// The index of every stage's first layer, followed by the number of layers.
+	inline const std::vector<size_t>& GetStageBoundaries() const { return m_StageBoundaries; }
+	// The measured feed forward time of every layer in seconds.
+	inline const std::vector<double>& GetLayerCosts() const { return m_LayerCosts; }
+
+	// The stats of the calls since the construction or the last reset.
+	inline const PipelineStats& GetStats() const { return m_Stats; }
+	void ResetStats();
+	// Prints the stages with their cost and utilization, and the bubble fraction.
+	void Summarize() const;
+
+private:
+	void Work(size_t worker);
+	// Runs the task on every stage's thread (with the stage's index) and waits for them.
+	void RunOnWorkers(const std::function<void(size_t stage)>& task);
+	void PrepareQueues(size_t numSamples);
+	void Partition(size_t numStages);
+
+private:
+	struct Stage
+	{
+		Model StageModel;
+		std::vector<LearnableTensor> Tensors;
+		std::vector<AccumulatorOptimizer*> Accumulators;
+		// The stage's input of every sample (its activation checkpoint), the gradient of its output from the next stage.
+		std::vector<Tensor3D> Inputs;
+		std::vector<Tensor3D> Gradients;
+		// From the previous stage (the indices of the samples, whose inputs are ready), from the next stage (the gradients).
+		std::unique_ptr<SPSCQueue<size_t>> ForwardQueue;
+		std::unique_ptr<SPSCQueue<size_t>> BackwardQueue;
+		double Time = 0.0;
+		float Cost = 0.0f;
+	};
+
+	Model& m_Model;
+	std::vector<LearnableTensor> m_Tensors;
+	std::vector<double> m_LayerCosts;
+	std::vector<size_t> m_StageBoundaries;
+	std::vector<std::unique_ptr<Stage>> m_Stages;
+	bool m_HasDropout = false;
+	PipelineStats m_Stats;
+
+	std::vector<std::thread> m_Workers;
+	std::mutex m_TaskMutex;
+	std::condition_variable m_TaskCondition;
+	std::condition_variable m_DoneCondition;
+	std::function<void(size_t stage)> m_Task;
+	size_t m_TaskId = 0;
+	size_t m_NumPending = 0;
+	std::exception_ptr m_TaskException;
+	bool m_IsStopping = false;
+};
+
+namespace_end
@@ -0,0 +1,727 @@
+#include "QuantizedModel.h"
+#include <assert.h>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+
+#include "DenseLayer.h"
+#include "ConvolutionalLayer.h"
+#include "MaxPoolingLayer.h"
+#include "ReshapeLayer.h"
+#include "DropoutLayer.h"
+#include "../Math/Operation.h"
+
+#ifdef ASYNC
+#include <future>
+#include "../ThreadPool.h"
+#endif
+
+
+namespace_start
+
+static const int32_t QuantizedMax = 127;
+
+// Runs function(start, end) over [0, count) split between the threads of the pool.
+template<typename Function>
+static void ParallelFor(size_t count, const Function& function)
+{
+#ifdef ASYNC
+	ThreadPool* pool = ThreadPool::GetInstance();
+	size_t numThreads = (size_t)pool->GetNumThreads();
+	size_t countPerThread = count / numThreads;
+	size_t extraCount = count % numThreads;
+
+	std::vector<std::future<void>> threads;
+	size_t start = 0;
+	for (size_t i = 0; i < numThreads; i++)
+	{
+		size_t end = start + countPerThread + (i < extraCount ? 1 : 0);
+		if (end > start)
+		{
+			threads.emplace_back(
+				pool->enqueue([&function, start, end]() { function(start, end); })
+			);
+		}
+		start = end;
+	}
+
+	for (auto& thread : threads) {
+		thread.get();
+	}
+#else
+	function(0, count);
+#endif
+}
+
+// Symmetric int8 quantization of every channel (a row of channelSize values), the sums are for the zero point correction.
+static void QuantizeChannels(const float* values, size_t numChannels, size_t channelSize,
+	std::vector<int8_t>& quantized, std::vector<float>& scales, std::vector<int32_t>& sums)
+{
+	quantized.resize(numChannels * channelSize);
+	scales.resize(numChannels);
+	sums.resize(numChannels);
+
+	for (size_t c = 0; c < numChannels; c++)
+	{
+		const float* channel = values + c * channelSize;
+		float maxAbs = 0.0f;
+		for (size_t i = 0; i < channelSize; i++)
+		{
+			maxAbs = std::max(maxAbs, std::abs(channel[i]));
+		}
+
+		scales[c] = maxAbs > 0.0f ? maxAbs / 127.0f : 1.0f;
+		int32_t sum = 0;
+		for (size_t i = 0; i < channelSize; i++)
+		{
+			int32_t q = (int32_t)std::lrint(channel[i] / scales[c]);
+			q = std::min(std::max(q, -127), 127);
+			quantized[c * channelSize + i] = (int8_t)q;
+			sum += q;
+		}
+		sums[c] = sum;
+	}
+}
+
+static void UpdateChannelSums(const std::vector<int8_t>& quantized, size_t channelSize, std::vector<int32_t>& sums)
+{
+	sums.assign(quantized.size() / channelSize, 0);
+	for (size_t i = 0; i < quantized.size(); i++)
+	{
+		sums[i / channelSize] += quantized[i];
+	}
+}
+
+static std::ostream& WriteParams(std::ostream& os, const QuantizationParams& params)
+{
+	return os << std::setprecision(std::numeric_limits<float>::max_digits10) << params.Scale << " " << params.ZeroPoint;
+}
+
+static std::shared_ptr<Layer> CreateLayer(const std::string& layerName, const std::string& layerFromData)
+{
+	Model model;
+	model.AddLayer(layerName, layerFromData);
+	return model.GetRootLayer();
+}
+
+
+QuantizationParams QuantizationParams::FromRange(float min, float max)
+{
+	min = std::min(min, 0.0f);
+	max = std::max(max, 0.0f);
+
+	QuantizationParams params;
+	if (max - min <= std::numeric_limits<float>::min())
+		return params;
+
+	params.Scale = (max - min) / QuantizedMax;
+	params.ZeroPoint = std::min(std::max((int32_t)std::lrint(-min / params.Scale), 0), QuantizedMax);
+	return params;
+}
+
+uint8_t QuantizationParams::Quantize(float value) const
+{
+	int32_t q = (int32_t)std::lrint(value / Scale) + ZeroPoint;
+	return (uint8_t)std::min(std::max(q, 0), QuantizedMax);
+}
+
+
+void QuantizedActivation::SetValuesShape(size_t rows, size_t cols, size_t depth)
+{
+	if (Values.GetRows() != rows || Values.GetCols() != cols || Values.GetDepth() != depth)
+		Values = Tensor3D(rows, cols, depth);
+
+	Rows = rows; Cols = cols; Depth = depth;
+	IsQuantized = false;
+}
+
+void QuantizedActivation::SetDataShape(size_t rows, size_t cols, size_t depth, const QuantizationParams& params)
+{
+	Data.resize(rows * cols * depth);
+	Rows = rows; Cols = cols; Depth = depth;
+	Params = params;
+	IsQuantized = true;
+}
+
+const uint8_t* QuantizedActivation::GetQuantized(const QuantizationParams& params, std::vector<uint8_t>& buffer) const
+{
+	if (IsQuantized)
+		return Data.data();
+
+	const float* values = Values.GetData();
+	buffer.resize(Values.GetSize());
+	for (size_t i = 0; i < buffer.size(); i++)
+	{
+		buffer[i] = params.Quantize(values[i]);
+	}
+	return buffer.data();
+}
+
+Tensor3D QuantizedActivation::ToTensor() const
+{
+	if (!IsQuantized)
+		return Values;
+
+	Tensor3D tensor(Rows, Cols, Depth);
+	for (size_t i = 0; i < Data.size(); i++)
+	{
+		tensor.GetData()[i] = Params.Dequantize(Data[i]);
+	}
+	return tensor;
+}
+
+
+QuantizedDenseLayer::QuantizedDenseLayer(const DenseLayer& layer, const QuantizationParams& inputParams, const QuantizationParams& outputParams)
+	: m_InputNodes(layer.GetWeights().GetCols()), m_OutputNodes(layer.GetWeights().GetRows()),
+	m_ActivationFunction(layer.GetActivationFunction()), m_InputParams(inputParams), m_OutputParams(outputParams)
+{
+	if (layer.GetWeights().IsOnDevice())
+		throw std::runtime_error("Quantization is only implemented on the host.");
+
+	QuantizeChannels(layer.GetWeights().GetData(), m_OutputNodes, m_InputNodes, m_Weights, m_Scales, m_WeightSums);
+	m_Bias.assign(layer.GetBias().GetData(), layer.GetBias().GetData() + m_OutputNodes);
+}
+
+QuantizedDenseLayer::QuantizedDenseLayer(const std::string& fromString)
+{
+	FromString(fromString);
+}
+
+void QuantizedDenseLayer::Infer(const QuantizedActivation& input, QuantizedActivation& output) const
+{
+	assert(input.Rows * input.Cols * input.Depth == m_InputNodes && "Invalid input shape!");
+
+	std::vector<uint8_t> buffer;
+	const uint8_t* inputs = input.GetQuantized(m_InputParams, buffer);
+	const QuantizationParams& inputParams = input.IsQuantized ? input.Params : m_InputParams;
+
+	if (m_IsQuantizingOutput)
+		output.SetDataShape(m_OutputNodes, 1, 1, m_OutputParams);
+	else
+		output.SetValuesShape(m_OutputNodes, 1, 1);
+
+	ParallelFor(m_OutputNodes, [&](size_t startRow, size_t endRow)
+	{
+		for (size_t r = startRow; r < endRow; r++)
+		{
+			int32_t sum = DotProductU8S8(inputs, m_Weights.data() + r * m_InputNodes, m_InputNodes) - inputParams.ZeroPoint * m_WeightSums[r];
+			float value = m_ActivationFunction.Activation(sum * (inputParams.Scale * m_Scales[r]) + m_Bias[r]);
+
+			if (m_IsQuantizingOutput)
+				output.Data[r] = m_OutputParams.Quantize(value);
+			else
+				output.Values.GetData()[r] = value;
+		}
+	});
+}
+
+std::string QuantizedDenseLayer::ToString() const
+{
+	std::stringstream ss;
+
+	ss << "[ " <<
+		m_InputNodes << " " << m_OutputNodes << " " <<
+		m_ActivationFunction.Name << " ( " << m_ActivationFunction.Params << " ) ";
+	WriteParams(ss, m_InputParams) << " ";
+	WriteParams(ss, m_OutputParams) <<
+	" ]";
+
+	for (size_t t = 0; t < m_Scales.size(); t++)
+	{
+		ss << " " << m_Scales[t];
+	}
+	for (size_t t = 0; t < m_Weights.size(); t++)
+	{
+		ss << " " << (int)m_Weights[t];
+	}
+	for (size_t t = 0; t < m_Bias.size(); t++)
+	{
+		ss << " " << m_Bias[t];
+	}
+
+	return ss.str();
+}
+
+void QuantizedDenseLayer::FromString(const std::string& data)
+{
+	std::size_t numsStartPos = data.find(']');
+	assert(data[0] == '[' && numsStartPos != std::string::npos && "Invalid hyperparameter format.");
+	numsStartPos += 1;
+
+	std::string hyperparams = data.substr(1, numsStartPos - 2);
+	std::size_t acivationParamsStart = hyperparams.find('(');
+	std::size_t acivationParamsEnd = hyperparams.find(')');
+	assert(acivationParamsStart != std::string::npos && acivationParamsEnd != std::string::npos && "Invalid activation function params format.");
+
+	std::stringstream ss(hyperparams);
+
+	std::string activationFStr;
+	std::string activationFParamsStr = hyperparams.substr(acivationParamsStart + 2, acivationParamsEnd - acivationParamsStart - 3);
+	ss >> m_InputNodes;
+	ss >> m_OutputNodes;
+	ss >> activationFStr;
+	m_ActivationFunction = GetActivationFunctionByName(activationFStr, activationFParamsStr);
+
+	std::stringstream qss(hyperparams.substr(acivationParamsEnd + 1));
+	qss >> m_InputParams.Scale >> m_InputParams.ZeroPoint;
+	qss >> m_OutputParams.Scale >> m_OutputParams.ZeroPoint;
+
+	m_Scales.resize(m_OutputNodes);
+	m_Weights.resize(m_OutputNodes * m_InputNodes);
+	m_Bias.resize(m_OutputNodes);
+
+	std::istringstream iss(data.substr(numsStartPos));
+
+	for (size_t i = 0; i < m_Scales.size(); i++)
+	{
+		iss >> m_Scales[i];
+	}
+	for (size_t i = 0; i < m_Weights.size(); i++)
+	{
+		int value;
+		iss >> value;
+		m_Weights[i] = (int8_t)value;
+	}
+	for (size_t i = 0; i < m_Bias.size(); i++)
+	{
+		iss >> m_Bias[i];
+	}
+
+	UpdateChannelSums(m_Weights, m_InputNodes, m_WeightSums);
+}
+
+
+QuantizedConvolutionalLayer::QuantizedConvolutionalLayer(const ConvolutionalLayer& layer, const QuantizationParams& inputParams, const QuantizationParams& outputParams)
+	: m_KernelHeight(layer.GetKernels().GetRows()), m_KernelWidth(layer.GetKernels().GetCols()), m_NumKernels(layer.GetNumKernels()),
+	m_Padding(layer.GetPadding()), m_Stride(layer.GetStride()), m_IsUseBias(layer.IsUseBias()),
+	m_ActivationFunction(layer.GetActivationFunction()), m_InputParams(inputParams), m_OutputParams(outputParams)
+{
+	if (layer.GetKernels().IsOnDevice())
+		throw std::runtime_error("Quantization is only implemented on the host.");
+
+	LayerShape shape = layer.GetLayerShape();
+	m_InputHeight = shape.InputRows;
+	m_InputWidth = shape.InputCols;
+	m_InputDepth = shape.InputDepth;
+
+	// The kernel of an output channel is the depth slices n * d ... n * d + d - 1, they are contiguous.
+	QuantizeChannels(layer.GetKernels().GetData(), m_NumKernels, m_InputDepth * m_KernelHeight * m_KernelWidth, m_Kernels, m_Scales, m_KernelSums);
+	if (m_IsUseBias)
+		m_Bias.assign(layer.GetBias().GetData(), layer.GetBias().GetData() + layer.GetBias().GetSize());
+}
+
+QuantizedConvolutionalLayer::QuantizedConvolutionalLayer(const std::string& fromString)
+{
+	FromString(fromString);
+}
+
+void QuantizedConvolutionalLayer::Infer(const QuantizedActivation& input, QuantizedActivation& output) const
+{
+	assert(input.Rows == m_InputHeight && input.Cols == m_InputWidth && input.Depth == m_InputDepth && "Invalid input shape!");
+
+	std::vector<uint8_t> buffer;
+	const uint8_t* inputs = input.GetQuantized(m_InputParams, buffer);
+	const QuantizationParams& inputParams = input.IsQuantized ? input.Params : m_InputParams;
+
+	LayerShape shape = GetLayerShape();
+	const size_t outputRows = shape.OutputRows;
+	const size_t outputCols = shape.OutputCols;
+	const size_t outputSliceSize = outputRows * outputCols;
+	const size_t patchSize = m_InputDepth * m_KernelHeight * m_KernelWidth;
+
+	if (m_IsQuantizingOutput)
+		output.SetDataShape(outputRows, outputCols, m_NumKernels, m_OutputParams);
+	else
+		output.SetValuesShape(outputRows, outputCols, m_NumKernels);
+
+	// Every output position's patch in (d, ky, kx) order, which is the kernel's order.
+	std::vector<uint8_t> patches(outputSliceSize * patchSize);
+	ParallelFor(outputRows, [&](size_t startRow, size_t endRow)
+	{
+		for (size_t y = startRow; y < endRow; y++)
+		{
+			for (size_t x = 0; x < outputCols; x++)
+			{
+				uint8_t* patch = patches.data() + (y * outputCols + x) * patchSize;
+				for (size_t d = 0; d < m_InputDepth; d++)
+				{
+					const uint8_t* inputSlice = inputs + d * m_InputHeight * m_InputWidth;
+					for (size_t ky = 0; ky < m_KernelHeight; ky++)
+					{
+						long long posY = (long long)(y * m_Stride + ky) - (long long)m_Padding;
+						for (size_t kx = 0; kx < m_KernelWidth; kx++)
+						{
+							long long posX = (long long)(x * m_Stride + kx) - (long long)m_Padding;
+							bool isInside = posY >= 0 && posY < (long long)m_InputHeight && posX >= 0 && posX < (long long)m_InputWidth;
+							*(patch++) = isInside ? inputSlice[posY * m_InputWidth + posX] : (uint8_t)inputParams.ZeroPoint;
+						}
+					}
+				}
+			}
+		}
+	});
+
+	ParallelFor(m_NumKernels, [&](size_t startKernel, size_t endKernel)
+	{
+		for (size_t n = startKernel; n < endKernel; n++)
+		{
+			const int8_t* kernel = m_Kernels.data() + n * patchSize;
+			const int32_t correction = inputParams.ZeroPoint * m_KernelSums[n];
+			const float scale = inputParams.Scale * m_Scales[n];
+
+			for (size_t p = 0; p < outputSliceSize; p++)
+			{
+				int32_t sum = DotProductU8S8(patches.data() + p * patchSize, kernel, patchSize) - correction;
+				size_t index = n * outputSliceSize + p;
+				float value = m_ActivationFunction.Activation(sum * scale + (m_IsUseBias ? m_Bias[index] : 0.0f));
+
+				if (m_IsQuantizingOutput)
+					output.Data[index] = m_OutputParams.Quantize(value);
+				else
+					output.Values.GetData()[index] = value;
+			}
+		}
+	});
+}
+
+LayerShape QuantizedConvolutionalLayer::GetLayerShape() const
+{
+	return
+	{
+		m_InputHeight, m_InputWidth, m_InputDepth,
+		CalcConvSize(m_InputHeight, m_KernelHeight, m_Stride, m_Padding), CalcConvSize(m_InputWidth, m_KernelWidth, m_Stride, m_Padding), m_NumKernels
+	};
+}
+
+std::string QuantizedConvolutionalLayer::ToString() const
+{
+	std::stringstream ss;
+
+	ss << "[ " <<
+		m_InputWidth << " " << m_InputHeight << " " << m_InputDepth << " " <<
+		m_KernelHeight << " " << m_KernelWidth << " " << m_NumKernels << " " << m_Padding << " " << m_IsUseBias << " " <<
+		m_ActivationFunction.Name << " ( " << m_ActivationFunction.Params << " ) ";
+	WriteParams(ss, m_InputParams) << " ";
+	WriteParams(ss, m_OutputParams) << " " << m_Stride <<
+	" ]";
+
+	for (size_t t = 0; t < m_Scales.size(); t++)
+	{
+		ss << " " << m_Scales[t];
+	}
+	for (size_t t = 0; t < m_Kernels.size(); t++)
+	{
+		ss << " " << (int)m_Kernels[t];
+	}
+	for (size_t t = 0; t < m_Bias.size(); t++)
+	{
+		ss << " " << m_Bias[t];
+	}
+
+	return ss.str();
+}
+
+void QuantizedConvolutionalLayer::FromString(const std::string& data)
+{
+	std::size_t numsStartPos = data.find(']');
+	assert(data[0] == '[' && numsStartPos != std::string::npos && "Invalid hyperparameter format.");
+	numsStartPos += 1;
+
+	std::string hyperparams = data.substr(1, numsStartPos - 2);
+	std::size_t acivationParamsStart = hyperparams.find('(');
+	std::size_t acivationParamsEnd = hyperparams.find(')');
+	assert(acivationParamsStart != std::string::npos && acivationParamsEnd != std::string::npos && "Invalid activation function params format.");
+
+	std::stringstream ss(hyperparams);
+
+	std::string activationFStr;
+	std::string activationFParamsStr = hyperparams.substr(acivationParamsStart + 2, acivationParamsEnd - acivationParamsStart - 3);
+	ss >> m_InputWidth >> m_InputHeight >> m_InputDepth;
+	ss >> m_KernelHeight >> m_KernelWidth >> m_NumKernels;
+	ss >> m_Padding >> m_IsUseBias;
+	ss >> activationFStr;
+	m_ActivationFunction = GetActivationFunctionByName(activationFStr, activationFParamsStr);
+
+	std::stringstream qss(hyperparams.substr(acivationParamsEnd + 1));
+	qss >> m_InputParams.Scale >> m_InputParams.ZeroPoint;
+	qss >> m_OutputParams.Scale >> m_OutputParams.ZeroPoint;
+	// The stride follows the quantization params, the files saved before the strided convolution have none.
+	if (!(qss >> m_Stride))
+		m_Stride = 1;
+
+	LayerShape shape = GetLayerShape();
+	const size_t patchSize = m_InputDepth * m_KernelHeight * m_KernelWidth;
+	m_Scales.resize(m_NumKernels);
+	m_Kernels.resize(m_NumKernels * patchSize);
+	m_Bias.resize(m_IsUseBias ? shape.OutputRows * shape.OutputCols * shape.OutputDepth : 0);
+
+	std::istringstream iss(data.substr(numsStartPos));
+
+	for (size_t i = 0; i < m_Scales.size(); i++)
+	{
+		iss >> m_Scales[i];
+	}
+	for (size_t i = 0; i < m_Kernels.size(); i++)
+	{
+		int value;
+		iss >> value;
+		m_Kernels[i] = (int8_t)value;
+	}
+	for (size_t i = 0; i < m_Bias.size(); i++)
+	{
+		iss >> m_Bias[i];
+	}
+
+	UpdateChannelSums(m_Kernels, patchSize, m_KernelSums);
+}
+
+
+QuantizedWrapperLayer::QuantizedWrapperLayer(const std::shared_ptr<Layer>& layer)
+	: m_Layer(layer)
+{
+	const std::string name = m_Layer->GetName();
+	m_IsPassingQuantized =
+		name == MaxPoolingLayer::ClassName() || name == ReshapeLayer::ClassName() || name == DropoutLayer::ClassName();
+}
+
+void QuantizedWrapperLayer::Infer(const QuantizedActivation& input, QuantizedActivation& output) const
+{
+	LayerShape shape = m_Layer->GetLayerShape();
+
+	if (!input.IsQuantized)
+	{
+		output.SetValuesShape(shape.OutputRows, shape.OutputCols, shape.OutputDepth);
+		m_Layer->Infer(input.Values, output.Values);
+		return;
+	}
+
+	if (!m_IsPassingQuantized)
+	{
+		output.SetValuesShape(shape.OutputRows, shape.OutputCols, shape.OutputDepth);
+		m_Layer->Infer(input.ToTensor(), output.Values);
+		return;
+	}
+
+	output.SetDataShape(shape.OutputRows, shape.OutputCols, shape.OutputDepth, input.Params);
+	if (m_Layer->GetName() != MaxPoolingLayer::ClassName())
+	{
+		assert(output.Data.size() == input.Data.size() && "Output shape not match!");
+		std::copy(input.Data.begin(), input.Data.end(), output.Data.begin());
+		return;
+	}
+
+	const MaxPoolingLayer* pooling = static_cast<const MaxPoolingLayer*>(m_Layer.get());
+	const size_t poolingHeight = pooling->GetPoolingHeight();
+	const size_t poolingWidth = pooling->GetPoolingWidth();
+
+	for (size_t d = 0; d < shape.OutputDepth; d++)
+	{
+		const uint8_t* inputSlice = input.Data.data() + d * shape.InputRows * shape.InputCols;
+		uint8_t* outputRow = output.Data.data() + d * shape.OutputRows * shape.OutputCols;
+
+		for (size_t r = 0; r < shape.OutputRows; r++, outputRow += shape.OutputCols)
+		{
+			std::fill(outputRow, outputRow + shape.OutputCols, 0);
+			for (size_t py = 0; py < poolingHeight; py++)
+			{
+				const uint8_t* inputRow = inputSlice + (r * poolingHeight + py) * shape.InputCols;
+				for (size_t c = 0; c < shape.OutputCols; c++)
+				{
+					for (size_t px = 0; px < poolingWidth; px++)
+					{
+						outputRow[c] = std::max(outputRow[c], inputRow[c * poolingWidth + px]);
+					}
+				}
+			}
+		}
+	}
+}
+
+
+QuantizedModel::QuantizedModel(const std::string& filePath)
+{
+	Load(filePath);
+}
+
+void QuantizedModel::AddLayer(const std::shared_ptr<QuantizedLayer>& layer)
+{
+	m_Layers.push_back(layer);
+	UpdateQuantizedOutputs();
+}
+
+void QuantizedModel::AddLayer(const std::string& layerName, const std::string& layerFromData)
+{
+	if (layerName == QuantizedDenseLayer::ClassName()) { AddLayer(std::make_shared<QuantizedDenseLayer>(layerFromData)); return; }
+	if (layerName == QuantizedConvolutionalLayer::ClassName()) { AddLayer(std::make_shared<QuantizedConvolutionalLayer>(layerFromData)); return; }
+
+	AddLayer(std::make_shared<QuantizedWrapperLayer>(CreateLayer(layerName, layerFromData)));
+}
+
+void QuantizedModel::UpdateQuantizedOutputs()
+{
+	for (size_t i = 0; i < m_Layers.size(); i++)
+	{
+		size_t next = i + 1;
+		while (next < m_Layers.size() && m_Layers[next]->IsPassingQuantized()) next++;
+
+		m_Layers[i]->SetQuantizingOutput(
+			m_Layers[i]->IsConsumingQuantized() && next < m_Layers.size() && m_Layers[next]->IsConsumingQuantized()
+		);
+	}
+}
+
+Tensor3D QuantizedModel::FeedForward(const Tensor3D& inputs) const
+{
+	assert(!m_Layers.empty() && "No layer available!");
+
+	if (inputs.IsOnDevice())
+		throw std::runtime_error("Quantized inference is only implemented on the host.");
+
+	QuantizedActivation activations[2];
+	activations[0].SetValuesShape(inputs.GetRows(), inputs.GetCols(), inputs.GetDepth());
+	std::copy(inputs.GetData(), inputs.GetData() + inputs.GetSize(), activations[0].Values.GetData());
+
+	size_t current = 0;
+	for (const std::shared_ptr<QuantizedLayer>& layer : m_Layers)
+	{
+		layer->Infer(activations[current], activations[1 - current]);
+		current = 1 - current;
+	}
+
+	return activations[current].ToTensor();
+}
+
+void QuantizedModel::Save(const std::string& filePath) const
+{
+	assert(!m_Layers.empty() && "No layer available!");
+
+	std::stringstream ss;
+
+	for (const std::shared_ptr<QuantizedLayer>& layer : m_Layers)
+	{
+		ss << layer->GetName() << layer->ToString() << std::endl;
+	}
+
+	std::ofstream file(filePath);
+	assert(file.is_open() && "Could not open file!");
+	file << ss.str();
+	file.close();
+}
+
+void QuantizedModel::Load(const std::string& filePath)
+{
+	std::ifstream file(filePath);
+	if (!file.is_open())
+	{
+		std::cout << "File is cannot be opened." << std::endl;
+	}
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::size_t endName = line.find('[');
+		std::string layerName = line.substr(0, endName);
+		std::string layerData = line.substr(endName);
+
+		AddLayer(layerName, layerData);
+	}
+}
+
+ModelShape QuantizedModel::GetModelShape() const
+{
+	assert(!m_Layers.empty() && "No layer available!");
+
+	LayerShape rootShape = m_Layers.front()->GetLayerShape();
+	LayerShape headShape = m_Layers.back()->GetLayerShape();
+
+	return
+	{
+		rootShape.InputRows, rootShape.InputCols, rootShape.InputDepth,
+		headShape.OutputRows, headShape.OutputCols, headShape.OutputDepth
+	};
+}
+
+size_t QuantizedModel::GetParamsBytes() const
+{
+	size_t bytes = 0;
+	for (const std::shared_ptr<QuantizedLayer>& layer : m_Layers)
+	{
+		bytes += layer->GetParamsBytes();
+	}
+	return bytes;
+}
+
+
+QuantizationCalibrator::QuantizationCalibrator(const Model& model)
+{
+	assert(model.IsModelCorrect() && "Model is not defined correctly!");
+
+	ModelShape modelShape = model.GetModelShape();
+	m_Activations.emplace_back(modelShape.InputRows, modelShape.InputCols, modelShape.InputDepth);
+
+	std::shared_ptr<Layer> layer = model.GetRootLayer();
+	while (layer)
+	{
+		LayerShape shape = layer->GetLayerShape();
+		m_Layers.push_back(layer);
+		m_Activations.emplace_back(shape.OutputRows, shape.OutputCols, shape.OutputDepth);
+		layer = layer->NextLayer;
+	}
+
+	m_Min.assign(m_Activations.size(), std::numeric_limits<float>::infinity());
+	m_Max.assign(m_Activations.size(), -std::numeric_limits<float>::infinity());
+}
+
+void QuantizationCalibrator::Observe(const Tensor3D& inputs)
+{
+	assert(inputs.GetSize() == m_Activations[0].GetSize() && "Invalid input shape!");
+
+	if (inputs.IsOnDevice())
+		throw std::runtime_error("Calibration is only implemented on the host.");
+
+	std::copy(inputs.GetData(), inputs.GetData() + inputs.GetSize(), m_Activations[0].GetData());
+	for (size_t i = 0; i < m_Layers.size(); i++)
+	{
+		m_Layers[i]->Infer(m_Activations[i], m_Activations[i + 1]);
+	}
+
+	for (size_t i = 0; i < m_Activations.size(); i++)
+	{
+		const float* values = m_Activations[i].GetData();
+		for (size_t t = 0; t < m_Activations[i].GetSize(); t++)
+		{
+			m_Min[i] = std::min(m_Min[i], values[t]);
+			m_Max[i] = std::max(m_Max[i], values[t]);
+		}
+	}
+
+	m_NumObserved++;
+}
+
+QuantizedModel QuantizationCalibrator::Quantize() const
+{
+	assert(m_NumObserved > 0 && "No sample observed!");
+
+	QuantizedModel model;
+	for (size_t i = 0; i < m_Layers.size(); i++)
+	{
+		const std::shared_ptr<Layer>& layer = m_Layers[i];
+		QuantizationParams inputParams = QuantizationParams::FromRange(m_Min[i], m_Max[i]);
+		QuantizationParams outputParams = QuantizationParams::FromRange(m_Min[i + 1], m_Max[i + 1]);
+
+		if (layer->GetName() == DenseLayer::ClassName())
+			model.AddLayer(std::make_shared<QuantizedDenseLayer>(*static_cast<const DenseLayer*>(layer.get()), inputParams, outputParams));
+		else if (layer->GetName() == ConvolutionalLayer::ClassName())
+			model.AddLayer(std::make_shared<QuantizedConvolutionalLayer>(*static_cast<const ConvolutionalLayer*>(layer.get()), inputParams, outputParams));
+		else
+			model.AddLayer(std::make_shared<QuantizedWrapperLayer>(CreateLayer(layer->GetName(), layer->ToString())));
+	}
+
+	return model;
+}
+
+namespace_end
@@ -0,0 +1,223 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+#include "Core.h"
+#include "Layer.h"
+#include "Model.h"
+
+
+namespace_start
+
+class DenseLayer;
+class ConvolutionalLayer;
+
+/*
+	Affine mapping of the float values to unsigned 7 bit integers: value = Scale * (q - ZeroPoint), q in [0, 127].
+	The 7 bit range keeps the pair sums of the AVX2 maddubs instruction from saturating (see DotProductU8S8).
+*/
+struct LIBRARY_API QuantizationParams
+{
+	float Scale = 1.0f;
+	int32_t ZeroPoint = 0;
+
+	// The range is extended to contain 0, so the zero padding and the RelU's zeros are exact.
+	static QuantizationParams FromRange(float min, float max);
+
+	uint8_t Quantize(float value) const;
+	inline float Dequantize(uint8_t value) const { return Scale * ((int32_t)value - ZeroPoint); }
+};
+
+/*
+	Activation between the layers of a quantized model, either float values or quantized values with their params.
+*/
+struct LIBRARY_API QuantizedActivation
+{
+	Tensor3D Values;
+	std::vector<uint8_t> Data;
+	QuantizationParams Params;
+	size_t Rows = 0, Cols = 0, Depth = 0;
+	bool IsQuantized = false;
+
+	void SetValuesShape(size_t rows, size_t cols, size_t depth);
+	void SetDataShape(size_t rows, size_t cols, size_t depth, const QuantizationParams& params);
+
+	// Quantizes the values into the data if the activation is not quantized yet.
+	const uint8_t* GetQuantized(const QuantizationParams& params, std::vector<uint8_t>& buffer) const;
+	Tensor3D ToTensor() const;
+};
+
+class LIBRARY_API QuantizedLayer
+{
+public:
+	virtual ~QuantizedLayer() { }
+
+	virtual void Infer(const QuantizedActivation& input, QuantizedActivation& output) const = 0;
+
+	virtual LayerShape GetLayerShape() const = 0;
+	// Dense and convolutional layers take quantized inputs, max pooling, reshape and dropout only pass them on.
+	virtual bool IsConsumingQuantized() const { return false; }
+	virtual bool IsPassingQuantized() const { return false; }
+	// Size of the parameters in bytes.
+	virtual size_t GetParamsBytes() const = 0;
+
+	virtual std::string GetName() const = 0;
+	virtual std::string ToString() const = 0;
+	virtual void FromString(const std::string& data) = 0;
+
+	// Set by the QuantizedModel, when the next layer takes quantized inputs the output is requantized in the epilogue.
+	inline void SetQuantizingOutput(bool isQuantizingOutput) { m_IsQuantizingOutput = isQuantizingOutput; }
+	inline bool IsQuantizingOutput() const { return m_IsQuantizingOutput; }
+
+protected:
+	bool m_IsQuantizingOutput = false;
+};
+
+/*
+	Dense layer with symmetric int8 weights per output node (row) and 7 bit activations per tensor.
+	The int32 sums are corrected with the input's zero point, scaled, biased and activated in one pass.
+*/
+class LIBRARY_API QuantizedDenseLayer : public QuantizedLayer
+{
+public:
+	QuantizedDenseLayer(const DenseLayer& layer, const QuantizationParams& inputParams, const QuantizationParams& outputParams);
+	QuantizedDenseLayer(const std::string& fromString);
+
+	virtual void Infer(const QuantizedActivation& input, QuantizedActivation& output) const override;
+
+	virtual LayerShape GetLayerShape() const override { return { m_InputNodes, 1, 1, m_OutputNodes, 1, 1 }; }
+	virtual bool IsConsumingQuantized() const override { return true; }
+	virtual size_t GetParamsBytes() const override { return m_Weights.size() + (m_Scales.size() + m_Bias.size()) * sizeof(float); }
+
+	virtual std::string GetName() const override { return ClassName(); }
+	virtual std::string ToString() const override;
+	virtual void FromString(const std::string& data) override;
+
+	static std::string ClassName() { return "QuantizedDenseLayer"; }
+private:
+	size_t m_InputNodes, m_OutputNodes;
+	std::vector<int8_t> m_Weights;  // out x in
+	std::vector<float> m_Scales;  // out
+	std::vector<int32_t> m_WeightSums;  // out, for the zero point correction
+	std::vector<float> m_Bias;  // out
+	ActivationFunciton m_ActivationFunction;
+
+	QuantizationParams m_InputParams, m_OutputParams;
+};
+
+/*
+	Convolutional layer with symmetric int8 kernels per output channel and 7 bit activations per tensor.
+	The input is unfolded into patches at the stride (the padding is the input's zero point), every output element is one dot product.
+*/
+class LIBRARY_API QuantizedConvolutionalLayer : public QuantizedLayer
+{
+public:
+	QuantizedConvolutionalLayer(const ConvolutionalLayer& layer, const QuantizationParams& inputParams, const QuantizationParams& outputParams);
+	QuantizedConvolutionalLayer(const std::string& fromString);
+
+	virtual void Infer(const QuantizedActivation& input, QuantizedActivation& output) const override;
+
+	virtual LayerShape GetLayerShape() const override;
+	virtual bool IsConsumingQuantized() const override { return true; }
+	virtual size_t GetParamsBytes() const override { return m_Kernels.size() + (m_Scales.size() + m_Bias.size()) * sizeof(float); }
+
+	virtual std::string GetName() const override { return ClassName(); }
+	virtual std::string ToString() const override;
+	virtual void FromString(const std::string& data) override;
+
+	static std::string ClassName() { return "QuantizedConvolutionalLayer"; }
+private:
+	size_t m_InputHeight, m_InputWidth, m_InputDepth;
+	size_t m_KernelHeight, m_KernelWidth, m_NumKernels;
+	size_t m_Padding, m_Stride;
+	bool m_IsUseBias;
+
+	std::vector<int8_t> m_Kernels;  // n x (d x kh x kw)
+	std::vector<float> m_Scales;  // n
+	std::vector<int32_t> m_KernelSums;  // n
+	std::vector<float> m_Bias;  // n x Ho x Wo
+	ActivationFunciton m_ActivationFunction;
+
+	QuantizationParams m_InputParams, m_OutputParams;
+};
+
+/*
+	Float layer of a quantized model, it is saved as the original layer.
+	Max pooling, reshape and dropout layers work on the quantized values directly (max pooling is monotonic in them),
+	the other layers dequantize their input.
+*/
+class LIBRARY_API QuantizedWrapperLayer : public QuantizedLayer
+{
+public:
+	QuantizedWrapperLayer(const std::shared_ptr<Layer>& layer);
+
+	virtual void Infer(const QuantizedActivation& input, QuantizedActivation& output) const override;
+
+	virtual LayerShape GetLayerShape() const override { return m_Layer->GetLayerShape(); }
+	virtual bool IsPassingQuantized() const override { return m_IsPassingQuantized; }
+	virtual size_t GetParamsBytes() const override { return m_Layer->GetLearnableParams() * sizeof(float); }
+
+	virtual std::string GetName() const override { return m_Layer->GetName(); }
+	virtual std::string ToString() const override { return m_Layer->ToString(); }
+	virtual void FromString(const std::string& data) override { m_Layer->FromString(data); }
+
+private:
+	std::shared_ptr<Layer> m_Layer;
+	bool m_IsPassingQuantized;
+};
+
+/*
+	Post training quantized model for inference on the host.
+	The file format is the model's one (a layer per line), the dense and convolutional layers are saved quantized.
+*/
+class LIBRARY_API QuantizedModel
+{
+public:
+	QuantizedModel() { }
+	QuantizedModel(const std::string& filePath);
+
+	void AddLayer(const std::shared_ptr<QuantizedLayer>& layer);
+	void AddLayer(const std::string& layerName, const std::string& layerFromData);
+
+	// Thread safe, the activations are allocated per call.
+	Tensor3D FeedForward(const Tensor3D& inputs) const;
+
+	void Save(const std::string& filePath) const;
+	void Load(const std::string& filePath);
+
+	ModelShape GetModelShape() const;
+	size_t GetParamsBytes() const;
+
+	inline const std::vector<std::shared_ptr<QuantizedLayer>>& GetLayers() const { return m_Layers; }
+private:
+	// A layer requantizes its output when the next layer (after the passing ones) takes quantized inputs.
+	void UpdateQuantizedOutputs();
+
+private:
+	std::vector<std::shared_ptr<QuantizedLayer>> m_Layers;
+};
+
+/*
+	Collects the range of the model's input and of every layer's output over the observed samples,
+	than quantizes the model's dense and convolutional layers with them.
+*/
+class LIBRARY_API QuantizationCalibrator
+{
+public:
+	QuantizationCalibrator(const Model& model);
+
+	void Observe(const Tensor3D& inputs);
+	inline size_t GetNumObserved() const { return m_NumObserved; }
+
+	QuantizedModel Quantize() const;
+
+private:
+	std::vector<std::shared_ptr<Layer>> m_Layers;
+	std::vector<Tensor3D> m_Activations;
+	std::vector<float> m_Min, m_Max;  // The model's input than every layer's output.
+	size_t m_NumObserved = 0;
+};
+
+namespace_end
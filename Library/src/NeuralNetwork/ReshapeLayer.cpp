@@ -1,6 +1,7 @@
 #include "ReshapeLayer.h"
 #include <assert.h>
 #include <sstream>
+#include <algorithm>
 #include <iostream>
 
 
@@ -31,6 +32,20 @@ Tensor3D ReshapeLayer::FeedForward(const Tensor3D& inputs)
 	return Tensor3D(m_OutputHeight, m_OutputWidth, m_OutputDepth, inputs.GetData(), inputs.IsOnDevice());
 }
 
+void ReshapeLayer::Infer(const Tensor3D& inputs, Tensor3D& output) const
+{
+	assert(m_InputHeight == inputs.GetRows() &&
+		m_InputWidth == inputs.GetCols() &&
+		m_InputDepth == inputs.GetDepth()
+		&& "Input shape not match!");
+	assert(output.GetSize() == inputs.GetSize() && "Output shape not match!");
+
+	if (inputs.IsOnDevice() || output.IsOnDevice())
+		throw std::runtime_error("Inference is only implemented on the host.");
+
+	std::copy(inputs.GetData(), inputs.GetData() + inputs.GetSize(), output.GetData());
+}
+
 Tensor3D ReshapeLayer::BackPropagation(const Tensor3D& inputs, const CostFunction& costFucntion, float learningRate, size_t t)
 {
 	assert(m_InputHeight == inputs.GetRows() &&
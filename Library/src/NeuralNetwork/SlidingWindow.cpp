@@ -0,0 +1,243 @@
+#include "SlidingWindow.h"
+#include <assert.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "ConvolutionalLayer.h"
+#include "MaxPoolingLayer.h"
+#include "ReshapeLayer.h"
+#include "DenseLayer.h"
+#include "DropoutLayer.h"
+
+
+namespace_start
+
+// The bias of every output position of a channel is the channel's bias.
+static Tensor3D BroadcastBias(const float* channelBias, size_t rows, size_t cols, size_t depth)
+{
+	Tensor3D bias(rows, cols, depth);
+	for (size_t d = 0; d < depth; d++)
+	{
+		std::fill(bias.GetData() + d * rows * cols, bias.GetData() + (d + 1) * rows * cols, channelBias[d]);
+	}
+	return bias;
+}
+
+Model ConvertToFullyConvolutional(const Model& windowModel, size_t frameRows, size_t frameCols, size_t* stride)
+{
+	assert(windowModel.IsModelCorrect() && "Model is not defined correctly!");
+
+	Model model;
+	size_t rows = frameRows, cols = frameCols;
+	size_t depth = windowModel.GetModelShape().InputDepth;
+	size_t totalStride = 1;
+	bool isFlattened = false;
+	LayerShape flattenedShape = {};
+
+	for (std::shared_ptr<Layer> layer = windowModel.GetRootLayer(); layer; layer = layer->NextLayer)
+	{
+		std::string name = layer->GetName();
+		if (name == ConvolutionalLayer::ClassName() && !isFlattened)
+		{
+			const ConvolutionalLayer* conv = static_cast<const ConvolutionalLayer*>(layer.get());
+			if (conv->GetKernels().IsOnDevice())
+				throw std::runtime_error("The window model must be on the host.");
+
+			const Tensor3D& kernels = conv->GetKernels();
+			size_t outputRows = CalcConvSize(rows, kernels.GetRows(), conv->GetStride(), conv->GetPadding());
+			size_t outputCols = CalcConvSize(cols, kernels.GetCols(), conv->GetStride(), conv->GetPadding());
+			if (kernels.GetRows() > rows + 2 * conv->GetPadding() || kernels.GetCols() > cols + 2 * conv->GetPadding())
+				throw std::runtime_error("The frame is smaller than the window.");
+
+			std::unique_ptr<Tensor3D> bias;
+			if (conv->IsUseBias())
+			{
+				const Tensor3D& windowBias = conv->GetBias();
+				const size_t channelSize = windowBias.GetRows() * windowBias.GetCols();
+				std::vector<float> channelBias(conv->GetNumKernels());
+				for (size_t d = 0; d < conv->GetNumKernels(); d++)
+				{
+					const float* channel = windowBias.GetData() + d * channelSize;
+					if (std::any_of(channel, channel + channelSize, [channel](float value) { return value != channel[0]; }))
+						throw std::runtime_error("The bias of a convolutional layer depends on the position, it can't be converted.");
+					channelBias[d] = channel[0];
+				}
+				bias = std::make_unique<Tensor3D>(BroadcastBias(channelBias.data(), outputRows, outputCols, conv->GetNumKernels()));
+			}
+
+			model.AddLayer(std::make_shared<ConvolutionalLayer>(rows, cols, depth, kernels, conv->GetNumKernels(), conv->GetPadding(), conv->GetActivationFunction(), bias.get(), conv->GetStride()));
+			rows = outputRows;
+			cols = outputCols;
+			depth = conv->GetNumKernels();
+			totalStride *= conv->GetStride();
+		}
+		else if (name == MaxPoolingLayer::ClassName() && !isFlattened)
+		{
+			const MaxPoolingLayer* pooling = static_cast<const MaxPoolingLayer*>(layer.get());
+			model.AddLayer(std::make_shared<MaxPoolingLayer>(rows, cols, depth, pooling->GetPoolingHeight(), pooling->GetPoolingWidth()));
+			rows /= pooling->GetPoolingHeight();
+			cols /= pooling->GetPoolingWidth();
+			assert(pooling->GetPoolingHeight() == pooling->GetPoolingWidth() && "Only square poolings are supported!");
+			totalStride *= pooling->GetPoolingHeight();
+		}
+		else if (name == ReshapeLayer::ClassName() && !isFlattened)
+		{
+			flattenedShape = layer->GetLayerShape();
+			if (flattenedShape.OutputCols != 1 || flattenedShape.OutputDepth != 1)
+				throw std::runtime_error("Only a flattening reshape is supported.");
+			isFlattened = true;
+		}
+		else if (name == DenseLayer::ClassName() && isFlattened)
+		{
+			const DenseLayer* dense = static_cast<const DenseLayer*>(layer.get());
+			const Tensor2D& weights = dense->GetWeights();
+			if (weights.IsOnDevice())
+				throw std::runtime_error("The window model must be on the host.");
+
+			// The weights of an output are in the input's memory order (depth, row, col) like a kernel block.
+			size_t kernelRows = 1, kernelCols = 1;
+			if (flattenedShape.InputRows)
+			{
+				kernelRows = flattenedShape.InputRows;
+				kernelCols = flattenedShape.InputCols;
+				flattenedShape = LayerShape();
+			}
+			const size_t numOutputs = weights.GetRows();
+			if (kernelRows > rows || kernelCols > cols)
+				throw std::runtime_error("The frame is smaller than the window.");
+			assert(kernelRows * kernelCols * depth == weights.GetCols() && "The dense layer does not match the flattened shape!");
+
+			Tensor3D kernels(kernelRows, kernelCols, depth * numOutputs, (const float*)weights.GetData(), false);
+			size_t outputRows = rows - kernelRows + 1, outputCols = cols - kernelCols + 1;
+			Tensor3D bias = BroadcastBias(dense->GetBias().GetData(), outputRows, outputCols, numOutputs);
+
+			model.AddLayer(std::make_shared<ConvolutionalLayer>(rows, cols, depth, kernels, numOutputs, 0, dense->GetActivationFunction(), &bias));
+			rows = outputRows;
+			cols = outputCols;
+			depth = numOutputs;
+		}
+		else if (name != DropoutLayer::ClassName())
+		{
+			throw std::runtime_error("The layer can't be converted to a fully convolutional one: " + name);
+		}
+	}
+
+	if (!isFlattened)
+		throw std::runtime_error("The window model has no dense head.");
+
+	if (stride)
+		*stride = totalStride;
+	return model;
+}
+
+
+static Tensor3D ResizeBilinear(const Tensor3D& input, size_t rows, size_t cols)
+{
+	Tensor3D output(rows, cols, input.GetDepth());
+	const float scaleRows = (float)input.GetRows() / rows;
+	const float scaleCols = (float)input.GetCols() / cols;
+
+	for (size_t d = 0; d < input.GetDepth(); d++)
+	{
+		const float* inputSlice = input.GetData() + d * input.GetRows() * input.GetCols();
+		float* outputSlice = output.GetData() + d * rows * cols;
+		for (size_t r = 0; r < rows; r++)
+		{
+			float y = std::min(std::max((r + 0.5f) * scaleRows - 0.5f, 0.0f), (float)(input.GetRows() - 1));
+			size_t y0 = (size_t)y, y1 = std::min(y0 + 1, input.GetRows() - 1);
+			float wy = y - y0;
+			for (size_t c = 0; c < cols; c++)
+			{
+				float x = std::min(std::max((c + 0.5f) * scaleCols - 0.5f, 0.0f), (float)(input.GetCols() - 1));
+				size_t x0 = (size_t)x, x1 = std::min(x0 + 1, input.GetCols() - 1);
+				float wx = x - x0;
+
+				float top = inputSlice[y0 * input.GetCols() + x0] * (1.0f - wx) + inputSlice[y0 * input.GetCols() + x1] * wx;
+				float bottom = inputSlice[y1 * input.GetCols() + x0] * (1.0f - wx) + inputSlice[y1 * input.GetCols() + x1] * wx;
+				outputSlice[r * cols + c] = top * (1.0f - wy) + bottom * wy;
+			}
+		}
+	}
+	return output;
+}
+
+SlidingWindowDetector::SlidingWindowDetector(const Model& windowModel, size_t frameRows, size_t frameCols, const std::vector<float>& scales)
+	: m_FrameRows(frameRows), m_FrameCols(frameCols), m_Scales(scales)
+{
+	ModelShape shape = windowModel.GetModelShape();
+	m_WindowRows = shape.InputRows;
+	m_WindowCols = shape.InputCols;
+
+	for (float scale : m_Scales)
+	{
+		size_t rows = (size_t)std::round(frameRows * scale), cols = (size_t)std::round(frameCols * scale);
+		if (rows < m_WindowRows || cols < m_WindowCols)
+			throw std::runtime_error("The scaled frame is smaller than the window at scale: " + std::to_string(scale));
+
+		m_Models.push_back(ConvertToFullyConvolutional(windowModel, rows, cols, &m_Stride));
+	}
+}
+
+std::vector<Tensor3D> SlidingWindowDetector::Evaluate(const Tensor3D& frame) const
+{
+	assert(frame.GetRows() == m_FrameRows && frame.GetCols() == m_FrameCols && "Invalid frame size!");
+
+	if (frame.IsOnDevice())
+		throw std::runtime_error("The frame must be on the host.");
+
+	std::vector<Tensor3D> scoreMaps;
+	for (size_t i = 0; i < m_Models.size(); i++)
+	{
+		ModelShape shape = m_Models[i].GetModelShape();
+		if (shape.InputRows == m_FrameRows && shape.InputCols == m_FrameCols)
+			scoreMaps.push_back(m_Models[i].FeedForward(frame));
+		else
+			scoreMaps.push_back(m_Models[i].FeedForward(ResizeBilinear(frame, shape.InputRows, shape.InputCols)));
+	}
+	return scoreMaps;
+}
+
+std::vector<WindowDetection> SlidingWindowDetector::ToDetections(const std::vector<Tensor3D>& scoreMaps, float threshold) const
+{
+	std::vector<WindowDetection> detections;
+	for (size_t i = 0; i < scoreMaps.size(); i++)
+	{
+		const float scale = m_Scales[i];
+		const Tensor3D& scoreMap = scoreMaps[i];
+		for (size_t r = 0; r < scoreMap.GetRows(); r++)
+		{
+			for (size_t c = 0; c < scoreMap.GetCols(); c++)
+			{
+				float score = scoreMap.GetData()[r * scoreMap.GetCols() + c];
+				if (score < threshold)
+					continue;
+
+				WindowDetection detection;
+				detection.Row = (size_t)std::round(r * m_Stride / scale);
+				detection.Col = (size_t)std::round(c * m_Stride / scale);
+				detection.Rows = std::min((size_t)std::round(m_WindowRows / scale), m_FrameRows - detection.Row);
+				detection.Cols = std::min((size_t)std::round(m_WindowCols / scale), m_FrameCols - detection.Col);
+				detection.Score = score;
+				detection.Scale = scale;
+				detections.push_back(detection);
+			}
+		}
+	}
+
+	std::sort(detections.begin(), detections.end(), [](const WindowDetection& left, const WindowDetection& right) { return left.Score > right.Score; });
+	return detections;
+}
+
+std::vector<WindowDetection> SlidingWindowDetector::Detect(const Tensor3D& frame, float threshold) const
+{
+	return ToDetections(Evaluate(frame), threshold);
+}
+
+WindowDetection SlidingWindowDetector::FindBest(const Tensor3D& frame) const
+{
+	std::vector<WindowDetection> detections = ToDetections(Evaluate(frame), -std::numeric_limits<float>::infinity());
+	return detections.size() ? detections.front() : WindowDetection();
+}
+
+namespace_end
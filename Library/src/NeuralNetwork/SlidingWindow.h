@@ -0,0 +1,63 @@
+#pragma once
+#include <vector>
+
+#include "Core.h"
+#include "Model.h"
+
+
+namespace_start
+
+/*
+	Converts a window model to a fully convolutional model over frameRows x frameCols frames, which evaluates every window position at once.
+	The window model is ConvolutionalLayers and MaxPoolingLayers, than a ReshapeLayer (flattening) and DenseLayers.
+	The first DenseLayer becomes a convolution with the flattened shape as its kernel, the rest of them 1x1 convolutions.
+	DropoutLayers are left out.
+
+	The output is a score map: the output of the window at (r * stride, c * stride) of the frame is at (r, c) (the outputs are the depth),
+	where the stride is the product of the poolings and the convolutions' strides. A window's score equals to the window model's output when the convolutions have
+	no padding, with padding the inner windows see the frame around them instead of the zero padding.
+	The convolutions' bias must be the same for every position of a channel. The layers are copied, the model is not referenced.
+*/
+LIBRARY_API Model ConvertToFullyConvolutional(const Model& windowModel, size_t frameRows, size_t frameCols, size_t* stride=nullptr);
+
+struct LIBRARY_API WindowDetection
+{
+	// The window in the frame's coordinates.
+	size_t Row = 0, Col = 0, Rows = 0, Cols = 0;
+	float Score = 0.0f;  // The first output of the window model.
+	float Scale = 1.0f;  // The scale of the frame in the pyramid.
+};
+
+/*
+	Scores every window position of frames with a window model, one pass of a fully convolutional model per scale of an image pyramid.
+	At a scale s the frame is resized (bilinear) by s, so a window covers windowRows / s x windowCols / s pixels of the frame.
+*/
+class LIBRARY_API SlidingWindowDetector
+{
+public:
+	SlidingWindowDetector(const Model& windowModel, size_t frameRows, size_t frameCols, const std::vector<float>& scales={ 1.0f });
+
+	// The score map of every scale.
+	std::vector<Tensor3D> Evaluate(const Tensor3D& frame) const;
+	// The windows scoring at least the threshold in decreasing score.
+	std::vector<WindowDetection> Detect(const Tensor3D& frame, float threshold) const;
+	// The best scoring window over all scales.
+	WindowDetection FindBest(const Tensor3D& frame) const;
+
+	inline size_t GetStride() const { return m_Stride; }
+	inline size_t GetWindowRows() const { return m_WindowRows; }
+	inline size_t GetWindowCols() const { return m_WindowCols; }
+	inline const std::vector<float>& GetScales() const { return m_Scales; }
+
+private:
+	std::vector<WindowDetection> ToDetections(const std::vector<Tensor3D>& scoreMaps, float threshold) const;
+
+private:
+	size_t m_FrameRows, m_FrameCols;
+	size_t m_WindowRows, m_WindowCols;
+	size_t m_Stride = 1;
+	std::vector<float> m_Scales;
+	std::vector<Model> m_Models;  // The fully convolutional model of every scale.
+};
+
+namespace_end
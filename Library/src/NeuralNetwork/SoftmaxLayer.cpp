@@ -19,21 +19,17 @@ Tensor3D SoftmaxLayer::FeedForward(const Tensor3D& inputs)
 			inputs.GetDepth() == 1
 		&& "Invalid input params!");
 
-	Tensor3D input = inputs;
-	input.ToHost();
-
-	float sum = 0.0f;
-	for (size_t i = 0; i < m_InputNodes; i++)
-	{
-		sum += exp(input.GetAt(i, 0, 0));
-	}
-
-	Tensor3D output = Map(input, [sum](float v) -> float { return exp(v) / sum; });
+	return Softmax(inputs);
+}
 
-	if (inputs.IsOnDevice())
-		output.ToDevice();
+void SoftmaxLayer::Infer(const Tensor3D& inputs, Tensor3D& output) const
+{
+	assert(inputs.GetRows() == m_InputNodes &&
+		inputs.GetCols() == 1 &&
+		inputs.GetDepth() == 1
+		&& "Invalid input params!");
 
-	return output;
+	Softmax(output, inputs);
 }
 
 Tensor3D SoftmaxLayer::BackPropagation(const Tensor3D& inputs, const CostFunction& costFunction, float learningRate, size_t t)
@@ -43,18 +39,13 @@ Tensor3D SoftmaxLayer::BackPropagation(const Tensor3D& inputs, const CostFunctio
 		inputs.GetDepth() == 1
 		&& "Invalid input params!");
 
-	Tensor3D input = inputs;
-	input.ToHost();
+	Tensor3D output = Softmax(inputs);
 
-	float sum = 0.0f;
-	for (size_t i = 0; i < m_InputNodes; i++)
+	// Softmax head with a cross entropy loss, the gradient respect to the inputs is p - y.
+	if (!NextLayer && costFunction.SoftmaxDiffCost)
 	{
-		sum += exp(input.GetAt(i, 0, 0));
+		return costFunction.SoftmaxDiffCost(output);
 	}
-	Tensor3D output = Map(input, [sum](float v) -> float { return exp(v) / sum; });
-
-	if (inputs.IsOnDevice())
-		output.ToDevice();
 
 	Tensor3D costs = NextLayer ?
 								NextLayer->BackPropagation(output, costFunction, learningRate, t) :
@@ -65,32 +56,7 @@ Tensor3D SoftmaxLayer::BackPropagation(const Tensor3D& inputs, const CostFunctio
 		costs.GetDepth() == 1
 		&& "Invalid input params!");
 
-	costs.ToHost();
-	output.ToHost();
-
-	Tensor3D gradCosts = Tensor3D(m_InputNodes, 1, 1);
-
-	for (size_t i = 0; i < m_InputNodes; i++)
-	{
-		float value = 0.0f;
-		for (size_t j = 0; j < m_InputNodes; j++)
-		{
-			if (i == j)
-			{
-				value += costs.GetAt(j, 0, 0) * output.GetAt(j, 0, 0) * (1.0f - output.GetAt(j, 0, 0));
-			}
-			else
-			{
-				value += costs.GetAt(j, 0, 0) * output.GetAt(j, 0, 0) * output.GetAt(i, 0, 0) * -1.0f;
-			}
-		}
-		gradCosts.SetAt(i, 0, 0, value);
-	}
-
-	if (inputs.IsOnDevice())
-		gradCosts.ToDevice();
-
-	return gradCosts;
+	return SoftmaxJacobianProduct(output, costs);
 }
 
 LayerShape SoftmaxLayer::GetLayerShape() const
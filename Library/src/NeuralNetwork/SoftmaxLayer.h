@@ -15,6 +15,7 @@ public:
 	virtual void ToDevice() override { }
 
 	virtual Tensor3D FeedForward(const Tensor3D& inputs);
+	virtual void Infer(const Tensor3D& inputs, Tensor3D& output) const;
 	virtual Tensor3D BackPropagation(const Tensor3D& inputs, const CostFunction& costFunction, float learningRate, size_t t);
 
 	virtual LayerShape GetLayerShape() const;
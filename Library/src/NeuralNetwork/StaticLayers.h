@@ -0,0 +1,394 @@
+#pragma once
+#include <memory>
+#include <tuple>
+#include <string>
+#include <cmath>
+#include <stdexcept>
+#include <type_traits>
+
+#include "Core.h"
+#include "Model.h"
+#include "ActivationF.h"
+#include "Initializer.h"
+#include "DenseLayer.h"
+#include "ConvolutionalLayer.h"
+#include "MaxPoolingLayer.h"
+#include "ReshapeLayer.h"
+#include "DropoutLayer.h"
+#include "../Math/StaticTensor.h"
+
+
+namespace_start
+
+/*
+	Header only layers with their shapes as template parameters for tiny models (like the XOR model), where the heap allocations,
+	the virtual calls and the ThreadPool dispatch of Model::FeedForward cost more than the arithmetic.
+	The weights are in place, the loops have compile time bounds, a feed forward never allocates and runs on the calling thread.
+
+	The layers load from and convert to their Layer counterpart, so a StaticModel reads and writes the Model's file format.
+	A layer's input can be any StaticTensor of the right size (a reshape is free), the output is in the memory order of the Layer's output.
+*/
+
+struct StaticSigmoid
+{
+	static inline float Apply(float v) { return 1.0f / (1.0f + std::exp(-v)); }
+	static inline bool Matches(const ActivationFunciton& activationFunction) { return activationFunction.Name == "sigmoid"; }
+	static inline ActivationFunciton Get() { return Sigmoid(); }
+};
+
+// The alpha is AlphaNumerator / AlphaDenominator (a float can't be a template parameter).
+template<int AlphaNumerator=0, int AlphaDenominator=1>
+struct StaticRelU
+{
+	static constexpr float Alpha() { return (float)AlphaNumerator / (float)AlphaDenominator; }
+	static inline float Apply(float v) { return v > 0.0f ? v : Alpha() * v; }
+	static inline bool Matches(const ActivationFunciton& activationFunction)
+	{
+		return activationFunction.Name == "RelU" && std::abs(std::stof(activationFunction.Params) - Alpha()) < 1e-6f;
+	}
+	static inline ActivationFunciton Get() { return RelU(Alpha()); }
+};
+
+
+template<size_t In, size_t Out, typename Activation>
+class StaticDense
+{
+public:
+	static constexpr size_t InputRows = In, InputCols = 1, InputDepth = 1, InputSize = In;
+	static constexpr size_t OutputRows = Out, OutputCols = 1, OutputDepth = 1, OutputSize = Out;
+	using Output = StaticTensor<Out, 1, 1>;
+
+	// The weights are (Out, In) row major like the DenseLayer's.
+	alignas(32) float Weights[Out * In] = { };
+	alignas(32) float Bias[Out] = { };
+
+	StaticDense() = default;
+	StaticDense(Initializer initializer)
+	{
+		for (float& weight : Weights) weight = initializer.Init();
+		for (float& bias : Bias) bias = initializer.Init();
+	}
+	StaticDense(const Layer& layer) { Load(layer); }
+
+	template<size_t R, size_t C, size_t D>
+	void FeedForward(const StaticTensor<R, C, D>& input, Output& output) const
+	{
+		static_assert(R * C * D == In, "Invalid input size!");
+		for (size_t o = 0; o < Out; o++)
+		{
+			const float* weights = Weights + o * In;
+			float sum = 0.0f;
+			for (size_t i = 0; i < In; i++)
+				sum += weights[i] * input.Data[i];
+			output.Data[o] = Activation::Apply(sum + Bias[o]);
+		}
+	}
+
+	template<size_t R, size_t C, size_t D>
+	Output FeedForward(const StaticTensor<R, C, D>& input) const
+	{
+		Output output;
+		FeedForward(input, output);
+		return output;
+	}
+
+	void Load(const Layer& layer)
+	{
+		if (layer.GetName() != DenseLayer::ClassName())
+			throw std::runtime_error("StaticDense can't be loaded from: " + layer.GetName());
+
+		const DenseLayer& dense = static_cast<const DenseLayer&>(layer);
+		if (dense.GetWeights().GetRows() != Out || dense.GetWeights().GetCols() != In || !Activation::Matches(dense.GetActivationFunction()))
+			throw std::runtime_error("The DenseLayer does not match the StaticDense.");
+		if (dense.GetWeights().IsOnDevice())
+			throw std::runtime_error("The layer must be on the host.");
+
+		std::copy(dense.GetWeights().GetData(), dense.GetWeights().GetData() + Out * In, Weights);
+		std::copy(dense.GetBias().GetData(), dense.GetBias().GetData() + Out, Bias);
+	}
+
+	std::shared_ptr<Layer> ToLayer() const
+	{
+		// The DenseLayer initializes its weights than its bias in memory order.
+		size_t t = 0;
+		Initializer initializer;
+		initializer.Init = [this, &t]() { return t < Out * In ? Weights[t++] : Bias[t++ - Out * In]; };
+		return std::make_shared<DenseLayer>(In, Out, Activation::Get(), initializer);
+	}
+};
+
+
+template<size_t InRows, size_t InCols, size_t InDepth, size_t KernelRows, size_t KernelCols, size_t NumKernels, size_t Padding,
+	typename Activation, bool IsUseBias=true, size_t Stride=1>
+class StaticConv
+{
+public:
+	static_assert(Stride > 0, "Invalid stride!");
+	static constexpr size_t InputRows = InRows, InputCols = InCols, InputDepth = InDepth, InputSize = InRows * InCols * InDepth;
+	static constexpr size_t OutputRows = (InRows + 2 * Padding - KernelRows) / Stride + 1, OutputCols = (InCols + 2 * Padding - KernelCols) / Stride + 1;
+	static constexpr size_t OutputDepth = NumKernels, OutputSize = OutputRows * OutputCols * NumKernels;
+	using Output = StaticTensor<OutputRows, OutputCols, NumKernels>;
+
+	// The kernels are (KernelRows, KernelCols, InDepth * NumKernels) and the bias is per output element like the ConvolutionalLayer's.
+	alignas(32) float Kernels[KernelRows * KernelCols * InDepth * NumKernels] = { };
+	alignas(32) float Bias[IsUseBias ? OutputSize : 1] = { };
+
+	StaticConv() = default;
+	StaticConv(Initializer initializer)
+	{
+		for (float& weight : Kernels) weight = initializer.Init();
+		if (IsUseBias)
+			for (float& bias : Bias) bias = initializer.Init();
+	}
+	StaticConv(const Layer& layer) { Load(layer); }
+
+	template<size_t R, size_t C, size_t D>
+	void FeedForward(const StaticTensor<R, C, D>& input, Output& output) const
+	{
+		static_assert(R * C * D == InputSize, "Invalid input size!");
+		for (size_t t = 0; t < OutputSize; t++)
+			output.Data[t] = IsUseBias ? Bias[t] : 0.0f;
+
+		// Every kernel weight is added to a rectangle of the output, the padding clips the rectangle (rounded to the stride).
+		for (size_t n = 0; n < NumKernels; n++)
+		for (size_t d = 0; d < InDepth; d++)
+		for (size_t ky = 0; ky < KernelRows; ky++)
+		for (size_t kx = 0; kx < KernelCols; kx++)
+		{
+			const float weight = Kernels[((n * InDepth + d) * KernelRows + ky) * KernelCols + kx];
+			const size_t yStart = Padding > ky ? (Padding - ky + Stride - 1) / Stride : 0;
+			const size_t yEnd = InRows + Padding > ky ? std::min((InRows + Padding - ky - 1) / Stride + 1, OutputRows) : 0;
+			const size_t xStart = Padding > kx ? (Padding - kx + Stride - 1) / Stride : 0;
+			const size_t xEnd = InCols + Padding > kx ? std::min((InCols + Padding - kx - 1) / Stride + 1, OutputCols) : 0;
+			for (size_t y = yStart; y < yEnd; y++)
+			{
+				const float* inputRow = input.Data + (d * InRows + y * Stride + ky - Padding) * InCols + kx - Padding;
+				float* outputRow = output.Data + (n * OutputRows + y) * OutputCols;
+				for (size_t x = xStart; x < xEnd; x++)
+					outputRow[x] += weight * inputRow[x * Stride];
+			}
+		}
+
+		for (size_t t = 0; t < OutputSize; t++)
+			output.Data[t] = Activation::Apply(output.Data[t]);
+	}
+
+	template<size_t R, size_t C, size_t D>
+	Output FeedForward(const StaticTensor<R, C, D>& input) const
+	{
+		Output output;
+		FeedForward(input, output);
+		return output;
+	}
+
+	void Load(const Layer& layer)
+	{
+		if (layer.GetName() != ConvolutionalLayer::ClassName())
+			throw std::runtime_error("StaticConv can't be loaded from: " + layer.GetName());
+
+		const ConvolutionalLayer& conv = static_cast<const ConvolutionalLayer&>(layer);
+		LayerShape shape = conv.GetLayerShape();
+		const Tensor3D& kernels = conv.GetKernels();
+		if (shape.InputRows != InRows || shape.InputCols != InCols || shape.InputDepth != InDepth || conv.GetNumKernels() != NumKernels ||
+			kernels.GetRows() != KernelRows || kernels.GetCols() != KernelCols || conv.GetPadding() != Padding || conv.GetStride() != Stride ||
+			conv.IsUseBias() != IsUseBias || !Activation::Matches(conv.GetActivationFunction()))
+			throw std::runtime_error("The ConvolutionalLayer does not match the StaticConv.");
+		if (kernels.IsOnDevice())
+			throw std::runtime_error("The layer must be on the host.");
+
+		std::copy(kernels.GetData(), kernels.GetData() + KernelRows * KernelCols * InDepth * NumKernels, Kernels);
+		if (IsUseBias)
+			std::copy(conv.GetBias().GetData(), conv.GetBias().GetData() + OutputSize, Bias);
+	}
+
+	std::shared_ptr<Layer> ToLayer() const
+	{
+		Tensor3D kernels(KernelRows, KernelCols, InDepth * NumKernels, (const float*)Kernels, false);
+		if (!IsUseBias)
+			return std::make_shared<ConvolutionalLayer>(InRows, InCols, InDepth, kernels, NumKernels, Padding, Activation::Get(), nullptr, Stride);
+
+		Tensor3D bias(OutputRows, OutputCols, NumKernels, (const float*)Bias, false);
+		return std::make_shared<ConvolutionalLayer>(InRows, InCols, InDepth, kernels, NumKernels, Padding, Activation::Get(), &bias, Stride);
+	}
+};
+
+
+template<size_t InRows, size_t InCols, size_t Depth, size_t PoolingRows, size_t PoolingCols>
+class StaticMaxPool
+{
+public:
+	static constexpr size_t InputRows = InRows, InputCols = InCols, InputDepth = Depth, InputSize = InRows * InCols * Depth;
+	static constexpr size_t OutputRows = InRows / PoolingRows, OutputCols = InCols / PoolingCols, OutputDepth = Depth;
+	static constexpr size_t OutputSize = OutputRows * OutputCols * Depth;
+	using Output = StaticTensor<OutputRows, OutputCols, Depth>;
+
+	StaticMaxPool() = default;
+	StaticMaxPool(const Layer& layer) { Load(layer); }
+
+	template<size_t R, size_t C, size_t D>
+	void FeedForward(const StaticTensor<R, C, D>& input, Output& output) const
+	{
+		static_assert(R * C * D == InputSize, "Invalid input size!");
+		for (size_t d = 0; d < Depth; d++)
+		for (size_t r = 0; r < OutputRows; r++)
+		for (size_t c = 0; c < OutputCols; c++)
+		{
+			const float* window = input.Data + (d * InRows + r * PoolingRows) * InCols + c * PoolingCols;
+			float maxValue = window[0];
+			for (size_t i = 0; i < PoolingRows; i++)
+				for (size_t j = 0; j < PoolingCols; j++)
+					maxValue = std::max(maxValue, window[i * InCols + j]);
+			output.Data[(d * OutputRows + r) * OutputCols + c] = maxValue;
+		}
+	}
+
+	template<size_t R, size_t C, size_t D>
+	Output FeedForward(const StaticTensor<R, C, D>& input) const
+	{
+		Output output;
+		FeedForward(input, output);
+		return output;
+	}
+
+	void Load(const Layer& layer)
+	{
+		if (layer.GetName() != MaxPoolingLayer::ClassName())
+			throw std::runtime_error("StaticMaxPool can't be loaded from: " + layer.GetName());
+
+		const MaxPoolingLayer& pooling = static_cast<const MaxPoolingLayer&>(layer);
+		LayerShape shape = pooling.GetLayerShape();
+		if (shape.InputRows != InRows || shape.InputCols != InCols || shape.InputDepth != Depth ||
+			pooling.GetPoolingHeight() != PoolingRows || pooling.GetPoolingWidth() != PoolingCols)
+			throw std::runtime_error("The MaxPoolingLayer does not match the StaticMaxPool.");
+	}
+
+	std::shared_ptr<Layer> ToLayer() const
+	{
+		return std::make_shared<MaxPoolingLayer>(InRows, InCols, Depth, PoolingRows, PoolingCols);
+	}
+};
+
+
+/*
+	A chain of static layers, the intermediates are locals of the feed forward.
+	Loads from a Model (or a model file) with the same layers, the ReshapeLayers and DropoutLayers of the Model are skipped.
+	ToModel inserts a ReshapeLayer between layers with different shapes (but the same size).
+*/
+template<typename... Layers>
+class StaticModel
+{
+	static_assert(sizeof...(Layers) > 0, "A StaticModel needs a layer!");
+	using LayerTuple = std::tuple<Layers...>;
+	template<size_t I> using LayerAt = typename std::tuple_element<I, LayerTuple>::type;
+	static constexpr size_t NumLayers = sizeof...(Layers);
+
+public:
+	using Input = StaticTensor<LayerAt<0>::InputRows, LayerAt<0>::InputCols, LayerAt<0>::InputDepth>;
+	using Output = typename LayerAt<NumLayers - 1>::Output;
+
+	StaticModel() = default;
+	StaticModel(const Model& model) { Load(model); }
+	StaticModel(const std::string& filePath) { Load(Model(filePath)); }
+
+	void FeedForward(const Input& input, Output& output) const
+	{
+		Forward<0>(input, output, std::integral_constant<bool, NumLayers == 1>());
+	}
+	Output FeedForward(const Input& input) const
+	{
+		Output output;
+		FeedForward(input, output);
+		return output;
+	}
+
+	void Load(const Model& model)
+	{
+		std::shared_ptr<Layer> layer = model.GetRootLayer();
+		LoadLayer<0>(layer, std::integral_constant<bool, NumLayers == 0>());
+		for (; layer && IsSkipped(*layer); layer = layer->NextLayer);
+		if (layer)
+			throw std::runtime_error("The model has more layers than the StaticModel.");
+	}
+
+	Model ToModel() const
+	{
+		Model model;
+		AddLayer<0>(model, std::integral_constant<bool, NumLayers == 0>());
+		return model;
+	}
+
+	// The Model's file format, the layers' optimizers are SGD.
+	void Save(const std::string& filePath) const
+	{
+		Model model = ToModel();
+		model.InitializeOptimizer(OptimizerFactory(OptimizerType::SGD));
+		model.Save(filePath);
+	}
+
+	template<size_t I> inline LayerAt<I>& GetLayer() { return std::get<I>(m_Layers); }
+	template<size_t I> inline const LayerAt<I>& GetLayer() const { return std::get<I>(m_Layers); }
+
+private:
+	template<size_t I, typename T>
+	void Forward(const T& input, Output& output, std::true_type /*isLast*/) const
+	{
+		std::get<I>(m_Layers).FeedForward(input, output);
+	}
+	template<size_t I, typename T>
+	void Forward(const T& input, Output& output, std::false_type /*isLast*/) const
+	{
+		static_assert(LayerAt<I>::OutputSize == LayerAt<I + 1>::InputSize, "The layers' sizes do not match!");
+		typename LayerAt<I>::Output next;
+		std::get<I>(m_Layers).FeedForward(input, next);
+		Forward<I + 1>(next, output, std::integral_constant<bool, I + 2 == NumLayers>());
+	}
+
+	static bool IsSkipped(const Layer& layer)
+	{
+		return layer.GetName() == ReshapeLayer::ClassName() || layer.GetName() == DropoutLayer::ClassName();
+	}
+
+	template<size_t I>
+	void LoadLayer(std::shared_ptr<Layer>&, std::true_type /*isEnd*/) { }
+	template<size_t I>
+	void LoadLayer(std::shared_ptr<Layer>& layer, std::false_type /*isEnd*/)
+	{
+		for (; layer && IsSkipped(*layer); layer = layer->NextLayer);
+		if (!layer)
+			throw std::runtime_error("The model has less layers than the StaticModel.");
+
+		std::get<I>(m_Layers).Load(*layer);
+		layer = layer->NextLayer;
+		LoadLayer<I + 1>(layer, std::integral_constant<bool, I + 1 == NumLayers>());
+	}
+
+	template<size_t I>
+	void AddLayer(Model&, std::true_type /*isEnd*/) const { }
+	template<size_t I>
+	void AddLayer(Model& model, std::false_type /*isEnd*/) const
+	{
+		AddReshape<I>(model, std::integral_constant<bool, I == 0>());
+		model.AddLayer(std::get<I>(m_Layers).ToLayer());
+		AddLayer<I + 1>(model, std::integral_constant<bool, I + 1 == NumLayers>());
+	}
+
+	template<size_t I>
+	void AddReshape(Model&, std::true_type /*isFirst*/) const { }
+	template<size_t I>
+	void AddReshape(Model& model, std::false_type /*isFirst*/) const
+	{
+		using Previous = LayerAt<I - 1>;
+		using Current = LayerAt<I>;
+		if (Previous::OutputRows != Current::InputRows || Previous::OutputCols != Current::InputCols || Previous::OutputDepth != Current::InputDepth)
+		{
+			model.AddLayer(std::make_shared<ReshapeLayer>(
+				Previous::OutputRows, Previous::OutputCols, Previous::OutputDepth,
+				Current::InputRows, Current::InputCols, Current::InputDepth));
+		}
+	}
+
+private:
+	LayerTuple m_Layers;
+};
+
+namespace_end
@@ -0,0 +1,166 @@
+#include "ProcessGroup.h"
+#include <assert.h>
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
+#include <chrono>
+#include <thread>
+#include <limits.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+namespace_start
+
+static const uint32_t ProcessGroupMagic = 0x50474F4D;  // "MOGP"
+
+struct ProcessGroupHeader
+{
+	std::atomic<uint32_t> Magic;
+	uint32_t WorldSize;
+	uint64_t Capacity;
+	// The barrier's counter and generation on their own cache lines, the waiting ranks only read the generation.
+	alignas(64) std::atomic<uint32_t> BarrierCount;
+	alignas(64) std::atomic<uint32_t> BarrierGeneration;
+};
+
+static const size_t HeaderSize = (sizeof(ProcessGroupHeader) + 63) / 64 * 64;
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "The futex needs a plain 32 bit atomic!");
+
+static void WaitWhileEqual(std::atomic<uint32_t>* address, uint32_t value)
+{
+	// Short waits spin, a barrier is often reached by every rank at about the same time.
+	for (size_t spin = 0; spin < 1024; spin++)
+	{
+		if (address->load(std::memory_order_acquire) != value)
+			return;
+	}
+
+	while (address->load(std::memory_order_acquire) == value)
+	{
+#ifdef __linux__
+		// Not a private futex: the waiters are in different processes.
+		syscall(SYS_futex, (uint32_t*)address, FUTEX_WAIT, value, nullptr, nullptr, 0);
+#else
+		std::this_thread::yield();
+#endif
+	}
+}
+
+static void WakeAll(std::atomic<uint32_t>* address)
+{
+#ifdef __linux__
+	syscall(SYS_futex, (uint32_t*)address, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+
+ProcessGroup::ProcessGroup(const std::string& name, size_t rank, size_t worldSize, size_t capacity)
+	: m_Rank(rank), m_WorldSize(worldSize), m_Capacity(capacity)
+{
+	assert(worldSize > 0 && rank < worldSize && capacity > 0 && "Invalid process group!");
+
+	m_Memory = std::make_unique<SharedMemory>(name, HeaderSize + (worldSize + 1) * capacity * sizeof(float), rank == 0);
+	m_Header = (ProcessGroupHeader*)m_Memory->GetData();
+
+	if (m_Rank == 0)
+	{
+		// The segment is zeroed, the magic is written last: the other ranks read the header after it.
+		m_Header->WorldSize = (uint32_t)worldSize;
+		m_Header->Capacity = capacity;
+		m_Header->Magic.store(ProcessGroupMagic, std::memory_order_release);
+	}
+	else
+	{
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+		while (m_Header->Magic.load(std::memory_order_acquire) != ProcessGroupMagic)
+		{
+			if (std::chrono::steady_clock::now() > deadline)
+				throw std::runtime_error("The process group was not initialized by rank 0: " + name);
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		if (m_Header->WorldSize != worldSize || m_Header->Capacity != capacity)
+			throw std::runtime_error("The process group's world size or capacity does not match: " + name);
+	}
+
+	// Every rank has attached when the first barrier is passed.
+	Barrier();
+}
+
+ProcessGroup::~ProcessGroup()
+{
+}
+
+float* ProcessGroup::GetSlot(size_t rank) const
+{
+	return (float*)(m_Memory->GetData() + HeaderSize) + rank * m_Capacity;
+}
+
+float* ProcessGroup::GetResult() const
+{
+	return GetSlot(m_WorldSize);
+}
+
+void ProcessGroup::Barrier()
+{
+	const uint32_t generation = m_Header->BarrierGeneration.load(std::memory_order_acquire);
+	if (m_Header->BarrierCount.fetch_add(1, std::memory_order_acq_rel) + 1 == m_WorldSize)
+	{
+		// The last rank resets the counter before the others are released, so they can arrive at the next barrier.
+		m_Header->BarrierCount.store(0, std::memory_order_relaxed);
+		m_Header->BarrierGeneration.fetch_add(1, std::memory_order_acq_rel);
+		WakeAll(&m_Header->BarrierGeneration);
+	}
+	else
+	{
+		WaitWhileEqual(&m_Header->BarrierGeneration, generation);
+	}
+}
+
+void ProcessGroup::AllReduce(float* data, size_t size)
+{
+	for (size_t offset = 0; offset < size; offset += m_Capacity)
+	{
+		const size_t partSize = std::min(m_Capacity, size - offset);
+		std::copy(data + offset, data + offset + partSize, GetSlot(m_Rank));
+		Barrier();
+
+		// The result is only written between the two barriers, it is read until the next operation's first barrier.
+		const size_t start = m_Rank * partSize / m_WorldSize, end = (m_Rank + 1) * partSize / m_WorldSize;
+		float* result = GetResult();
+		std::copy(GetSlot(0) + start, GetSlot(0) + end, result + start);
+		for (size_t rank = 1; rank < m_WorldSize; rank++)
+		{
+			const float* slot = GetSlot(rank);
+			for (size_t i = start; i < end; i++)
+				result[i] += slot[i];
+		}
+		Barrier();
+
+		std::copy(result, result + partSize, data + offset);
+	}
+}
+
+void ProcessGroup::Broadcast(float* data, size_t size, size_t root)
+{
+	assert(root < m_WorldSize && "Invalid root!");
+
+	for (size_t offset = 0; offset < size; offset += m_Capacity)
+	{
+		const size_t partSize = std::min(m_Capacity, size - offset);
+		if (m_Rank == root)
+			std::copy(data + offset, data + offset + partSize, GetSlot(root));
+		Barrier();
+
+		if (m_Rank != root)
+			std::copy(GetSlot(root), GetSlot(root) + partSize, data + offset);
+		Barrier();
+	}
+}
+
+namespace_end
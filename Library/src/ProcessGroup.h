@@ -0,0 +1,52 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <stdint.h>
+
+#include "Core.h"
+#include "SharedMemory.h"
+
+
+namespace_start
+
+struct ProcessGroupHeader;
+
+/*
+	The worldSize processes of a host (or threads) cooperating through a named shared memory segment, for the multi process training.
+	Every rank constructs the group with the same name, world size and capacity; rank 0 owns the segment, so the name should be unique per launch
+	(a stale segment of a crashed launch is replaced only when rank 0 creates it before the others open it).
+
+	The collective operations must be called by every rank in the same order. A barrier waits on a futex on Linux (it spins and yields elsewhere).
+	The reductions sum in rank order, so the results are the same in every rank and in every run.
+*/
+class LIBRARY_API ProcessGroup
+{
+public:
+	// capacity: the number of floats a collective operation can take at once, larger buffers are processed in parts.
+	ProcessGroup(const std::string& name, size_t rank, size_t worldSize, size_t capacity=1 << 20);
+	~ProcessGroup();
+
+	ProcessGroup(const ProcessGroup&) = delete;
+	ProcessGroup& operator=(const ProcessGroup&) = delete;
+
+	void Barrier();
+	// The data becomes the sum of every rank's data. Every rank reduces a contiguous chunk of the slots (a reduce scatter), than gathers the sums.
+	void AllReduce(float* data, size_t size);
+	// The data becomes the root's data.
+	void Broadcast(float* data, size_t size, size_t root=0);
+
+	inline size_t GetRank() const { return m_Rank; }
+	inline size_t GetWorldSize() const { return m_WorldSize; }
+	inline size_t GetCapacity() const { return m_Capacity; }
+
+private:
+	float* GetSlot(size_t rank) const;
+	float* GetResult() const;
+
+private:
+	size_t m_Rank, m_WorldSize, m_Capacity;
+	std::unique_ptr<SharedMemory> m_Memory;
+	ProcessGroupHeader* m_Header = nullptr;
+};
+
+namespace_end
@@ -0,0 +1,86 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include <thread>
+
+#include "Core.h"
+
+
+namespace_start
+
+/*
+	A bounded lock free queue between one producer thread and one consumer thread (a ring buffer with a power of two capacity).
+	Push waits while the queue is full, Pop waits while it is empty (spinning, than yielding).
+*/
+template<typename T>
+class SPSCQueue
+{
+public:
+	SPSCQueue(size_t capacity)
+	{
+		size_t size = 1;
+		while (size < capacity)
+			size *= 2;
+		m_Items.resize(size);
+		m_Mask = size - 1;
+	}
+
+	SPSCQueue(const SPSCQueue&) = delete;
+	SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+	bool TryPush(const T& item)
+	{
+		const size_t tail = m_Tail.load(std::memory_order_relaxed);
+		if (tail - m_Head.load(std::memory_order_acquire) > m_Mask)
+			return false;
+
+		m_Items[tail & m_Mask] = item;
+		m_Tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool TryPop(T& item)
+	{
+		const size_t head = m_Head.load(std::memory_order_relaxed);
+		if (head == m_Tail.load(std::memory_order_acquire))
+			return false;
+
+		item = m_Items[head & m_Mask];
+		m_Head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	void Push(const T& item)
+	{
+		for (size_t spin = 0; !TryPush(item); spin++)
+		{
+			if (spin >= 64)
+				std::this_thread::yield();
+		}
+	}
+
+	T Pop()
+	{
+		T item;
+		for (size_t spin = 0; !TryPop(item); spin++)
+		{
+			if (spin >= 64)
+				std::this_thread::yield();
+		}
+		return item;
+	}
+
+	inline size_t GetCapacity() const { return m_Items.size(); }
+
+private:
+	std::vector<T> m_Items;
+	size_t m_Mask = 0;
+	// The consumer's and the producer's index on their own cache lines.
+	char m_HeadPadding[64];
+	std::atomic<size_t> m_Head{ 0 };
+	char m_TailPadding[64];
+	std::atomic<size_t> m_Tail{ 0 };
+	char m_EndPadding[64];
+};
+
+namespace_end
@@ -0,0 +1,521 @@
+#include "HNSWIndex.h"
+#include <assert.h>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <queue>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstddef>
+
+#include "../Math/Operation.h"
+
+
+namespace_start
+
+namespace
+{
+	const char FileMagic[8] = { 'M', 'O', 'G', 'I', 'H', 'N', 'S', 'W' };
+	const uint64_t FileVersion = 2;
+
+	struct FileHeader
+	{
+		char Magic[8];
+		uint64_t Version;
+		uint64_t Dimension, MaxConnections, EfConstruction;
+		uint64_t Count, NumRemoved, UpperLinksSize;
+		int64_t EntryPoint, MaxLevel;
+		uint64_t Checksum;  // Since version 2.
+	};
+
+	// Every array of the file starts at a multiple of 8 bytes.
+	size_t Align(size_t offset) { return (offset + 7) / 8 * 8; }
+}
+
+std::string SearchRecallReport::ToString() const
+{
+	std::stringstream ss;
+
+	ss << "Recall@" << K << " over " << NumQueries << " # queries (ef: " << Ef << "): " << Recall * 100.0f << "%, " <<
+		"search: " << Microseconds << " us, exact search: " << ExactMicroseconds << " us";
+
+	return ss.str();
+}
+
+HNSWIndex::HNSWIndex(size_t dimension, size_t maxConnections, size_t efConstruction, unsigned int seed)
+	: m_Dimension(dimension), m_MaxConnections(std::max(maxConnections, size_t(2))), m_MaxConnections0(2 * m_MaxConnections),
+	m_EfConstruction(std::max(efConstruction, m_MaxConnections)), m_LevelFactor(1.0 / std::log((double)m_MaxConnections)), m_Random(seed)
+{
+}
+
+HNSWIndex::HNSWIndex(const std::string& filePath)
+	: m_Dimension(0), m_MaxConnections(2), m_MaxConnections0(4), m_EfConstruction(2), m_LevelFactor(1.0), m_Random(42)
+{
+	Load(filePath);
+}
+
+size_t HNSWIndex::Add(const float* vector)
+{
+	assert(m_Count < UINT32_MAX && "Too many vectors!");
+	Detach();
+
+	const uint32_t id = (uint32_t)m_Count;
+	std::uniform_real_distribution<double> distribution(std::numeric_limits<double>::min(), 1.0);
+	const int32_t level = (int32_t)(-std::log(distribution(m_Random)) * m_LevelFactor);
+
+	m_Vectors.insert(m_Vectors.end(), vector, vector + m_Dimension);  // The vector can't be an element of m_Vectors.
+	m_Levels.push_back(level);
+	m_Removed.push_back(0);
+	m_Links0.resize(m_Links0.size() + m_MaxConnections0 + 1, 0);
+	m_UpperOffsets.push_back(m_UpperLinks.size());
+	m_UpperLinks.resize(m_UpperLinks.size() + level * (m_MaxConnections + 1), 0);
+	m_Count++;
+	UpdateViews();
+
+	const float* query = GetVector(id);
+	if (m_MaxLevel < 0)
+	{
+		m_EntryPoint = id;
+		m_MaxLevel = level;
+		return id;
+	}
+
+	uint32_t entryPoint = m_EntryPoint;
+	for (int l = m_MaxLevel; l > level; l--)
+	{
+		entryPoint = SearchClosest(query, entryPoint, l);
+	}
+
+	std::vector<uint8_t> visited;
+	for (int l = std::min(level, m_MaxLevel); l >= 0; l--)
+	{
+		std::vector<Candidate> candidates = SearchLayer(query, entryPoint, m_EfConstruction, l, visited);
+		std::vector<Candidate> neighbors = SelectNeighbors(candidates, m_MaxConnections);
+
+		uint32_t* links = GetMutableLinks(id, l);
+		links[0] = (uint32_t)neighbors.size();
+		for (size_t i = 0; i < neighbors.size(); i++)
+		{
+			links[i + 1] = neighbors[i].second;
+			Connect(neighbors[i].second, id, l);
+		}
+
+		entryPoint = candidates.front().second;
+	}
+
+	if (level > m_MaxLevel)
+	{
+		m_EntryPoint = id;
+		m_MaxLevel = level;
+	}
+
+	return id;
+}
+
+void HNSWIndex::Add(const Tensor2D& rows)
+{
+	assert(rows.GetCols() == m_Dimension && "Invalid vector size!");
+
+	if (rows.IsOnDevice())
+		throw std::runtime_error("The index is only implemented on the host.");
+
+	std::vector<float> row(m_Dimension);
+	for (size_t r = 0; r < rows.GetRows(); r++)
+	{
+		for (size_t c = 0; c < m_Dimension; c++)
+		{
+			row[c] = rows.GetAt(r, c);
+		}
+		Add(row.data());
+	}
+}
+
+bool HNSWIndex::Remove(size_t id)
+{
+	if (id >= m_Count || IsRemoved(id))
+		return false;
+
+	Detach();
+	m_Removed[id] = 1;
+	m_NumRemoved++;
+	return true;
+}
+
+void HNSWIndex::Connect(uint32_t id, uint32_t neighbor, int level)
+{
+	const size_t maxCount = level == 0 ? m_MaxConnections0 : m_MaxConnections;
+	uint32_t* links = GetMutableLinks(id, level);
+
+	if (links[0] < maxCount)
+	{
+		links[++links[0]] = neighbor;
+		return;
+	}
+
+	// The links are full, the new set is selected from the old links and the new one.
+	const float* base = GetVector(id);
+	std::vector<Candidate> candidates;
+	candidates.reserve(maxCount + 1);
+	candidates.emplace_back(SquaredDistance(base, GetVector(neighbor), m_Dimension), neighbor);
+	for (uint32_t i = 1; i <= links[0]; i++)
+	{
+		candidates.emplace_back(SquaredDistance(base, GetVector(links[i]), m_Dimension), links[i]);
+	}
+	std::sort(candidates.begin(), candidates.end());
+
+	std::vector<Candidate> selected = SelectNeighbors(candidates, maxCount);
+	links[0] = (uint32_t)selected.size();
+	for (size_t i = 0; i < selected.size(); i++)
+	{
+		links[i + 1] = selected[i].second;
+	}
+}
+
+std::vector<HNSWIndex::Candidate> HNSWIndex::SelectNeighbors(const std::vector<Candidate>& candidates, size_t maxCount) const
+{
+	std::vector<Candidate> selected;
+	std::vector<Candidate> pruned;
+
+	for (const Candidate& candidate : candidates)
+	{
+		if (selected.size() >= maxCount)
+			break;
+
+		bool isCloserToBase = true;
+		for (const Candidate& other : selected)
+		{
+			if (SquaredDistance(GetVector(candidate.second), GetVector(other.second), m_Dimension) < candidate.first)
+			{
+				isCloserToBase = false;
+				break;
+			}
+		}
+
+		if (isCloserToBase)
+			selected.push_back(candidate);
+		else
+			pruned.push_back(candidate);
+	}
+
+	// The pruned candidates fill up the links, so the sparse regions stay connected.
+	for (size_t i = 0; i < pruned.size() && selected.size() < maxCount; i++)
+	{
+		selected.push_back(pruned[i]);
+	}
+
+	return selected;
+}
+
+uint32_t HNSWIndex::SearchClosest(const float* query, uint32_t entryPoint, int level) const
+{
+	uint32_t closest = entryPoint;
+	float closestDistance = SquaredDistance(query, GetVector(closest), m_Dimension);
+
+	bool isChanged = true;
+	while (isChanged)
+	{
+		isChanged = false;
+		const uint32_t* links = GetLinks(closest, level);
+		for (uint32_t i = 1; i <= links[0]; i++)
+		{
+			float distance = SquaredDistance(query, GetVector(links[i]), m_Dimension);
+			if (distance < closestDistance)
+			{
+				closest = links[i];
+				closestDistance = distance;
+				isChanged = true;
+			}
+		}
+	}
+
+	return closest;
+}
+
+std::vector<HNSWIndex::Candidate> HNSWIndex::SearchLayer(const float* query, uint32_t entryPoint, size_t ef, int level, std::vector<uint8_t>& visited) const
+{
+	visited.assign(m_Count, 0);
+
+	// The candidates to expand (nearest first) and the ef nearest found (farthest first).
+	std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;
+	std::priority_queue<Candidate> nearest;
+
+	float entryDistance = SquaredDistance(query, GetVector(entryPoint), m_Dimension);
+	candidates.emplace(entryDistance, entryPoint);
+	nearest.emplace(entryDistance, entryPoint);
+	visited[entryPoint] = 1;
+
+	while (!candidates.empty())
+	{
+		Candidate current = candidates.top();
+		if (current.first > nearest.top().first && nearest.size() >= ef)
+			break;
+		candidates.pop();
+
+		const uint32_t* links = GetLinks(current.second, level);
+		for (uint32_t i = 1; i <= links[0]; i++)
+		{
+			uint32_t neighbor = links[i];
+			if (visited[neighbor])
+				continue;
+			visited[neighbor] = 1;
+
+			float distance = SquaredDistance(query, GetVector(neighbor), m_Dimension);
+			if (nearest.size() < ef || distance < nearest.top().first)
+			{
+				candidates.emplace(distance, neighbor);
+				nearest.emplace(distance, neighbor);
+				if (nearest.size() > ef)
+					nearest.pop();
+			}
+		}
+	}
+
+	std::vector<Candidate> result(nearest.size());
+	for (size_t i = result.size(); i > 0; i--)
+	{
+		result[i - 1] = nearest.top();
+		nearest.pop();
+	}
+	return result;
+}
+
+std::vector<SearchResult> HNSWIndex::Search(const float* query, size_t k, size_t ef) const
+{
+	std::vector<SearchResult> results;
+	if (GetSize() == 0 || k == 0)
+		return results;
+
+	uint32_t entryPoint = m_EntryPoint;
+	for (int l = m_MaxLevel; l > 0; l--)
+	{
+		entryPoint = SearchClosest(query, entryPoint, l);
+	}
+
+	// The removed vectors take places of the candidates, the search is repeated with more when they are not enough.
+	std::vector<uint8_t> visited;
+	for (ef = std::max(ef, k); ; ef *= 2)
+	{
+		std::vector<Candidate> candidates = SearchLayer(query, entryPoint, ef, 0, visited);
+
+		results.clear();
+		for (const Candidate& candidate : candidates)
+		{
+			if (results.size() >= k)
+				break;
+			if (!IsRemoved(candidate.second))
+				results.push_back({ candidate.second, candidate.first });
+		}
+
+		if (results.size() >= std::min(k, GetSize()) || candidates.size() < ef)
+			break;
+	}
+
+	return results;
+}
+
+std::vector<SearchResult> HNSWIndex::ExactSearch(const float* query, size_t k) const
+{
+	std::vector<SearchResult> results;
+	for (size_t id = 0; id < m_Count; id++)
+	{
+		if (!IsRemoved(id))
+			results.push_back({ id, SquaredDistance(query, GetVector(id), m_Dimension) });
+	}
+
+	k = std::min(k, results.size());
+	std::partial_sort(results.begin(), results.begin() + k, results.end(),
+		[](const SearchResult& left, const SearchResult& right) { return left.Distance < right.Distance; });
+	results.resize(k);
+	return results;
+}
+
+SearchRecallReport HNSWIndex::EvaluateRecall(const Tensor2D& queries, size_t k, size_t ef) const
+{
+	assert(queries.GetCols() == m_Dimension && "Invalid query size!");
+
+	SearchRecallReport report;
+	report.NumQueries = queries.GetRows();
+	report.K = k;
+	report.Ef = ef;
+
+	size_t numFound = 0, numExact = 0;
+	double microseconds = 0.0, exactMicroseconds = 0.0;
+	std::vector<float> query(m_Dimension);
+	for (size_t r = 0; r < queries.GetRows(); r++)
+	{
+		for (size_t c = 0; c < m_Dimension; c++)
+		{
+			query[c] = queries.GetAt(r, c);
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<SearchResult> results = Search(query.data(), k, ef);
+		auto end = std::chrono::high_resolution_clock::now();
+		std::vector<SearchResult> exactResults = ExactSearch(query.data(), k);
+		auto exactEnd = std::chrono::high_resolution_clock::now();
+
+		microseconds += std::chrono::duration<double, std::micro>(end - start).count();
+		exactMicroseconds += std::chrono::duration<double, std::micro>(exactEnd - end).count();
+
+		for (const SearchResult& exact : exactResults)
+		{
+			numFound += std::any_of(results.begin(), results.end(), [&exact](const SearchResult& result) { return result.Id == exact.Id; });
+		}
+		numExact += exactResults.size();
+	}
+
+	if (numExact)
+		report.Recall = (float)numFound / numExact;
+	if (report.NumQueries)
+	{
+		report.Microseconds = microseconds / report.NumQueries;
+		report.ExactMicroseconds = exactMicroseconds / report.NumQueries;
+	}
+	return report;
+}
+
+void HNSWIndex::Save(const std::string& filePath) const
+{
+	FileHeader header;
+	std::memcpy(header.Magic, FileMagic, sizeof(FileMagic));
+	header.Version = FileVersion;
+	header.Dimension = m_Dimension;
+	header.MaxConnections = m_MaxConnections;
+	header.EfConstruction = m_EfConstruction;
+	header.Count = m_Count;
+	header.NumRemoved = m_NumRemoved;
+	header.UpperLinksSize = m_Count ? m_UpperOffsetsView[m_Count - 1] + m_LevelsView[m_Count - 1] * (m_MaxConnections + 1) : 0;
+	header.EntryPoint = m_EntryPoint;
+	header.MaxLevel = m_MaxLevel;
+	header.Checksum = Checksum(m_VectorsView, m_Count, m_Dimension);
+
+	std::ofstream file(filePath, std::ios::binary);
+	if (!file.is_open())
+		throw std::runtime_error("Could not open file: " + filePath);
+
+	size_t offset = 0;
+	auto write = [&](const void* data, size_t size)
+	{
+		static const char padding[8] = { 0 };
+		file.write(padding, Align(offset) - offset);
+		file.write((const char*)data, size);
+		offset = Align(offset) + size;
+	};
+
+	write(&header, sizeof(header));
+	write(m_VectorsView, m_Count * m_Dimension * sizeof(float));
+	write(m_LevelsView, m_Count * sizeof(int32_t));
+	write(m_RemovedView, m_Count * sizeof(uint8_t));
+	write(m_Links0View, m_Count * (m_MaxConnections0 + 1) * sizeof(uint32_t));
+	write(m_UpperOffsetsView, m_Count * sizeof(uint64_t));
+	write(m_UpperLinksView, header.UpperLinksSize * sizeof(uint32_t));
+}
+
+void HNSWIndex::Load(const std::string& filePath)
+{
+	std::unique_ptr<MappedFile> file = std::make_unique<MappedFile>(filePath);
+
+	// The header of the version 1 files ends before the checksum.
+	FileHeader header = {};
+	const size_t headerSize = file->GetSize() >= sizeof(header) ? sizeof(header) : offsetof(FileHeader, Checksum);
+	if (file->GetSize() < headerSize)
+		throw std::runtime_error("Invalid index file: " + filePath);
+	std::memcpy(&header, file->GetData(), headerSize);
+	if (std::memcmp(header.Magic, FileMagic, sizeof(FileMagic)) != 0 || (header.Version != FileVersion && header.Version != 1) ||
+		(header.Version == FileVersion && headerSize != sizeof(header)))
+		throw std::runtime_error("Invalid index file: " + filePath);
+	if (header.Version == 1)
+		header.Checksum = 0;
+	if (header.Dimension == 0 || header.MaxConnections < 2 || header.NumRemoved > header.Count ||
+		(header.Count && (header.EntryPoint < 0 || (uint64_t)header.EntryPoint >= header.Count)))
+		throw std::runtime_error("Invalid index file: " + filePath);
+
+	// Every view is checked before the index is changed, a truncated file leaves the index as it was.
+	const size_t count = header.Count, dimension = header.Dimension, maxConnections0 = 2 * header.MaxConnections;
+	size_t offset = header.Version == 1 ? offsetof(FileHeader, Checksum) : sizeof(header);
+	auto view = [&](size_t size) -> const uint8_t*
+	{
+		offset = Align(offset);
+		if (offset > file->GetSize() || size > file->GetSize() - offset)
+			throw std::runtime_error("Invalid index file: " + filePath);
+		const uint8_t* data = file->GetData() + offset;
+		offset += size;
+		return data;
+	};
+
+	const float* vectorsView = (const float*)view(count * dimension * sizeof(float));
+	const int32_t* levelsView = (const int32_t*)view(count * sizeof(int32_t));
+	const uint8_t* removedView = view(count * sizeof(uint8_t));
+	const uint32_t* links0View = (const uint32_t*)view(count * (maxConnections0 + 1) * sizeof(uint32_t));
+	const uint64_t* upperOffsetsView = (const uint64_t*)view(count * sizeof(uint64_t));
+	const uint32_t* upperLinksView = (const uint32_t*)view(header.UpperLinksSize * sizeof(uint32_t));
+
+	m_Dimension = dimension;
+	m_MaxConnections = header.MaxConnections;
+	m_MaxConnections0 = maxConnections0;
+	m_EfConstruction = header.EfConstruction;
+	m_LevelFactor = 1.0 / std::log((double)m_MaxConnections);
+	m_Count = count;
+	m_NumRemoved = header.NumRemoved;
+	m_EntryPoint = (uint32_t)header.EntryPoint;
+	m_MaxLevel = (int32_t)header.MaxLevel;
+	m_FileChecksum = header.Checksum;
+
+	m_VectorsView = vectorsView;
+	m_LevelsView = levelsView;
+	m_RemovedView = removedView;
+	m_Links0View = links0View;
+	m_UpperOffsetsView = upperOffsetsView;
+	m_UpperLinksView = upperLinksView;
+
+	m_Vectors.clear();
+	m_Levels.clear();
+	m_Removed.clear();
+	m_Links0.clear();
+	m_UpperOffsets.clear();
+	m_UpperLinks.clear();
+	m_File = std::move(file);
+}
+
+uint64_t HNSWIndex::Checksum(const float* vectors, size_t count, size_t dimension)
+{
+	// FNV-1a over the bits of the values.
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t t = 0; t < count * dimension; t++)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, vectors + t, sizeof(bits));
+		hash = (hash ^ bits) * 1099511628211ull;
+	}
+	return hash;
+}
+
+void HNSWIndex::Detach()
+{
+	if (!m_File)
+		return;
+
+	size_t upperLinksSize = m_Count ? m_UpperOffsetsView[m_Count - 1] + m_LevelsView[m_Count - 1] * (m_MaxConnections + 1) : 0;
+	m_Vectors.assign(m_VectorsView, m_VectorsView + m_Count * m_Dimension);
+	m_Levels.assign(m_LevelsView, m_LevelsView + m_Count);
+	m_Removed.assign(m_RemovedView, m_RemovedView + m_Count);
+	m_Links0.assign(m_Links0View, m_Links0View + m_Count * (m_MaxConnections0 + 1));
+	m_UpperOffsets.assign(m_UpperOffsetsView, m_UpperOffsetsView + m_Count);
+	m_UpperLinks.assign(m_UpperLinksView, m_UpperLinksView + upperLinksSize);
+
+	m_File.reset();
+	UpdateViews();
+}
+
+void HNSWIndex::UpdateViews()
+{
+	m_VectorsView = m_Vectors.data();
+	m_LevelsView = m_Levels.data();
+	m_RemovedView = m_Removed.data();
+	m_Links0View = m_Links0.data();
+	m_UpperOffsetsView = m_UpperOffsets.data();
+	m_UpperLinksView = m_UpperLinks.data();
+}
+
+namespace_end
@@ -0,0 +1,132 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <memory>
+#include <random>
+#include <stdint.h>
+
+#include "Core.h"
+#include "../Math/Tensor2D.h"
+#include "../MappedFile.h"
+
+
+namespace_start
+
+struct LIBRARY_API SearchResult
+{
+	size_t Id;
+	float Distance;  // Squared euclidean distance.
+};
+
+// Recall of the approximate search against the exact search.
+struct LIBRARY_API SearchRecallReport
+{
+	size_t NumQueries = 0, K = 0, Ef = 0;
+	float Recall = 0.0f;  // Rate of the exact k nearest found by the approximate search.
+	float Microseconds = 0.0f, ExactMicroseconds = 0.0f;  // Average search time of a query.
+
+	std::string ToString() const;
+};
+
+/*
+	Approximate nearest neighbor index (hierarchical navigable small world graph) of vectors with squared euclidean distance.
+	Vectors get consecutive ids as they are added, removed vectors are kept in the graph for the navigation
+	but they are never returned.
+
+	The file format is the memory layout of the index, Load maps the file and the index searches the mapped memory,
+	the first Add or Remove copies it to the memory. The file has the machine's byte order and the checksum of the vectors.
+*/
+class LIBRARY_API HNSWIndex
+{
+public:
+	// maxConnections: the links of a vector per layer (twice as many on the bottom layer).
+	// efConstruction: the number of candidates while a vector is added.
+	HNSWIndex(size_t dimension, size_t maxConnections = 16, size_t efConstruction = 200, unsigned int seed = 42);
+	HNSWIndex(const std::string& filePath);
+
+	HNSWIndex(const HNSWIndex&) = delete;
+	HNSWIndex& operator=(const HNSWIndex&) = delete;
+	HNSWIndex(HNSWIndex&&) = default;
+	HNSWIndex& operator=(HNSWIndex&&) = default;
+
+	// Returns the id of the vector.
+	size_t Add(const float* vector);
+	// Adds every row as a vector.
+	void Add(const Tensor2D& rows);
+	// Returns false if there is no such vector or it is already removed.
+	bool Remove(size_t id);
+
+	// The k nearest vectors in increasing distance, ef is the number of candidates on the bottom layer (ef >= k).
+	std::vector<SearchResult> Search(const float* query, size_t k, size_t ef = 64) const;
+	std::vector<SearchResult> ExactSearch(const float* query, size_t k) const;
+
+	// The rows are the queries.
+	SearchRecallReport EvaluateRecall(const Tensor2D& queries, size_t k, size_t ef = 64) const;
+
+	void Save(const std::string& filePath) const;
+	void Load(const std::string& filePath);
+
+	inline size_t GetDimension() const { return m_Dimension; }
+	// The number of vectors (with the removed ones), the ids are smaller.
+	inline size_t GetCount() const { return m_Count; }
+	inline size_t GetSize() const { return m_Count - m_NumRemoved; }
+	inline bool IsRemoved(size_t id) const { return m_RemovedView[id] != 0; }
+	inline bool IsMapped() const { return m_File != nullptr; }
+	inline const float* GetVector(size_t id) const { return m_VectorsView + id * m_Dimension; }
+	// The checksum saved in the loaded file, 0 when the index is not loaded (or the file has none).
+	inline uint64_t GetFileChecksum() const { return m_FileChecksum; }
+
+	// Checksum of the vectors' bits (count x dimension), Save writes it for the vectors of the index.
+	static uint64_t Checksum(const float* vectors, size_t count, size_t dimension);
+
+private:
+	typedef std::pair<float, uint32_t> Candidate;
+
+	// Links of the vector on the level: the count then the ids.
+	inline const uint32_t* GetLinks(size_t id, int level) const
+	{
+		return level == 0 ? m_Links0View + id * (m_MaxConnections0 + 1) : m_UpperLinksView + m_UpperOffsetsView[id] + (level - 1) * (m_MaxConnections + 1);
+	}
+	inline uint32_t* GetMutableLinks(size_t id, int level) { return const_cast<uint32_t*>(GetLinks(id, level)); }
+
+	uint32_t SearchClosest(const float* query, uint32_t entryPoint, int level) const;
+	// The ef nearest candidates on the level in increasing distance.
+	std::vector<Candidate> SearchLayer(const float* query, uint32_t entryPoint, size_t ef, int level, std::vector<uint8_t>& visited) const;
+	// Keeps the candidates which are closer to the base than to the already selected ones (than fills up to maxCount).
+	std::vector<Candidate> SelectNeighbors(const std::vector<Candidate>& candidates, size_t maxCount) const;
+	void Connect(uint32_t id, uint32_t neighbor, int level);
+
+	void Detach();
+	void UpdateViews();
+
+private:
+	size_t m_Dimension;
+	size_t m_MaxConnections, m_MaxConnections0;
+	size_t m_EfConstruction;
+	double m_LevelFactor;
+	std::mt19937 m_Random;
+
+	size_t m_Count = 0;
+	size_t m_NumRemoved = 0;
+	uint32_t m_EntryPoint = 0;
+	int32_t m_MaxLevel = -1;
+	uint64_t m_FileChecksum = 0;
+
+	std::vector<float> m_Vectors;  // count x dimension
+	std::vector<int32_t> m_Levels;  // The top level of every vector.
+	std::vector<uint8_t> m_Removed;
+	std::vector<uint32_t> m_Links0;  // count x (1 + max connections * 2)
+	std::vector<uint64_t> m_UpperOffsets;  // The offset of every vector's upper links.
+	std::vector<uint32_t> m_UpperLinks;  // levels x (1 + max connections) for every vector.
+
+	// The data of the owned vectors, or the mapped file's.
+	std::unique_ptr<MappedFile> m_File;
+	const float* m_VectorsView = nullptr;
+	const int32_t* m_LevelsView = nullptr;
+	const uint8_t* m_RemovedView = nullptr;
+	const uint32_t* m_Links0View = nullptr;
+	const uint64_t* m_UpperOffsetsView = nullptr;
+	const uint32_t* m_UpperLinksView = nullptr;
+};
+
+namespace_end
@@ -0,0 +1,117 @@
+#include "SharedMemory.h"
+#include <stdexcept>
+#include <chrono>
+#include <thread>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+
+namespace_start
+
+#ifdef _WIN32
+
+SharedMemory::SharedMemory(const std::string& name, size_t size, bool isOwner, size_t timeoutMilliseconds)
+	: m_Name("Local\\" + name), m_Size(size), m_IsOwner(isOwner)
+{
+	// The mapping is freed with its last handle, a stale segment can't outlive its processes.
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMilliseconds);
+	while (!m_Mapping)
+	{
+		if (m_IsOwner)
+			m_Mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, m_Name.c_str());
+		else
+			m_Mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, m_Name.c_str());
+
+		if (!m_Mapping && (m_IsOwner || std::chrono::steady_clock::now() > deadline))
+			throw std::runtime_error("Could not open shared memory: " + name);
+		if (!m_Mapping)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	m_Data = (uint8_t*)MapViewOfFile(m_Mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (!m_Data)
+	{
+		CloseHandle(m_Mapping);
+		throw std::runtime_error("Could not map shared memory: " + name);
+	}
+}
+
+SharedMemory::~SharedMemory()
+{
+	if (m_Data)
+		UnmapViewOfFile(m_Data);
+	if (m_Mapping)
+		CloseHandle(m_Mapping);
+}
+
+#else
+
+SharedMemory::SharedMemory(const std::string& name, size_t size, bool isOwner, size_t timeoutMilliseconds)
+	: m_Name("/" + name), m_Size(size), m_IsOwner(isOwner)
+{
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMilliseconds);
+	if (m_IsOwner)
+	{
+		shm_unlink(m_Name.c_str());
+		m_File = shm_open(m_Name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+		if (m_File < 0 || ftruncate(m_File, (off_t)size) != 0)
+		{
+			if (m_File >= 0)
+				close(m_File);
+			throw std::runtime_error("Could not create shared memory: " + name);
+		}
+	}
+	else
+	{
+		// The segment is ready, when the owner has created it and has set its size.
+		struct stat status;
+		while (true)
+		{
+			if (m_File < 0)
+				m_File = shm_open(m_Name.c_str(), O_RDWR, 0600);
+			if (m_File >= 0 && fstat(m_File, &status) == 0 && (size_t)status.st_size >= size)
+				break;
+
+			if (std::chrono::steady_clock::now() > deadline)
+			{
+				if (m_File >= 0)
+					close(m_File);
+				throw std::runtime_error("Could not open shared memory: " + name);
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_File, 0);
+	if (data == MAP_FAILED)
+	{
+		close(m_File);
+		if (m_IsOwner)
+			shm_unlink(m_Name.c_str());
+		throw std::runtime_error("Could not map shared memory: " + name);
+	}
+	m_Data = (uint8_t*)data;
+}
+
+SharedMemory::~SharedMemory()
+{
+	if (m_Data)
+		munmap(m_Data, m_Size);
+	if (m_File >= 0)
+		close(m_File);
+	if (m_IsOwner)
+		shm_unlink(m_Name.c_str());
+}
+
+#endif
+
+namespace_end
@@ -0,0 +1,40 @@
+#pragma once
+#include <string>
+#include <stdint.h>
+
+#include "Core.h"
+
+
+namespace_start
+
+/*
+	A named memory segment shared by the processes of the host.
+	The owner creates the segment (a stale segment with the same name is replaced) and removes the name when it is destructed,
+	the others open it, waiting at most timeoutMilliseconds for the owner to create it. A new segment is zeroed.
+*/
+class LIBRARY_API SharedMemory
+{
+public:
+	SharedMemory(const std::string& name, size_t size, bool isOwner, size_t timeoutMilliseconds=10000);
+	~SharedMemory();
+
+	SharedMemory(const SharedMemory&) = delete;
+	SharedMemory& operator=(const SharedMemory&) = delete;
+
+	inline uint8_t* GetData() const { return m_Data; }
+	inline size_t GetSize() const { return m_Size; }
+
+private:
+	std::string m_Name;
+	uint8_t* m_Data = nullptr;
+	size_t m_Size = 0;
+	bool m_IsOwner;
+
+#ifdef _WIN32
+	void* m_Mapping = nullptr;
+#else
+	int m_File = -1;
+#endif
+};
+
+namespace_end
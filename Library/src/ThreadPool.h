@@ -33,6 +33,14 @@ public:
         );
 
         std::future<return_type> res = task->get_future();
+
+        // The calling thread runs the work itself, see SetRunningInline.
+        if (IsRunningInline())
+        {
+            (*task)();
+            return res;
+        }
+
         {
             std::unique_lock<std::mutex> lock(queue_mutex);
 
@@ -48,6 +56,15 @@ public:
 
     inline size_t GetNumThreads() const { return m_NumThreads; }
 
+    // If set, the work enqueued from the calling thread is executed immediately on that thread (per thread setting).
+    // Used by threads that already run in parallel (like inference sessions), so they don't compete for the workers.
+    static inline void SetRunningInline(bool isRunningInline) { IsRunningInline() = isRunningInline; }
+    static inline bool& IsRunningInline()
+    {
+        static thread_local bool s_IsRunningInline = false;
+        return s_IsRunningInline;
+    }
+
 private:
     // Need to keep track of threads so we can join them
     std::vector< std::thread > workers;
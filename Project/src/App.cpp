@@ -1,7 +1,13 @@
 #include "App.h"
 #include <sstream>
+#include <algorithm>
+#include <fstream>
+#include <memory>
 
 #include "Trainers/ClassificationTrainer.h"
+#include "Trainers/EmbeddingTrainer.h"
+#include "Server.h"
+#include "VideoPipeline.h"
 
 #include <Mogi.h>
 #include <MogiDataset.h>
@@ -40,27 +46,137 @@ void App()
 		}
 		else if (command == "train")
 		{
-			std::string modelName, datasetName;
+			std::string modelName, datasetName, baseModelName;
 			int numImages;
 			if (params >> modelName && params >> datasetName && params >> numImages)
 			{
-				TrainOneShotFacialRecognizer("Datasets/FacialImages", datasetName, numImages, "Models/" + modelName);
+				params >> baseModelName;
+				TrainOneShotFacialRecognizer("Datasets/FacialImages", datasetName, numImages, "Models/" + modelName, baseModelName.size() ? "Models/" + baseModelName : "");
 			}
 			else
 			{
-				std::cout << "Provide a model/dataset name and the number of images the dataset holds. \"train model_name.txt dataset_name 400\"" << std::endl;
+				std::cout << "Provide a model/dataset name, the number of images the dataset holds and optionally a trained model to start from (only its dense layers are trained). \"train model_name.txt dataset_name 400\" or \"train model_name.txt dataset_name 400 base_model_name.txt\"" << std::endl;
 			}
 		}
 		else if (command == "test")
+		{
+			std::string modelName, galleryName;
+			float threshold = 0.5f;
+			if (params >> modelName)
+			{
+				params >> galleryName >> threshold;
+				TestFacialRecognizer("Models/" + modelName, galleryName.size() ? "Models/" + galleryName : "", threshold);
+			}
+			else
+			{
+				std::cout << "Provide a model name, for an embedding model the gallery name and optionally the distance threshold. \"test model_name.txt\" or \"test embedding_model_name.txt gallery_name.txt 0.5\"" << std::endl;
+			}
+		}
+		else if (command == "test_frames")
+		{
+			std::string modelName, framesPath, galleryName;
+			float threshold = 0.5f;
+			if (params >> modelName && params >> framesPath)
+			{
+				params >> galleryName >> threshold;
+				TestFacialRecognizer("Models/" + modelName, galleryName.size() ? "Models/" + galleryName : "", threshold, framesPath);
+			}
+			else
+			{
+				std::cout << "Provide a model name, a video file or an image directory, for an embedding model the gallery name and optionally the distance threshold. \"test_frames model_name.txt Datasets/Video.mp4\" or \"test_frames embedding_model_name.txt Datasets/Frames gallery_name.txt 0.5\"" << std::endl;
+			}
+		}
+		else if (command == "search")
+		{
+			std::string modelName, framesPath;
+			float threshold = 0.8f;
+			if (params >> modelName)
+			{
+				params >> framesPath >> threshold;
+				SearchFaces("Models/" + modelName, framesPath, threshold);
+			}
+			else
+			{
+				std::cout << "Provide a model name, optionally a video file or an image directory instead of the camera and the score threshold. \"search model_name.txt\" or \"search model_name.txt Datasets/Frames 0.8\"" << std::endl;
+			}
+		}
+		else if (command == "train_embedding")
+		{
+			std::string modelName, datasetName;
+			int numImages;
+			if (params >> modelName && params >> datasetName && params >> numImages)
+			{
+				TrainFacialEmbedding("Datasets/FacialImages", datasetName, numImages, "Models/" + modelName);
+			}
+			else
+			{
+				std::cout << "Provide a model/dataset name and the number of images the dataset holds. \"train_embedding model_name.txt dataset_name 400\"" << std::endl;
+			}
+		}
+		else if (command == "enroll")
+		{
+			std::string modelName, galleryName, datasetName;
+			int numImages;
+			if (params >> modelName && params >> galleryName && params >> datasetName && params >> numImages)
+			{
+				EnrollFaces("Models/" + modelName, "Models/" + galleryName, "Datasets/FacialImages", datasetName, numImages);
+			}
+			else
+			{
+				std::cout << "Provide an embedding model/gallery/dataset name and the number of images to enroll. \"enroll model_name.txt gallery_name.txt dataset_name 10\"" << std::endl;
+			}
+		}
+		else if (command == "quantize")
+		{
+			std::string modelName, quantizedModelName, datasetName;
+			int numImages;
+			if (params >> modelName && params >> quantizedModelName && params >> datasetName && params >> numImages)
+			{
+				QuantizeFacialRecognizer("Datasets/FacialImages", datasetName, numImages, "Models/" + modelName, "Models/" + quantizedModelName);
+			}
+			else
+			{
+				std::cout << "Provide a model/quantized model/dataset name and the number of images the dataset holds. \"quantize model_name.txt model_name_int8.txt dataset_name 400\"" << std::endl;
+			}
+		}
+		else if (command == "compile")
+		{
+			std::string modelName, outputName, name;
+			if (params >> modelName && params >> outputName && params >> name)
+			{
+				CompileModel("Models/" + modelName, "Models/" + outputName, name);
+			}
+			else
+			{
+				std::cout << "Provide a model name, the name of the generated files and their namespace. \"compile model_name.txt model_name model_name\"" << std::endl;
+			}
+		}
+		else if (command == "serve")
+		{
+			std::string modelName;
+			size_t maxBatchSize = 8, maxWaitMicroseconds = 2000, numWorkers = 1;
+			if (params >> modelName)
+			{
+				params >> maxBatchSize >> maxWaitMicroseconds >> numWorkers;
+				ServeModel("Models/" + modelName, maxBatchSize, maxWaitMicroseconds, numWorkers);
+			}
+			else
+			{
+				std::cout << "Provide a model name, optionally the max batch size, max wait [us] and # workers. \"serve model_name.txt 8 2000 1\"" << std::endl;
+			}
+		}
+		else if (command == "load")
 		{
 			std::string modelName;
+			size_t numClients = 16, numRequests = 100, maxBatchSize = 8, maxWaitMicroseconds = 2000, numWorkers = 1;
 			if (params >> modelName)
 			{
-				TestFacialRecognizer("Models/" + modelName);
+				params >> numClients >> numRequests >> maxBatchSize >> maxWaitMicroseconds >> numWorkers;
+				GenerateLoad("Models/" + modelName, numClients, numRequests, maxBatchSize, maxWaitMicroseconds, numWorkers);
 			}
 			else
 			{
-				std::cout << "Provide a model name. \"test model_name.txt\"" << std::endl;
+				std::cout << "Provide a model name, optionally the # clients, # requests per client, max batch size, max wait [us] and # workers. \"load model_name.txt 16 100 8 2000 1\"" << std::endl;
 			}
 		}
 
@@ -70,11 +186,12 @@ void App()
 
 int GeatherFacialImages(const std::string& folderPath, const std::string& name)
 {
-	cv::VideoCapture cap(0);
-	if (!cap.isOpened()) {
-		std::cerr << "Error opening video capture device" << std::endl;
+	std::unique_ptr<CameraFrameSource> source = std::make_unique<CameraFrameSource>(0);
+	if (!source->IsOpened())
 		return -1;
-	}
+
+	// The capture and the cropping run in the background, the window shows the latest frame.
+	VideoPipeline pipeline(std::move(source), nullptr);
 
 	std::cout << "Press s to capture a training image and press ESC to save and exit." << std::endl;
 	
@@ -82,31 +199,17 @@ int GeatherFacialImages(const std::string& folderPath, const std::string& name)
 	cv::namedWindow("Input", cv::WINDOW_AUTOSIZE);
 
 	std::vector<cv::Mat> images;
+	VideoPipelineResult result;
 
-	while (true) {
-		cv::Mat frame;
-		cv::Mat croppedFrame;
-		cap >> frame; // Capture a new frame from the camera
+	while (!pipeline.IsFinished()) {
+		bool isNewFrame = pipeline.GetResult(result, std::chrono::milliseconds(10));
 
-		if (frame.empty()) {
-			std::cerr << "Error: captured frame is empty." << std::endl;
-			break;
-		}
-
-		cv::resize(frame, croppedFrame, cv::Size(512, 512));
-		int size = 128 + 64;
-		cv::Rect regionOfIntrest(croppedFrame.rows/2 - size/2, croppedFrame.cols/2 - size/2, size, size);
-		croppedFrame = croppedFrame(regionOfIntrest);
-
-
-		cv::cvtColor(croppedFrame, croppedFrame, cv::COLOR_BGR2GRAY);
-
-		int key = cv::waitKey(10) & 0xFF;
-		if (key == 's') {
+		int key = cv::waitKey(1) & 0xFF;
+		if (key == 's' && !result.Frame.empty()) {
 			std::cout << "Captured image: " << images.size() + 1 << std::endl;
 
 			cv::Mat data;
-			cv::resize(croppedFrame, data, cv::Size(128, 128));
+			cv::resize(result.Frame, data, cv::Size(128, 128));
 			images.push_back(data);
 		}
 		else if (key == 27) {	// ESC
@@ -119,17 +222,18 @@ int GeatherFacialImages(const std::string& folderPath, const std::string& name)
 			break;
 		}
 
-		cv::imshow("Input", croppedFrame);
+		if (isNewFrame)
+			cv::imshow("Input", result.Frame);
 	}
 
-	cap.release();
+	pipeline.Stop();
 	cv::destroyAllWindows();
 
 	return images.size();
 }
 
 
-void TrainOneShotFacialRecognizer(const std::string& folderPath, const std::string& name, int numImages, const std::string& modelName)
+void TrainOneShotFacialRecognizer(const std::string& folderPath, const std::string& name, int numImages, const std::string& modelName, const std::string& baseModelName)
 {
 	std::cout << "Datasets loading..." << std::endl;
 	mogi::dataset::FaceRecognitionDataset trainingDataset(
@@ -142,6 +246,63 @@ void TrainOneShotFacialRecognizer(const std::string& folderPath, const std::stri
 	);
 	std::cout << "Datasets loaded!" << std::endl;
 
+	mogi::Model model;
+	if (baseModelName.size())
+	{
+		std::cout << "Loading base modell..." << std::endl;
+		model.Load(baseModelName);
+
+		// The convolutional features are reused, the layers before the first dense layer are frozen.
+		size_t numFeatureLayers = 0;
+		for (std::shared_ptr<mogi::Layer> layer = model.GetRootLayer(); layer && layer->GetName() != mogi::DenseLayer::ClassName(); layer = layer->NextLayer)
+			numFeatureLayers++;
+		model.FreezePrefix(numFeatureLayers);
+	}
+	else
+	{
+		model.AddLayer(std::make_shared<mogi::ConvolutionalLayer>(128, 128, 1, 3, 3, 32, 1, mogi::RelU(), mogi::He(3 * 3 * 2), false));
+		model.AddLayer(std::make_shared<mogi::MaxPoolingLayer>(128, 128, 32, 2, 2));
+		model.AddLayer(std::make_shared<mogi::ConvolutionalLayer>(64, 64, 32, 3, 3, 64, 1, mogi::RelU(), mogi::He(3 * 3 * 32), false));
+		model.AddLayer(std::make_shared<mogi::MaxPoolingLayer>(64, 64, 64, 2, 2));
+		model.AddLayer(std::make_shared<mogi::ConvolutionalLayer>(32, 32, 64, 3, 3, 128, 1, mogi::RelU(), mogi::He(3 * 3 * 64), false));
+		model.AddLayer(std::make_shared<mogi::MaxPoolingLayer>(32, 32, 128, 2, 2));
+		model.AddLayer(std::make_shared<mogi::ConvolutionalLayer>(16, 16, 128, 3, 3, 128, 1, mogi::RelU(), mogi::He(3 * 3 * 128), false));
+		model.AddLayer(std::make_shared<mogi::MaxPoolingLayer>(16, 16, 128, 2, 2));
+
+		model.AddLayer(std::make_shared<mogi::ReshapeLayer>(8, 8, 128, 8 * 8 * 128, 1, 1));
+		model.AddLayer(std::make_shared<mogi::DenseLayer>(8 * 8 * 128, 128, mogi::RelU(), mogi::Xavier(8 * 8 * 128, 128)));
+		model.AddLayer(std::make_shared<mogi::DenseLayer>(128, 1, mogi::Sigmoid(), mogi::Xavier(128, 1)));
+	}
+
+	model.InitializeOptimizer(mogi::OptimizerFactory(mogi::Adam));
+	model.Summarize();
+
+	ClassificationTrainer trainer(&model, &trainingDataset, &testDataset, CostFunctionFactory(CostFunctionType::BinaryCrossEntropyLoss), true);
+	// The frozen features of the training images are calculated once, in a file next to the model.
+	trainer.SetPrefixCache(true, modelName + ".cache");
+
+	trainer.Train(1, 0.0001f, 0.0001f);
+
+	model.ToHost();
+	std::cout << "Saving modell..." << std::endl;
+	model.Save(modelName);
+	std::cout << "Modell saved!" << std::endl;
+}
+
+void TrainFacialEmbedding(const std::string& folderPath, const std::string& name, int numImages, const std::string& modelName)
+{
+	std::cout << "Datasets loading..." << std::endl;
+	mogi::dataset::FaceTripletDataset trainingDataset(
+		folderPath, name, 0, numImages,
+		"Datasets/GeneralFacesCropped", "image", 0, numImages
+	);
+	mogi::dataset::FaceTripletDataset testDataset(
+		folderPath, name, 0, numImages * 0.2f,
+		"Datasets/GeneralFacesCropped", "image", 0, numImages * 0.2f
+	);
+	std::cout << "Datasets loaded!" << std::endl;
+
+	// The shared tower of the siamese network, it maps a face to a 64 long embedding.
 	mogi::Model model;
 	model.AddLayer(std::make_shared<mogi::ConvolutionalLayer>(128, 128, 1, 3, 3, 32, 1, mogi::RelU(), mogi::He(3 * 3 * 2), false));
 	model.AddLayer(std::make_shared<mogi::MaxPoolingLayer>(128, 128, 32, 2, 2));
@@ -154,12 +315,12 @@ void TrainOneShotFacialRecognizer(const std::string& folderPath, const std::stri
 
 	model.AddLayer(std::make_shared<mogi::ReshapeLayer>(8, 8, 128, 8 * 8 * 128, 1, 1));
 	model.AddLayer(std::make_shared<mogi::DenseLayer>(8 * 8 * 128, 128, mogi::RelU(), mogi::Xavier(8 * 8 * 128, 128)));
-	model.AddLayer(std::make_shared<mogi::DenseLayer>(128, 1, mogi::Sigmoid(), mogi::Xavier(128, 1)));
+	model.AddLayer(std::make_shared<mogi::DenseLayer>(128, 64, mogi::Sigmoid(), mogi::Xavier(128, 64)));
 
 	model.InitializeOptimizer(mogi::OptimizerFactory(mogi::Adam));
 	model.Summarize();
 
-	ClassificationTrainer trainer(&model, &trainingDataset, &testDataset, CostFunctionFactory(CostFunctionType::BinaryCrossEntropyLoss), true);
+	EmbeddingTrainer trainer(&model, &trainingDataset, &testDataset, 1.0f, true);
 
 	trainer.Train(1, 0.0001f, 0.0001f);
 
@@ -169,19 +330,157 @@ void TrainOneShotFacialRecognizer(const std::string& folderPath, const std::stri
 	std::cout << "Modell saved!" << std::endl;
 }
 
+static mogi::Tensor3D ImageToTensor(const cv::Mat& grayImage)
+{
+	mogi::Tensor3D input(128, 128, 1);
+	WriteGrayImage(grayImage, input);
+	return input;
+}
 
-void TestFacialRecognizer(const std::string& modelPath)
+void EnrollFaces(const std::string& modelPath, const std::string& galleryPath, const std::string& folderPath, const std::string& name, int numImages)
+{
+	std::cout << "Loading modell..." << std::endl;
+	mogi::Model model(modelPath);
+	std::cout << "Modell loaded!" << std::endl;
+
+	mogi::EmbeddingGallery gallery(model);
+	if (std::ifstream(galleryPath).good())
+	{
+		gallery.Load(galleryPath);
+	}
+	gallery.Remove(name);
+
+	for (int i = 0; i < numImages; i++)
+	{
+		std::string filePath = folderPath + "/" + name + "_" + std::to_string(i) + ".jpg";
+		cv::Mat image = cv::imread(filePath, cv::IMREAD_GRAYSCALE);
+		if (image.empty())
+		{
+			std::cerr << "Error: no image at: " << filePath << std::endl;
+			continue;
+		}
+
+		gallery.Enroll(name, ImageToTensor(image));
+	}
+
+	gallery.Save(galleryPath);
+	std::cout << "Enrolled " << name << ", the gallery has " << gallery.GetNumEmbeddings() << " # embeddings." << std::endl;
+}
+
+void QuantizeFacialRecognizer(const std::string& folderPath, const std::string& name, int numImages, const std::string& modelPath, const std::string& quantizedModelPath)
+{
+	std::cout << "Datasets loading..." << std::endl;
+	mogi::dataset::FaceRecognitionDataset calibrationDataset(
+		folderPath, name, 0, numImages,
+		"Datasets/GeneralFacesCropped", "image", 0, numImages
+	);
+	mogi::dataset::FaceRecognitionDataset testDataset(
+		folderPath, name, 0, numImages * 0.2f,
+		"Datasets/GeneralFacesCropped", "image", 0, numImages * 0.2f
+	);
+	std::cout << "Datasets loaded!" << std::endl;
+
+	mogi::Model model(modelPath);
+	calibrationDataset.Shuffle();
+	mogi::QuantizedModel quantizedModel = mogi::dataset::QuantizeModel(model, calibrationDataset, std::min<size_t>(300, calibrationDataset.GetEpochSize()));
+
+	mogi::dataset::QuantizationReport report = mogi::dataset::EvaluateQuantization(model, quantizedModel, testDataset);
+	std::cout << report.ToString() << std::endl;
+
+	std::cout << "Saving quantized modell..." << std::endl;
+	quantizedModel.Save(quantizedModelPath);
+	std::cout << "Quantized modell saved!" << std::endl;
+}
+
+void CompileModel(const std::string& modelPath, const std::string& outputPath, const std::string& name)
+{
+	std::cout << "Loading modell..." << std::endl;
+	mogi::Model model(modelPath);
+	std::cout << "Modell loaded!" << std::endl;
+
+	mogi::ModelCompiler(model, name).Compile(outputPath);
+	std::cout << "Modell compiled to " << outputPath << ".h and " << outputPath << ".cpp" << std::endl;
+}
+
+
+void TestFacialRecognizer(const std::string& modelPath, const std::string& galleryPath, float threshold, const std::string& framesPath)
 {
 	std::cout << "Loading modell..." << std::endl;
 	mogi::Model model(modelPath);
 	std::cout << "Modell loaded!" << std::endl;
 	model.Summarize();
 
-	cv::VideoCapture cap(0);
-	if (!cap.isOpened()) {
-		std::cerr << "Error opening video capture device" << std::endl;
+	// With a gallery the model is an embedding model, a face is identified by the nearest enrolled embedding.
+	std::unique_ptr<mogi::EmbeddingGallery> gallery;
+	if (galleryPath.size())
+	{
+		gallery = std::make_unique<mogi::EmbeddingGallery>(model, galleryPath);
+		std::cout << "Gallery loaded with " << gallery->GetNumEmbeddings() << " # embeddings." << std::endl;
+
+		// The lookup stage is the gallery's index, its recall is measured with the enrolled embeddings as queries.
+		const mogi::HNSWIndex& index = gallery->GetIndex();
+		mogi::Tensor2D queries(index.GetSize(), index.GetDimension());
+		for (size_t id = 0, r = 0; id < index.GetCount(); id++)
+		{
+			if (index.IsRemoved(id))
+				continue;
+			for (size_t c = 0; c < index.GetDimension(); c++)
+				queries.SetAt(r, c, index.GetVector(id)[c]);
+			r++;
+		}
+		if (queries.GetRows())
+			std::cout << index.EvaluateRecall(queries, 1).ToString() << std::endl;
+	}
+
+	// Every frame the pipeline keeps is evaluated on the inference thread, a nearly unchanged frame reuses the last output.
+	mogi::InferenceCache cache(model);
+	auto inference = [&](const mogi::Tensor3D& input) {
+		std::stringstream label;
+		mogi::Tensor3D output = cache.FeedForward(input);
+		output.ToHost();
+		if (gallery)
+		{
+			mogi::GalleryMatch match = gallery->IdentifyEmbedding(output);
+			if (match.Distance >= 0.0f && match.Distance < threshold)
+			{
+				label << "Identified: " << match.Name;
+			}
+			else
+			{
+				label << "Unknown";
+			}
+			label << " (distance: " << match.Distance << ")";
+		}
+		else
+		{
+			if (output.GetAt(0, 0, 0) >= 0.8f)
+			{
+				label << "Verified: ";
+			}
+			label << output.ToString();
+		}
+		return label.str();
+	};
+
+	// The frames of a file or directory are processed headless, all of them.
+	if (framesPath.size())
+	{
+		VideoPipeline pipeline(std::make_unique<FileFrameSource>(framesPath), inference, 128, 128, 2, false);
+
+		VideoPipelineResult result;
+		for (size_t i = 0; pipeline.GetResult(result); i++)
+		{
+			std::cout << "Frame " << i << ": " << result.Label << std::endl;
+		}
+
+		std::cout << pipeline.GetStats().ToString() << std::endl;
+		std::cout << "Cache " << cache.GetStats().ToString() << std::endl;
 		return;
 	}
+
+	std::unique_ptr<CameraFrameSource> source = std::make_unique<CameraFrameSource>(0);
+	if (!source->IsOpened())
+		return;
 	std::string faceCascadePath = "C:/Dev/Szakdolgozat/Project/Dependencies/opencv/sources/data/haarcascades/haarcascade_frontalface_default.xml";
 	cv::CascadeClassifier faceCascade;
 	if (!faceCascade.load(faceCascadePath)) {
@@ -189,25 +488,19 @@ void TestFacialRecognizer(const std::string& modelPath)
 		return;
 	}
 
-	std::cout << "Press v to verify with the modell or ESC to exit." << std::endl;
-
-	cv::namedWindow("Input", cv::WINDOW_AUTOSIZE);
+	VideoPipeline pipeline(std::move(source), inference);
 
-	while (true) {
-		cv::Mat frame;
-		cv::Mat croppedFrame;
-		cap >> frame; // Capture a new frame from the camera
+	std::cout << "Press v to print the latest result of the modell, s for the pipeline's and the cache's statistics or ESC to exit." << std::endl;
 
-		if (frame.empty()) {
-			std::cerr << "Error: captured frame is empty." << std::endl;
-			break;
-		}
+	cv::namedWindow("Input", cv::WINDOW_AUTOSIZE);
 
-		cv::resize(frame, croppedFrame, cv::Size(512, 512));
-		int size = 128 + 64;
-		cv::Rect regionOfIntrest(croppedFrame.rows / 2 - size / 2, croppedFrame.cols / 2 - size / 2, size, size);
-		croppedFrame = croppedFrame(regionOfIntrest);
-		cv::cvtColor(croppedFrame, croppedFrame, cv::COLOR_BGR2GRAY);
+	// The display shows the latest frame in every iteration, a slow inference only delays the label.
+	VideoPipelineResult result;
+	std::string label;
+	cv::Mat frame;
+	while (!pipeline.IsFinished()) {
+		if (pipeline.GetResult(result, std::chrono::milliseconds(0)))
+			label = result.Label;
 
 		/*std::vector<cv::Rect> faces;
 		faceCascade.detectMultiScale(croppedFrame, faces);
@@ -215,38 +508,91 @@ void TestFacialRecognizer(const std::string& modelPath)
 			croppedFrame = croppedFrame(faces[0]);
 		cv::resize(croppedFrame, croppedFrame, cv::Size(128, 128));*/
 
-		int key = cv::waitKey(10) & 0xFF;
-		if (key == 'v') {
-			cv::Mat data;
-			cv::resize(croppedFrame, data, cv::Size(128, 128));
-
-			mogi::Tensor3D input(128, 128, 1);
-			for (size_t i = 0; i < input.GetRows(); i++)
-			{
-				for (size_t j = 0; j < input.GetCols(); j++)
-				{
-					auto value = data.at<uchar>(i, j);
-					input.SetAt(i, j, 0, value / 255.0f);
-				}
-			}
-
-			mogi::Tensor3D output = model.FeedForward(input);
-			if (output.GetAt(0, 0, 0) >= 0.8f)
-			{
-				std::cout << "Verified: ";
-			}
-			std::cout << output.ToString() << std::endl;
+		int key = cv::waitKey(1) & 0xFF;
+		if (key == 'v' && label.size()) {
+			std::cout << label << std::endl;
+		}
+		else if (key == 's') {
+			std::cout << pipeline.GetStats().ToString() << std::endl;
+			std::cout << "Cache " << cache.GetStats().ToString() << std::endl;
 		}
 		else if (key == 27) {	// ESC
 			break;
 		}
 
-		cv::resize(croppedFrame, croppedFrame, cv::Size(512, 512));
-
-		cv::imshow("Input", croppedFrame);
+		if (pipeline.GetLatestFrame(frame))
+		{
+			cv::Mat displayFrame;
+			cv::resize(frame, displayFrame, cv::Size(512, 512));
+			if (label.size())
+				cv::putText(displayFrame, label, cv::Point(10, 30), cv::FONT_HERSHEY_SIMPLEX, 0.8, cv::Scalar(255), 2);
+			cv::imshow("Input", displayFrame);
+		}
 	}
 
-	cap.release();
+	pipeline.Stop();
+	std::cout << pipeline.GetStats().ToString() << std::endl;
+	std::cout << "Cache " << cache.GetStats().ToString() << std::endl;
 	cv::destroyAllWindows();
 
-}
\ No newline at end of file
+}
+
+void SearchFaces(const std::string& modelPath, const std::string& framesPath, float threshold)
+{
+	std::cout << "Loading modell..." << std::endl;
+	mogi::Model model(modelPath);
+	std::cout << "Modell loaded!" << std::endl;
+
+	// The window model runs once per scale over the whole frame instead of once per window position.
+	const size_t frameRows = 288, frameCols = 384;
+	mogi::SlidingWindowDetector detector(model, frameRows, frameCols, { 1.0f, 0.75f, 0.5f });
+
+	std::unique_ptr<FrameSource> source;
+	if (framesPath.size())
+		source = std::make_unique<FileFrameSource>(framesPath);
+	else
+		source = std::make_unique<CameraFrameSource>(0);
+	const bool isHeadless = framesPath.size();
+
+	if (!isHeadless)
+	{
+		std::cout << "Press ESC to exit." << std::endl;
+		cv::namedWindow("Input", cv::WINDOW_AUTOSIZE);
+	}
+
+	mogi::Tensor3D input(frameRows, frameCols, 1);
+	cv::Mat frame, grayFrame;
+	for (size_t i = 0; source->Read(frame); i++)
+	{
+		if (frame.channels() == 1)
+			grayFrame = frame;
+		else
+			cv::cvtColor(frame, grayFrame, cv::COLOR_BGR2GRAY);
+		WriteGrayImage(grayFrame, input);
+
+		auto start = std::chrono::steady_clock::now();
+		mogi::WindowDetection best = detector.FindBest(input);
+		float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		// The window in the frame's coordinates.
+		float scaleRows = (float)frame.rows / frameRows, scaleCols = (float)frame.cols / frameCols;
+		cv::Rect window((int)(best.Col * scaleCols), (int)(best.Row * scaleRows), (int)(best.Cols * scaleCols), (int)(best.Rows * scaleRows));
+
+		if (isHeadless)
+		{
+			std::cout << "Frame " << i << ": " << (best.Score >= threshold ? "face" : "no face") << " at (" << window.x << ", " << window.y << ", " <<
+				window.width << " x " << window.height << "), score: " << best.Score << ", " << milliseconds << " ms" << std::endl;
+			continue;
+		}
+
+		if (best.Score >= threshold)
+			cv::rectangle(frame, window, cv::Scalar(0, 255, 0), 2);
+		cv::imshow("Input", frame);
+
+		if ((cv::waitKey(1) & 0xFF) == 27)	// ESC
+			break;
+	}
+
+	if (!isHeadless)
+		cv::destroyAllWindows();
+}
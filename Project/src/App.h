@@ -3,5 +3,14 @@
 
 void App();
 int GeatherFacialImages(const std::string& folderPath, const std::string& name);
-void TrainOneShotFacialRecognizer(const std::string& folderPath, const std::string& name, int numImages, const std::string& modelName);
-void TestFacialRecognizer(const std::string& modelPath);
\ No newline at end of file
+// With a base model (a trained recognizer) its convolutional layers are frozen and only the dense head is trained, from the cached features.
+void TrainOneShotFacialRecognizer(const std::string& folderPath, const std::string& name, int numImages, const std::string& modelName, const std::string& baseModelName="");
+void TrainFacialEmbedding(const std::string& folderPath, const std::string& name, int numImages, const std::string& modelName);
+void EnrollFaces(const std::string& modelPath, const std::string& galleryPath, const std::string& folderPath, const std::string& name, int numImages);
+void QuantizeFacialRecognizer(const std::string& folderPath, const std::string& name, int numImages, const std::string& modelPath, const std::string& quantizedModelPath);
+// Writes the model as a C++ source (outputPath.h and outputPath.cpp) without a dependency on the library, in the namespace name.
+void CompileModel(const std::string& modelPath, const std::string& outputPath, const std::string& name);
+// Without the frames path the frames are captured by the camera, otherwise they are the frames of the video file or the images of the directory.
+void TestFacialRecognizer(const std::string& modelPath, const std::string& galleryPath="", float threshold=0.5f, const std::string& framesPath="");
+// Searches the best scoring window of the window model in the frames of the camera, or a video file or an image directory.
+void SearchFaces(const std::string& modelPath, const std::string& framesPath="", float threshold=0.8f);
\ No newline at end of file
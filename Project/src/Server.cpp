@@ -0,0 +1,137 @@
+#include "Server.h"
+#include <iostream>
+#include <sstream>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <chrono>
+
+#include <Mogi.h>
+
+
+void ServeModel(const std::string& modelPath, size_t maxBatchSize, size_t maxWaitMicroseconds, size_t numWorkers)
+{
+	mogi::Model model(modelPath);
+	mogi::ModelShape shape = model.GetModelShape();
+	const size_t inputSize = shape.InputRows * shape.InputCols * shape.InputDepth;
+
+	mogi::InferenceServer server(model, maxBatchSize, maxWaitMicroseconds, numWorkers);
+
+	// The responses are written by a separate thread, so the reader keeps submitting while the batches run.
+	std::queue<std::pair<std::string, std::future<mogi::Tensor3D>>> pending;
+	std::mutex pendingMutex, outputMutex;
+	std::condition_variable pendingCondition;
+	bool isReading = true;
+
+	std::thread responder([&]() {
+		while (true)
+		{
+			std::pair<std::string, std::future<mogi::Tensor3D>> response;
+			{
+				std::unique_lock<std::mutex> lock(pendingMutex);
+				pendingCondition.wait(lock, [&] { return !pending.empty() || !isReading; });
+				if (pending.empty())
+					return;
+				response = std::move(pending.front());
+				pending.pop();
+			}
+
+			std::stringstream ss;
+			ss << response.first;
+			try
+			{
+				mogi::Tensor3D output = response.second.get();
+				for (size_t i = 0; i < output.GetSize(); i++)
+					ss << " " << output.GetData()[i];
+			}
+			catch (const std::exception& e)
+			{
+				ss << " error: " << e.what();
+			}
+
+			std::unique_lock<std::mutex> lock(outputMutex);
+			std::cout << ss.str() << std::endl;
+		}
+	});
+
+	std::string line;
+	while (std::getline(std::cin, line) && line != "exit")
+	{
+		if (line.empty())
+			continue;
+
+		if (line == "stats")
+		{
+			std::stringstream stats(server.GetStats().ToString());
+			std::unique_lock<std::mutex> lock(outputMutex);
+			for (std::string statsLine; std::getline(stats, statsLine);)
+				std::cout << "# " << statsLine << std::endl;
+			continue;
+		}
+
+		std::stringstream request(line);
+		std::string id;
+		request >> id;
+
+		mogi::Tensor3D input(shape.InputRows, shape.InputCols, shape.InputDepth);
+		size_t numValues = 0;
+		while (numValues < inputSize && request >> input.GetData()[numValues])
+			numValues++;
+
+		std::future<mogi::Tensor3D> output;
+		if (numValues == inputSize)
+		{
+			output = server.Submit(input);
+		}
+		else
+		{
+			// Invalid requests are answered in order too.
+			std::promise<mogi::Tensor3D> error;
+			error.set_exception(std::make_exception_ptr(std::runtime_error("expected " + std::to_string(inputSize) + " values, got " + std::to_string(numValues))));
+			output = error.get_future();
+		}
+
+		std::unique_lock<std::mutex> lock(pendingMutex);
+		pending.push({ id, std::move(output) });
+		pendingCondition.notify_one();
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(pendingMutex);
+		isReading = false;
+	}
+	pendingCondition.notify_one();
+	responder.join();
+}
+
+void GenerateLoad(const std::string& modelPath, size_t numClients, size_t numRequests, size_t maxBatchSize, size_t maxWaitMicroseconds, size_t numWorkers)
+{
+	mogi::Model model(modelPath);
+	mogi::ModelShape shape = model.GetModelShape();
+
+	mogi::InferenceServer server(model, maxBatchSize, maxWaitMicroseconds, numWorkers);
+
+	std::vector<mogi::Tensor3D> inputs;
+	for (size_t i = 0; i < 16; i++)
+		inputs.push_back(mogi::Random3D(shape.InputRows, shape.InputCols, shape.InputDepth, 0.0f, 1.0f));
+
+	auto startTime = std::chrono::steady_clock::now();
+
+	// Every client waits for its response before sending the next request (closed loop).
+	std::vector<std::thread> clients;
+	for (size_t c = 0; c < numClients; c++)
+	{
+		clients.emplace_back([&, c]() {
+			for (size_t i = 0; i < numRequests; i++)
+				server.Submit(inputs[(c + i) % inputs.size()]).get();
+		});
+	}
+	for (std::thread& client : clients)
+		client.join();
+
+	double duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+	std::cout << "clients: " << numClients << ", max batch size: " << maxBatchSize << ", max wait: " << maxWaitMicroseconds << "[us], workers: " << numWorkers << std::endl;
+	std::cout << server.GetStats().ToString() << std::endl;
+	std::cout << "throughput: " << (numClients * numRequests) / duration << " requests/s" << std::endl;
+}
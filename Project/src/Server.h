@@ -0,0 +1,11 @@
+#pragma once
+#include <string>
+
+/*
+	Serves the model over stdin/stdout, one request per line: "<id> <v0> <v1> ... <vn-1>", where n is the model's input size
+	(the values in the input tensor's memory order). Every request is answered with a line: "<id> <o0> ... <om-1>", in order.
+	"stats" prints the latency percentiles (lines starting with '#'), "exit" or the end of the input stops the server.
+*/
+void ServeModel(const std::string& modelPath, size_t maxBatchSize, size_t maxWaitMicroseconds, size_t numWorkers);
+// Local load generator: numClients threads submit numRequests random inputs each, than the server's statistics are printed.
+void GenerateLoad(const std::string& modelPath, size_t numClients, size_t numRequests, size_t maxBatchSize, size_t maxWaitMicroseconds, size_t numWorkers);
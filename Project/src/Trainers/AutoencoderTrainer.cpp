@@ -22,6 +22,7 @@ float AutoencoderTrainer::Validate(float* successRate) const
 		m_Model->ToDevice();
 	}
 
+	mogi::Loss loss = m_CostFunctionFactory.BuildLoss();
 	float cost = 0.0f;
 	for (size_t i = 0; i < m_TestingDataset->GetEpochSize(); i++)
 	{
@@ -36,8 +37,7 @@ float AutoencoderTrainer::Validate(float* successRate) const
 		mogi::Tensor3D output = m_Model->FeedForward(testingSample.Input);
 		output.ToHost();
 
-		mogi::CostFunction loss = m_CostFunctionFactory.Build(testingSample.Label);
-		cost += loss.Cost(output);
+		cost += loss.Evaluate(output, testingSample.Label);
 	}
 
 	return cost / m_TestingDataset->GetEpochSize();
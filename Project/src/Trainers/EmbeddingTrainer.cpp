@@ -0,0 +1,217 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include "Timer.h"
+#include "EmbeddingTrainer.h"
+
+
+EmbeddingTrainer::EmbeddingTrainer(
+	mogi::Model* model,
+	mogi::dataset::Dataset* training,
+	mogi::dataset::Dataset* testing,
+	float margin,
+	bool useDevice
+)
+	: Trainer(model, training, testing, CostFunctionFactory(MeanSuareError), useDevice), m_Margin(margin)  // The triplet loss replaces the cost function.
+{
+}
+
+bool EmbeddingTrainer::IsDatasetCompatible(const mogi::dataset::Dataset& dataset) const
+{
+	mogi::ModelShape modelShape = m_Model->GetModelShape();
+	mogi::dataset::SampleShape sampleShape = dataset.GetSampleShape();
+
+	return (
+		modelShape.InputRows == sampleShape.InputRows &&
+		modelShape.InputCols == sampleShape.InputCols &&
+		modelShape.InputDepth * 3 == sampleShape.InputDepth
+	);
+}
+
+// Copies the params in place, the layers may watch their memory.
+static void CopyParams(mogi::Tensor& destination, const mogi::Tensor& source)
+{
+	if (source.IsOnDevice())
+		destination.Mult(0.0f).Add(source);
+	else
+		std::copy(source.GetData(), source.GetData() + source.GetSize(), destination.GetData());
+}
+
+void EmbeddingTrainer::Embed(const mogi::Tensor3D& triplet, mogi::Tensor3D* images, mogi::Tensor3D* embeddings) const
+{
+	mogi::ModelShape modelShape = m_Model->GetModelShape();
+	size_t imageSize = modelShape.InputRows * modelShape.InputCols * modelShape.InputDepth;
+
+	for (size_t i = 0; i < 3; i++)
+	{
+		images[i] = mogi::Tensor3D(modelShape.InputRows, modelShape.InputCols, modelShape.InputDepth, (const float*)triplet.GetData() + i * imageSize, false);
+		if (m_UseDeivce)
+		{
+			images[i].ToDevice();
+		}
+
+		embeddings[i] = m_Model->FeedForward(images[i]);
+		embeddings[i].ToHost();
+	}
+}
+
+void EmbeddingTrainer::Train(
+	size_t epochs,
+	float startLearningRate,
+	float endLearningRate
+)
+{
+	const size_t loadingBarTotal = 20;  // total number of steps for the loading bar.
+
+	if (!IsDatasetCompatible(*m_TrainingDataset))
+	{
+		std::cout << "The dataset is not compatible with the data!" << std::endl;
+		return;
+	}
+
+	// The three images of a triplet are back propagated through the gradient model, which only sums their gradients,
+	// so all of them are computed with the same params and the model's optimizers make one step per triplet.
+	mogi::Model gradientModel;
+	for (std::shared_ptr<mogi::Layer> layer = m_Model->GetRootLayer(); layer; layer = layer->NextLayer)
+	{
+		gradientModel.AddLayer(layer->GetName(), layer->ToString());
+	}
+	gradientModel.SetMixedPrecision(m_Model->IsMixedPrecision());
+	gradientModel.InitializeOptimizer(mogi::OptimizerFactory(mogi::OptimizerType::Accumulator));
+	for (std::shared_ptr<mogi::Layer> layer = m_Model->GetRootLayer(), gradientLayer = gradientModel.GetRootLayer(); layer; layer = layer->NextLayer, gradientLayer = gradientLayer->NextLayer)
+	{
+		gradientLayer->SetFrozen(layer->IsFrozen());
+	}
+
+	if (m_UseDeivce)
+	{
+		m_Model->ToDevice();
+		gradientModel.ToDevice();
+	}
+
+	std::vector<mogi::LearnableTensor> tensors;
+	std::vector<mogi::LearnableTensor> gradientTensors;
+	for (std::shared_ptr<mogi::Layer> layer = m_Model->GetRootLayer(), gradientLayer = gradientModel.GetRootLayer(); layer; layer = layer->NextLayer, gradientLayer = gradientLayer->NextLayer)
+	{
+		for (const mogi::LearnableTensor& tensor : layer->GetLearnableTensors())
+			tensors.push_back(tensor);
+		for (const mogi::LearnableTensor& tensor : gradientLayer->GetLearnableTensors())
+			gradientTensors.push_back(tensor);
+	}
+
+	mogi::Tensor3D images[3];
+	mogi::Tensor3D embeddings[3];
+	mogi::Tensor3D costs[3];
+
+	for (size_t e = 0; e < epochs; e++)
+	{
+		float learningRate = startLearningRate + ((float)e / (float)epochs) * (endLearningRate - startLearningRate);
+		float avgLoss = 0.0f;
+		float avgStep = 0.0f;
+
+		std::cout << "Epoch " << std::setw(7) << "(" + std::to_string(e + 1) + "/" + std::to_string(epochs) + ") ";
+		std::cout << "[" << std::string(loadingBarTotal, ' ') << "] " << "0%" << " loss: " << avgLoss << " step: " << avgStep << "[ms]";
+
+		Timer timer;
+		for (size_t t = 0; t < m_TrainingDataset->GetEpochSize(); t += 1)
+		{
+			Timer stepTimer;
+			mogi::dataset::Sample trainingSample = m_TrainingDataset->GetSample();
+			m_TrainingDataset->Next();
+
+			// All three embeddings are needed for the costs, than the tower learns from each image with its own cost.
+			Embed(trainingSample.Input, images, embeddings);
+			float loss = mogi::TripletLoss(embeddings[0], embeddings[1], embeddings[2], m_Margin, &costs[0], &costs[1], &costs[2]);
+
+			if (loss > 0.0f)
+			{
+				for (size_t j = 0; j < tensors.size(); j++)
+				{
+					CopyParams(*gradientTensors[j].Params, *tensors[j].Params);
+					static_cast<mogi::AccumulatorOptimizer*>(gradientTensors[j].ParamsOptimizer)->Reset();
+				}
+				gradientModel.MarkParamsChanged();
+
+				for (size_t i = 0; i < 3; i++)
+				{
+					if (m_UseDeivce)
+					{
+						costs[i].ToDevice();
+					}
+
+					mogi::CostFunction costFunction;
+					const mogi::Tensor3D& cost = costs[i];
+					costFunction.DiffCost = [&cost](const mogi::Tensor3D&) { return cost; };
+					gradientModel.BackPropagation(images[i], costFunction, learningRate, t);
+				}
+
+				for (size_t j = 0; j < tensors.size(); j++)
+				{
+					mogi::AccumulatorOptimizer* accumulator = static_cast<mogi::AccumulatorOptimizer*>(gradientTensors[j].ParamsOptimizer);
+					tensors[j].ParamsOptimizer->Update(tensors[j].Params, &accumulator->GetGradient(), learningRate);
+				}
+				m_Model->MarkParamsChanged();
+			}
+
+			avgLoss *= t;
+			avgLoss += loss;
+			avgLoss /= t + 1;
+
+			float stepDuration = stepTimer.GetTime() * 1000;
+			avgStep *= t;
+			avgStep += stepDuration;
+			avgStep /= t + 1;
+
+			if ((t % std::max(size_t(1), (m_TrainingDataset->GetEpochSize() / 100)) == 0) || (t == (m_TrainingDataset->GetEpochSize() - 1)))
+			{
+				float status = std::min((float)t / (float)(m_TrainingDataset->GetEpochSize() - 1), 1.0f);
+				size_t loadingStatus = status * loadingBarTotal;
+				std::cout << "\r" << "Epoch " << std::setw(7) << "(" + std::to_string(e + 1) + "/" + std::to_string(epochs) + ") ";
+				std::cout << "[" << std::string(loadingStatus, '=') << std::string(loadingBarTotal - loadingStatus, ' ') << "] ";
+				std::cout << (size_t)(status * 100) << "%" << " loss: " << avgLoss << " step: " << (int)avgStep << "[ms]";
+			}
+		}
+		double duration = timer.GetTime();
+		std::cout << " duration: " << duration << "[s]";
+
+		float successRate = 0.0f;
+		float averageCost = Validate(&successRate);
+
+		std::cout << " Average cost: " << averageCost << " Success rate: " << std::to_string(successRate) << std::endl;
+
+		m_TrainingDataset->Shuffle();
+	}
+}
+
+float EmbeddingTrainer::Validate(float* successRate) const
+{
+	if (!IsDatasetCompatible(*m_TestingDataset))
+	{
+		std::cout << "The dataset is not compatible with the data!" << std::endl;
+		return 0.0f;
+	}
+
+	mogi::Tensor3D images[3];
+	mogi::Tensor3D embeddings[3];
+
+	float cost = 0.0f;
+	float successCount = 0;
+	for (size_t i = 0; i < m_TestingDataset->GetEpochSize(); i++)
+	{
+		mogi::dataset::Sample testingSample = m_TestingDataset->GetSample();
+		m_TestingDataset->Next();
+
+		Embed(testingSample.Input, images, embeddings);
+
+		const size_t size = embeddings[0].GetSize();
+		if (mogi::SquaredDistance(embeddings[0].GetData(), embeddings[1].GetData(), size) <
+			mogi::SquaredDistance(embeddings[0].GetData(), embeddings[2].GetData(), size))
+			successCount++;
+
+		cost += mogi::TripletLoss(embeddings[0], embeddings[1], embeddings[2], m_Margin);
+	}
+
+	if (successRate)
+		*successRate = successCount / m_TestingDataset->GetEpochSize();
+	return cost / m_TestingDataset->GetEpochSize();
+}
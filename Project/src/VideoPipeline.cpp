@@ -0,0 +1,259 @@
+#include "VideoPipeline.h"
+#include <assert.h>
+#include <sstream>
+#include <algorithm>
+
+
+CameraFrameSource::CameraFrameSource(int device)
+	: m_Capture(device)
+{
+	if (!m_Capture.isOpened())
+		std::cerr << "Error opening video capture device" << std::endl;
+}
+
+bool CameraFrameSource::Read(cv::Mat& frame)
+{
+	if (!m_Capture.read(frame) || frame.empty())
+	{
+		std::cerr << "Error: captured frame is empty." << std::endl;
+		return false;
+	}
+	return true;
+}
+
+FileFrameSource::FileFrameSource(const std::string& path, float fps)
+	: m_FrameTime(fps > 0.0f ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(1.0f / fps)) : std::chrono::steady_clock::duration::zero())
+{
+	std::vector<cv::String> filePaths;
+	try
+	{
+		cv::glob(path, filePaths);
+	}
+	catch (const cv::Exception&)
+	{
+	}
+
+	for (const cv::String& filePath : filePaths)
+	{
+		std::string extension = filePath.substr(filePath.find_last_of('.') + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (extension == "jpg" || extension == "jpeg" || extension == "png" || extension == "bmp")
+			m_ImagePaths.push_back(filePath);
+	}
+
+	if (m_ImagePaths.empty() && !m_Capture.open(path))
+		std::cerr << "Error: no frames at: " << path << std::endl;
+
+	m_NextFrameTime = std::chrono::steady_clock::now();
+}
+
+bool FileFrameSource::Read(cv::Mat& frame)
+{
+	if (m_FrameTime != std::chrono::steady_clock::duration::zero())
+	{
+		std::this_thread::sleep_until(m_NextFrameTime);
+		m_NextFrameTime += m_FrameTime;
+	}
+
+	if (m_ImagePaths.size())
+	{
+		do
+		{
+			if (m_NextImage >= m_ImagePaths.size())
+				return false;
+			frame = cv::imread(m_ImagePaths[m_NextImage++], cv::IMREAD_COLOR);
+		} while (frame.empty());
+		return true;
+	}
+
+	return m_Capture.isOpened() && m_Capture.read(frame) && !frame.empty();
+}
+
+
+void CropFace(const cv::Mat& frame, cv::Mat& croppedFrame)
+{
+	cv::Mat resizedFrame;
+	cv::resize(frame, resizedFrame, cv::Size(512, 512));
+	int size = 128 + 64;
+	cv::Rect regionOfIntrest(resizedFrame.rows / 2 - size / 2, resizedFrame.cols / 2 - size / 2, size, size);
+
+	if (resizedFrame.channels() == 1)
+		resizedFrame(regionOfIntrest).copyTo(croppedFrame);
+	else
+		cv::cvtColor(resizedFrame(regionOfIntrest), croppedFrame, cv::COLOR_BGR2GRAY);
+}
+
+void WriteGrayImage(const cv::Mat& grayImage, mogi::Tensor3D& input)
+{
+	assert(input.GetDepth() == 1 && grayImage.type() == CV_8UC1 && "Invalid image or input!");
+
+	if (input.IsOnDevice())
+		throw std::runtime_error("The input must be on the host.");
+
+	cv::Mat resizedImage;
+	cv::resize(grayImage, resizedImage, cv::Size((int)input.GetCols(), (int)input.GetRows()));
+
+	// The input's memory is row major like the image's, the conversion writes it directly.
+	cv::Mat inputView((int)input.GetRows(), (int)input.GetCols(), CV_32FC1, input.GetData());
+	resizedImage.convertTo(inputView, CV_32FC1, 1.0 / 255.0);
+}
+
+
+std::string VideoPipelineStats::ToString() const
+{
+	std::stringstream ss;
+
+	ss << "captured: " << NumCaptured << " (" << CaptureFps << " fps), processed: " << NumProcessed << " (" << Fps << " fps), dropped: " << NumDropped << "\n";
+	ss << "latency [ms] p50: " << LatencyP50 << " p90: " << LatencyP90 << " p99: " << LatencyP99;
+
+	return ss.str();
+}
+
+VideoPipeline::VideoPipeline(std::unique_ptr<FrameSource> source, InferenceFunction inference, size_t inputRows, size_t inputCols,
+	size_t queueCapacity, bool isDropping)
+	: m_Source(std::move(source)), m_Inference(inference), m_InputRows(inputRows), m_InputCols(inputCols),
+	m_Captured(queueCapacity, isDropping), m_Preprocessed(queueCapacity, isDropping), m_Results(queueCapacity, isDropping)
+{
+	m_StartTime = m_LastCaptureTime = m_LastResultTime = Clock::now();
+
+	m_Threads.emplace_back(&VideoPipeline::Capture, this);
+	m_Threads.emplace_back(&VideoPipeline::Preprocess, this);
+	m_Threads.emplace_back(&VideoPipeline::Infer, this);
+}
+
+VideoPipeline::~VideoPipeline()
+{
+	Stop();
+	for (std::thread& thread : m_Threads)
+	{
+		thread.join();
+	}
+}
+
+void VideoPipeline::Stop()
+{
+	m_Captured.Close();
+	m_Preprocessed.Close();
+	m_Results.Close();
+}
+
+void VideoPipeline::Capture()
+{
+	while (true)
+	{
+		Packet packet;
+		if (!m_Source->Read(packet.Frame))
+			break;
+		packet.CaptureTime = Clock::now();
+
+		if (!m_Captured.Push(std::move(packet)))
+			break;
+
+		std::unique_lock<std::mutex> lock(m_StatsMutex);
+		m_NumCaptured++;
+		m_LastCaptureTime = Clock::now();
+	}
+	m_Captured.Close();
+}
+
+void VideoPipeline::Preprocess()
+{
+	Packet packet;
+	while (m_Captured.Pop(packet))
+	{
+		cv::Mat croppedFrame;
+		CropFace(packet.Frame, croppedFrame);
+		packet.Frame = croppedFrame;
+		{
+			std::unique_lock<std::mutex> lock(m_LatestFrameMutex);
+			m_LatestFrame = croppedFrame;
+		}
+
+		if (m_Inference)
+		{
+			packet.Input = AcquireInput();
+			WriteGrayImage(packet.Frame, *packet.Input);
+		}
+
+		if (!m_Preprocessed.Push(std::move(packet)))
+			break;
+	}
+	m_Preprocessed.Close();
+}
+
+void VideoPipeline::Infer()
+{
+	Packet packet;
+	while (m_Preprocessed.Pop(packet))
+	{
+		VideoPipelineResult result;
+		result.Frame = packet.Frame;
+		result.CaptureTime = packet.CaptureTime;
+		if (m_Inference)
+			result.Label = m_Inference(*packet.Input);
+		packet.Input.reset();  // The input goes back to the pool.
+
+		if (!m_Results.Push(std::move(result)))
+			break;
+	}
+	m_Results.Close();
+}
+
+std::shared_ptr<mogi::Tensor3D> VideoPipeline::AcquireInput()
+{
+	// Only the preprocessing takes inputs from the pool, an input owned by the pool alone is not used by other stages.
+	for (const std::shared_ptr<mogi::Tensor3D>& input : m_InputPool)
+	{
+		if (input.use_count() == 1)
+			return input;
+	}
+
+	m_InputPool.push_back(std::make_shared<mogi::Tensor3D>(m_InputRows, m_InputCols, 1));
+	return m_InputPool.back();
+}
+
+bool VideoPipeline::GetResult(VideoPipelineResult& result, std::chrono::milliseconds timeout)
+{
+	if (!m_Results.Pop(result, timeout))
+		return false;
+
+	std::unique_lock<std::mutex> lock(m_StatsMutex);
+	m_LastResultTime = Clock::now();
+	m_Latencies.Add(std::chrono::duration<float, std::milli>(m_LastResultTime - result.CaptureTime).count());
+	return true;
+}
+
+bool VideoPipeline::GetLatestFrame(cv::Mat& frame) const
+{
+	std::unique_lock<std::mutex> lock(m_LatestFrameMutex);
+	if (m_LatestFrame.empty())
+		return false;
+
+	frame = m_LatestFrame;
+	return true;
+}
+
+bool VideoPipeline::IsFinished() const
+{
+	return m_Results.IsFinished();
+}
+
+VideoPipelineStats VideoPipeline::GetStats() const
+{
+	VideoPipelineStats stats;
+	stats.NumDropped = m_Captured.GetNumDropped() + m_Preprocessed.GetNumDropped() + m_Results.GetNumDropped();
+
+	std::unique_lock<std::mutex> lock(m_StatsMutex);
+	stats.NumCaptured = m_NumCaptured;
+	stats.NumProcessed = m_Latencies.GetCount();
+
+	float captureSeconds = std::chrono::duration<float>(m_LastCaptureTime - m_StartTime).count();
+	float resultSeconds = std::chrono::duration<float>(m_LastResultTime - m_StartTime).count();
+	stats.CaptureFps = captureSeconds > 0.0f ? stats.NumCaptured / captureSeconds : 0.0f;
+	stats.Fps = resultSeconds > 0.0f ? stats.NumProcessed / resultSeconds : 0.0f;
+
+	stats.LatencyP50 = m_Latencies.Percentile(0.5f);
+	stats.LatencyP90 = m_Latencies.Percentile(0.9f);
+	stats.LatencyP99 = m_Latencies.Percentile(0.99f);
+	return stats;
+}
@@ -0,0 +1,231 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+
+#include <Mogi.h>
+
+#include <opencv2/opencv.hpp>
+
+
+/*
+	Bounded queue between two stages of the pipeline. A dropping queue keeps the latest items (the oldest is dropped when it is full),
+	otherwise Push waits for a free place. After Close, Push fails and Pop returns the remaining items.
+*/
+template<typename T>
+class FrameQueue
+{
+public:
+	FrameQueue(size_t capacity, bool isDropping) : m_Capacity(std::max(capacity, size_t(1))), m_IsDropping(isDropping) { }
+
+	bool Push(T item)
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		if (m_IsDropping)
+		{
+			while (m_Items.size() >= m_Capacity)
+			{
+				m_Items.pop_front();
+				m_NumDropped++;
+			}
+		}
+		else
+		{
+			m_Condition.wait(lock, [&] { return m_Items.size() < m_Capacity || m_IsClosed; });
+		}
+
+		if (m_IsClosed)
+			return false;
+
+		m_Items.push_back(std::move(item));
+		m_Condition.notify_all();
+		return true;
+	}
+
+	// Returns false when the queue is closed and empty, or the timeout is over.
+	bool Pop(T& item, std::chrono::milliseconds timeout = std::chrono::milliseconds::max())
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		auto isReady = [&] { return !m_Items.empty() || m_IsClosed; };
+		if (timeout == std::chrono::milliseconds::max())
+			m_Condition.wait(lock, isReady);
+		else
+			m_Condition.wait_for(lock, timeout, isReady);
+
+		if (m_Items.empty())
+			return false;
+
+		item = std::move(m_Items.front());
+		m_Items.pop_front();
+		m_Condition.notify_all();
+		return true;
+	}
+
+	void Close()
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_IsClosed = true;
+		m_Condition.notify_all();
+	}
+
+	bool IsFinished() const
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		return m_IsClosed && m_Items.empty();
+	}
+
+	size_t GetNumDropped() const
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		return m_NumDropped;
+	}
+
+private:
+	size_t m_Capacity;
+	bool m_IsDropping;
+
+	std::deque<T> m_Items;
+	mutable std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	bool m_IsClosed = false;
+	size_t m_NumDropped = 0;
+};
+
+
+class FrameSource
+{
+public:
+	virtual ~FrameSource() { }
+
+	// Returns false when there are no more frames.
+	virtual bool Read(cv::Mat& frame) = 0;
+};
+
+class CameraFrameSource : public FrameSource
+{
+public:
+	CameraFrameSource(int device = 0);
+
+	bool Read(cv::Mat& frame) override;
+	inline bool IsOpened() const { return m_Capture.isOpened(); }
+
+private:
+	cv::VideoCapture m_Capture;
+};
+
+/*
+	Frames of a video file, or the images of a directory in the order of their names.
+	With fps the frames are given with the pace of a camera, otherwise as fast as they are read.
+*/
+class FileFrameSource : public FrameSource
+{
+public:
+	FileFrameSource(const std::string& path, float fps = 0.0f);
+
+	bool Read(cv::Mat& frame) override;
+	inline bool IsOpened() const { return m_ImagePaths.size() || m_Capture.isOpened(); }
+
+private:
+	std::vector<std::string> m_ImagePaths;
+	size_t m_NextImage = 0;
+	cv::VideoCapture m_Capture;
+
+	std::chrono::steady_clock::duration m_FrameTime;
+	std::chrono::steady_clock::time_point m_NextFrameTime;
+};
+
+
+// The center crop of the frame in grayscale, as it is shown and saved.
+void CropFace(const cv::Mat& frame, cv::Mat& croppedFrame);
+// Writes the resized grayscale image into the (rows, cols, 1) input, scaled to [0, 1].
+void WriteGrayImage(const cv::Mat& grayImage, mogi::Tensor3D& input);
+
+
+struct VideoPipelineResult
+{
+	cv::Mat Frame;  // The cropped grayscale frame.
+	std::string Label;  // The result of the inference, empty without inference.
+	std::chrono::steady_clock::time_point CaptureTime;
+};
+
+struct VideoPipelineStats
+{
+	size_t NumCaptured = 0, NumDropped = 0, NumProcessed = 0;
+	float CaptureFps = 0.0f, Fps = 0.0f;
+	// End-to-end latency percentiles in milliseconds of the last results, from the capture until the result.
+	float LatencyP50 = 0.0f, LatencyP90 = 0.0f, LatencyP99 = 0.0f;
+
+	std::string ToString() const;
+};
+
+/*
+	Capture, preprocessing and inference run on separate threads, connected by bounded queues.
+	A dropping pipeline (for a camera) keeps the latest frames: a slow stage skips the frames it could not keep up with.
+	Without dropping (for files) every frame is processed and the source waits for the slowest stage.
+
+	The preprocessing writes the model input into reused tensors, the inference function maps the input to a label.
+*/
+class VideoPipeline
+{
+public:
+	using InferenceFunction = std::function<std::string(const mogi::Tensor3D& input)>;
+
+	VideoPipeline(std::unique_ptr<FrameSource> source, InferenceFunction inference, size_t inputRows = 128, size_t inputCols = 128,
+		size_t queueCapacity = 2, bool isDropping = true);
+	~VideoPipeline();
+
+	// Waits for the next result, returns false when the timeout is over or the pipeline is finished.
+	bool GetResult(VideoPipelineResult& result, std::chrono::milliseconds timeout = std::chrono::milliseconds::max());
+	// The latest preprocessed frame, it is not paced by the inference (for the display). False before the first frame.
+	bool GetLatestFrame(cv::Mat& frame) const;
+	// True when the source is exhausted and every result was taken.
+	bool IsFinished() const;
+	void Stop();
+
+	VideoPipelineStats GetStats() const;
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct Packet
+	{
+		cv::Mat Frame;
+		std::shared_ptr<mogi::Tensor3D> Input;
+		Clock::time_point CaptureTime;
+	};
+
+	void Capture();
+	void Preprocess();
+	void Infer();
+
+	// A tensor only owned by the pool, or a new one.
+	std::shared_ptr<mogi::Tensor3D> AcquireInput();
+
+private:
+	std::unique_ptr<FrameSource> m_Source;
+	InferenceFunction m_Inference;
+	size_t m_InputRows, m_InputCols;
+
+	FrameQueue<Packet> m_Captured;
+	FrameQueue<Packet> m_Preprocessed;
+	FrameQueue<VideoPipelineResult> m_Results;
+	std::vector<std::shared_ptr<mogi::Tensor3D>> m_InputPool;
+
+	mutable std::mutex m_LatestFrameMutex;
+	cv::Mat m_LatestFrame;
+
+	Clock::time_point m_StartTime;
+	mutable std::mutex m_StatsMutex;
+	size_t m_NumCaptured = 0;
+	Clock::time_point m_LastCaptureTime, m_LastResultTime;
+	mogi::LatencyWindow m_Latencies;
+
+	std::vector<std::thread> m_Threads;
+};
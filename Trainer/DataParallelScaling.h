@@ -0,0 +1,52 @@
+#pragma once
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <algorithm>
+
+#include <Mogi.h>
+#include "src/Timer.h"
+
+/*
+	Samples per second of the data parallel training against the number of replicas, on random 28x28 samples.
+*/
+void DataParallelScaling(size_t batchSize = 32, size_t numBatches = 20)
+{
+	mogi::Model model;
+	model.AddLayer(std::make_shared<mogi::ConvolutionalLayer>(28, 28, 1, 3, 3, 8, 1, mogi::RelU(0.0f), mogi::He(3 * 3)));
+	model.AddLayer(std::make_shared<mogi::MaxPoolingLayer>(28, 28, 8, 2, 2));
+	model.AddLayer(std::make_shared<mogi::ConvolutionalLayer>(14, 14, 8, 3, 3, 16, 1, mogi::RelU(0.0f), mogi::He(3 * 3 * 8)));
+	model.AddLayer(std::make_shared<mogi::MaxPoolingLayer>(14, 14, 16, 2, 2));
+	model.AddLayer(std::make_shared<mogi::ReshapeLayer>(7, 7, 16, 7 * 7 * 16, 1, 1));
+	model.AddLayer(std::make_shared<mogi::DenseLayer>(7 * 7 * 16, 10, mogi::Sigmoid(), mogi::Xavier(7 * 7 * 16, 10)));
+	model.InitializeOptimizer(mogi::OptimizerFactory(mogi::OptimizerType::SGD));
+
+	std::vector<mogi::Tensor3D> inputs, labels;
+	for (size_t i = 0; i < batchSize; i++)
+	{
+		inputs.push_back(mogi::Random3D(28, 28, 1, 0.0f, 1.0f));
+		mogi::Tensor3D label(10, 1, 1);
+		label.SetAt(i % 10, 0, 0, 1.0f);
+		labels.push_back(label);
+	}
+
+	mogi::Loss loss(mogi::CostType::MeanSquareError);
+	const size_t maxReplicas = std::max(1u, std::thread::hardware_concurrency());
+	double baseline = 0.0;
+	for (size_t numReplicas = 1; numReplicas <= maxReplicas; numReplicas *= 2)
+	{
+		mogi::DataParallelModel dataParallel(model, numReplicas, loss);
+		dataParallel.TrainBatch(inputs, labels, 0.01f, 0);  // Warm up.
+
+		Timer timer;
+		for (size_t t = 0; t < numBatches; t++)
+		{
+			dataParallel.TrainBatch(inputs, labels, 0.01f, t);
+		}
+		double samplesPerSecond = numBatches * batchSize / timer.GetTime();
+		baseline = numReplicas == 1 ? samplesPerSecond : baseline;
+
+		std::cout << "Replicas: " << std::setw(3) << numReplicas << " samples/s: " << std::setw(10) << samplesPerSecond <<
+			" speedup: " << samplesPerSecond / baseline << std::endl;
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <Mogi.h>
+#include <MogiDataset.h>
+
+/*
+	The numerical drift of the bfloat16 mixed precision training against the fp32 training on MNIST. The same model is trained in both modes
+	on the same samples, after every report interval the mean training cost, the largest param difference and the test accuracy are printed.
+*/
+void MixedPrecisionDrift(size_t numSamples = 10000, size_t reportInterval = 1000, size_t numTestSamples = 1000)
+{
+	std::string path = "C:/Dev/Szakdolgozat/Project/Trainer/Datasets/MNIST/";
+	mogi::dataset::MNISTDataset testingDataset(path + "t10k-images.idx3-ubyte", path + "t10k-labels.idx1-ubyte");
+	mogi::dataset::MNISTDataset trainingDataset(path + "train-images.idx3-ubyte", path + "train-labels.idx1-ubyte");
+
+	mogi::Model model;
+	model.AddLayer(std::make_shared<mogi::ConvolutionalLayer>(28, 28, 1, 3, 3, 8, 1, mogi::RelU(0.0f), mogi::He(3 * 3)));
+	model.AddLayer(std::make_shared<mogi::MaxPoolingLayer>(28, 28, 8, 2, 2));
+	model.AddLayer(std::make_shared<mogi::ConvolutionalLayer>(14, 14, 8, 3, 3, 10, 1, mogi::RelU(0.0f), mogi::He(3 * 3)));
+	model.AddLayer(std::make_shared<mogi::MaxPoolingLayer>(14, 14, 10, 2, 2));
+	model.AddLayer(std::make_shared<mogi::ConvolutionalLayer>(7, 7, 10, 3, 3, 12, 1, mogi::RelU(0.0f), mogi::He(3 * 3)));
+	model.AddLayer(std::make_shared<mogi::ReshapeLayer>(7, 7, 12, 7 * 7 * 12, 1, 1));
+	model.AddLayer(std::make_shared<mogi::DenseLayer>(7 * 7 * 12, 10, mogi::Sigmoid(), mogi::Xavier(7 * 7 * 12, 10)));
+	model.InitializeOptimizer(mogi::OptimizerFactory(mogi::OptimizerType::SGD));
+
+	mogi::Model mixedModel;
+	for (std::shared_ptr<mogi::Layer> layer = model.GetRootLayer(); layer; layer = layer->NextLayer)
+	{
+		mixedModel.AddLayer(layer->GetName(), layer->ToString());
+	}
+	mixedModel.SetMixedPrecision(true);
+	mixedModel.Summarize();
+
+	// Both models are tested on the same samples.
+	std::vector<mogi::dataset::Sample> testSamples;
+	for (size_t i = 0; i < numTestSamples; i++)
+	{
+		testSamples.push_back(testingDataset.GetSample());
+		testingDataset.Next();
+	}
+
+	auto accuracy = [&testSamples](const mogi::Model& testedModel) {
+		size_t numCorrect = 0;
+		for (mogi::dataset::Sample& sample : testSamples)
+		{
+			mogi::Tensor3D output = testedModel.FeedForward(sample.Input);
+			if (mogi::MaxPos(mogi::CreateWatcher(output, 0)).first == mogi::MaxPos(mogi::CreateWatcher(sample.Label, 0)).first)
+				numCorrect++;
+		}
+		return (float)numCorrect / (float)testSamples.size();
+	};
+
+	auto maxParamDifference = [&model, &mixedModel]() {
+		float difference = 0.0f;
+		for (std::shared_ptr<mogi::Layer> layer = model.GetRootLayer(), mixedLayer = mixedModel.GetRootLayer(); layer; layer = layer->NextLayer, mixedLayer = mixedLayer->NextLayer)
+		{
+			std::vector<mogi::LearnableTensor> tensors = layer->GetLearnableTensors();
+			std::vector<mogi::LearnableTensor> mixedTensors = mixedLayer->GetLearnableTensors();
+			for (size_t j = 0; j < tensors.size(); j++)
+			{
+				for (size_t i = 0; i < tensors[j].Params->GetSize(); i++)
+				{
+					difference = std::max(difference, std::abs(tensors[j].Params->GetData()[i] - mixedTensors[j].Params->GetData()[i]));
+				}
+			}
+		}
+		return difference;
+	};
+
+	mogi::Loss loss(mogi::CostType::MeanSquareError);
+	float cost = 0.0f, mixedCost = 0.0f;
+	for (size_t t = 0; t < numSamples; t++)
+	{
+		mogi::dataset::Sample sample = trainingDataset.GetSample();
+		trainingDataset.Next();
+
+		model.BackPropagation(sample.Input, loss.Bind(sample.Label), 0.01f, t);
+		cost += loss.GetLastCost();
+		mixedModel.BackPropagation(sample.Input, loss.Bind(sample.Label), 0.01f, t);
+		mixedCost += loss.GetLastCost();
+
+		if ((t + 1) % reportInterval == 0)
+		{
+			std::cout << "Samples: " << std::setw(7) << t + 1 <<
+				" cost fp32: " << std::setw(10) << cost / reportInterval << " bf16: " << std::setw(10) << mixedCost / reportInterval <<
+				" max param difference: " << std::setw(10) << maxParamDifference() <<
+				" accuracy fp32: " << std::setw(6) << accuracy(model) << " bf16: " << std::setw(6) << accuracy(mixedModel) << std::endl;
+			cost = 0.0f;
+			mixedCost = 0.0f;
+		}
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <iostream>
+#include <string>
+
+#include <Mogi.h>
+#include <MogiDataset.h>
+#include "src/ClassificationTrainer.h"
+
+/*
+	The XOR training as one rank of a multi process training on the host. Launch worldSize processes with the same name:
+		Trainer --rank 0 --world-size 2 --name xor
+		Trainer --rank 1 --world-size 2 --name xor
+	Every rank starts from rank 0's model and trains on its half of the dataset, rank 0 writes the checkpoint.
+*/
+void MultiProcessTraining(size_t rank, size_t worldSize, const std::string& name)
+{
+	mogi::ProcessGroup processGroup(name, rank, worldSize);
+
+	mogi::Model model;
+	model.AddLayer(std::make_shared<mogi::DenseLayer>(2, 3, mogi::Sigmoid(), mogi::Xavier(2, 3)));
+	model.AddLayer(std::make_shared<mogi::DenseLayer>(3, 1, mogi::Sigmoid(), mogi::Xavier(3, 1)));
+	model.InitializeOptimizer(mogi::OptimizerFactory(mogi::OptimizerType::SGD));
+
+	mogi::dataset::XORDataset dataset;
+
+	ClassificationTrainer trainer(
+		&model,
+		&dataset,
+		&dataset,
+		CostFunctionFactory(CostFunctionType::MeanSuareError),
+		false);
+	trainer.SetDataParallel(1, 2);
+	trainer.SetProcessGroup(&processGroup, name + "_checkpoint.txt");
+
+	trainer.Train(1000, 1.0f, 0.1f);
+
+	std::cout << "Rank " << rank << " finished." << std::endl;
+}
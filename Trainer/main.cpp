@@ -4,6 +4,9 @@
 #include "GeneralFacesTraining.h"
 #include "ImageCompareTraining.h"
 #include "FaceRecognitionTraining.h"
+#include "DataParallelScaling.h"
+#include "MultiProcessTraining.h"
+#include "MixedPrecisionDrift.h"
 
 #include "src/Timer.h"
 #include "src/ClassificationTrainer.h"
@@ -11,9 +14,25 @@
 
 int main(int argc, char* argv[])
 {
+	size_t rank = 0, worldSize = 0;
+	std::string name = "mogi_trainer";
 	for (int i = 0; i < argc; i++)
 	{
 		std::cout << argv[i] << std::endl;
+
+		std::string argument = argv[i];
+		if (argument == "--rank" && i + 1 < argc)
+			rank = std::stoul(argv[i + 1]);
+		else if (argument == "--world-size" && i + 1 < argc)
+			worldSize = std::stoul(argv[i + 1]);
+		else if (argument == "--name" && i + 1 < argc)
+			name = argv[i + 1];
+	}
+
+	if (worldSize)
+	{
+		MultiProcessTraining(rank, worldSize, name);
+		return 0;
 	}
 
 
@@ -21,6 +40,8 @@ int main(int argc, char* argv[])
 	//GeneralFaceTraining();
 	//ImageCompareTraining();
 	//FaceRecognitionTraining();
+	//DataParallelScaling();
+	//MixedPrecisionDrift();
 
 	{
 		/*
@@ -72,6 +93,34 @@ int main(int argc, char* argv[])
 		//trainer.Train(1000, 1.0f, 0.1f);
 
 		testing();
+
+		/*
+			The same model with compile time shapes: no allocation, virtual call or thread dispatch per inference.
+		*/
+		mogi::StaticModel<
+			mogi::StaticDense<2, 3, mogi::StaticSigmoid>,
+			mogi::StaticDense<3, 1, mogi::StaticSigmoid>> staticModel(simpleModel);
+
+		const int numInferences = 100000;
+		mogi::StaticTensor<2, 1, 1> staticInput(1.0f);
+		float sum = 0.0f;
+		Timer timer;
+		for (int i = 0; i < numInferences; i++)
+		{
+			sum += staticModel.FeedForward(staticInput)[0];
+		}
+		double staticTime = timer.GetTime();
+
+		mogi::Tensor3D input = staticInput.ToTensor3D();
+		timer.Restart();
+		for (int i = 0; i < numInferences; i++)
+		{
+			sum -= simpleModel.FeedForward(input).GetData()[0];
+		}
+		double modelTime = timer.GetTime();
+
+		std::cout << "Model: " << modelTime * 1e9 / numInferences << " ns, StaticModel: " << staticTime * 1e9 / numInferences <<
+			" ns per inference (difference: " << sum << ")" << std::endl;
 	}
 
 	{
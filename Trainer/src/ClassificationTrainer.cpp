@@ -23,6 +23,7 @@ float ClassificationTrainer::Validate(float* successRate) const
 		return 0.0f;
 	}
 
+	mogi::Loss loss = m_CostFunctionFactory.BuildLoss();
 	float cost = 0.0f;
 	float successCount = 0;
 	for (size_t i = 0; i < m_TestingDataset->GetEpochSize(); i++)
@@ -44,8 +45,7 @@ float ClassificationTrainer::Validate(float* successRate) const
 		if (outputMaxPos.first == labelMaxPos.first)
 			successCount++;
 
-		mogi::CostFunction loss = m_CostFunctionFactory.Build(testingSample.Label);
-		cost += loss.Cost(output);
+		cost += loss.Evaluate(output, testingSample.Label);
 	}
 
 	if (successRate)
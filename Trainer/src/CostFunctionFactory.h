@@ -30,6 +30,21 @@ public:
 		return mogi::CostFunction();
 	}
 
+	// The loss is built once and bound to every sample's label, instead of building a cost function per sample.
+	mogi::Loss BuildLoss() const
+	{
+		switch (m_Type)
+		{
+		case MeanSuareError:			return mogi::Loss(mogi::CostType::MeanSquareError);
+		case CrossEntropyLoss:			return mogi::Loss(mogi::CostType::CrossEntropy);
+		case BinaryCrossEntropyLoss:	return mogi::Loss(mogi::CostType::BinaryCrossEntropy);
+		default:
+			break;
+		}
+		assert(false && "Unknown cost function type!");
+		return mogi::Loss(mogi::CostType::MeanSquareError);
+	}
+
 private:
 	CostFunctionType m_Type;
 };
@@ -0,0 +1,39 @@
+#pragma once
+#include <Mogi.h>
+#include <MogiDataset.h>
+#include "Trainer.h"
+
+
+/*
+	Trains the shared tower of a siamese network with the triplet loss.
+	The datasets' inputs are the anchor, positive and negative images stacked as channels (see FaceTripletDataset),
+	the model embeds one of them.
+*/
+class EmbeddingTrainer : public Trainer
+{
+public:
+	EmbeddingTrainer(
+		mogi::Model* model,
+		mogi::dataset::Dataset* training,
+		mogi::dataset::Dataset* testing,
+		float margin,
+		bool useDevice
+	);
+
+	virtual void Train(
+		size_t epochs,
+		float startLearningRate,
+		float endLearningRate
+	);
+
+	// The success rate is the rate of the triplets where the positive is closer to the anchor than the negative.
+	virtual float Validate(float* successRate) const;
+
+private:
+	bool IsDatasetCompatible(const mogi::dataset::Dataset& dataset) const;
+	// The three embeddings of a triplet on the host.
+	void Embed(const mogi::Tensor3D& triplet, mogi::Tensor3D* images, mogi::Tensor3D* embeddings) const;
+
+private:
+	float m_Margin;
+};
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <iomanip>
+#include <cstdio>
 #include "Timer.h"
 #include "Trainer.h"
 
@@ -21,6 +22,30 @@ Trainer::Trainer(
 	}
 }
 
+void Trainer::SetDataParallel(size_t numReplicas, size_t batchSize, unsigned int seed)
+{
+	m_NumReplicas = numReplicas;
+	m_BatchSize = std::max(batchSize, size_t(1));
+	m_Seed = seed;
+}
+
+void Trainer::SetProcessGroup(mogi::ProcessGroup* processGroup, const std::string& checkpointPath)
+{
+	m_ProcessGroup = processGroup;
+	m_CheckpointPath = checkpointPath;
+}
+
+void Trainer::SetMixedPrecision(bool isMixedPrecision)
+{
+	m_IsMixedPrecision = isMixedPrecision;
+}
+
+void Trainer::SetPrefixCache(bool isCachingPrefix, const std::string& cachePath)
+{
+	m_IsCachingPrefix = isCachingPrefix;
+	m_PrefixCachePath = cachePath;
+}
+
 void Trainer::Train(
 	size_t epochs,
 	float startLearningRate,
@@ -35,63 +60,147 @@ void Trainer::Train(
 		return;
 	}
 
+	if (m_IsMixedPrecision)
+	{
+		if (m_UseDeivce)
+		{
+			std::cout << "The mixed precision training is host only!" << std::endl;
+			return;
+		}
+		m_Model->SetMixedPrecision(true);
+	}
+
+	// The outputs of the frozen prefix are calculated once on the host, before the model is moved to the device.
+	std::unique_ptr<mogi::dataset::PrefixCacheDataset> prefixCache;
+	if (m_IsCachingPrefix && m_Model->GetFrozenPrefix() > 0)
+	{
+		if (m_NumReplicas || m_ProcessGroup)
+		{
+			std::cout << "The prefix cache is not supported in the data parallel training!" << std::endl;
+			return;
+		}
+		prefixCache = std::make_unique<mogi::dataset::PrefixCacheDataset>(*m_TrainingDataset, *m_Model, m_PrefixCachePath, m_Seed);
+	}
+
 	if (m_UseDeivce)
 	{
 		m_Model->ToDevice();
 	}
 
+	mogi::Loss loss = m_CostFunctionFactory.BuildLoss();
+
+	mogi::dataset::Dataset* trainingDataset = prefixCache ? prefixCache.get() : m_TrainingDataset;
+	std::unique_ptr<mogi::dataset::ShardedDataset> shardedDataset;
+	std::unique_ptr<mogi::DataParallelModel> dataParallel;
+	if (m_NumReplicas || m_ProcessGroup)
+	{
+		if (m_UseDeivce)
+		{
+			std::cout << "The data parallel training is host only!" << std::endl;
+			return;
+		}
+		if (m_ProcessGroup)
+		{
+			shardedDataset = std::make_unique<mogi::dataset::ShardedDataset>(*m_TrainingDataset, m_ProcessGroup->GetRank(), m_ProcessGroup->GetWorldSize(), m_Seed);
+			trainingDataset = shardedDataset.get();
+		}
+		dataParallel = std::make_unique<mogi::DataParallelModel>(*m_Model, std::max(m_NumReplicas, size_t(1)), loss, m_Seed, m_ProcessGroup);
+	}
+	std::vector<mogi::Tensor3D> inputs, labels;
+	const size_t batchSize = dataParallel ? m_BatchSize : 1;
+	const size_t stepsPerEpoch = (trainingDataset->GetEpochSize() + batchSize - 1) / batchSize;
+	const bool isMainRank = !m_ProcessGroup || m_ProcessGroup->GetRank() == 0;
+	std::ostream nullOutput(nullptr);  // Discards the progress of the other ranks.
+	std::ostream& output = isMainRank ? std::cout : nullOutput;
+
 	for (size_t e = 0; e < epochs; e++)
 	{
 		float learningRate = startLearningRate + ((float)e / (float)epochs) * (endLearningRate - startLearningRate);
 		float avgLoss = 0.0f;
 		float avgStep = 0.0f;
 
-		std::cout << "Epoch " << std::setw(7) << "(" + std::to_string(e + 1) + "/" + std::to_string(epochs) + ") ";
-		std::cout << "[" << std::string(loadingBarTotal, ' ') << "] " << "0%" << " loss: " << avgLoss << " step: " << avgStep << "[ms]";
+		output << "Epoch " << std::setw(7) << "(" + std::to_string(e + 1) + "/" + std::to_string(epochs) + ") ";
+		output << "[" << std::string(loadingBarTotal, ' ') << "] " << "0%" << " loss: " << avgLoss << " step: " << avgStep << "[ms]";
 
 		Timer timer;
-		for (size_t t = 0; t < m_TrainingDataset->GetEpochSize(); t += 1)
+		for (size_t t = 0, step = 0; t < trainingDataset->GetEpochSize(); step++)
 		{
 			Timer stepTimer;
-			mogi::dataset::Sample trainingSample = m_TrainingDataset->GetSample();
-			m_TrainingDataset->Next();
-
-			if (m_UseDeivce)
+			float cost = 0.0f;
+			if (dataParallel)
 			{
-				trainingSample.Input.ToDevice();
-				trainingSample.Label.ToDevice();
+				inputs.clear();
+				labels.clear();
+				for (size_t i = 0; i < batchSize && t + i < trainingDataset->GetEpochSize(); i++)
+				{
+					mogi::dataset::Sample trainingSample = trainingDataset->GetSample();
+					trainingDataset->Next();
+					inputs.push_back(trainingSample.Input);
+					labels.push_back(trainingSample.Label);
+				}
+
+				cost = dataParallel->TrainBatch(inputs, labels, learningRate, step);
+				t += inputs.size();
 			}
+			else
+			{
+				mogi::dataset::Sample trainingSample = trainingDataset->GetSample();
+				trainingDataset->Next();
 
-			mogi::CostFunction loss = m_CostFunctionFactory.Build(trainingSample.Label);
-			m_Model->BackPropagation(trainingSample.Input, loss, learningRate, t);
+				if (m_UseDeivce)
+				{
+					trainingSample.Input.ToDevice();
+					trainingSample.Label.ToDevice();
+				}
 
-			mogi::Tensor3D output = m_Model->FeedForward(trainingSample.Input);
-			avgLoss *= t;
-			avgLoss += loss.Cost(output);
-			avgLoss /= t + 1;
+				// The cost is computed with the gradient during the back propagation, no extra feed forward is needed.
+				if (prefixCache)
+					m_Model->BackPropagationFromPrefix(trainingSample.Input, loss.Bind(trainingSample.Label), learningRate, t);
+				else
+					m_Model->BackPropagation(trainingSample.Input, loss.Bind(trainingSample.Label), learningRate, t);
+				cost = loss.GetLastCost();
+				t += 1;
+			}
+
+			avgLoss *= step;
+			avgLoss += cost;
+			avgLoss /= step + 1;
 
 			float stepDuration = stepTimer.GetTime() * 1000;
-			avgStep *= t;
+			avgStep *= step;
 			avgStep += stepDuration;
-			avgStep /= t + 1;
+			avgStep /= step + 1;
 
-			if ((t % std::max(size_t(1), (m_TrainingDataset->GetEpochSize() / 100)) == 0) || (t == (m_TrainingDataset->GetEpochSize() - 1)))
+			if ((step % std::max(size_t(1), (stepsPerEpoch / 100)) == 0) || (t == trainingDataset->GetEpochSize()))
 			{
-				float status = std::min((float)t / (float)(m_TrainingDataset->GetEpochSize() - 1), 1.0f);
+				float status = std::min((float)t / (float)trainingDataset->GetEpochSize(), 1.0f);
 				size_t loadingStatus = status * loadingBarTotal;
-				std::cout << "\r" << "Epoch " << std::setw(7) << "(" + std::to_string(e + 1) + "/" + std::to_string(epochs) + ") ";
-				std::cout << "[" << std::string(loadingStatus, '=') << std::string(loadingBarTotal - loadingStatus, ' ') << "] ";
-				std::cout << (size_t)(status * 100) << "%" << " loss: " << avgLoss << " step: " << (int)avgStep << "[ms]";
+				output << "\r" << "Epoch " << std::setw(7) << "(" + std::to_string(e + 1) + "/" + std::to_string(epochs) + ") ";
+				output << "[" << std::string(loadingStatus, '=') << std::string(loadingBarTotal - loadingStatus, ' ') << "] ";
+				output << (size_t)(status * 100) << "%" << " loss: " << avgLoss << " step: " << (int)avgStep << "[ms]";
 			}
 		}
 		double duration = timer.GetTime();
-		std::cout << " duration: " << duration << "[s]";
+		output << " duration: " << duration << "[s]";
+
+		if (isMainRank)
+		{
+			float successRate = 0.0f;
+			float averageCost = Validate(&successRate);
+
+			output << " Average cost: " << averageCost << " " << (successRate > -0.9f ? "Success rate: " + std::to_string(successRate) : "") << std::endl;
+		}
 
-		float successRate = 0.0f;
-		float averageCost = Validate(&successRate);
-		
-		std::cout << " Average cost: " << averageCost << " " << (successRate > -0.9f ? "Success rate: " + std::to_string(successRate) : "") << std::endl;
+		if (m_ProcessGroup && isMainRank && !m_CheckpointPath.empty())
+		{
+			// Written next to the checkpoint and renamed, a checkpoint is never read half written.
+			const std::string temporaryPath = m_CheckpointPath + ".tmp";
+			m_Model->Save(temporaryPath);
+			std::remove(m_CheckpointPath.c_str());
+			if (std::rename(temporaryPath.c_str(), m_CheckpointPath.c_str()) != 0)
+				output << "Could not write the checkpoint: " << m_CheckpointPath << std::endl;
+		}
 
-		m_TrainingDataset->Shuffle();
+		trainingDataset->Shuffle();
 	}
 }
\ No newline at end of file
@@ -24,10 +24,40 @@ public:
 	// Returns the average cost and set successRate. If there is no successRate in training set it to -1.
 	virtual float Validate(float* successRate=nullptr) const = 0;  
 
+	/*
+		Trains with numReplicas model replicas on as many threads (see mogi::DataParallelModel), one optimizer step per batch of batchSize samples.
+		The training is reproducible for a number of replicas and a seed. 0 replicas: the sequential training (one step per sample).
+	*/
+	void SetDataParallel(size_t numReplicas, size_t batchSize, unsigned int seed=0);
+
+	/*
+		Trains as one rank of a multi process training (see mogi::ProcessGroup), with max(1, numReplicas) replicas per process.
+		Every rank trains on its shard of the training dataset (its order must be the same in every process), the gradients are all reduced per step.
+		Rank 0 writes the model to the checkpoint path after every epoch (if the path is not empty), the other ranks do not print the progress.
+	*/
+	void SetProcessGroup(mogi::ProcessGroup* processGroup, const std::string& checkpointPath="");
+
+	// Trains the model in bfloat16 mixed precision (see mogi::Model::SetMixedPrecision), host only. The model keeps the mode after the training.
+	void SetMixedPrecision(bool isMixedPrecision);
+
+	/*
+		Caches the output of the model's frozen prefix (see mogi::Model::SetFrozen) for every training sample at the start of the training,
+		the epochs only train the layers after the prefix. In memory, or in the cache file (see mogi::dataset::PrefixCacheDataset).
+		The training dataset must give the same samples in every epoch. Not supported in the data parallel training.
+	*/
+	void SetPrefixCache(bool isCachingPrefix, const std::string& cachePath="");
+
 protected:
 	mogi::Model* m_Model;
 	mogi::dataset::Dataset* m_TrainingDataset;
 	mogi::dataset::Dataset* m_TestingDataset;
 	CostFunctionFactory m_CostFunctionFactory;
 	bool m_UseDeivce = false;
+	size_t m_NumReplicas = 0, m_BatchSize = 1;
+	unsigned int m_Seed = 0;
+	mogi::ProcessGroup* m_ProcessGroup = nullptr;
+	std::string m_CheckpointPath;
+	bool m_IsMixedPrecision = false;
+	bool m_IsCachingPrefix = false;
+	std::string m_PrefixCachePath;
 };